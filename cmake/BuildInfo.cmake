@@ -97,7 +97,7 @@ message(STATUS "")
 # Testing & Development
 # ============================================================================
 
-if(BUILD_STRESS_TEST OR HVIF_TOOLS_TESTS OR HVIF_TOOLS_SANITIZERS OR HVIF_TOOLS_WARNINGS)
+if(BUILD_STRESS_TEST OR BUILD_BENCHMARK OR HVIF_TOOLS_TESTS OR HVIF_TOOLS_SANITIZERS OR HVIF_TOOLS_WARNINGS)
     message(STATUS "Development options:")
     
     if(TARGET hvif-stress-test)
@@ -106,6 +106,12 @@ if(BUILD_STRESS_TEST OR HVIF_TOOLS_TESTS OR HVIF_TOOLS_SANITIZERS OR HVIF_TOOLS_
         message(STATUS "  Stress test:      FAILED")
     endif()
     
+    if(TARGET hvif-bench)
+        message(STATUS "  Benchmark:        ON")
+    elseif(BUILD_BENCHMARK)
+        message(STATUS "  Benchmark:        FAILED")
+    endif()
+    
     if(HVIF_TOOLS_TESTS)
         message(STATUS "  Tests:            ${HVIF_TOOLS_TESTS}")
     endif()
@@ -179,6 +185,10 @@ if(TARGET hvif-stress-test)
     list(APPEND _targets_list "hvif-stress-test")
 endif()
 
+if(TARGET hvif-bench)
+    list(APPEND _targets_list "hvif-bench")
+endif()
+
 if(TARGET HVIFThumbnailProvider)
     list(APPEND _targets_list "HVIFThumbnailProvider")
 endif()
@@ -30,11 +30,15 @@ if(TARGET hviftools)
     install(FILES
         ${CMAKE_SOURCE_DIR}/src/common/HaikuIcon.h
         ${CMAKE_SOURCE_DIR}/src/common/IconConverter.h
+        ${CMAKE_SOURCE_DIR}/src/common/ConversionCache.h
+        ${CMAKE_SOURCE_DIR}/src/common/IconArchive.h
         ${CMAKE_SOURCE_DIR}/src/common/IconAdapter.h
         ${CMAKE_SOURCE_DIR}/src/common/HVIFStructures.h
         ${CMAKE_SOURCE_DIR}/src/common/IOMStructures.h
         ${CMAKE_SOURCE_DIR}/src/common/Utils.h
         ${CMAKE_SOURCE_DIR}/src/common/BMessage.h
+        ${CMAKE_SOURCE_DIR}/src/common/BMessageBuilder.h
+        ${CMAKE_SOURCE_DIR}/src/common/BMessageView.h
         DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/hviftools/common
         COMPONENT e_devel
     )
@@ -44,6 +48,8 @@ if(TARGET hviftools)
         ${CMAKE_SOURCE_DIR}/src/import/IOMParser.h
         ${CMAKE_SOURCE_DIR}/src/import/SVGParser.h
         ${CMAKE_SOURCE_DIR}/src/import/PNGParser.h
+        ${CMAKE_SOURCE_DIR}/src/import/PNGDecoder.h
+        ${CMAKE_SOURCE_DIR}/src/import/TraceConverter.h
         DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/hviftools/import
         COMPONENT e_devel
     )
@@ -52,6 +58,8 @@ if(TARGET hviftools)
         ${CMAKE_SOURCE_DIR}/src/export/HVIFWriter.h
         ${CMAKE_SOURCE_DIR}/src/export/IOMWriter.h
         ${CMAKE_SOURCE_DIR}/src/export/SVGWriter.h
+        ${CMAKE_SOURCE_DIR}/src/export/PathOutliner.h
+        ${CMAKE_SOURCE_DIR}/src/export/PNGEncoder.h
         ${CMAKE_SOURCE_DIR}/src/export/PNGWriter.h
         DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/hviftools/export
         COMPONENT e_devel
@@ -92,6 +100,7 @@ if(TARGET imagetracer)
     install(FILES
         ${CMAKE_SOURCE_DIR}/src/tracer/core/ImageTracer.h
         ${CMAKE_SOURCE_DIR}/src/tracer/core/TracingOptions.h
+        ${CMAKE_SOURCE_DIR}/src/tracer/core/TracingStats.h
         ${CMAKE_SOURCE_DIR}/src/tracer/core/BitmapData.h
         ${CMAKE_SOURCE_DIR}/src/tracer/core/IndexedBitmap.h
         ${CMAKE_SOURCE_DIR}/src/tracer/core/VectorizationProgress.h
@@ -117,6 +126,7 @@ if(TARGET imagetracer)
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/BackgroundRemover.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/GeometryDetector.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/GradientDetector.h
+        ${CMAKE_SOURCE_DIR}/src/tracer/processing/ImagePyramid.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/PathHierarchy.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/PathScanner.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/PathSimplifier.h
@@ -124,6 +134,7 @@ if(TARGET imagetracer)
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/RegionMerger.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/SelectiveBlur.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/SharedEdgeRegistry.h
+        ${CMAKE_SOURCE_DIR}/src/tracer/processing/TileSeams.h
         ${CMAKE_SOURCE_DIR}/src/tracer/processing/VisvalingamWhyatt.h
         DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/imagetracer/processing
         COMPONENT e_devel
@@ -1,8 +1,5 @@
 #!/usr/bin/env python3
-import sys
-import os
 import subprocess
-import tempfile
 import shutil
 import inkex
 
@@ -13,40 +10,23 @@ class HVIFInput(inkex.InputExtension):
                 "icon2icon utility not found. Please install HVIF-Tools."
             )
 
-        with tempfile.NamedTemporaryFile(mode='wb', suffix='.hvif', delete=False) as hvif_file:
-            hvif_file.write(stream.read())
-            hvif_file.flush()
-            hvif_path = hvif_file.name
-        
         try:
-            with tempfile.NamedTemporaryFile(mode='r', suffix='.svg', delete=False) as svg_file:
-                svg_path = svg_file.name
-            
-            try:
-                result = subprocess.run(
-                    ['icon2icon', hvif_path, svg_path],
-                    capture_output=True,
-                    text=True,
-                    timeout=30
-                )
-            except subprocess.TimeoutExpired:
-                raise inkex.AbortExtension("HVIF conversion timeout exceeded (30s)")
-            except FileNotFoundError:
-                raise inkex.AbortExtension("icon2icon not found in PATH")
-            
-            if result.returncode != 0:
-                raise inkex.AbortExtension(f"Failed to convert HVIF file: {result.stderr}")
-            
-            with open(svg_path, 'rb') as f:
-                svg_content = f.read()
-            
-            return svg_content
-            
-        finally:
-            if os.path.exists(hvif_path):
-                os.unlink(hvif_path)
-            if 'svg_path' in locals() and os.path.exists(svg_path):
-                os.unlink(svg_path)
+            result = subprocess.run(
+                ['icon2icon', '-', '-', '-f', 'svg'],
+                input=stream.read(),
+                capture_output=True,
+                timeout=30
+            )
+        except subprocess.TimeoutExpired:
+            raise inkex.AbortExtension("HVIF conversion timeout exceeded (30s)")
+        except FileNotFoundError:
+            raise inkex.AbortExtension("icon2icon not found in PATH")
+
+        if result.returncode != 0:
+            stderr = result.stderr.decode('utf-8', 'replace')
+            raise inkex.AbortExtension(f"Failed to convert HVIF file: {stderr}")
+
+        return result.stdout
 
 if __name__ == '__main__':
     HVIFInput().run()
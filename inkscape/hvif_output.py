@@ -1,8 +1,5 @@
 #!/usr/bin/env python3
-import sys
-import os
 import subprocess
-import tempfile
 import shutil
 import inkex
 
@@ -13,38 +10,23 @@ class HVIFOutput(inkex.OutputExtension):
                 "icon2icon utility not found. Please install HVIF-Tools."
             )
 
-        with tempfile.NamedTemporaryFile(mode='w', suffix='.svg', delete=False) as svg_file:
-            svg_file.write(self.document.getroot().tostring().decode('utf-8'))
-            svg_file.flush()
-            svg_path = svg_file.name
-        
         try:
-            with tempfile.NamedTemporaryFile(mode='rb', suffix='.hvif', delete=False) as hvif_file:
-                hvif_path = hvif_file.name
-            
-            try:
-                result = subprocess.run(
-                    ['icon2icon', svg_path, hvif_path],
-                    capture_output=True,
-                    text=True,
-                    timeout=30
-                )
-            except subprocess.TimeoutExpired:
-                raise inkex.AbortExtension("HVIF conversion timeout exceeded (30s)")
-            except FileNotFoundError:
-                raise inkex.AbortExtension("icon2icon not found in PATH")
-            
-            if result.returncode != 0:
-                raise inkex.AbortExtension(f"Failed to convert to HVIF: {result.stderr}")
-            
-            with open(hvif_path, 'rb') as f:
-                stream.write(f.read())
-            
-        finally:
-            if os.path.exists(svg_path):
-                os.unlink(svg_path)
-            if 'hvif_path' in locals() and os.path.exists(hvif_path):
-                os.unlink(hvif_path)
+            result = subprocess.run(
+                ['icon2icon', '-', '-', '-f', 'hvif'],
+                input=self.document.getroot().tostring(),
+                capture_output=True,
+                timeout=30
+            )
+        except subprocess.TimeoutExpired:
+            raise inkex.AbortExtension("HVIF conversion timeout exceeded (30s)")
+        except FileNotFoundError:
+            raise inkex.AbortExtension("icon2icon not found in PATH")
+
+        if result.returncode != 0:
+            stderr = result.stderr.decode('utf-8', 'replace')
+            raise inkex.AbortExtension(f"Failed to convert to HVIF: {stderr}")
+
+        stream.write(result.stdout)
 
 if __name__ == '__main__':
     HVIFOutput().run()
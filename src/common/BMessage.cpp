@@ -604,7 +604,7 @@ BMessage::_ValidateMessage()
 
 
 uint32_t
-BMessage::_HashName(const char* name) const
+BMessage::_HashName(const char* name)
 {
 	char ch;
 	uint32_t result = 0;
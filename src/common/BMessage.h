@@ -402,6 +402,9 @@ public:
 			class Private;
 
 private:
+	friend class BMessageBuilder;
+	friend class BMessageView;
+
 			enum {
 				MESSAGE_FORMAT_R5				= 'FOB1',
 				MESSAGE_FORMAT_R5_SWAPPED		= '1BOF',
@@ -486,7 +489,7 @@ private:
 			status_t			_Clear();
 			status_t			_ValidateMessage();
 
-			uint32_t			_HashName(const char* name) const;
+	static	uint32_t			_HashName(const char* name);
 			status_t			_FindField(const char* name, type_code type,
 									field_header** result) const;
 
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+
+#include "BMessageBuilder.h"
+
+namespace haiku_compat {
+
+static const size_t kInitialBuckets = 16;
+static const size_t kNoSizePrefix = (size_t)-1;
+
+
+BMessageBuilder::BMessageBuilder(std::vector<uint8_t>& buffer, uint32_t what,
+	int32_t fieldCountHint)
+	:
+	fBuffer(buffer),
+	fDepth(0)
+{
+	_OpenLevel(what, fieldCountHint, kNoSizePrefix, -1);
+}
+
+
+void
+BMessageBuilder::_Grow(size_t extra)
+{
+	size_t needed = fBuffer.size() + extra;
+	if (needed > fBuffer.capacity())
+		fBuffer.reserve(std::max(needed, fBuffer.capacity() * 2));
+	fBuffer.resize(needed);
+}
+
+
+void
+BMessageBuilder::_OpenLevel(uint32_t what, int32_t fieldCountHint,
+	size_t sizePrefix, int32_t parentField)
+{
+	// Levels are kept around after they close so their field tables keep
+	// their capacity for the next message at the same depth.
+	if (fLevels.size() <= fDepth)
+		fLevels.resize(fDepth + 1);
+
+	Level& level = fLevels[fDepth++];
+	level.start = fBuffer.size();
+	level.sizePrefix = sizePrefix;
+	level.parentField = parentField;
+	level.what = what;
+	level.flags = 0;
+	level.fields.clear();
+	level.chain.clear();
+	level.buckets.assign(kInitialBuckets, -1);
+
+	_Grow(sizeof(message_header)
+		+ std::max(fieldCountHint, (int32_t)0) * sizeof(field_header));
+	level.dataStart = fBuffer.size();
+}
+
+
+status_t
+BMessageBuilder::_CloseLevel()
+{
+	Level& level = fLevels[fDepth - 1];
+
+	uint32_t fieldCount = (uint32_t)level.fields.size();
+	size_t headerSize = sizeof(message_header)
+		+ fieldCount * sizeof(field_header);
+	size_t reserved = level.dataStart - level.start;
+	if (reserved < headerSize) {
+		fBuffer.insert(fBuffer.begin() + level.dataStart,
+			headerSize - reserved, 0);
+	} else if (reserved > headerSize) {
+		fBuffer.erase(fBuffer.begin() + level.start + headerSize,
+			fBuffer.begin() + level.dataStart);
+	}
+	level.dataStart = level.start + headerSize;
+
+	message_header header;
+	memset(&header, 0, sizeof(header));
+	header.format = BMessage::MESSAGE_FORMAT_HAIKU;
+	header.flags = level.flags;
+	header.what = level.what;
+	header.current_specifier = -1;
+	header.message_area = -1;
+	header.unused1 = 0xFFFFFFFF;
+	header.unused2 = 0xFFFFFFFF;
+	header.unused3 = 0xFFFFFFFF;
+	header.unused4 = 0xFFFFFFFF;
+	header.data_size = (uint32_t)(fBuffer.size() - level.dataStart);
+	header.field_count = fieldCount;
+	header.hash_table_size = BMessage::MESSAGE_BODY_HASH_TABLE_SIZE;
+
+	// Chain the fields in insertion order, as BMessage::_AddField does.
+	int32_t tails[BMessage::MESSAGE_BODY_HASH_TABLE_SIZE];
+	for (uint32_t i = 0; i < BMessage::MESSAGE_BODY_HASH_TABLE_SIZE; i++) {
+		header.hash_table[i] = -1;
+		tails[i] = -1;
+	}
+
+	for (uint32_t i = 0; i < fieldCount; i++) {
+		field_header& field = level.fields[i];
+		const char* name = (const char*)&fBuffer[level.dataStart + field.offset];
+		uint32_t hash = BMessage::_HashName(name) % header.hash_table_size;
+
+		field.next_field = -1;
+		if (tails[hash] < 0)
+			header.hash_table[hash] = i;
+		else
+			level.fields[tails[hash]].next_field = i;
+		tails[hash] = i;
+	}
+
+	memcpy(&fBuffer[level.start], &header, sizeof(header));
+	if (fieldCount > 0) {
+		memcpy(&fBuffer[level.start + sizeof(header)], &level.fields[0],
+			fieldCount * sizeof(field_header));
+	}
+
+	if (level.sizePrefix == kNoSizePrefix) {
+		fDepth--;
+		return B_OK;
+	}
+
+	uint32_t messageSize = (uint32_t)(fBuffer.size() - level.start);
+	memcpy(&fBuffer[level.sizePrefix], &messageSize, sizeof(uint32_t));
+
+	Level& parent = fLevels[fDepth - 2];
+	field_header& field = parent.fields[level.parentField];
+	size_t itemSize = sizeof(uint32_t) + messageSize;
+
+	// The item was written at the end of the buffer. If other fields of
+	// the parent were added after this one, rotate the item back to the
+	// end of its own field.
+	size_t fieldEnd = parent.dataStart + field.offset + field.name_length
+		+ field.data_size;
+	if (fieldEnd != level.sizePrefix) {
+		std::rotate(fBuffer.begin() + fieldEnd,
+			fBuffer.begin() + level.sizePrefix, fBuffer.end());
+		for (size_t i = 0; i < parent.fields.size(); i++) {
+			if (parent.fields[i].offset > field.offset)
+				parent.fields[i].offset += itemSize;
+		}
+	}
+
+	field.data_size += itemSize;
+	field.count++;
+	fDepth--;
+	return B_OK;
+}
+
+
+void
+BMessageBuilder::_IndexField(Level& level, int32_t index, uint32_t hash)
+{
+	if (level.fields.size() > level.buckets.size()) {
+		level.buckets.assign(level.buckets.size() * 2, -1);
+		for (int32_t i = 0; i < index; i++) {
+			const char* name = (const char*)&fBuffer[level.dataStart
+				+ level.fields[i].offset];
+			size_t bucket = BMessage::_HashName(name)
+				& (level.buckets.size() - 1);
+			level.chain[i] = level.buckets[bucket];
+			level.buckets[bucket] = i;
+		}
+	}
+
+	size_t bucket = hash & (level.buckets.size() - 1);
+	level.chain.push_back(level.buckets[bucket]);
+	level.buckets[bucket] = index;
+}
+
+
+status_t
+BMessageBuilder::_FindOrAddField(const char* name, type_code type,
+	bool isFixedSize, int32_t* fieldIndex)
+{
+	if (name == NULL)
+		return B_BAD_VALUE;
+
+	if (fDepth == 0)
+		return B_NO_INIT;
+
+	Level& level = fLevels[fDepth - 1];
+	uint32_t hash = BMessage::_HashName(name);
+
+	int32_t index = level.buckets[hash & (level.buckets.size() - 1)];
+	while (index >= 0) {
+		const field_header& field = level.fields[index];
+		if (strcmp((const char*)&fBuffer[level.dataStart + field.offset],
+				name) == 0) {
+			if (field.type != type)
+				return B_BAD_TYPE;
+
+			*fieldIndex = index;
+			return B_OK;
+		}
+		index = level.chain[index];
+	}
+
+	field_header field;
+	field.flags = BMessage::FIELD_FLAG_VALID;
+	if (isFixedSize)
+		field.flags |= BMessage::FIELD_FLAG_FIXED_SIZE;
+	field.name_length = (uint16_t)(strlen(name) + 1);
+	field.type = type;
+	field.count = 0;
+	field.data_size = 0;
+	field.offset = (uint32_t)(fBuffer.size() - level.dataStart);
+	field.next_field = -1;
+
+	_Grow(field.name_length);
+	memcpy(&fBuffer[level.dataStart + field.offset], name, field.name_length);
+
+	level.fields.push_back(field);
+	*fieldIndex = (int32_t)level.fields.size() - 1;
+	_IndexField(level, *fieldIndex, hash);
+	return B_OK;
+}
+
+
+size_t
+BMessageBuilder::_MakeRoom(Level& level, int32_t fieldIndex, size_t numBytes)
+{
+	field_header& field = level.fields[fieldIndex];
+	size_t position = level.dataStart + field.offset + field.name_length
+		+ field.data_size;
+
+	if (position == fBuffer.size()) {
+		_Grow(numBytes);
+		return position;
+	}
+
+	// Adding to a field that is not the last one; everything behind it
+	// moves up.
+	fBuffer.insert(fBuffer.begin() + position, numBytes, 0);
+	for (size_t i = 0; i < level.fields.size(); i++) {
+		if (level.fields[i].offset > field.offset)
+			level.fields[i].offset += numBytes;
+	}
+
+	return position;
+}
+
+
+status_t
+BMessageBuilder::AddData(const char* name, type_code type, const void* data,
+	ssize_t numBytes, bool isFixedSize)
+{
+	if (numBytes <= 0 || data == NULL)
+		return B_BAD_VALUE;
+
+	int32_t fieldIndex;
+	status_t result = _FindOrAddField(name, type, isFixedSize, &fieldIndex);
+	if (result != B_OK)
+		return result;
+
+	Level& level = fLevels[fDepth - 1];
+	field_header& field = level.fields[fieldIndex];
+
+	if ((field.flags & BMessage::FIELD_FLAG_FIXED_SIZE) != 0) {
+		if (field.count > 0 && field.data_size / field.count != (uint32_t)numBytes)
+			return B_BAD_VALUE;
+
+		size_t position = _MakeRoom(level, fieldIndex, numBytes);
+		memcpy(&fBuffer[position], data, numBytes);
+		field.data_size += numBytes;
+	} else {
+		uint32_t size = (uint32_t)numBytes;
+		size_t position = _MakeRoom(level, fieldIndex, sizeof(uint32_t) + size);
+		memcpy(&fBuffer[position], &size, sizeof(uint32_t));
+		memcpy(&fBuffer[position + sizeof(uint32_t)], data, size);
+		field.data_size += sizeof(uint32_t) + size;
+	}
+
+	field.count++;
+	return B_OK;
+}
+
+
+status_t
+BMessageBuilder::AddBool(const char* name, bool value)
+{
+	return AddData(name, B_BOOL_TYPE, &value, sizeof(value), true);
+}
+
+
+status_t
+BMessageBuilder::AddInt32(const char* name, int32_t value)
+{
+	return AddData(name, B_INT32_TYPE, &value, sizeof(value), true);
+}
+
+
+status_t
+BMessageBuilder::AddFloat(const char* name, float value)
+{
+	return AddData(name, B_FLOAT_TYPE, &value, sizeof(value), true);
+}
+
+
+status_t
+BMessageBuilder::AddDouble(const char* name, double value)
+{
+	return AddData(name, B_DOUBLE_TYPE, &value, sizeof(value), true);
+}
+
+
+status_t
+BMessageBuilder::AddString(const char* name, const char* string)
+{
+	if (string == NULL)
+		return B_BAD_VALUE;
+
+	return AddData(name, B_STRING_TYPE, string, strlen(string) + 1, false);
+}
+
+
+status_t
+BMessageBuilder::AddString(const char* name, const std::string& string)
+{
+	return AddData(name, B_STRING_TYPE, string.c_str(), string.length() + 1,
+		false);
+}
+
+
+status_t
+BMessageBuilder::AddPoint(const char* name, BPoint point)
+{
+	return AddData(name, B_POINT_TYPE, &point, sizeof(point), true);
+}
+
+
+status_t
+BMessageBuilder::BeginMessage(const char* name, uint32_t what,
+	int32_t fieldCountHint)
+{
+	int32_t fieldIndex;
+	status_t result = _FindOrAddField(name, B_MESSAGE_TYPE, false, &fieldIndex);
+	if (result != B_OK)
+		return result;
+
+	size_t sizePrefix = fBuffer.size();
+	_Grow(sizeof(uint32_t));
+	_OpenLevel(what, fieldCountHint, sizePrefix, fieldIndex);
+	return B_OK;
+}
+
+
+status_t
+BMessageBuilder::EndMessage()
+{
+	if (fDepth < 2)
+		return B_BAD_VALUE;
+
+	return _CloseLevel();
+}
+
+
+status_t
+BMessageBuilder::SetFlags(uint32_t flags)
+{
+	if (fDepth == 0)
+		return B_NO_INIT;
+
+	fLevels[fDepth - 1].flags = flags;
+	return B_OK;
+}
+
+
+status_t
+BMessageBuilder::Finish()
+{
+	if (fDepth != 1)
+		return fDepth == 0 ? B_NO_INIT : B_BAD_VALUE;
+
+	return _CloseLevel();
+}
+
+}
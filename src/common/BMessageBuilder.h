@@ -0,0 +1,85 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef BMESSAGE_BUILDER_H
+#define BMESSAGE_BUILDER_H
+
+#include <vector>
+
+#include "BMessage.h"
+
+namespace haiku_compat {
+
+// Writes a flattened Haiku-format message straight into a byte buffer.
+// Nested messages are opened with BeginMessage() and written in place as
+// items of the enclosing field; no intermediate BMessage is flattened or
+// copied. Field names are looked up through a per-message hash index.
+//
+// A field header slot is reserved for each expected field of a message
+// (see BeginMessage()); if the guess is off the message's data is moved
+// once when it is closed. The output matches BMessage::Flatten() for the
+// same sequence of Add calls.
+class BMessageBuilder {
+public:
+								BMessageBuilder(std::vector<uint8_t>& buffer,
+									uint32_t what, int32_t fieldCountHint = 0);
+
+			status_t			AddData(const char* name, type_code type,
+									const void* data, ssize_t numBytes,
+									bool isFixedSize = true);
+			status_t			AddBool(const char* name, bool value);
+			status_t			AddInt32(const char* name, int32_t value);
+			status_t			AddFloat(const char* name, float value);
+			status_t			AddDouble(const char* name, double value);
+			status_t			AddString(const char* name,
+									const char* string);
+			status_t			AddString(const char* name,
+									const std::string& string);
+			status_t			AddPoint(const char* name, BPoint point);
+
+			status_t			BeginMessage(const char* name, uint32_t what,
+									int32_t fieldCountHint = 0);
+			status_t			EndMessage();
+			status_t			SetFlags(uint32_t flags);
+
+			// Closes the top-level message. The buffer holds the complete
+			// flattened message afterwards.
+			status_t			Finish();
+
+private:
+			typedef BMessage::message_header message_header;
+			typedef BMessage::field_header field_header;
+
+			struct Level {
+				size_t			start;
+				size_t			dataStart;
+				size_t			sizePrefix;
+				int32_t			parentField;
+				uint32_t		what;
+				uint32_t		flags;
+				std::vector<field_header> fields;
+				std::vector<int32_t> buckets;
+				std::vector<int32_t> chain;
+			};
+
+			void				_Grow(size_t extra);
+			void				_OpenLevel(uint32_t what, int32_t fieldCountHint,
+									size_t sizePrefix, int32_t parentField);
+			status_t			_CloseLevel();
+			status_t			_FindOrAddField(const char* name, type_code type,
+									bool isFixedSize, int32_t* fieldIndex);
+			void				_IndexField(Level& level, int32_t index,
+									uint32_t hash);
+			size_t				_MakeRoom(Level& level, int32_t fieldIndex,
+									size_t numBytes);
+
+			std::vector<uint8_t>& fBuffer;
+			std::vector<Level>	fLevels;
+			size_t				fDepth;
+};
+
+}
+
+#endif
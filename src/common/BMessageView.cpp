@@ -0,0 +1,422 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "BMessageView.h"
+
+namespace haiku_compat {
+
+BMessageView::BMessageView()
+	:
+	fFields(NULL),
+	fData(NULL),
+	fSwapFields(false),
+	fInitStatus(B_NO_INIT)
+{
+	memset(&fHeader, 0, sizeof(fHeader));
+}
+
+
+status_t
+BMessageView::SetTo(const void* flatBuffer, ssize_t size)
+{
+	Unset();
+
+	if (flatBuffer == NULL || size < (ssize_t)sizeof(message_header))
+		return fInitStatus = B_BAD_VALUE;
+
+	memcpy(&fHeader, flatBuffer, sizeof(message_header));
+
+	bool needSwap = false;
+	uint32_t format = fHeader.format;
+	if (format == BMessage::MESSAGE_FORMAT_HAIKU_SWAPPED) {
+		needSwap = true;
+		format = BMessage::_SwapUInt32(format);
+	}
+
+	// Only the native Haiku layout can be read in place; R5 and Dano
+	// messages have to go through BMessage::Unflatten.
+	if (format != BMessage::MESSAGE_FORMAT_HAIKU) {
+		Unset();
+		return fInitStatus = B_BAD_DATA;
+	}
+
+	if (needSwap) {
+		fHeader.what = BMessage::_SwapUInt32(fHeader.what);
+		fHeader.data_size = BMessage::_SwapUInt32(fHeader.data_size);
+		fHeader.field_count = BMessage::_SwapUInt32(fHeader.field_count);
+		fHeader.hash_table_size = BMessage::_SwapUInt32(fHeader.hash_table_size);
+		for (uint32_t i = 0; i < 5; i++)
+			fHeader.hash_table[i] = BMessage::_SwapInt32(fHeader.hash_table[i]);
+	}
+
+	if (fHeader.field_count > 10000) {
+		Unset();
+		return fInitStatus = B_BAD_DATA;
+	}
+
+	size_t fieldsSize = fHeader.field_count * sizeof(field_header);
+	if ((size_t)size < sizeof(message_header) + fieldsSize + fHeader.data_size) {
+		Unset();
+		return fInitStatus = B_BAD_DATA;
+	}
+
+	const uint8_t* buffer = (const uint8_t*)flatBuffer;
+	fFields = buffer + sizeof(message_header);
+	fData = fFields + fieldsSize;
+	fSwapFields = needSwap;
+
+	return fInitStatus = _ValidateFields();
+}
+
+
+status_t
+BMessageView::SetTo(const BMessage& message)
+{
+	Unset();
+
+	if (message.fHeader == NULL) {
+		fHeader.what = message.what;
+		return fInitStatus = B_OK;
+	}
+
+	memcpy(&fHeader, message.fHeader, sizeof(message_header));
+	fHeader.what = message.what;
+	fFields = (const uint8_t*)message.fFields;
+	fData = message.fData;
+	fSwapFields = false;
+
+	return fInitStatus = _ValidateFields();
+}
+
+
+void
+BMessageView::Unset()
+{
+	memset(&fHeader, 0, sizeof(fHeader));
+	fFields = NULL;
+	fData = NULL;
+	fSwapFields = false;
+	fInitStatus = B_NO_INIT;
+	fItemTable.clear();
+	fItemOffsets.clear();
+}
+
+
+status_t
+BMessageView::_ValidateFields()
+{
+	if (fHeader.field_count > 0 && (fFields == NULL || fData == NULL)) {
+		Unset();
+		return B_BAD_DATA;
+	}
+
+	if (fHeader.hash_table_size == 0 || fHeader.hash_table_size > 5)
+		fHeader.hash_table_size = 0;
+
+	for (uint32_t i = 0; i < fHeader.field_count; i++) {
+		field_header field;
+		_ReadField(i, &field);
+
+		if (field.next_field >= 0
+			&& (uint32_t)field.next_field > fHeader.field_count) {
+			Unset();
+			return B_BAD_DATA;
+		}
+
+		uint64_t fieldEnd = (uint64_t)field.offset + field.name_length
+			+ field.data_size;
+		if (fieldEnd > fHeader.data_size) {
+			Unset();
+			return B_BAD_DATA;
+		}
+	}
+
+	return B_OK;
+}
+
+
+void
+BMessageView::_ReadField(uint32_t index, field_header* field) const
+{
+	memcpy(field, fFields + index * sizeof(field_header), sizeof(field_header));
+	if (!fSwapFields)
+		return;
+
+	field->flags = BMessage::_SwapUInt16(field->flags);
+	field->name_length = BMessage::_SwapUInt16(field->name_length);
+	field->type = BMessage::_SwapUInt32(field->type);
+	field->count = BMessage::_SwapUInt32(field->count);
+	field->data_size = BMessage::_SwapUInt32(field->data_size);
+	field->offset = BMessage::_SwapUInt32(field->offset);
+	field->next_field = BMessage::_SwapInt32(field->next_field);
+}
+
+
+status_t
+BMessageView::_FindField(const char* name, type_code type,
+	uint32_t* fieldIndex, field_header* field) const
+{
+	if (name == NULL)
+		return B_BAD_VALUE;
+
+	if (fInitStatus != B_OK)
+		return B_NO_INIT;
+
+	if (fHeader.field_count == 0)
+		return B_NAME_NOT_FOUND;
+
+	if (fHeader.hash_table_size > 0) {
+		int32_t nextField = fHeader.hash_table[BMessage::_HashName(name)
+			% fHeader.hash_table_size];
+
+		// Chains are bounded by the field count so a corrupt table
+		// cannot loop forever.
+		for (uint32_t steps = 0; nextField >= 0
+				&& (uint32_t)nextField < fHeader.field_count
+				&& steps < fHeader.field_count; steps++) {
+			_ReadField(nextField, field);
+			if ((field->flags & BMessage::FIELD_FLAG_VALID) == 0)
+				break;
+
+			if (strncmp((const char*)(fData + field->offset), name,
+				field->name_length) == 0) {
+				if (type != B_ANY_TYPE && field->type != type)
+					return B_BAD_TYPE;
+
+				*fieldIndex = nextField;
+				return B_OK;
+			}
+
+			nextField = field->next_field;
+		}
+	}
+
+	for (uint32_t i = 0; i < fHeader.field_count; i++) {
+		_ReadField(i, field);
+		if ((field->flags & BMessage::FIELD_FLAG_VALID) == 0)
+			continue;
+
+		if (strncmp((const char*)(fData + field->offset), name,
+			field->name_length) == 0) {
+			if (type != B_ANY_TYPE && field->type != type)
+				return B_BAD_TYPE;
+
+			*fieldIndex = i;
+			return B_OK;
+		}
+	}
+
+	return B_NAME_NOT_FOUND;
+}
+
+
+status_t
+BMessageView::_ItemOffset(uint32_t fieldIndex, const field_header& field,
+	int32_t index, uint32_t* offset) const
+{
+	uint32_t start = field.offset + field.name_length;
+
+	if ((field.flags & BMessage::FIELD_FLAG_FIXED_SIZE) != 0) {
+		*offset = start + index * (field.data_size / field.count);
+		return B_OK;
+	}
+
+	if (index == 0) {
+		uint32_t itemSize;
+		if (field.data_size < sizeof(uint32_t))
+			return B_BAD_DATA;
+		memcpy(&itemSize, fData + start, sizeof(uint32_t));
+		if (itemSize > field.data_size - sizeof(uint32_t))
+			return B_BAD_DATA;
+
+		*offset = start;
+		return B_OK;
+	}
+
+	if (fItemTable.empty())
+		fItemTable.assign(fHeader.field_count, -1);
+
+	if (fItemTable[fieldIndex] < 0) {
+		// Walk the size-prefixed items once and remember where each
+		// one starts.
+		uint32_t end = start + field.data_size;
+		uint32_t position = start;
+		size_t first = fItemOffsets.size();
+		for (uint32_t i = 0; i < field.count; i++) {
+			uint32_t itemSize;
+			if (end - position < sizeof(uint32_t)) {
+				fItemOffsets.resize(first);
+				return B_BAD_DATA;
+			}
+			memcpy(&itemSize, fData + position, sizeof(uint32_t));
+			if (itemSize > end - position - sizeof(uint32_t)) {
+				fItemOffsets.resize(first);
+				return B_BAD_DATA;
+			}
+
+			fItemOffsets.push_back(position);
+			position += sizeof(uint32_t) + itemSize;
+		}
+		fItemTable[fieldIndex] = (int32_t)first;
+	}
+
+	*offset = fItemOffsets[fItemTable[fieldIndex] + index];
+	return B_OK;
+}
+
+
+status_t
+BMessageView::GetInfo(const char* name, type_code* typeFound,
+	int32_t* countFound) const
+{
+	uint32_t fieldIndex;
+	field_header field;
+	status_t result = _FindField(name, B_ANY_TYPE, &fieldIndex, &field);
+	if (result != B_OK)
+		return result;
+
+	if (typeFound != NULL)
+		*typeFound = field.type;
+	if (countFound != NULL)
+		*countFound = field.count;
+
+	return B_OK;
+}
+
+
+status_t
+BMessageView::FindData(const char* name, type_code type, int32_t index,
+	const void** data, ssize_t* numBytes) const
+{
+	if (data == NULL)
+		return B_BAD_VALUE;
+
+	*data = NULL;
+	uint32_t fieldIndex;
+	field_header field;
+	status_t result = _FindField(name, type, &fieldIndex, &field);
+	if (result != B_OK)
+		return result;
+
+	if (index < 0 || (uint32_t)index >= field.count)
+		return B_BAD_INDEX;
+
+	uint32_t offset;
+	result = _ItemOffset(fieldIndex, field, index, &offset);
+	if (result != B_OK)
+		return result;
+
+	if ((field.flags & BMessage::FIELD_FLAG_FIXED_SIZE) != 0) {
+		*data = fData + offset;
+		if (numBytes != NULL)
+			*numBytes = field.data_size / field.count;
+	} else {
+		uint32_t size;
+		memcpy(&size, fData + offset, sizeof(uint32_t));
+		*data = fData + offset + sizeof(uint32_t);
+		if (numBytes != NULL)
+			*numBytes = size;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+BMessageView::FindData(const char* name, type_code type, const void** data,
+	ssize_t* numBytes) const
+{
+	return FindData(name, type, 0, data, numBytes);
+}
+
+
+#define DEFINE_FIND_FUNCTIONS(type, typeName, typeCode) \
+status_t \
+BMessageView::Find##typeName(const char* name, type* value) const \
+{ \
+	return Find##typeName(name, 0, value); \
+} \
+\
+\
+status_t \
+BMessageView::Find##typeName(const char* name, int32_t index, \
+	type* value) const \
+{ \
+	if (value == NULL) \
+		return B_BAD_VALUE; \
+	\
+	const void* ptr = NULL; \
+	ssize_t bytes = 0; \
+	status_t error = FindData(name, typeCode, index, &ptr, &bytes); \
+	\
+	if (error == B_OK && bytes == sizeof(type)) \
+		memcpy(value, ptr, sizeof(type)); \
+	\
+	return error; \
+}
+
+
+DEFINE_FIND_FUNCTIONS(bool, Bool, B_BOOL_TYPE)
+DEFINE_FIND_FUNCTIONS(int32_t, Int32, B_INT32_TYPE)
+DEFINE_FIND_FUNCTIONS(float, Float, B_FLOAT_TYPE)
+DEFINE_FIND_FUNCTIONS(double, Double, B_DOUBLE_TYPE)
+DEFINE_FIND_FUNCTIONS(BPoint, Point, B_POINT_TYPE)
+
+#undef DEFINE_FIND_FUNCTIONS
+
+
+status_t
+BMessageView::FindString(const char* name, const char** string) const
+{
+	return FindString(name, 0, string);
+}
+
+
+status_t
+BMessageView::FindString(const char* name, int32_t index,
+	const char** string) const
+{
+	ssize_t bytes;
+	return FindData(name, B_STRING_TYPE, index, (const void**)string, &bytes);
+}
+
+
+const char*
+BMessageView::GetString(const char* name, const char* defaultValue) const
+{
+	const char* value;
+	if (FindString(name, 0, &value) == B_OK)
+		return value;
+	return defaultValue;
+}
+
+
+status_t
+BMessageView::FindMessage(const char* name, BMessageView* message) const
+{
+	return FindMessage(name, 0, message);
+}
+
+
+status_t
+BMessageView::FindMessage(const char* name, int32_t index,
+	BMessageView* message) const
+{
+	if (message == NULL)
+		return B_BAD_VALUE;
+
+	const void* data = NULL;
+	ssize_t size = 0;
+	status_t error = FindData(name, B_MESSAGE_TYPE, index, &data, &size);
+
+	if (error == B_OK)
+		error = message->SetTo(data, size);
+	else
+		message->Unset();
+
+	return error;
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef BMESSAGE_VIEW_H
+#define BMESSAGE_VIEW_H
+
+#include <vector>
+
+#include "BMessage.h"
+
+namespace haiku_compat {
+
+// Read-only view of a flattened message. The view borrows the buffer it
+// was set to and never copies field data; nested messages are returned as
+// views into the same buffer, so the buffer must outlive every view made
+// from it. Item offsets of variable-size fields are indexed on first
+// access, making indexed lookups O(1) after that.
+class BMessageView {
+public:
+								BMessageView();
+
+			status_t			SetTo(const void* flatBuffer, ssize_t size);
+			status_t			SetTo(const BMessage& message);
+			void				Unset();
+
+			status_t			InitCheck() const { return fInitStatus; }
+			uint32_t			What() const { return fHeader.what; }
+
+			status_t			GetInfo(const char* name, type_code* typeFound,
+									int32_t* countFound = NULL) const;
+
+			status_t			FindData(const char* name, type_code type,
+									const void** data,
+									ssize_t* numBytes) const;
+			status_t			FindData(const char* name, type_code type,
+									int32_t index, const void** data,
+									ssize_t* numBytes) const;
+
+			status_t			FindBool(const char* name, bool* value) const;
+			status_t			FindBool(const char* name, int32_t index,
+									bool* value) const;
+			status_t			FindInt32(const char* name,
+									int32_t* value) const;
+			status_t			FindInt32(const char* name, int32_t index,
+									int32_t* value) const;
+			status_t			FindFloat(const char* name, float* value) const;
+			status_t			FindFloat(const char* name, int32_t index,
+									float* value) const;
+			status_t			FindDouble(const char* name,
+									double* value) const;
+			status_t			FindDouble(const char* name, int32_t index,
+									double* value) const;
+			status_t			FindPoint(const char* name,
+									BPoint* point) const;
+			status_t			FindPoint(const char* name, int32_t index,
+									BPoint* point) const;
+
+			status_t			FindString(const char* name,
+									const char** string) const;
+			status_t			FindString(const char* name, int32_t index,
+									const char** string) const;
+			const char*			GetString(const char* name,
+									const char* defaultValue = NULL) const;
+
+			status_t			FindMessage(const char* name,
+									BMessageView* message) const;
+			status_t			FindMessage(const char* name, int32_t index,
+									BMessageView* message) const;
+
+private:
+			typedef BMessage::message_header message_header;
+			typedef BMessage::field_header field_header;
+
+			status_t			_ValidateFields();
+			void				_ReadField(uint32_t index,
+									field_header* field) const;
+			status_t			_FindField(const char* name, type_code type,
+									uint32_t* fieldIndex,
+									field_header* field) const;
+			status_t			_ItemOffset(uint32_t fieldIndex,
+									const field_header& field, int32_t index,
+									uint32_t* offset) const;
+
+			message_header		fHeader;
+			const uint8_t*		fFields;
+			const uint8_t*		fData;
+			bool				fSwapFields;
+			status_t			fInitStatus;
+
+	mutable	std::vector<int32_t> fItemTable;
+	mutable	std::vector<uint32_t> fItemOffsets;
+};
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#include "ConversionCache.h"
+
+namespace haiku {
+
+// Bump whenever a parser, writer or the tracer changes its output, so
+// results stored on disk by an older build are not picked up.
+static const int kCacheVersion = 3;
+
+static inline uint64_t
+Rotate(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t
+Finalize(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static inline uint64_t
+Load64(const uint8_t* p)
+{
+	return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16)
+		| ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40)
+		| ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline uint64_t
+Round(uint64_t lane, uint64_t k)
+{
+	return Rotate(lane ^ k * 0x87c37b91114253d5ULL, 31) * 0x4cf5ad432745937fULL;
+}
+
+// Four independent lanes over 32-byte stripes, folded into two 64-bit
+// words. Input is read in little endian order so keys are the same on
+// every host. Not cryptographic: the cache trusts the inputs it is given.
+static void
+HashBytes(const uint8_t* data, size_t size, uint64_t& h1, uint64_t& h2)
+{
+	uint64_t lanes[4] = { h1, h2, h1 ^ 0x52dce729ULL, h2 ^ 0x38495ab5ULL };
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		lanes[0] = Round(lanes[0], Load64(data + i));
+		lanes[1] = Round(lanes[1], Load64(data + i + 8));
+		lanes[2] = Round(lanes[2], Load64(data + i + 16));
+		lanes[3] = Round(lanes[3], Load64(data + i + 24));
+	}
+
+	for (int lane = 0; i + 8 <= size; i += 8, lane++)
+		lanes[lane] = Round(lanes[lane], Load64(data + i));
+
+	uint64_t k = 0;
+	for (size_t b = size; b > i; b--)
+		k = (k << 8) | data[b - 1];
+	lanes[3] = Round(lanes[3], k);
+
+	h1 = Finalize(lanes[0] + Rotate(lanes[1], 23) + size);
+	h2 = Finalize(lanes[2] + Rotate(lanes[3], 23) + h1);
+	h1 = Finalize((h1 ^ lanes[3]) + h2);
+}
+
+static bool
+ReadFileBytes(const std::string& path, std::vector<uint8_t>& data)
+{
+	std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	std::streamoff size = file.tellg();
+	if (size < 0)
+		return false;
+
+	data.resize((size_t)size);
+	file.seekg(0);
+	if (size > 0 && !file.read(reinterpret_cast<char*>(&data[0]), size))
+		return false;
+
+	return true;
+}
+
+ConversionCache::ConversionCache(size_t memoryLimit)
+	: fMemoryLimit(memoryLimit)
+	, fMemoryUsed(0)
+	, fHits(0)
+	, fMisses(0)
+{
+}
+
+ConversionCache::~ConversionCache()
+{
+}
+
+void
+ConversionCache::SetDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock(fLock);
+	fDirectory = directory;
+}
+
+std::string
+ConversionCache::Key(const std::vector<uint8_t>& input, IconFormat inputFormat,
+	IconFormat outputFormat, const ConvertOptions& opts)
+{
+	// Only options that change the output bytes; verbosity, statistics
+	// and the cache itself do not.
+	std::ostringstream settings;
+	settings.precision(9);
+	settings << kCacheVersion << '|' << inputFormat << '|' << outputFormat;
+
+	if (outputFormat == FORMAT_SVG) {
+		settings << "|svg " << opts.svgWidth << ' ' << opts.svgHeight
+			<< ' ' << opts.svgViewBox << ' ' << opts.preserveNames
+			<< ' ' << opts.coordinateScale;
+	}
+	if (outputFormat == FORMAT_PNG) {
+		settings << "|png " << opts.pngWidth << ' ' << opts.pngHeight << ' ' << opts.pngScale
+			<< ' ' << opts.pngEffort;
+	}
+	if (inputFormat == FORMAT_PNG)
+		settings << "|trace " << opts.pngPreset << ' ' << opts.pngRemoveBackground
+			<< ' ' << opts.pngCubic;
+
+	std::string prefix = settings.str();
+	uint64_t h1 = 0x9e3779b97f4a7c15ULL;
+	uint64_t h2 = 0xbf58476d1ce4e5b9ULL;
+	HashBytes(reinterpret_cast<const uint8_t*>(prefix.data()), prefix.size(), h1, h2);
+	HashBytes(input.empty() ? NULL : &input[0], input.size(), h1, h2);
+
+	char key[33];
+	snprintf(key, sizeof(key), "%016llx%016llx",
+		(unsigned long long)h1, (unsigned long long)h2);
+	return key;
+}
+
+bool
+ConversionCache::Lookup(const std::string& key, std::vector<uint8_t>& output)
+{
+	std::lock_guard<std::mutex> lock(fLock);
+
+	std::map<std::string, std::list<Entry>::iterator>::iterator found = fIndex.find(key);
+	if (found != fIndex.end()) {
+		fEntries.splice(fEntries.begin(), fEntries, found->second);
+		output = found->second->second;
+		fHits++;
+		return true;
+	}
+
+	if (!fDirectory.empty() && ReadFileBytes(_EntryPath(key), output)) {
+		_Remember(key, output);
+		fHits++;
+		return true;
+	}
+
+	fMisses++;
+	return false;
+}
+
+void
+ConversionCache::Store(const std::string& key, const std::vector<uint8_t>& output)
+{
+	std::lock_guard<std::mutex> lock(fLock);
+
+	_Remember(key, output);
+
+	if (fDirectory.empty())
+		return;
+
+	// Written next to the entry and renamed into place, so a reader in
+	// another process never sees a partial file. Failures only cost the
+	// next run a conversion.
+	std::string path = _EntryPath(key);
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+	if (error)
+		return;
+
+	std::ostringstream temporary;
+	temporary << path << '.' << std::hash<std::thread::id>()(std::this_thread::get_id())
+		<< '.' << std::chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+
+	{
+		std::ofstream file(temporary.str().c_str(), std::ios::binary);
+		if (!file.is_open())
+			return;
+		if (!output.empty())
+			file.write(reinterpret_cast<const char*>(&output[0]), output.size());
+		if (!file) {
+			file.close();
+			std::remove(temporary.str().c_str());
+			return;
+		}
+	}
+
+	std::filesystem::rename(temporary.str(), path, error);
+	if (error)
+		std::remove(temporary.str().c_str());
+}
+
+void
+ConversionCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(fLock);
+	fEntries.clear();
+	fIndex.clear();
+	fMemoryUsed = 0;
+}
+
+std::string
+ConversionCache::_EntryPath(const std::string& key) const
+{
+	// Entries are spread over subdirectories named by the first two
+	// characters of their key.
+	return (std::filesystem::path(fDirectory) / key.substr(0, 2) / key).string();
+}
+
+void
+ConversionCache::_Remember(const std::string& key, const std::vector<uint8_t>& output)
+{
+	if (output.size() > fMemoryLimit)
+		return;
+
+	std::map<std::string, std::list<Entry>::iterator>::iterator found = fIndex.find(key);
+	if (found != fIndex.end()) {
+		fMemoryUsed -= found->second->second.size();
+		fEntries.erase(found->second);
+		fIndex.erase(found);
+	}
+
+	while (!fEntries.empty() && fMemoryUsed + output.size() > fMemoryLimit) {
+		fMemoryUsed -= fEntries.back().second.size();
+		fIndex.erase(fEntries.back().first);
+		fEntries.pop_back();
+	}
+
+	fEntries.push_front(Entry(key, output));
+	fIndex[key] = fEntries.begin();
+	fMemoryUsed += output.size();
+}
+
+}
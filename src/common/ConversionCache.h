@@ -0,0 +1,60 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef CONVERSION_CACHE_H
+#define CONVERSION_CACHE_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "IconConverter.h"
+
+namespace haiku {
+
+// Converted icons keyed by a hash of the input bytes, both formats and the
+// options that change the output. Recent results are kept in memory up to
+// a byte limit; with a directory set, every result is also stored there
+// under its key, so other processes converting the same input find it.
+class ConversionCache {
+public:
+	explicit			ConversionCache(size_t memoryLimit = 64 * 1024 * 1024);
+						~ConversionCache();
+
+	void				SetDirectory(const std::string& directory);
+	const std::string&	Directory() const { return fDirectory; }
+
+	static std::string	Key(const std::vector<uint8_t>& input, IconFormat inputFormat,
+							IconFormat outputFormat, const ConvertOptions& opts);
+
+	bool				Lookup(const std::string& key, std::vector<uint8_t>& output);
+	void				Store(const std::string& key, const std::vector<uint8_t>& output);
+	void				Clear();
+
+	size_t				Hits() const { return fHits; }
+	size_t				Misses() const { return fMisses; }
+
+private:
+	typedef std::pair<std::string, std::vector<uint8_t> > Entry;
+
+	std::string			_EntryPath(const std::string& key) const;
+	void				_Remember(const std::string& key, const std::vector<uint8_t>& output);
+
+	std::list<Entry>	fEntries;
+	std::map<std::string, std::list<Entry>::iterator> fIndex;
+	size_t				fMemoryLimit;
+	size_t				fMemoryUsed;
+	std::string			fDirectory;
+	size_t				fHits;
+	size_t				fMisses;
+	std::mutex			fLock;
+};
+
+}
+
+#endif
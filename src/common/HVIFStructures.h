@@ -210,6 +210,36 @@ struct HVIFIcon {
 	std::vector<Shape> shapes;
 };
 
+// What HVIFParser::Scan() reports about an icon without building it. The
+// bounds cover all path points, control points included, in the units of
+// Path::points and before any shape transform.
+struct HVIFSummary {
+	bool valid;
+	const char* error;
+
+	int styleCount;
+	int gradientCount;
+	int pathCount;
+	int pointCount;
+	int shapeCount;
+	int transformerCount;
+	bool hasShapeTransforms;
+
+	float minX;
+	float minY;
+	float maxX;
+	float maxY;
+
+	HVIFSummary()
+		: valid(false), error(NULL), styleCount(0), gradientCount(0), pathCount(0),
+		  pointCount(0), shapeCount(0), transformerCount(0), hasShapeTransforms(false),
+		  minX(0), minY(0), maxX(0), maxY(0) {}
+
+	bool HasGradients() const { return gradientCount > 0; }
+	bool HasTransformers() const { return transformerCount > 0; }
+	bool HasBounds() const { return pointCount > 0; }
+};
+
 }
 
 #endif
@@ -0,0 +1,377 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "IconArchive.h"
+
+namespace haiku {
+
+static const char kMagic[4] = { 'H', 'V', 'P', 'K' };
+static const uint32_t kVersion = 1;
+static const size_t kHeaderSize = 32;
+static const size_t kEntrySize = 24;
+
+static inline uint32_t
+Get32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+		| ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+Get64(const uint8_t* p)
+{
+	return (uint64_t)Get32(p) | ((uint64_t)Get32(p + 4) << 32);
+}
+
+static inline void
+Put32(std::vector<uint8_t>& out, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+static inline void
+Put64(std::vector<uint8_t>& out, uint64_t value)
+{
+	Put32(out, (uint32_t)value);
+	Put32(out, (uint32_t)(value >> 32));
+}
+
+static uint64_t
+HashBlob(const std::vector<uint8_t>& data)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < data.size(); i++)
+		hash = (hash ^ data[i]) * 0x100000001b3ULL;
+	return hash;
+}
+
+IconArchiveWriter::IconArchiveWriter()
+	: fDeduplicate(true)
+{
+}
+
+bool
+IconArchiveWriter::Add(const std::string& name, const std::vector<uint8_t>& data)
+{
+	if (name.empty()) {
+		fLastError = "Icon without a name";
+		return false;
+	}
+	if (fEntries.find(name) != fEntries.end()) {
+		fLastError = "Duplicate icon name: " + name;
+		return false;
+	}
+	if (data.size() > UINT32_MAX) {
+		fLastError = "Icon too large: " + name;
+		return false;
+	}
+
+	if (fDeduplicate) {
+		uint64_t hash = HashBlob(data);
+		std::pair<std::multimap<uint64_t, size_t>::iterator,
+			std::multimap<uint64_t, size_t>::iterator> range = fBlobsByHash.equal_range(hash);
+		for (std::multimap<uint64_t, size_t>::iterator it = range.first; it != range.second; ++it) {
+			if (fBlobs[it->second] == data) {
+				fEntries[name] = it->second;
+				return true;
+			}
+		}
+		fBlobsByHash.insert(std::make_pair(hash, fBlobs.size()));
+	}
+
+	fEntries[name] = fBlobs.size();
+	fBlobs.push_back(data);
+	return true;
+}
+
+bool
+IconArchiveWriter::Write(const std::string& file)
+{
+	fLastError.clear();
+
+	// std::map keeps the names in bytewise order, as the index needs them.
+	std::vector<uint8_t> names;
+	for (std::map<std::string, size_t>::const_iterator it = fEntries.begin();
+			it != fEntries.end(); ++it) {
+		names.insert(names.end(), it->first.begin(), it->first.end());
+	}
+
+	uint64_t namesOffset = kHeaderSize + (uint64_t)fEntries.size() * kEntrySize;
+	uint64_t dataOffset = namesOffset + names.size();
+	if (names.size() > UINT32_MAX || fEntries.size() > UINT32_MAX) {
+		fLastError = "Too many icons for one archive";
+		return false;
+	}
+
+	std::vector<uint64_t> blobOffsets(fBlobs.size());
+	uint64_t offset = dataOffset;
+	for (size_t i = 0; i < fBlobs.size(); i++) {
+		blobOffsets[i] = offset;
+		offset += fBlobs[i].size();
+	}
+
+	std::vector<uint8_t> head;
+	head.reserve(namesOffset);
+	head.insert(head.end(), kMagic, kMagic + 4);
+	Put32(head, kVersion);
+	Put32(head, (uint32_t)fEntries.size());
+	Put32(head, (uint32_t)fBlobs.size());
+	Put64(head, namesOffset);
+	Put64(head, dataOffset);
+
+	uint32_t nameOffset = 0;
+	for (std::map<std::string, size_t>::const_iterator it = fEntries.begin();
+			it != fEntries.end(); ++it) {
+		Put32(head, nameOffset);
+		Put32(head, (uint32_t)it->first.size());
+		Put64(head, blobOffsets[it->second]);
+		Put32(head, (uint32_t)fBlobs[it->second].size());
+		Put32(head, 0);
+		nameOffset += (uint32_t)it->first.size();
+	}
+
+	std::ofstream out(file.c_str(), std::ios::binary);
+	if (!out.is_open()) {
+		fLastError = "Cannot create " + file;
+		return false;
+	}
+
+	out.write(reinterpret_cast<const char*>(&head[0]), head.size());
+	if (!names.empty())
+		out.write(reinterpret_cast<const char*>(&names[0]), names.size());
+	for (size_t i = 0; i < fBlobs.size(); i++) {
+		if (!fBlobs[i].empty())
+			out.write(reinterpret_cast<const char*>(&fBlobs[i][0]), fBlobs[i].size());
+	}
+
+	out.close();
+	if (!out) {
+		fLastError = "Failed to write " + file;
+		return false;
+	}
+
+	return true;
+}
+
+IconArchive::IconArchive()
+	: fData(NULL)
+	, fSize(0)
+	, fMapped(false)
+	, fCount(0)
+	, fNamesOffset(0)
+{
+}
+
+IconArchive::~IconArchive()
+{
+	Close();
+}
+
+bool
+IconArchive::Open(const std::string& file)
+{
+	Close();
+	fLastError.clear();
+
+#ifndef _WIN32
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd < 0) {
+		fLastError = "Cannot open " + file;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)kHeaderSize) {
+		close(fd);
+		fLastError = "Not an icon archive: " + file;
+		return false;
+	}
+
+	void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		fLastError = "Cannot map " + file;
+		return false;
+	}
+
+	fData = static_cast<const uint8_t*>(mapping);
+	fSize = (size_t)st.st_size;
+	fMapped = true;
+#else
+	std::ifstream in(file.c_str(), std::ios::binary | std::ios::ate);
+	if (!in.is_open()) {
+		fLastError = "Cannot open " + file;
+		return false;
+	}
+
+	std::streamoff size = in.tellg();
+	if (size < (std::streamoff)kHeaderSize) {
+		fLastError = "Not an icon archive: " + file;
+		return false;
+	}
+
+	fBuffer.resize((size_t)size);
+	in.seekg(0);
+	if (!in.read(reinterpret_cast<char*>(&fBuffer[0]), size)) {
+		fBuffer.clear();
+		fLastError = "Cannot read " + file;
+		return false;
+	}
+
+	fData = &fBuffer[0];
+	fSize = fBuffer.size();
+#endif
+
+	if (!_Validate()) {
+		std::string error = fLastError;
+		Close();
+		fLastError = error + ": " + file;
+		return false;
+	}
+
+	return true;
+}
+
+void
+IconArchive::Close()
+{
+#ifndef _WIN32
+	if (fMapped)
+		munmap(const_cast<uint8_t*>(fData), fSize);
+#endif
+
+	fBuffer.clear();
+	fData = NULL;
+	fSize = 0;
+	fMapped = false;
+	fCount = 0;
+	fNamesOffset = 0;
+}
+
+std::string
+IconArchive::NameAt(size_t index) const
+{
+	if (index >= fCount)
+		return std::string();
+
+	const uint8_t* entry = _Entry(index);
+	return std::string(reinterpret_cast<const char*>(fData + fNamesOffset + Get32(entry)),
+		Get32(entry + 4));
+}
+
+bool
+IconArchive::DataAt(size_t index, const uint8_t*& data, size_t& size) const
+{
+	if (index >= fCount)
+		return false;
+
+	const uint8_t* entry = _Entry(index);
+	data = fData + Get64(entry + 8);
+	size = Get32(entry + 16);
+	return true;
+}
+
+bool
+IconArchive::Find(const std::string& name, const uint8_t*& data, size_t& size) const
+{
+	size_t low = 0;
+	size_t high = fCount;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		int order = _CompareName(middle, name);
+		if (order == 0)
+			return DataAt(middle, data, size);
+		if (order < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return false;
+}
+
+// Everything the lookups rely on is checked once here, so they can read
+// the index without bounds checks.
+bool
+IconArchive::_Validate()
+{
+	if (memcmp(fData, kMagic, 4) != 0) {
+		fLastError = "Not an icon archive";
+		return false;
+	}
+	if (Get32(fData + 4) != kVersion) {
+		fLastError = "Unsupported icon archive version";
+		return false;
+	}
+
+	uint64_t count = Get32(fData + 8);
+	uint64_t namesOffset = Get64(fData + 16);
+	uint64_t dataOffset = Get64(fData + 24);
+	if (namesOffset != kHeaderSize + count * kEntrySize || dataOffset < namesOffset
+		|| dataOffset > fSize) {
+		fLastError = "Damaged icon archive index";
+		return false;
+	}
+
+	fCount = (size_t)count;
+	fNamesOffset = namesOffset;
+	uint64_t namesSize = dataOffset - namesOffset;
+
+	for (size_t i = 0; i < fCount; i++) {
+		const uint8_t* entry = _Entry(i);
+		uint64_t nameStart = Get32(entry);
+		uint64_t nameLength = Get32(entry + 4);
+		uint64_t blobStart = Get64(entry + 8);
+		uint64_t blobSize = Get32(entry + 16);
+
+		if (nameStart + nameLength > namesSize || blobStart < dataOffset
+			|| blobStart > fSize || blobSize > fSize - blobStart) {
+			fLastError = "Damaged icon archive entry";
+			return false;
+		}
+
+		if (i > 0 && _CompareName(i - 1, NameAt(i)) >= 0) {
+			fLastError = "Icon archive index is not sorted";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const uint8_t*
+IconArchive::_Entry(size_t index) const
+{
+	return fData + kHeaderSize + index * kEntrySize;
+}
+
+int
+IconArchive::_CompareName(size_t index, const std::string& name) const
+{
+	const uint8_t* entry = _Entry(index);
+	const uint8_t* entryName = fData + fNamesOffset + Get32(entry);
+	size_t length = Get32(entry + 4);
+
+	int order = memcmp(entryName, name.data(), std::min(length, name.size()));
+	if (order != 0)
+		return order;
+	if (length == name.size())
+		return 0;
+	return length < name.size() ? -1 : 1;
+}
+
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef ICON_ARCHIVE_H
+#define ICON_ARCHIVE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace haiku {
+
+// Many HVIF icons packed in one file: a header, an index of names sorted
+// bytewise, the names and the HVIF data. All numbers are little endian.
+//
+//	 0	"HVPK"
+//	 4	uint32 version
+//	 8	uint32 number of entries
+//	12	uint32 number of distinct icons
+//	16	uint64 offset of the names
+//	24	uint64 offset of the icon data
+//	32	entries of 24 bytes: uint32 name offset (from the names), uint32
+//		name length, uint64 data offset (from the start of the file),
+//		uint32 data size, uint32 reserved
+//
+// Entries with identical data may point at the same bytes.
+
+class IconArchiveWriter {
+public:
+							IconArchiveWriter();
+
+	// Store identical icons once (the default).
+	void					SetDeduplicate(bool deduplicate)
+								{ fDeduplicate = deduplicate; }
+
+	// Fails for a name that was already added.
+	bool					Add(const std::string& name, const std::vector<uint8_t>& data);
+
+	bool					Write(const std::string& file);
+
+	size_t					CountIcons() const { return fEntries.size(); }
+	size_t					CountDistinct() const { return fBlobs.size(); }
+
+	const std::string&		GetLastError() const { return fLastError; }
+
+private:
+	// Name and index of its data in fBlobs.
+	std::map<std::string, size_t> fEntries;
+	std::vector<std::vector<uint8_t> > fBlobs;
+	// Indices into fBlobs by a hash of their bytes.
+	std::multimap<uint64_t, size_t> fBlobsByHash;
+	bool					fDeduplicate;
+	std::string				fLastError;
+};
+
+// Read access to a packed archive. The file is mapped into memory where
+// the platform allows it and read whole otherwise; lookups are a binary
+// search over the index, and the data they return points into the mapping,
+// ready for hvif::HVIFParser::ParseData() without a copy. Pointers stay
+// valid until Close().
+class IconArchive {
+public:
+							IconArchive();
+							~IconArchive();
+
+	bool					Open(const std::string& file);
+	void					Close();
+
+	size_t					CountIcons() const { return fCount; }
+	std::string				NameAt(size_t index) const;
+	bool					DataAt(size_t index, const uint8_t*& data, size_t& size) const;
+
+	bool					Find(const std::string& name, const uint8_t*& data,
+								size_t& size) const;
+
+	const std::string&		GetLastError() const { return fLastError; }
+
+private:
+							IconArchive(const IconArchive&);
+	IconArchive&			operator=(const IconArchive&);
+
+	bool					_Validate();
+	const uint8_t*			_Entry(size_t index) const;
+	int						_CompareName(size_t index, const std::string& name) const;
+
+	const uint8_t*			fData;
+	size_t					fSize;
+	bool					fMapped;
+	std::vector<uint8_t>	fBuffer;
+
+	size_t					fCount;
+	uint64_t				fNamesOffset;
+	std::string				fLastError;
+};
+
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include <algorithm>
 
 #include "IconConverter.h"
+#include "ConversionCache.h"
 #include "IconAdapter.h"
 #include "SVGWriter.h"
 #include "SVGParser.h"
@@ -149,6 +150,51 @@ DeduplicateIconPaths(Icon& icon)
 	icon.paths.swap(uniquePaths);
 }
 
+static bool
+ReadFileBytes(const std::string& file, std::vector<uint8_t>& data)
+{
+	std::ifstream f(file.c_str(), std::ios::binary | std::ios::ate);
+	if (!f.is_open())
+		return false;
+
+	std::streamoff size = f.tellg();
+	if (size < 0)
+		return false;
+
+	data.resize(static_cast<size_t>(size));
+	f.seekg(0);
+	if (size > 0 && !f.read(reinterpret_cast<char*>(&data[0]), size))
+		return false;
+
+	return true;
+}
+
+static bool
+IsCacheable(IconFormat inputFormat, IconFormat outputFormat, const ConvertOptions& opts)
+{
+	if (opts.cache == NULL)
+		return false;
+	if (inputFormat == FORMAT_AUTO || inputFormat == FORMAT_UNKNOWN
+		|| outputFormat == FORMAT_AUTO || outputFormat == FORMAT_UNKNOWN)
+		return false;
+
+	// Tracing that may be cut short has no single result to keep.
+	if (inputFormat == FORMAT_PNG && (opts.pngTimeBudgetMs > 0 || opts.pngCancel != NULL))
+		return false;
+
+	return true;
+}
+
+static void
+ResetStats(const ConvertOptions& opts)
+{
+	// A cached result took no tracing or writing to measure.
+	if (opts.pngStats != NULL)
+		opts.pngStats->Reset();
+	if (opts.pngWriteStats != NULL)
+		*opts.pngWriteStats = PNGWriterStats();
+}
+
 bool
 IconConverter::Convert(const std::string& inputFile, IconFormat inputFormat,
 	const std::string& outputFile, IconFormat outputFormat)
@@ -167,7 +213,7 @@ IconConverter::Convert(const std::string& inputFile, IconFormat inputFormat,
 	if (actualInputFormat == FORMAT_AUTO) {
 		actualInputFormat = DetectFormat(inputFile);
 		if (opts.verbose) {
-			std::cout << "Detected input format: " << FormatToString(actualInputFormat) << std::endl;
+			std::cerr << "Detected input format: " << FormatToString(actualInputFormat) << std::endl;
 		}
 	}
 
@@ -175,7 +221,28 @@ IconConverter::Convert(const std::string& inputFile, IconFormat inputFormat,
 	if (actualOutputFormat == FORMAT_AUTO) {
 		actualOutputFormat = DetectFormatByExtension(outputFile);
 		if (opts.verbose) {
-			std::cout << "Detected output format: " << FormatToString(actualOutputFormat) << std::endl;
+			std::cerr << "Detected output format: " << FormatToString(actualOutputFormat) << std::endl;
+		}
+	}
+
+	std::string cacheKey;
+	std::vector<uint8_t> cached;
+	if (IsCacheable(actualInputFormat, actualOutputFormat, opts)
+		&& ReadFileBytes(inputFile, cached)) {
+		cacheKey = ConversionCache::Key(cached, actualInputFormat, actualOutputFormat, opts);
+		if (opts.cache->Lookup(cacheKey, cached)) {
+			if (opts.verbose)
+				std::cerr << "Using cached result" << std::endl;
+			ResetStats(opts);
+
+			std::ofstream f(outputFile.c_str(), std::ios::binary);
+			if (!cached.empty())
+				f.write(reinterpret_cast<const char*>(&cached[0]), cached.size());
+			if (!f) {
+				SetError("Failed to write file: " + outputFile);
+				return false;
+			}
+			return true;
 		}
 	}
 
@@ -183,7 +250,15 @@ IconConverter::Convert(const std::string& inputFile, IconFormat inputFormat,
 	if (!sLastError.empty())
 		return false;
 
-	return Save(icon, outputFile, actualOutputFormat, opts);
+	if (!Save(icon, outputFile, actualOutputFormat, opts))
+		return false;
+
+	// The written file is what gets cached, so a later hit reproduces it
+	// byte for byte.
+	if (!cacheKey.empty() && ReadFileBytes(outputFile, cached))
+		opts.cache->Store(cacheKey, cached);
+
+	return true;
 }
 
 bool
@@ -277,6 +352,24 @@ IconConverter::DetectFormatBySignature(const std::string& file)
 	return FORMAT_UNKNOWN;
 }
 
+IconFormat
+IconConverter::DetectFormat(const std::vector<uint8_t>& data)
+{
+	// Buffers have no name to go by: anything without a binary signature
+	// is taken to be SVG text.
+	if (data.size() < 4)
+		return FORMAT_HVIF;
+
+	if (data[0] == 0x6E && data[1] == 0x63 && data[2] == 0x69 && data[3] == 0x66)
+		return FORMAT_HVIF;
+	if (data[0] == 'I' && data[1] == 'M' && data[2] == 'S' && data[3] == 'G')
+		return FORMAT_IOM;
+	if (data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G')
+		return FORMAT_PNG;
+
+	return FORMAT_SVG;
+}
+
 IconFormat
 IconConverter::DetectFormatByExtension(const std::string& file)
 {
@@ -388,21 +481,8 @@ IconConverter::LoadFromBuffer(const std::vector<uint8_t>& data, IconFormat forma
 	sLastError.clear();
 
 	IconFormat actualFormat = format;
-	if (actualFormat == FORMAT_AUTO) {
-		if (data.size() >= 4) {
-			if (data[0] == 0x6E && data[1] == 0x63 && data[2] == 0x69 && data[3] == 0x66)
-				actualFormat = FORMAT_HVIF;
-			else if (data[0] == 'I' && data[1] == 'M' && data[2] == 'S' && data[3] == 'G')
-				actualFormat = FORMAT_IOM;
-			else if (data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G')
-				actualFormat = FORMAT_PNG;
-			else {
-				actualFormat = FORMAT_SVG;
-			}
-		} else {
-			actualFormat = FORMAT_HVIF;
-		}
-	}
+	if (actualFormat == FORMAT_AUTO)
+		actualFormat = DetectFormat(data);
 
 	ConvertOptions opts;
 
@@ -465,19 +545,19 @@ IconConverter::ConvertBuffer(const std::vector<uint8_t>& inputData, IconFormat i
 	sLastError.clear();
 
 	IconFormat actualInputFormat = inputFormat;
-	if (actualInputFormat == FORMAT_AUTO) {
-		if (inputData.size() >= 4) {
-			if (inputData[0] == 0x6E && inputData[1] == 0x63 && inputData[2] == 0x69 && inputData[3] == 0x66)
-				actualInputFormat = FORMAT_HVIF;
-			else if (inputData[0] == 'I' && inputData[1] == 'M' && inputData[2] == 'S' && inputData[3] == 'G')
-				actualInputFormat = FORMAT_IOM;
-			else if (inputData[0] == 0x89 && inputData[1] == 'P' && inputData[2] == 'N' && inputData[3] == 'G')
-				actualInputFormat = FORMAT_PNG;
-			else {
-				actualInputFormat = FORMAT_SVG;
-			}
-		} else {
-			actualInputFormat = FORMAT_HVIF;
+	if (actualInputFormat == FORMAT_AUTO)
+		actualInputFormat = DetectFormat(inputData);
+
+	IconFormat actualOutputFormat = outputFormat;
+	if (actualOutputFormat == FORMAT_AUTO)
+		actualOutputFormat = FORMAT_HVIF;
+
+	std::string cacheKey;
+	if (IsCacheable(actualInputFormat, actualOutputFormat, opts)) {
+		cacheKey = ConversionCache::Key(inputData, actualInputFormat, actualOutputFormat, opts);
+		if (opts.cache->Lookup(cacheKey, outputData)) {
+			ResetStats(opts);
+			return true;
 		}
 	}
 
@@ -503,7 +583,13 @@ IconConverter::ConvertBuffer(const std::vector<uint8_t>& inputData, IconFormat i
 	if (!sLastError.empty())
 		return false;
 
-	return SaveToBuffer(icon, outputData, outputFormat, opts);
+	if (!SaveToBuffer(icon, outputData, actualOutputFormat, opts))
+		return false;
+
+	if (!cacheKey.empty())
+		opts.cache->Store(cacheKey, outputData);
+
+	return true;
 }
 
 bool
@@ -584,7 +670,11 @@ IconConverter::LoadPNG(const std::string& file, const ConvertOptions& opts)
 	PNGParseOptions pngOpts;
 	pngOpts.preset = opts.pngPreset;
 	pngOpts.removeBackground = opts.pngRemoveBackground;
+	pngOpts.cubic = opts.pngCubic;
 	pngOpts.verbose = opts.verbose;
+	pngOpts.stats = opts.pngStats;
+	pngOpts.cancel = opts.pngCancel;
+	pngOpts.timeBudgetMs = opts.pngTimeBudgetMs;
 
 	if (!parser.Parse(file, icon, pngOpts)) {
 		SetError("PNG parsing failed: " + parser.GetLastError());
@@ -629,15 +719,8 @@ IconConverter::LoadIOMBuffer(const std::vector<uint8_t>& data)
 		return icon;
 	}
 
-	haiku_compat::BMessage msg;
-	haiku_compat::status_t result = msg.Unflatten((const char*)&data[4], (ssize_t)(data.size() - 4));
-	if (result != haiku_compat::B_OK) {
-		SetError("Failed to unflatten BMessage from buffer");
-		return icon;
-	}
-
 	iom::IOMParser parser;
-	if (!parser.ParseMessage(msg)) {
+	if (!parser.ParseBuffer(&data[0], data.size())) {
 		SetError("IOM parsing failed: " + parser.GetLastError());
 		return icon;
 	}
@@ -684,7 +767,11 @@ IconConverter::LoadPNGBuffer(const std::vector<uint8_t>& data, const ConvertOpti
 	PNGParseOptions pngOpts;
 	pngOpts.preset = opts.pngPreset;
 	pngOpts.removeBackground = opts.pngRemoveBackground;
+	pngOpts.cubic = opts.pngCubic;
 	pngOpts.verbose = opts.verbose;
+	pngOpts.stats = opts.pngStats;
+	pngOpts.cancel = opts.pngCancel;
+	pngOpts.timeBudgetMs = opts.pngTimeBudgetMs;
 
 	if (!parser.ParseBuffer(data, icon, pngOpts)) {
 		SetError("PNG parsing failed: " + parser.GetLastError());
@@ -980,6 +1067,8 @@ IconConverter::SavePNG(const Icon& icon, const std::string& file, const ConvertO
 	pngOpts.width = opts.pngWidth;
 	pngOpts.height = opts.pngHeight;
 	pngOpts.scale = opts.pngScale;
+	pngOpts.effort = opts.pngEffort;
+	pngOpts.stats = opts.pngWriteStats;
 
 	if (!writer.WriteToFile(tmp, file, pngOpts)) {
 		SetError("Failed to write PNG file");
@@ -1002,6 +1091,8 @@ IconConverter::SavePNGBuffer(const Icon& icon, std::vector<uint8_t>& buffer, con
 	pngOpts.width = opts.pngWidth;
 	pngOpts.height = opts.pngHeight;
 	pngOpts.scale = opts.pngScale;
+	pngOpts.effort = opts.pngEffort;
+	pngOpts.stats = opts.pngWriteStats;
 
 	if (!writer.WriteToBuffer(tmp, buffer, pngOpts)) {
 		SetError("Failed to write PNG buffer");
@@ -11,9 +11,12 @@
 #include "HaikuIcon.h"
 #include "HVIFWriter.h"
 #include "PNGParser.h"
+#include "PNGWriter.h"
 
 namespace haiku {
 
+class ConversionCache;
+
 enum IconFormat {
 	FORMAT_AUTO,
 	FORMAT_UNKNOWN,
@@ -33,8 +36,17 @@ struct ConvertOptions {
 	int pngWidth;
 	int pngHeight;
 	float pngScale;
+	PNGEffort pngEffort;
+	PNGWriterStats* pngWriteStats;
 	PNGVectorizationPreset pngPreset;
 	bool pngRemoveBackground;
+	bool pngCubic;
+	TracingStats* pngStats;
+	const std::atomic<bool>* pngCancel;
+	int pngTimeBudgetMs;
+	// Results found in the cache are returned as they were stored, and
+	// leave pngStats and pngWriteStats reset to empty.
+	ConversionCache* cache;
 	
 	ConvertOptions() 
 		: svgWidth(64)
@@ -46,8 +58,15 @@ struct ConvertOptions {
 		, pngWidth(64)
 		, pngHeight(64)
 		, pngScale(1.0f)
+		, pngEffort(PNG_EFFORT_DEFAULT)
+		, pngWriteStats(NULL)
 		, pngPreset(PRESET_ICON)
 		, pngRemoveBackground(false)
+		, pngCubic(false)
+		, pngStats(NULL)
+		, pngCancel(NULL)
+		, pngTimeBudgetMs(0)
+		, cache(NULL)
 	{}
 };
 
@@ -69,6 +88,7 @@ public:
 	static IconFormat	DetectFormat(const std::string& file);
 	static IconFormat	DetectFormatBySignature(const std::string& file);
 	static IconFormat	DetectFormatByExtension(const std::string& file);
+	static IconFormat	DetectFormat(const std::vector<uint8_t>& data);
 	
 	static Icon			Load(const std::string& file, IconFormat format);
 	
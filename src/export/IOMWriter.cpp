@@ -35,33 +35,25 @@ IOMWriter::WriteToFile(const std::string& filename, const Icon& icon)
 bool
 IOMWriter::WriteToBuffer(std::vector<uint8_t>& buffer, const Icon& icon)
 {
-	haiku_compat::BMessage msg(1);
-	_BuildMessage(msg, icon);
-
-	ssize_t size = msg.FlattenedSize();
-	if (size <= 0)
-		return false;
-
-	std::vector<char> flatBuffer;
-	flatBuffer.resize(size);
-
-	if (msg.Flatten(&flatBuffer[0], size) != haiku_compat::B_OK)
-		return false;
+	size_t estimate = 1024 + icon.styles.size() * 256 + icon.shapes.size() * 512;
+	for (size_t i = 0; i < icon.paths.size(); ++i)
+		estimate += 128 + icon.paths[i].points.size() * 25;
 
 	buffer.clear();
+	buffer.reserve(estimate);
 	buffer.push_back('I');
 	buffer.push_back('M');
 	buffer.push_back('S');
 	buffer.push_back('G');
 
-	for (size_t i = 0; i < flatBuffer.size(); ++i)
-		buffer.push_back((uint8_t)flatBuffer[i]);
+	haiku_compat::BMessageBuilder msg(buffer, 1, 3);
+	_BuildMessage(msg, icon);
 
-	return true;
+	return msg.Finish() == haiku_compat::B_OK;
 }
 
 void
-IOMWriter::_BuildMessage(haiku_compat::BMessage& msg, const Icon& icon)
+IOMWriter::_BuildMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon)
 {
 	_AddPathsToMessage(msg, icon);
 	_AddStylesToMessage(msg, icon);
@@ -69,147 +61,148 @@ IOMWriter::_BuildMessage(haiku_compat::BMessage& msg, const Icon& icon)
 }
 
 void
-IOMWriter::_AddStylesToMessage(haiku_compat::BMessage& msg, const Icon& icon)
+IOMWriter::_AddStylesToMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon)
 {
-	haiku_compat::BMessage stylesContainer(1);
-	stylesContainer.MakeEmpty();
+	msg.BeginMessage("styles", 1, icon.styles.empty() ? 0 : 1);
 
 	for (size_t i = 0; i < icon.styles.size(); ++i) {
-		_AddStyleToMessage(stylesContainer, icon.styles[i], (int)i);
+		_AddStyleToMessage(msg, icon.styles[i], (int)i);
 	}
-	msg.AddMessage("styles", &stylesContainer);
+	msg.EndMessage();
 }
 
 void
-IOMWriter::_AddPathsToMessage(haiku_compat::BMessage& msg, const Icon& icon)
+IOMWriter::_AddPathsToMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon)
 {
-	haiku_compat::BMessage pathsContainer(1);
-	pathsContainer.MakeEmpty();
+	msg.BeginMessage("paths", 1, icon.paths.empty() ? 0 : 1);
 
 	for (size_t i = 0; i < icon.paths.size(); ++i) {
-		_AddPathToMessage(pathsContainer, icon.paths[i], (int)i);
+		_AddPathToMessage(msg, icon.paths[i], (int)i);
 	}
-	msg.AddMessage("paths", &pathsContainer);
+	msg.EndMessage();
 }
 
 void
-IOMWriter::_AddShapesToMessage(haiku_compat::BMessage& msg, const Icon& icon)
+IOMWriter::_AddShapesToMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon)
 {
-	haiku_compat::BMessage shapesContainer(1);
-	shapesContainer.MakeEmpty();
+	msg.BeginMessage("shapes", 1, icon.shapes.empty() ? 0 : 1);
 
 	for (size_t i = 0; i < icon.shapes.size(); ++i) {
-		_AddShapeToMessage(shapesContainer, icon.shapes[i], (int)i);
+		_AddShapeToMessage(msg, icon.shapes[i], (int)i);
 	}
-	msg.AddMessage("shapes", &shapesContainer);
+	msg.EndMessage();
 }
 
 void
-IOMWriter::_AddStyleToMessage(haiku_compat::BMessage& container, const Style& style, int index)
+IOMWriter::_AddStyleToMessage(haiku_compat::BMessageBuilder& container, const Style& style, int index)
 {
-	haiku_compat::BMessage styleMsg(1);
+	container.BeginMessage("style", 1, style.isGradient ? 3 : 2);
 
 	if (!style.name.empty())
-		styleMsg.AddString("name", style.name);
+		container.AddString("name", style.name);
 	else
-		styleMsg.AddString("name", "<style>");
+		container.AddString("name", "<style>");
 
 	if (style.isGradient) {
 		if (style.gradient.stops.size() > 0) {
-			styleMsg.AddInt32("color", (int32_t)style.gradient.stops[0].color);
+			container.AddInt32("color", (int32_t)style.gradient.stops[0].color);
 		} else {
-			styleMsg.AddInt32("color", (int32_t)0xFF000000);
+			container.AddInt32("color", (int32_t)0xFF000000);
 		}
 
-		haiku_compat::BMessage gradMsg(1);
-		_AddGradientToMessage(gradMsg, style.gradient);
-		styleMsg.AddMessage("gradient", &gradMsg);
+		container.BeginMessage("gradient", 1, style.gradient.stops.empty() ? 5 : 7);
+		_AddGradientToMessage(container, style.gradient);
+		container.EndMessage();
 	} else {
-		styleMsg.AddInt32("color", (int32_t)style.color);
+		container.AddInt32("color", (int32_t)style.color);
 	}
 
-	container.AddMessage("style", &styleMsg);
+	container.EndMessage();
 }
 
 void
-IOMWriter::_AddPathToMessage(haiku_compat::BMessage& container, const Path& path, int index)
+IOMWriter::_AddPathToMessage(haiku_compat::BMessageBuilder& container, const Path& path, int index)
 {
-	haiku_compat::BMessage pathMsg(1);
+	size_t pointCount = path.points.size();
+
+	container.BeginMessage("path", 1, pointCount > 0 ? 6 : 2);
 
 	if (!path.name.empty())
-		pathMsg.AddString("name", path.name);
+		container.AddString("name", path.name);
 	else
-		pathMsg.AddString("name", "<path>");
-
-	size_t pointCount = path.points.size();
+		container.AddString("name", "<path>");
 
 	for (size_t i = 0; i < pointCount; ++i) {
 		const ControlPoint& cp = path.points[i];
-		pathMsg.AddPoint("point", haiku_compat::BPoint(cp.x, cp.y));
+		container.AddPoint("point", haiku_compat::BPoint(cp.x, cp.y));
 	}
 
 	for (size_t i = 0; i < pointCount; ++i) {
 		const ControlPoint& cp = path.points[i];
-		pathMsg.AddPoint("point in", haiku_compat::BPoint(cp.x_in, cp.y_in));
+		container.AddPoint("point in", haiku_compat::BPoint(cp.x_in, cp.y_in));
 	}
 
 	for (size_t i = 0; i < pointCount; ++i) {
 		const ControlPoint& cp = path.points[i];
-		pathMsg.AddPoint("point out", haiku_compat::BPoint(cp.x_out, cp.y_out));
+		container.AddPoint("point out", haiku_compat::BPoint(cp.x_out, cp.y_out));
 	}
 
 	for (size_t i = 0; i < pointCount; ++i) {
-		pathMsg.AddBool("connected", false);
+		container.AddBool("connected", false);
 	}
 
-	pathMsg.AddBool("path closed", path.closed);
+	container.AddBool("path closed", path.closed);
 
-	container.AddMessage("path", &pathMsg);
+	container.EndMessage();
 }
 
 void
-IOMWriter::_AddShapeToMessage(haiku_compat::BMessage& container, const Shape& shape, int index)
+IOMWriter::_AddShapeToMessage(haiku_compat::BMessageBuilder& container, const Shape& shape, int index)
 {
-	haiku_compat::BMessage shapeMsg(1);
+	int32_t fieldCount = 7;
+	if (!shape.pathIndices.empty())
+		fieldCount++;
+	if (!shape.transformers.empty())
+		fieldCount++;
 
-	shapeMsg.AddInt32("type", TRANSFORMER_SHAPE_FLAGS);
+	container.BeginMessage("shape", 1, fieldCount);
 
-	shapeMsg.AddInt32("style ref", shape.styleIndex);
+	container.AddInt32("type", TRANSFORMER_SHAPE_FLAGS);
+
+	container.AddInt32("style ref", shape.styleIndex);
 
 	for (size_t i = 0; i < shape.pathIndices.size(); ++i) {
-		shapeMsg.AddInt32("path ref", shape.pathIndices[i]);
+		container.AddInt32("path ref", shape.pathIndices[i]);
 	}
 
 	if (!shape.name.empty())
-		shapeMsg.AddString("name", shape.name);
+		container.AddString("name", shape.name);
 	else
-		shapeMsg.AddString("name", "");
+		container.AddString("name", "");
 
-	shapeMsg.AddBool("hinting", shape.hinting);
+	container.AddBool("hinting", shape.hinting);
 
 	for (size_t i = 0; i < shape.transformers.size(); ++i) {
-		haiku_compat::BMessage transMsg(1);
-		_AddTransformerToMessage(transMsg, shape.transformers[i]);
-		shapeMsg.AddMessage("transformer", &transMsg);
+		_AddTransformerToMessage(container, shape.transformers[i]);
 	}
 
 	if (shape.hasTransform && shape.transform.size() >= 6) {
-		shapeMsg.AddData("transformation", haiku_compat::B_DOUBLE_TYPE,
+		container.AddData("transformation", haiku_compat::B_DOUBLE_TYPE,
 			&shape.transform[0], 6 * sizeof(double), true);
 	} else {
 		double identity[6] = {1.0, 0.0, 0.0, 1.0, 0.0, 0.0};
-		shapeMsg.AddData("transformation", haiku_compat::B_DOUBLE_TYPE,
+		container.AddData("transformation", haiku_compat::B_DOUBLE_TYPE,
 			identity, 6 * sizeof(double), true);
 	}
 
-	shapeMsg.AddFloat("min visibility scale", shape.minVisibility);
-	shapeMsg.AddFloat("max visibility scale", shape.maxVisibility);
+	container.AddFloat("min visibility scale", shape.minVisibility);
+	container.AddFloat("max visibility scale", shape.maxVisibility);
 
-	container.AddMessage("shape", &shapeMsg);
+	container.EndMessage();
 }
 
 void
-IOMWriter::_AddGradientToMessage(haiku_compat::BMessage& msg, const Gradient& grad)
+IOMWriter::_AddGradientToMessage(haiku_compat::BMessageBuilder& msg, const Gradient& grad)
 {
 	msg.AddString("class", "Gradient");
 	msg.AddString("class", "Gradient");
@@ -237,16 +230,12 @@ IOMWriter::_AddGradientToMessage(haiku_compat::BMessage& msg, const Gradient& gr
 }
 
 void
-IOMWriter::_AddTransformerToMessage(haiku_compat::BMessage& msg, const Transformer& trans)
+IOMWriter::_AddTransformerToMessage(haiku_compat::BMessageBuilder& msg, const Transformer& trans)
 {
-	haiku_compat::BMessage::Private msgPrivate(msg);
-
-	if (msgPrivate.InitHeader() != haiku_compat::B_OK)
-		return;
-
 	switch (trans.type) {
 		case TRANSFORMER_STROKE:
-			msgPrivate.GetMessageHeader()->flags = TRANSFORMER_STROKE_FLAGS;
+			msg.BeginMessage("transformer", 1, 8);
+			msg.SetFlags(TRANSFORMER_STROKE_FLAGS);
 			msg.AddString("name", "Stroke");
 			msg.AddInt32("line cap", trans.lineCap);
 			msg.AddInt32("line join", trans.lineJoin);
@@ -258,7 +247,8 @@ IOMWriter::_AddTransformerToMessage(haiku_compat::BMessage& msg, const Transform
 			break;
 
 		case TRANSFORMER_AFFINE:
-			msgPrivate.GetMessageHeader()->flags = TRANSFORMER_AFFINE_FLAGS;
+			msg.BeginMessage("transformer", 1, 2);
+			msg.SetFlags(TRANSFORMER_AFFINE_FLAGS);
 			msg.AddString("name", "Affine");
 			if (trans.matrix.size() >= 6) {
 				msg.AddData("matrix", haiku_compat::B_DOUBLE_TYPE,
@@ -267,7 +257,8 @@ IOMWriter::_AddTransformerToMessage(haiku_compat::BMessage& msg, const Transform
 			break;
 
 		case TRANSFORMER_CONTOUR:
-			msgPrivate.GetMessageHeader()->flags = TRANSFORMER_CONTOUR_FLAGS;
+			msg.BeginMessage("transformer", 1, 5);
+			msg.SetFlags(TRANSFORMER_CONTOUR_FLAGS);
 			msg.AddString("name", "Contour");
 			msg.AddInt32("line join", trans.lineJoin);
 			msg.AddInt32("inner join", 1);
@@ -277,13 +268,20 @@ IOMWriter::_AddTransformerToMessage(haiku_compat::BMessage& msg, const Transform
 			break;
 
 		case TRANSFORMER_PERSPECTIVE:
-			msgPrivate.GetMessageHeader()->flags = TRANSFORMER_PERSPECTIVE_FLAGS;
+			msg.BeginMessage("transformer", 1, 2);
+			msg.SetFlags(TRANSFORMER_PERSPECTIVE_FLAGS);
 			msg.AddString("name", "Perspective");
 			for (size_t i = 0; i < 9 && i < trans.matrix.size(); i++) {
 				msg.AddDouble("matrix", trans.matrix[i]);
 			}
 			break;
+
+		default:
+			msg.BeginMessage("transformer", 1, 0);
+			break;
 	}
+
+	msg.EndMessage();
 }
 
 }
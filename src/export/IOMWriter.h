@@ -10,7 +10,7 @@
 #include <vector>
 
 #include "IOMStructures.h"
-#include "BMessage.h"
+#include "BMessageBuilder.h"
 
 namespace iom {
 
@@ -23,16 +23,16 @@ public:
 	bool	WriteToBuffer(std::vector<uint8_t>& buffer, const Icon& icon);
 
 private:
-	void	_BuildMessage(haiku_compat::BMessage& msg, const Icon& icon);
-	void	_AddStylesToMessage(haiku_compat::BMessage& msg, const Icon& icon);
-	void	_AddPathsToMessage(haiku_compat::BMessage& msg, const Icon& icon);
-	void	_AddShapesToMessage(haiku_compat::BMessage& msg, const Icon& icon);
+	void	_BuildMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon);
+	void	_AddStylesToMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon);
+	void	_AddPathsToMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon);
+	void	_AddShapesToMessage(haiku_compat::BMessageBuilder& msg, const Icon& icon);
 	
-	void	_AddStyleToMessage(haiku_compat::BMessage& container, const Style& style, int index);
-	void	_AddPathToMessage(haiku_compat::BMessage& container, const Path& path, int index);
-	void	_AddShapeToMessage(haiku_compat::BMessage& container, const Shape& shape, int index);
-	void	_AddGradientToMessage(haiku_compat::BMessage& msg, const Gradient& grad);
-	void	_AddTransformerToMessage(haiku_compat::BMessage& msg, const Transformer& trans);
+	void	_AddStyleToMessage(haiku_compat::BMessageBuilder& container, const Style& style, int index);
+	void	_AddPathToMessage(haiku_compat::BMessageBuilder& container, const Path& path, int index);
+	void	_AddShapeToMessage(haiku_compat::BMessageBuilder& container, const Shape& shape, int index);
+	void	_AddGradientToMessage(haiku_compat::BMessageBuilder& msg, const Gradient& grad);
+	void	_AddTransformerToMessage(haiku_compat::BMessageBuilder& msg, const Transformer& trans);
 };
 
 }
@@ -0,0 +1,916 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <queue>
+#include <thread>
+
+#include "PNGEncoder.h"
+
+namespace haiku {
+
+static const size_t kWindowSize = 32768;
+static const size_t kWindowMask = kWindowSize - 1;
+static const size_t kMaxDistance = kWindowSize - 1;
+static const int kMinMatch = 3;
+static const int kMaxMatch = 258;
+static const int kHashBits = 15;
+static const size_t kBlockSymbols = 32768;
+static const size_t kMaxStoredBlock = 65535;
+
+// Rows are only split across threads in blocks at least this big, so
+// every thread has enough data to find matches in.
+static const size_t kParallelBlockBytes = 256 * 1024;
+
+struct EffortLevel {
+	int		chain;
+	int		nice;
+	bool	lazy;
+};
+
+static const EffortLevel kLevels[] = {
+	{ 0, 0, false },
+	{ 4, 32, false },
+	{ 32, 128, true },
+	{ 1024, kMaxMatch, true }
+};
+
+static const char* const kEffortNames[] = { "store", "fast", "default", "max" };
+
+static const uint16_t kLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t kLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t kDistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t kDistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t kCodeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static void BuildCodes(const uint8_t* lengths, int count, uint16_t* codes);
+
+// Lookup tables, built once.
+struct EncoderTables {
+	uint8_t		lengthSymbol[kMaxMatch + 1];
+	uint8_t		distanceSymbol[512];
+	uint32_t	crc[256];
+	uint8_t		fixedLiteralLengths[288];
+	uint16_t	fixedLiteralCodes[288];
+	uint8_t		fixedDistanceLengths[30];
+	uint16_t	fixedDistanceCodes[30];
+
+	EncoderTables()
+	{
+		for (int symbol = 0; symbol < 29; symbol++) {
+			int end = symbol < 28 ? kLengthBase[symbol + 1] : kMaxMatch + 1;
+			for (int length = kLengthBase[symbol]; length < end; length++)
+				lengthSymbol[length] = symbol;
+		}
+		lengthSymbol[kMaxMatch] = 28;
+
+		// Distances up to 256 are looked up directly, longer ones by
+		// their upper bits.
+		for (int symbol = 0; symbol < 30; symbol++) {
+			int end = symbol < 29 ? kDistanceBase[symbol + 1] : 32769;
+			for (int distance = kDistanceBase[symbol]; distance < end; distance++) {
+				int d = distance - 1;
+				if (d < 256)
+					distanceSymbol[d] = symbol;
+				else
+					distanceSymbol[256 + (d >> 7)] = symbol;
+			}
+		}
+
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320U ^ (c >> 1) : c >> 1;
+			crc[n] = c;
+		}
+
+		for (int i = 0; i < 288; i++)
+			fixedLiteralLengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+		for (int i = 0; i < 30; i++)
+			fixedDistanceLengths[i] = 5;
+		BuildCodes(fixedLiteralLengths, 288, fixedLiteralCodes);
+		BuildCodes(fixedDistanceLengths, 30, fixedDistanceCodes);
+	}
+};
+
+static const EncoderTables&
+Tables()
+{
+	static const EncoderTables tables;
+	return tables;
+}
+
+static inline int
+DistanceSymbol(int distance)
+{
+	int d = distance - 1;
+	return Tables().distanceSymbol[d < 256 ? d : 256 + (d >> 7)];
+}
+
+static uint32_t
+Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+	const uint32_t* table = Tables().crc;
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static uint32_t
+Adler32(const uint8_t* data, size_t size)
+{
+	uint32_t a = 1, b = 0;
+	while (size > 0) {
+		// The largest run that cannot overflow 32 bits before the modulo.
+		size_t run = std::min(size, (size_t)5552);
+		for (size_t i = 0; i < run; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += run;
+		size -= run;
+	}
+	return (b << 16) | a;
+}
+
+static inline void
+PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back((uint8_t)(value >> 24));
+	out.push_back((uint8_t)(value >> 16));
+	out.push_back((uint8_t)(value >> 8));
+	out.push_back((uint8_t)value);
+}
+
+// Code lengths of a Huffman code for the frequencies, no longer than
+// maxLength. Unused symbols get length 0; at least two symbols always get
+// a code, so decoders see a complete tree.
+static void
+BuildLengths(const uint32_t* frequencies, int count, int maxLength, uint8_t* lengths)
+{
+	memset(lengths, 0, count);
+
+	std::vector<int> symbols;
+	for (int i = 0; i < count; i++) {
+		if (frequencies[i] > 0)
+			symbols.push_back(i);
+	}
+
+	if (symbols.size() < 2) {
+		int used = symbols.empty() ? 0 : symbols[0];
+		lengths[used] = 1;
+		lengths[used == 0 ? 1 : 0] = 1;
+		return;
+	}
+
+	// Plain Huffman first; nodes after the leaves are internal, each made
+	// after both of its children.
+	struct Node {
+		uint64_t	weight;
+		int			parent;
+	};
+	std::vector<Node> nodes(symbols.size());
+	typedef std::pair<uint64_t, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+	for (size_t i = 0; i < symbols.size(); i++) {
+		nodes[i].weight = frequencies[symbols[i]];
+		nodes[i].parent = -1;
+		queue.push(Entry(nodes[i].weight, (int)i));
+	}
+
+	while (queue.size() > 1) {
+		Entry a = queue.top();
+		queue.pop();
+		Entry b = queue.top();
+		queue.pop();
+
+		Node node = { a.first + b.first, -1 };
+		nodes[a.second].parent = (int)nodes.size();
+		nodes[b.second].parent = (int)nodes.size();
+		queue.push(Entry(node.weight, (int)nodes.size()));
+		nodes.push_back(node);
+	}
+
+	std::vector<int> depth(nodes.size(), 0);
+	for (int i = (int)nodes.size() - 2; i >= 0; i--)
+		depth[i] = depth[nodes[i].parent] + 1;
+
+	// Fold codes that are too long into the longest allowed length, then
+	// lengthen shorter codes until the lengths describe a full tree again.
+	int lengthCounts[33] = { 0 };
+	for (size_t i = 0; i < symbols.size(); i++)
+		lengthCounts[std::min(depth[i], 32)]++;
+	for (int i = maxLength + 1; i <= 32; i++) {
+		lengthCounts[maxLength] += lengthCounts[i];
+		lengthCounts[i] = 0;
+	}
+
+	uint32_t total = 0;
+	for (int i = maxLength; i > 0; i--)
+		total += (uint32_t)lengthCounts[i] << (maxLength - i);
+	while (total != (1U << maxLength)) {
+		lengthCounts[maxLength]--;
+		for (int i = maxLength - 1; i > 0; i--) {
+			if (lengthCounts[i] > 0) {
+				lengthCounts[i]--;
+				lengthCounts[i + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	// The longest codes go to the rarest symbols.
+	std::stable_sort(symbols.begin(), symbols.end(), [frequencies](int a, int b) {
+		return frequencies[a] < frequencies[b];
+	});
+	size_t next = 0;
+	for (int length = maxLength; length > 0; length--) {
+		for (int k = 0; k < lengthCounts[length]; k++)
+			lengths[symbols[next++]] = length;
+	}
+}
+
+// Canonical codes for the lengths, bit reversed since deflate writes
+// Huffman codes starting from their most significant bit.
+static void
+BuildCodes(const uint8_t* lengths, int count, uint16_t* codes)
+{
+	int lengthCounts[16] = { 0 };
+	for (int i = 0; i < count; i++)
+		lengthCounts[lengths[i]]++;
+	lengthCounts[0] = 0;
+
+	int nextCode[16] = { 0 };
+	int code = 0;
+	for (int bits = 1; bits < 16; bits++) {
+		code = (code + lengthCounts[bits - 1]) << 1;
+		nextCode[bits] = code;
+	}
+
+	for (int i = 0; i < count; i++) {
+		int length = lengths[i];
+		if (length == 0) {
+			codes[i] = 0;
+			continue;
+		}
+
+		int value = nextCode[length]++;
+		int reversed = 0;
+		for (int b = 0; b < length; b++)
+			reversed |= ((value >> b) & 1) << (length - 1 - b);
+		codes[i] = (uint16_t)reversed;
+	}
+}
+
+class BitWriter {
+public:
+	explicit BitWriter(std::vector<uint8_t>& out)
+		: fOut(out)
+		, fBits(0)
+		, fCount(0)
+	{
+	}
+
+	inline void Write(uint32_t value, int count)
+	{
+		fBits |= (uint64_t)value << fCount;
+		fCount += count;
+		while (fCount >= 8) {
+			fOut.push_back((uint8_t)fBits);
+			fBits >>= 8;
+			fCount -= 8;
+		}
+	}
+
+	void Align()
+	{
+		if (fCount > 0)
+			Write(0, 8 - fCount);
+	}
+
+	std::vector<uint8_t>& Output() { return fOut; }
+
+private:
+	std::vector<uint8_t>&	fOut;
+	uint64_t				fBits;
+	int						fCount;
+};
+
+// LZ77 with hash chains over a 32 KiB window, written as deflate blocks
+// of about kBlockSymbols symbols, each with whichever of dynamic codes,
+// fixed codes or storing comes out smallest.
+class Deflater {
+public:
+	explicit Deflater(PNGEffort effort)
+		: fLevel(kLevels[effort])
+		, fStore(effort == PNG_EFFORT_STORE)
+		, fData(NULL)
+		, fSize(0)
+		, fBlockStart(0)
+		, fBlockBytes(0)
+		, fWriter(NULL)
+	{
+	}
+
+	// Appends data as raw deflate blocks. Unless last is set the stream
+	// ends on an empty stored block, byte aligned and not final, so the
+	// output of another Deflater can follow it.
+	void Compress(const uint8_t* data, size_t size, bool last, std::vector<uint8_t>& out)
+	{
+		BitWriter writer(out);
+		fWriter = &writer;
+		fData = data;
+		fSize = size;
+		fBlockStart = 0;
+		fBlockBytes = 0;
+
+		if (fStore) {
+			_WriteStored(data, size, last);
+			return;
+		}
+
+		fHead.assign(1 << kHashBits, 0);
+		fPrev.assign(kWindowSize, 0);
+		fSymbols.clear();
+		fSymbols.reserve(kBlockSymbols);
+		_ResetFrequencies();
+
+		size_t i = 0;
+		bool pending = false;
+		int pendingLength = 0;
+		int pendingDistance = 0;
+
+		while (i < size) {
+			int length = 0;
+			int distance = 0;
+			if (i + kMinMatch <= size) {
+				if (!pending || pendingLength < fLevel.nice)
+					length = _FindMatch(i, pending ? pendingLength : kMinMatch - 1, distance);
+				_Insert(i);
+			}
+
+			if (pending) {
+				// A longer match one byte later wins over the one kept back.
+				if (length > 0) {
+					_Literal(fData[i - 1]);
+					pendingLength = length;
+					pendingDistance = distance;
+					i++;
+					continue;
+				}
+
+				_Match(pendingLength, pendingDistance);
+				i = _InsertRange(i + 1, i - 1 + pendingLength);
+				pending = false;
+				continue;
+			}
+
+			if (length >= kMinMatch) {
+				if (fLevel.lazy && length < fLevel.nice) {
+					pending = true;
+					pendingLength = length;
+					pendingDistance = distance;
+					i++;
+					continue;
+				}
+
+				_Match(length, distance);
+				i = _InsertRange(i + 1, i + length);
+				continue;
+			}
+
+			_Literal(fData[i]);
+			i++;
+		}
+
+		if (pending)
+			_Match(pendingLength, pendingDistance);
+
+		_FlushBlock(last);
+		if (!last) {
+			writer.Write(0, 3);
+			writer.Align();
+			writer.Write(0x0000, 16);
+			writer.Write(0xffff, 16);
+		}
+		writer.Align();
+	}
+
+private:
+	static inline uint32_t _Hash(const uint8_t* p)
+	{
+		uint32_t value = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+		return (value * 0x9e3779b1U) >> (32 - kHashBits);
+	}
+
+	inline void _Insert(size_t position)
+	{
+		uint32_t hash = _Hash(fData + position);
+		fPrev[position & kWindowMask] = fHead[hash];
+		fHead[hash] = (uint32_t)position + 1;
+	}
+
+	size_t _InsertRange(size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; i++) {
+			if (i + kMinMatch <= fSize)
+				_Insert(i);
+		}
+		return end;
+	}
+
+	// Longest earlier match for the bytes at position, if longer than
+	// minimum; 0 otherwise. Positions in the chains are stored plus one.
+	int _FindMatch(size_t position, int minimum, int& distance)
+	{
+		int maxLength = (int)std::min((size_t)kMaxMatch, fSize - position);
+		int best = minimum;
+		if (best >= maxLength)
+			return 0;
+
+		const uint8_t* current = fData + position;
+		uint32_t candidate = fHead[_Hash(current)];
+		int chain = fLevel.chain;
+
+		while (candidate != 0 && chain-- > 0) {
+			size_t start = candidate - 1;
+			if (position - start > kMaxDistance)
+				break;
+
+			const uint8_t* earlier = fData + start;
+			if (earlier[best] == current[best] && earlier[0] == current[0]
+				&& earlier[1] == current[1]) {
+				int length = 2;
+				while (length < maxLength && earlier[length] == current[length])
+					length++;
+
+				if (length > best) {
+					best = length;
+					distance = (int)(position - start);
+					if (length >= fLevel.nice || length == maxLength)
+						break;
+				}
+			}
+
+			uint32_t next = fPrev[start & kWindowMask];
+			if (next >= candidate)
+				break;
+			candidate = next;
+		}
+
+		return best > minimum ? best : 0;
+	}
+
+	void _ResetFrequencies()
+	{
+		memset(fLiteralFrequencies, 0, sizeof(fLiteralFrequencies));
+		memset(fDistanceFrequencies, 0, sizeof(fDistanceFrequencies));
+	}
+
+	inline void _Literal(uint8_t value)
+	{
+		fSymbols.push_back(value);
+		fLiteralFrequencies[value]++;
+		fBlockBytes++;
+		if (fSymbols.size() >= kBlockSymbols)
+			_FlushBlock(false);
+	}
+
+	inline void _Match(int length, int distance)
+	{
+		fSymbols.push_back(0x80000000U | ((uint32_t)length << 15) | (uint32_t)distance);
+		fLiteralFrequencies[257 + Tables().lengthSymbol[length]]++;
+		fDistanceFrequencies[DistanceSymbol(distance)]++;
+		fBlockBytes += length;
+		if (fSymbols.size() >= kBlockSymbols)
+			_FlushBlock(false);
+	}
+
+	void _WriteStored(const uint8_t* data, size_t size, bool last)
+	{
+		size_t offset = 0;
+		do {
+			size_t length = std::min(size - offset, kMaxStoredBlock);
+			bool final = last && offset + length == size;
+
+			fWriter->Write(final ? 1 : 0, 3);
+			fWriter->Align();
+			fWriter->Write((uint32_t)length, 16);
+			fWriter->Write((uint32_t)length ^ 0xffff, 16);
+
+			std::vector<uint8_t>& out = fWriter->Output();
+			out.insert(out.end(), data + offset, data + offset + length);
+			offset += length;
+		} while (offset < size);
+	}
+
+	struct CodeLengthSymbol {
+		uint8_t		symbol;
+		uint8_t		extra;
+		uint8_t		extraBits;
+	};
+
+	// The code lengths of both trees, run length encoded with the repeat
+	// symbols 16 to 18.
+	static void _EncodeLengths(const uint8_t* lengths, int count,
+		std::vector<CodeLengthSymbol>& encoded, uint32_t* frequencies)
+	{
+		encoded.clear();
+		int i = 0;
+		while (i < count) {
+			int value = lengths[i];
+			int run = 1;
+			while (i + run < count && lengths[i + run] == value)
+				run++;
+			i += run;
+
+			if (value == 0) {
+				while (run >= 11) {
+					int take = std::min(run, 138);
+					CodeLengthSymbol s = { 18, (uint8_t)(take - 11), 7 };
+					encoded.push_back(s);
+					run -= take;
+				}
+				if (run >= 3) {
+					CodeLengthSymbol s = { 17, (uint8_t)(run - 3), 3 };
+					encoded.push_back(s);
+					run = 0;
+				}
+			} else {
+				CodeLengthSymbol s = { (uint8_t)value, 0, 0 };
+				encoded.push_back(s);
+				run--;
+				while (run >= 3) {
+					int take = std::min(run, 6);
+					CodeLengthSymbol repeat = { 16, (uint8_t)(take - 3), 2 };
+					encoded.push_back(repeat);
+					run -= take;
+				}
+			}
+
+			for (; run > 0; run--) {
+				CodeLengthSymbol s = { (uint8_t)value, 0, 0 };
+				encoded.push_back(s);
+			}
+		}
+
+		for (size_t k = 0; k < encoded.size(); k++)
+			frequencies[encoded[k].symbol]++;
+	}
+
+	uint64_t _DataBits(const uint8_t* literalLengths, const uint8_t* distanceLengths) const
+	{
+		uint64_t bits = 0;
+		for (int i = 0; i < 286; i++) {
+			bits += (uint64_t)fLiteralFrequencies[i]
+				* (literalLengths[i] + (i > 256 ? kLengthExtra[i - 257] : 0));
+		}
+		for (int i = 0; i < 30; i++) {
+			bits += (uint64_t)fDistanceFrequencies[i]
+				* (distanceLengths[i] + kDistanceExtra[i]);
+		}
+		return bits;
+	}
+
+	void _WriteSymbols(const uint8_t* literalLengths, const uint16_t* literalCodes,
+		const uint8_t* distanceLengths, const uint16_t* distanceCodes)
+	{
+		const EncoderTables& tables = Tables();
+
+		for (size_t i = 0; i < fSymbols.size(); i++) {
+			uint32_t symbol = fSymbols[i];
+			if ((symbol & 0x80000000U) == 0) {
+				fWriter->Write(literalCodes[symbol], literalLengths[symbol]);
+				continue;
+			}
+
+			int length = (symbol >> 15) & 0x1ff;
+			int distance = symbol & 0x7fff;
+
+			int lengthSymbol = tables.lengthSymbol[length];
+			fWriter->Write(literalCodes[257 + lengthSymbol], literalLengths[257 + lengthSymbol]);
+			fWriter->Write(length - kLengthBase[lengthSymbol], kLengthExtra[lengthSymbol]);
+
+			int distanceSymbol = DistanceSymbol(distance);
+			fWriter->Write(distanceCodes[distanceSymbol], distanceLengths[distanceSymbol]);
+			fWriter->Write(distance - kDistanceBase[distanceSymbol], kDistanceExtra[distanceSymbol]);
+		}
+
+		fWriter->Write(literalCodes[256], literalLengths[256]);
+	}
+
+	void _FlushBlock(bool last)
+	{
+		fLiteralFrequencies[256]++;
+
+		uint8_t literalLengths[286];
+		uint8_t distanceLengths[30];
+		BuildLengths(fLiteralFrequencies, 286, 15, literalLengths);
+		BuildLengths(fDistanceFrequencies, 30, 15, distanceLengths);
+
+		int literalCount = 286;
+		while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+			literalCount--;
+		int distanceCount = 30;
+		while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+			distanceCount--;
+
+		uint8_t allLengths[286 + 30];
+		memcpy(allLengths, literalLengths, literalCount);
+		memcpy(allLengths + literalCount, distanceLengths, distanceCount);
+
+		uint32_t codeLengthFrequencies[19] = { 0 };
+		_EncodeLengths(allLengths, literalCount + distanceCount, fEncodedLengths,
+			codeLengthFrequencies);
+
+		uint8_t codeLengthLengths[19];
+		BuildLengths(codeLengthFrequencies, 19, 7, codeLengthLengths);
+		int codeLengthCount = 19;
+		while (codeLengthCount > 4
+			&& codeLengthLengths[kCodeLengthOrder[codeLengthCount - 1]] == 0) {
+			codeLengthCount--;
+		}
+
+		uint64_t dynamicBits = 3 + 14 + 3 * codeLengthCount
+			+ _DataBits(literalLengths, distanceLengths);
+		for (size_t i = 0; i < fEncodedLengths.size(); i++) {
+			dynamicBits += codeLengthLengths[fEncodedLengths[i].symbol]
+				+ fEncodedLengths[i].extraBits;
+		}
+
+		const EncoderTables& tables = Tables();
+		uint64_t fixedBits = 3 + _DataBits(tables.fixedLiteralLengths,
+			tables.fixedDistanceLengths);
+		uint64_t storedBits = (fBlockBytes + 5 * (fBlockBytes / kMaxStoredBlock + 1)) * 8 + 7;
+
+		if (storedBits <= dynamicBits && storedBits <= fixedBits) {
+			_WriteStored(fData + fBlockStart, fBlockBytes, last);
+		} else if (fixedBits <= dynamicBits) {
+			fWriter->Write(last ? 1 : 0, 1);
+			fWriter->Write(1, 2);
+			_WriteSymbols(tables.fixedLiteralLengths, tables.fixedLiteralCodes,
+				tables.fixedDistanceLengths, tables.fixedDistanceCodes);
+		} else {
+			uint16_t literalCodes[286];
+			uint16_t distanceCodes[30];
+			uint16_t codeLengthCodes[19];
+			BuildCodes(literalLengths, 286, literalCodes);
+			BuildCodes(distanceLengths, 30, distanceCodes);
+			BuildCodes(codeLengthLengths, 19, codeLengthCodes);
+
+			fWriter->Write(last ? 1 : 0, 1);
+			fWriter->Write(2, 2);
+			fWriter->Write(literalCount - 257, 5);
+			fWriter->Write(distanceCount - 1, 5);
+			fWriter->Write(codeLengthCount - 4, 4);
+			for (int i = 0; i < codeLengthCount; i++)
+				fWriter->Write(codeLengthLengths[kCodeLengthOrder[i]], 3);
+
+			for (size_t i = 0; i < fEncodedLengths.size(); i++) {
+				const CodeLengthSymbol& s = fEncodedLengths[i];
+				fWriter->Write(codeLengthCodes[s.symbol], codeLengthLengths[s.symbol]);
+				fWriter->Write(s.extra, s.extraBits);
+			}
+
+			_WriteSymbols(literalLengths, literalCodes, distanceLengths, distanceCodes);
+		}
+
+		fSymbols.clear();
+		_ResetFrequencies();
+		fBlockStart += fBlockBytes;
+		fBlockBytes = 0;
+	}
+
+	EffortLevel				fLevel;
+	bool					fStore;
+	const uint8_t*			fData;
+	size_t					fSize;
+	size_t					fBlockStart;
+	size_t					fBlockBytes;
+	BitWriter*				fWriter;
+
+	std::vector<uint32_t>	fHead;
+	std::vector<uint32_t>	fPrev;
+	std::vector<uint32_t>	fSymbols;
+	std::vector<CodeLengthSymbol> fEncodedLengths;
+	uint32_t				fLiteralFrequencies[286];
+	uint32_t				fDistanceFrequencies[30];
+};
+
+// Upper bound of the deflate output for size bytes split into a number of
+// independently compressed parts: no block is ever written bigger than
+// storing it would be.
+static size_t
+DeflateBound(size_t size, size_t parts)
+{
+	size_t blocks = size / kBlockSymbols + size / kMaxStoredBlock + 2 * parts + 1;
+	return size + 6 * blocks;
+}
+
+const char*
+PNGEffortName(PNGEffort effort)
+{
+	return kEffortNames[effort];
+}
+
+bool
+PNGEffortFromName(const char* name, PNGEffort& effort)
+{
+	for (int i = PNG_EFFORT_STORE; i <= PNG_EFFORT_MAX; i++) {
+		if (strcmp(name, kEffortNames[i]) == 0) {
+			effort = (PNGEffort)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+PNGEncoder::PNGEncoder(PNGEffort effort)
+	: fEffort(effort)
+	, fThreads(0)
+	, fEncodeMs(0)
+	, fUsedThreads(0)
+{
+}
+
+bool
+PNGEncoder::Encode(const uint8_t* pixels, int width, int height, size_t stride,
+	std::vector<uint8_t>& output)
+{
+	if (pixels == NULL || width <= 0 || height <= 0 || width > 0x3fffffff / 4
+		|| height > 0x7fffffff)
+		return false;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<uint8_t> filtered;
+	_FilterRows(pixels, width, height, stride, filtered);
+
+	size_t rowBytes = 1 + (size_t)width * 4;
+	size_t size = filtered.size();
+
+	int threads = fThreads > 0 ? fThreads : (int)std::thread::hardware_concurrency();
+	if (threads < 1 || fEffort == PNG_EFFORT_STORE)
+		threads = 1;
+	size_t parts = std::max((size_t)1, std::min((size_t)threads, size / kParallelBlockBytes));
+
+	// Signature, header, data and end chunks around the zlib stream, all
+	// in one allocation.
+	static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	output.clear();
+	output.reserve(sizeof(kSignature) + 25 + 12 + 6 + DeflateBound(size, parts) + 12);
+	output.insert(output.end(), kSignature, kSignature + sizeof(kSignature));
+
+	size_t chunk = output.size();
+	PutBigEndian(output, 13);
+	output.insert(output.end(), { 'I', 'H', 'D', 'R' });
+	PutBigEndian(output, width);
+	PutBigEndian(output, height);
+	output.insert(output.end(), { 8, 6, 0, 0, 0 });
+	PutBigEndian(output, Crc32(&output[chunk + 4], 17));
+
+	chunk = output.size();
+	PutBigEndian(output, 0);
+	output.insert(output.end(), { 'I', 'D', 'A', 'T' });
+
+	static const uint8_t kZlibHeaders[][2] = {
+		{ 0x78, 0x01 }, { 0x78, 0x01 }, { 0x78, 0x9c }, { 0x78, 0xda }
+	};
+	output.insert(output.end(), kZlibHeaders[fEffort], kZlibHeaders[fEffort] + 2);
+
+	if (parts == 1) {
+		Deflater deflater(fEffort);
+		deflater.Compress(&filtered[0], size, true, output);
+	} else {
+		// Parts end on row boundaries.
+		size_t rowsPerPart = ((size_t)height + parts - 1) / parts;
+		std::vector<std::vector<uint8_t> > compressed(parts);
+		std::vector<std::future<void> > futures;
+
+		for (size_t p = 0; p < parts; p++) {
+			size_t begin = std::min(p * rowsPerPart, (size_t)height) * rowBytes;
+			size_t end = std::min((p + 1) * rowsPerPart, (size_t)height) * rowBytes;
+			bool last = p + 1 == parts;
+			std::vector<uint8_t>* out = &compressed[p];
+			const uint8_t* data = &filtered[0];
+			PNGEffort effort = fEffort;
+
+			futures.push_back(std::async(std::launch::async, [=]() {
+				out->reserve(DeflateBound(end - begin, 1));
+				Deflater deflater(effort);
+				deflater.Compress(data + begin, end - begin, last, *out);
+			}));
+		}
+
+		for (size_t p = 0; p < parts; p++) {
+			futures[p].wait();
+			output.insert(output.end(), compressed[p].begin(), compressed[p].end());
+		}
+	}
+
+	PutBigEndian(output, Adler32(&filtered[0], size));
+
+	size_t dataLength = output.size() - chunk - 8;
+	output[chunk] = (uint8_t)(dataLength >> 24);
+	output[chunk + 1] = (uint8_t)(dataLength >> 16);
+	output[chunk + 2] = (uint8_t)(dataLength >> 8);
+	output[chunk + 3] = (uint8_t)dataLength;
+	PutBigEndian(output, Crc32(&output[chunk + 4], dataLength + 4));
+
+	PutBigEndian(output, 0);
+	output.insert(output.end(), { 'I', 'E', 'N', 'D' });
+	PutBigEndian(output, Crc32(&output[output.size() - 4], 4));
+
+	fUsedThreads = (int)parts;
+	fEncodeMs = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void
+PNGEncoder::_FilterRows(const uint8_t* pixels, int width, int height, size_t stride,
+	std::vector<uint8_t>& filtered) const
+{
+	const size_t bytes = (size_t)width * 4;
+	const int bpp = 4;
+
+	filtered.resize((bytes + 1) * height);
+	std::vector<uint8_t> candidate(bytes);
+	std::vector<uint8_t> zeros(bytes, 0);
+
+	for (int y = 0; y < height; y++) {
+		const uint8_t* row = pixels + (size_t)y * stride;
+		const uint8_t* above = y > 0 ? pixels + (size_t)(y - 1) * stride : &zeros[0];
+		uint8_t* out = &filtered[(bytes + 1) * y];
+
+		if (fEffort == PNG_EFFORT_STORE) {
+			out[0] = 0;
+			memcpy(out + 1, row, bytes);
+			continue;
+		}
+
+		// Each filter is tried and the one whose output has the smallest
+		// sum of magnitudes, read as signed bytes, is kept.
+		uint64_t bestCost = UINT64_MAX;
+		for (int filter = 0; filter < 5; filter++) {
+			uint64_t cost = 0;
+			for (size_t i = 0; i < bytes; i++) {
+				int left = i >= (size_t)bpp ? row[i - bpp] : 0;
+				int up = above[i];
+				int upLeft = i >= (size_t)bpp ? above[i - bpp] : 0;
+
+				int predictor = 0;
+				switch (filter) {
+					case 1: predictor = left; break;
+					case 2: predictor = up; break;
+					case 3: predictor = (left + up) >> 1; break;
+					case 4:
+					{
+						int p = left + up - upLeft;
+						int pa = abs(p - left);
+						int pb = abs(p - up);
+						int pc = abs(p - upLeft);
+						predictor = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+						break;
+					}
+				}
+
+				uint8_t value = (uint8_t)(row[i] - predictor);
+				candidate[i] = value;
+				cost += value < 128 ? value : 256 - value;
+			}
+
+			if (cost < bestCost) {
+				bestCost = cost;
+				out[0] = (uint8_t)filter;
+				memcpy(out + 1, &candidate[0], bytes);
+			}
+		}
+	}
+}
+
+}
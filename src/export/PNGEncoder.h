@@ -0,0 +1,62 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef EXPORT_PNG_ENCODER_H
+#define EXPORT_PNG_ENCODER_H
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+namespace haiku {
+
+// How hard the encoder works to make the file small. STORE writes the
+// pixels uncompressed; the others pick a filter for every row and deflate
+// with Huffman codes fitted to each block, searching longer for matches
+// the higher the level.
+enum PNGEffort {
+	PNG_EFFORT_STORE = 0,
+	PNG_EFFORT_FAST,
+	PNG_EFFORT_DEFAULT,
+	PNG_EFFORT_MAX
+};
+
+const char*	PNGEffortName(PNGEffort effort);
+bool		PNGEffortFromName(const char* name, PNGEffort& effort);
+
+// Writes 8-bit RGBA images as PNG. Large images are split into blocks of
+// rows that are compressed on separate threads; each block starts a fresh
+// match window, which costs a little size for a lot of time.
+class PNGEncoder {
+public:
+	explicit		PNGEncoder(PNGEffort effort = PNG_EFFORT_DEFAULT);
+
+	void			SetEffort(PNGEffort effort) { fEffort = effort; }
+	PNGEffort		Effort() const { return fEffort; }
+
+	// Threads to compress with; 0 uses one per core.
+	void			SetThreads(int threads) { fThreads = threads; }
+
+	// Replaces output with the encoded image. stride is the distance in
+	// bytes between the starts of two rows.
+	bool			Encode(const uint8_t* pixels, int width, int height, size_t stride,
+						std::vector<uint8_t>& output);
+
+	double			EncodeMs() const { return fEncodeMs; }
+	int				UsedThreads() const { return fUsedThreads; }
+
+private:
+	void			_FilterRows(const uint8_t* pixels, int width, int height,
+						size_t stride, std::vector<uint8_t>& filtered) const;
+
+	PNGEffort		fEffort;
+	int				fThreads;
+	double			fEncodeMs;
+	int				fUsedThreads;
+};
+
+}
+
+#endif
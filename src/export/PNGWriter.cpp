@@ -3,8 +3,12 @@
  * Distributed under the terms of the MIT License.
  */
 
-#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <sstream>
 
 #include "nanosvg.h"
 #include "nanosvgrast.h"
@@ -13,12 +17,9 @@
 #include <Application.h>
 #include <Bitmap.h>
 #include <BitmapStream.h>
-#include <File.h>
 #include <TranslatorRoster.h>
 #include <TranslationUtils.h>
 #include <DataIO.h>
-#else
-#include "stb_image_write.h"
 #endif
 
 #include "PNGWriter.h"
@@ -26,6 +27,25 @@
 
 namespace haiku {
 
+std::string
+PNGWriterStats::ToJson() const
+{
+	char number[32];
+	std::ostringstream out;
+
+	out << "{\n";
+	out << "  \"encoder\": \"" << encoder << "\",\n";
+	out << "  \"threads\": " << threads << ",\n";
+	snprintf(number, sizeof(number), "%.3f", rasterizeMs);
+	out << "  \"rasterize_ms\": " << number << ",\n";
+	snprintf(number, sizeof(number), "%.3f", encodeMs);
+	out << "  \"encode_ms\": " << number << ",\n";
+	out << "  \"raw_bytes\": " << rawBytes << ",\n";
+	out << "  \"encoded_bytes\": " << encodedBytes << "\n";
+	out << "}\n";
+	return out.str();
+}
+
 PNGWriter::PNGWriter()
 {
 #ifdef __HAIKU__
@@ -42,37 +62,36 @@ bool
 PNGWriter::WriteToFile(const Icon& icon, const std::string& filename, 
 	const PNGWriterOptions& opts)
 {
-	std::vector<uint8_t> pixelData;
-	int width, height;
-
-	if (!_RasterizeIcon(icon, opts, pixelData, width, height))
+	std::vector<uint8_t> buffer;
+	if (!_Encode(icon, opts, buffer))
 		return false;
 
-#ifdef __HAIKU__
-	BBitmap* bitmap = _CreateBBitmapFromPixelData(pixelData, width, height);
-	if (!bitmap)
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file.is_open())
 		return false;
 
-	bool result = _SaveBBitmapToPNG(bitmap, filename);
-	delete bitmap;
-	return result;
-#else
-	int result = stbi_write_png(filename.c_str(), width, height, 4, 
-		&pixelData[0], width * 4);
-
-	return result != 0;
-#endif
+	file.write(reinterpret_cast<const char*>(&buffer[0]), buffer.size());
+	return !file.fail();
 }
 
 bool
 PNGWriter::WriteToBuffer(const Icon& icon, std::vector<uint8_t>& buffer,
 	const PNGWriterOptions& opts)
+{
+	return _Encode(icon, opts, buffer);
+}
+
+bool
+PNGWriter::_Encode(const Icon& icon, const PNGWriterOptions& opts,
+	std::vector<uint8_t>& buffer)
 {
 	std::vector<uint8_t> pixelData;
 	int width, height;
 
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 	if (!_RasterizeIcon(icon, opts, pixelData, width, height))
 		return false;
+	std::chrono::steady_clock::time_point rasterized = std::chrono::steady_clock::now();
 
 #ifdef __HAIKU__
 	BBitmap* bitmap = _CreateBBitmapFromPixelData(pixelData, width, height);
@@ -81,27 +100,37 @@ PNGWriter::WriteToBuffer(const Icon& icon, std::vector<uint8_t>& buffer,
 
 	bool result = _SaveBBitmapToPNGBuffer(bitmap, buffer);
 	delete bitmap;
-	return result;
-#else
-	struct WriteContext {
-		std::vector<uint8_t>* buffer;
-	};
-
-	WriteContext ctx;
-	ctx.buffer = &buffer;
+	if (!result)
+		return false;
 
-	stbi_write_func* writeFunc = [](void* context, void* data, int size) {
-		WriteContext* ctx = static_cast<WriteContext*>(context);
-		uint8_t* bytes = static_cast<uint8_t*>(data);
-		ctx->buffer->insert(ctx->buffer->end(), bytes, bytes + size);
-	};
+	std::string encoder = "translator";
+	int threads = 1;
+#else
+	PNGEncoder encoder(opts.effort);
+	encoder.SetThreads(opts.threads);
+	if (!encoder.Encode(&pixelData[0], width, height, (size_t)width * 4, buffer))
+		return false;
 
-	buffer.clear();
-	int result = stbi_write_png_to_func(writeFunc, &ctx, width, height, 4,
-		&pixelData[0], width * 4);
+	int threads = encoder.UsedThreads();
+#endif
 
-	return result != 0;
+	if (opts.stats != NULL) {
+		PNGWriterStats& stats = *opts.stats;
+		stats.rasterizeMs = std::chrono::duration<double, std::milli>(
+			rasterized - start).count();
+		stats.encodeMs = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - rasterized).count();
+		stats.rawBytes = pixelData.size();
+		stats.encodedBytes = buffer.size();
+#ifdef __HAIKU__
+		stats.encoder = encoder;
+#else
+		stats.encoder = PNGEffortName(opts.effort);
 #endif
+		stats.threads = threads;
+	}
+
+	return true;
 }
 
 bool
@@ -171,6 +200,11 @@ PNGWriter::_GenerateSVGString(const Icon& icon, int width, int height)
 	opts.includeNames = false;
 	opts.coordinateScale = 102.0f;
 
+	// nanosvg gets plain fills only: strokes and contours are outlined
+	// here, flat to a fifth of an output pixel.
+	opts.outlineStrokes = true;
+	opts.outlineTolerance = 0.2 * 64.0 / std::max(1, std::max(width, height));
+
 	return writer.Write(icon, opts);
 }
 
@@ -203,27 +237,6 @@ PNGWriter::_CreateBBitmapFromPixelData(const std::vector<uint8_t>& pixelData,
 	return bitmap;
 }
 
-bool
-PNGWriter::_SaveBBitmapToPNG(BBitmap* bitmap, const std::string& filename)
-{
-	BFile file(filename.c_str(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
-	if (file.InitCheck() != B_OK)
-		return false;
-
-	BBitmapStream stream(bitmap);
-	
-	BTranslatorRoster* roster = BTranslatorRoster::Default();
-	if (!roster)
-		return false;
-
-	status_t result = roster->Translate(&stream, NULL, NULL, &file, B_PNG_FORMAT);
-
-	BBitmap* temp;
-	stream.DetachBitmap(&temp);
-
-	return result == B_OK;
-}
-
 bool
 PNGWriter::_SaveBBitmapToPNGBuffer(BBitmap* bitmap, std::vector<uint8_t>& buffer)
 {
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include "HaikuIcon.h"
+#include "PNGEncoder.h"
 
 #ifdef __HAIKU__
 class BBitmap;
@@ -16,12 +17,37 @@ class BBitmap;
 
 namespace haiku {
 
+// What writing one image cost. Sizes are in bytes; raw is the RGBA
+// pixel data before encoding.
+struct PNGWriterStats {
+	double		rasterizeMs;
+	double		encodeMs;
+	size_t		rawBytes;
+	size_t		encodedBytes;
+	std::string	encoder;
+	int			threads;
+
+	PNGWriterStats()
+		: rasterizeMs(0), encodeMs(0), rawBytes(0), encodedBytes(0),
+		  threads(0) {}
+
+	std::string	ToJson() const;
+};
+
 struct PNGWriterOptions {
-	int			width;
-	int			height;
-	float		scale;
+	int				width;
+	int				height;
+	float			scale;
 
-	PNGWriterOptions() : width(64), height(64), scale(1.0f) {}
+	// Ignored on Haiku, where the PNG translator encodes.
+	PNGEffort		effort;
+	int				threads;
+
+	PNGWriterStats*	stats;
+
+	PNGWriterOptions()
+		: width(64), height(64), scale(1.0f), effort(PNG_EFFORT_DEFAULT),
+		  threads(0), stats(NULL) {}
 };
 
 class PNGWriter {
@@ -39,10 +65,12 @@ private:
 	bool		_RasterizeIcon(const Icon& icon, const PNGWriterOptions& opts,
 					std::vector<uint8_t>& pixelData, int& outWidth, int& outHeight);
 
+	bool		_Encode(const Icon& icon, const PNGWriterOptions& opts,
+					std::vector<uint8_t>& buffer);
+
 	std::string _GenerateSVGString(const Icon& icon, int width, int height);
 
 #ifdef __HAIKU__
-	bool		_SaveBBitmapToPNG(BBitmap* bitmap, const std::string& filename);
 	bool		_SaveBBitmapToPNGBuffer(BBitmap* bitmap, std::vector<uint8_t>& buffer);
 	BBitmap*	_CreateBBitmapFromPixelData(const std::vector<uint8_t>& pixelData, 
 					int width, int height);
@@ -0,0 +1,425 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "PathOutliner.h"
+#include "HVIFStructures.h"
+
+namespace haiku {
+
+static const double kPi = 3.14159265358979323846;
+static const double kEpsilon = 1e-9;
+static const int kMaxSteps = 1024;
+
+PathOutliner::PathOutliner(double tolerance)
+	: fTolerance(0.01)
+{
+	SetTolerance(tolerance);
+}
+
+void
+PathOutliner::SetTolerance(double tolerance)
+{
+	if (tolerance > 0)
+		fTolerance = tolerance;
+}
+
+void
+PathOutliner::Stroke(const Path& path, const Transformer& stroke,
+	std::vector<Path>& outlines)
+{
+	double halfWidth = std::fabs(stroke.width) / 2;
+	if (halfWidth <= 0)
+		return;
+
+	_Flatten(path);
+	if (fLine.empty())
+		return;
+
+	if (fLine.size() == 1) {
+		// A dot only shows with a cap that reaches past its end.
+		const Point& p = fLine[0];
+		if (stroke.lineCap == hvif::ROUND_CAP) {
+			_Add(p.x + halfWidth, p.y);
+			_Arc(p, 0, -2 * kPi, halfWidth);
+		} else if (stroke.lineCap == hvif::SQUARE) {
+			_Add(p.x - halfWidth, p.y + halfWidth);
+			_Add(p.x + halfWidth, p.y + halfWidth);
+			_Add(p.x + halfWidth, p.y - halfWidth);
+			_Add(p.x - halfWidth, p.y - halfWidth);
+		}
+		_TakeOutline(outlines);
+		return;
+	}
+
+	size_t count = fLine.size();
+	fReversed.assign(fLine.rbegin(), fLine.rend());
+
+	// A closed path of two points has no inside; it is stroked as the
+	// line between them.
+	if (path.closed && count > 2) {
+		_Offset(fLine, true, halfWidth, stroke);
+		_TakeOutline(outlines);
+		_Offset(fReversed, true, halfWidth, stroke);
+		_TakeOutline(outlines);
+		return;
+	}
+
+	_Offset(fLine, false, halfWidth, stroke);
+	_Cap(fLine[count - 2], fLine[count - 1], halfWidth, stroke.lineCap);
+	_Offset(fReversed, false, halfWidth, stroke);
+	_Cap(fReversed[count - 2], fReversed[count - 1], halfWidth, stroke.lineCap);
+	_TakeOutline(outlines);
+}
+
+void
+PathOutliner::Contour(const Path& path, const Transformer& contour,
+	std::vector<Path>& outlines)
+{
+	_Flatten(path);
+	if (fLine.size() > 1 && std::fabs(fLine.back().x - fLine.front().x) < kEpsilon
+		&& std::fabs(fLine.back().y - fLine.front().y) < kEpsilon) {
+		fLine.pop_back();
+	}
+	if (fLine.size() < 3)
+		return;
+
+	double area = 0;
+	for (size_t i = 0, j = fLine.size() - 1; i < fLine.size(); j = i++)
+		area += fLine[j].x * fLine[i].y - fLine[i].x * fLine[j].y;
+	if (std::fabs(area) < kEpsilon)
+		return;
+
+	// The inside is on the left of a counter-clockwise outline, which is
+	// where positive offsets go, so growing it means offsetting right.
+	double grow = contour.width / 2;
+	_Offset(fLine, true, area > 0 ? -grow : grow, contour);
+
+	// Shrunk past its own width the outline turns inside out and crosses
+	// itself; then nothing is left of the shape to fill.
+	if (grow < 0 && !_KeepsInside(-grow)) {
+		fOutline.clear();
+		return;
+	}
+
+	_TakeOutline(outlines);
+}
+
+bool
+PathOutliner::_KeepsInside(double distance) const
+{
+	// What is left of a shrunk shape has corners inside the line, at
+	// the full distance from all of it. Corners of the loops an inverted
+	// outline makes are always closer to some other part of the line.
+	double limit = std::max(0.0, distance - fTolerance);
+	size_t count = fLine.size();
+
+	for (size_t k = 0; k < fOutline.size(); k++) {
+		const Point& p = fOutline[k];
+		bool inside = false;
+		bool clear = true;
+
+		for (size_t i = 0, j = count - 1; i < count && clear; j = i++) {
+			const Point& a = fLine[j];
+			const Point& b = fLine[i];
+			if ((a.y > p.y) != (b.y > p.y)
+				&& p.x < a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y)) {
+				inside = !inside;
+			}
+
+			double dx = b.x - a.x;
+			double dy = b.y - a.y;
+			double lengthSquared = dx * dx + dy * dy;
+			double t = 0;
+			if (lengthSquared > 0) {
+				t = ((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSquared;
+				t = std::max(0.0, std::min(1.0, t));
+			}
+			if (std::hypot(a.x + t * dx - p.x, a.y + t * dy - p.y) < limit)
+				clear = false;
+		}
+
+		if (inside && clear)
+			return true;
+	}
+
+	return false;
+}
+
+void
+PathOutliner::_Flatten(const Path& path)
+{
+	fLine.clear();
+	fOutline.clear();
+
+	size_t count = path.points.size();
+	if (count == 0)
+		return;
+
+	size_t segments = path.closed ? count : count - 1;
+	_Add(path.points[0].x, path.points[0].y);
+
+	for (size_t i = 0; i < segments; i++) {
+		const PathPoint& from = path.points[i];
+		const PathPoint& to = path.points[(i + 1) % count];
+
+		if (_IsStraight(from, to)) {
+			_Add(to.x, to.y);
+			continue;
+		}
+
+		// The largest second difference of the control points bounds how
+		// far the curve strays from its chords: 3/4 d / n^2 for n steps.
+		double dx1 = from.x - 2 * from.x_out + to.x_in;
+		double dy1 = from.y - 2 * from.y_out + to.y_in;
+		double dx2 = from.x_out - 2 * to.x_in + to.x;
+		double dy2 = from.y_out - 2 * to.y_in + to.y;
+		double d = std::sqrt(std::max(dx1 * dx1 + dy1 * dy1, dx2 * dx2 + dy2 * dy2));
+
+		int steps = 1;
+		if (d > kEpsilon)
+			steps = std::min(kMaxSteps, (int)std::ceil(std::sqrt(0.75 * d / fTolerance)));
+
+		for (int s = 1; s < steps; s++) {
+			double t = (double)s / steps;
+			double mt = 1 - t;
+			double a = mt * mt * mt;
+			double b = 3 * mt * mt * t;
+			double c = 3 * mt * t * t;
+			double e = t * t * t;
+			_Add(a * from.x + b * from.x_out + c * to.x_in + e * to.x,
+				a * from.y + b * from.y_out + c * to.y_in + e * to.y);
+		}
+		_Add(to.x, to.y);
+	}
+
+	fLine.swap(fOutline);
+	fOutline.clear();
+
+	if (path.closed && fLine.size() > 1 && std::fabs(fLine.back().x - fLine.front().x) < kEpsilon
+		&& std::fabs(fLine.back().y - fLine.front().y) < kEpsilon) {
+		fLine.pop_back();
+	}
+}
+
+bool
+PathOutliner::_IsStraight(const PathPoint& from, const PathPoint& to) const
+{
+	// The curve stays within the hull of its control points, so handles
+	// close to the chord make it a line.
+	double dx = to.x - from.x;
+	double dy = to.y - from.y;
+	double length = std::sqrt(dx * dx + dy * dy);
+	if (length < kEpsilon) {
+		return std::hypot(from.x_out - from.x, from.y_out - from.y) <= fTolerance
+			&& std::hypot(to.x_in - to.x, to.y_in - to.y) <= fTolerance;
+	}
+
+	double out = std::fabs((from.x_out - from.x) * dy - (from.y_out - from.y) * dx) / length;
+	double in = std::fabs((to.x_in - from.x) * dy - (to.y_in - from.y) * dx) / length;
+	return out <= fTolerance && in <= fTolerance;
+}
+
+void
+PathOutliner::_Offset(const std::vector<Point>& line, bool closed, double offset,
+	const Transformer& t)
+{
+	size_t count = line.size();
+
+	if (closed) {
+		for (size_t i = 0; i < count; i++)
+			_Join(line[(i + count - 1) % count], line[i], line[(i + 1) % count], offset, t);
+		return;
+	}
+
+	double dx = line[1].x - line[0].x;
+	double dy = line[1].y - line[0].y;
+	double length = std::sqrt(dx * dx + dy * dy);
+	_Add(line[0].x - dy / length * offset, line[0].y + dx / length * offset);
+
+	for (size_t i = 1; i + 1 < count; i++)
+		_Join(line[i - 1], line[i], line[i + 1], offset, t);
+
+	dx = line[count - 1].x - line[count - 2].x;
+	dy = line[count - 1].y - line[count - 2].y;
+	length = std::sqrt(dx * dx + dy * dy);
+	_Add(line[count - 1].x - dy / length * offset, line[count - 1].y + dx / length * offset);
+}
+
+void
+PathOutliner::_Join(const Point& p0, const Point& p1, const Point& p2, double offset,
+	const Transformer& t)
+{
+	double length1 = std::hypot(p1.x - p0.x, p1.y - p0.y);
+	double length2 = std::hypot(p2.x - p1.x, p2.y - p1.y);
+	double ux1 = (p1.x - p0.x) / length1;
+	double uy1 = (p1.y - p0.y) / length1;
+	double ux2 = (p2.x - p1.x) / length2;
+	double uy2 = (p2.y - p1.y) / length2;
+
+	// Both segments offset to the left by the signed offset.
+	double ax = p1.x - uy1 * offset;
+	double ay = p1.y + ux1 * offset;
+	double bx = p1.x - uy2 * offset;
+	double by = p1.y + ux2 * offset;
+
+	double cross = ux1 * uy2 - uy1 * ux2;
+	double dot = ux1 * ux2 + uy1 * uy2;
+	double radius = std::fabs(offset);
+
+	if (std::fabs(cross) < kEpsilon && dot > 0) {
+		_Add(ax, ay);
+		return;
+	}
+
+	// Where the two offset edges meet, |offset| / cos(turn / 2) away from
+	// the vertex.
+	double halfCos = std::sqrt(std::max(0.0, (1 + dot) / 2));
+	double halfSin = std::sqrt(std::max(0.0, (1 - dot) / 2));
+	bool meets = halfCos > kEpsilon;
+	double mx = 0, my = 0;
+	if (meets) {
+		mx = p1.x + (ax + bx - 2 * p1.x) / (1 + dot);
+		my = p1.y + (ay + by - 2 * p1.y) / (1 + dot);
+	}
+
+	if (cross * offset > 0) {
+		// Inside of the turn the edges meet at the miter point, as long as
+		// it is not further out than the shorter segment is long; past
+		// that the corner is beveled, like the renderer does.
+		double reach = std::max(std::min(length1, length2), 1.01 * radius);
+		if (meets && radius <= reach * halfCos) {
+			_Add(mx, my);
+		} else {
+			_Add(ax, ay);
+			_Add(bx, by);
+		}
+		return;
+	}
+
+	bool withinLimit = meets && 1 / halfCos <= std::max(1.0, t.miterLimit);
+
+	switch (t.lineJoin) {
+		case hvif::BEVEL:
+			_Add(ax, ay);
+			_Add(bx, by);
+			break;
+
+		case hvif::ROUND:
+			_Add(ax, ay);
+			_Arc(p1, std::atan2(ay - p1.y, ax - p1.x),
+				(offset > 0 ? -1 : 1) * std::atan2(std::fabs(cross), dot), radius);
+			_Add(bx, by);
+			break;
+
+		case hvif::MITER_REVERT:
+			if (withinLimit) {
+				_Add(mx, my);
+			} else {
+				_Add(ax, ay);
+				_Add(bx, by);
+			}
+			break;
+
+		case hvif::MITER_ROUND:
+			if (withinLimit) {
+				_Add(mx, my);
+			} else {
+				_Add(ax, ay);
+				_Arc(p1, std::atan2(ay - p1.y, ax - p1.x),
+					(offset > 0 ? -1 : 1) * std::atan2(std::fabs(cross), dot), radius);
+				_Add(bx, by);
+			}
+			break;
+
+		case hvif::MITER:
+		default:
+			if (withinLimit) {
+				_Add(mx, my);
+			} else {
+				// Cut square across the bisector at the miter limit.
+				double limit = std::max(1.0, t.miterLimit);
+				double reach = radius * (limit - halfCos) / halfSin;
+				_Add(ax + ux1 * reach, ay + uy1 * reach);
+				_Add(bx - ux2 * reach, by - uy2 * reach);
+			}
+			break;
+	}
+}
+
+void
+PathOutliner::_Cap(const Point& from, const Point& end, double halfWidth, int lineCap)
+{
+	double length = std::hypot(end.x - from.x, end.y - from.y);
+	double ux = (end.x - from.x) / length;
+	double uy = (end.y - from.y) / length;
+
+	// The left side ends at end + normal, the right side starts at
+	// end - normal.
+	double nx = -uy * halfWidth;
+	double ny = ux * halfWidth;
+
+	if (lineCap == hvif::SQUARE) {
+		_Add(end.x + nx + ux * halfWidth, end.y + ny + uy * halfWidth);
+		_Add(end.x - nx + ux * halfWidth, end.y - ny + uy * halfWidth);
+	} else if (lineCap == hvif::ROUND_CAP) {
+		_Arc(end, std::atan2(ny, nx), -kPi, halfWidth);
+	}
+}
+
+void
+PathOutliner::_Arc(const Point& center, double startAngle, double sweep, double radius)
+{
+	// Steps short enough that no chord strays more than the tolerance
+	// from the circle; only the points between the ends are added.
+	double step = kPi / 2;
+	if (radius > fTolerance)
+		step = std::min(step, 2 * std::acos(1 - fTolerance / radius));
+
+	int steps = std::min(kMaxSteps, std::max(1, (int)std::ceil(std::fabs(sweep) / step)));
+	for (int i = 1; i < steps; i++) {
+		double angle = startAngle + sweep * i / steps;
+		_Add(center.x + std::cos(angle) * radius, center.y + std::sin(angle) * radius);
+	}
+}
+
+void
+PathOutliner::_Add(double x, double y)
+{
+	if (!fOutline.empty() && std::fabs(fOutline.back().x - x) < kEpsilon
+		&& std::fabs(fOutline.back().y - y) < kEpsilon) {
+		return;
+	}
+
+	Point p = { x, y };
+	fOutline.push_back(p);
+}
+
+void
+PathOutliner::_TakeOutline(std::vector<Path>& outlines)
+{
+	if (fOutline.size() > 1 && std::fabs(fOutline.back().x - fOutline.front().x) < kEpsilon
+		&& std::fabs(fOutline.back().y - fOutline.front().y) < kEpsilon) {
+		fOutline.pop_back();
+	}
+
+	if (fOutline.size() >= 3) {
+		Path outline;
+		outline.closed = true;
+		outline.points.resize(fOutline.size());
+		for (size_t i = 0; i < fOutline.size(); i++) {
+			PathPoint& p = outline.points[i];
+			p.x = p.x_in = p.x_out = fOutline[i].x;
+			p.y = p.y_in = p.y_out = fOutline[i].y;
+		}
+		outlines.push_back(outline);
+	}
+
+	fOutline.clear();
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef EXPORT_PATH_OUTLINER_H
+#define EXPORT_PATH_OUTLINER_H
+
+#include <vector>
+#include "HaikuIcon.h"
+
+namespace haiku {
+
+// Turns stroke and contour transformers into plain filled outlines, the
+// way the icon renderer applies them: the path is flattened to a polyline
+// within the tolerance (in path units) and offset on one or both sides,
+// with the transformer's join, cap and miter limit. Outlines are closed
+// paths of straight segments meant to be filled with the nonzero rule;
+// every stroke outline winds the same way, so overlapping strokes of one
+// shape add up instead of cancelling out.
+class PathOutliner {
+public:
+	explicit		PathOutliner(double tolerance = 0.01);
+
+	void			SetTolerance(double tolerance);
+	double			Tolerance() const { return fTolerance; }
+
+	// Appends the outline of a stroke of stroke.width around the path:
+	// two rings for a closed path, one ring with caps for an open one.
+	void			Stroke(const Path& path, const Transformer& stroke,
+						std::vector<Path>& outlines);
+
+	// Appends the path grown by half of contour.width on every side, or
+	// shrunk for a negative width. Open paths are closed first, as they
+	// are when filled. A path shrunk by more than it is wide leaves
+	// nothing, and no outline is appended.
+	void			Contour(const Path& path, const Transformer& contour,
+						std::vector<Path>& outlines);
+
+private:
+	struct Point {
+		double		x;
+		double		y;
+	};
+
+	void			_Flatten(const Path& path);
+	bool			_IsStraight(const PathPoint& from, const PathPoint& to) const;
+	void			_Offset(const std::vector<Point>& line, bool closed,
+						double offset, const Transformer& t);
+	void			_Join(const Point& p0, const Point& p1, const Point& p2,
+						double offset, const Transformer& t);
+	void			_Cap(const Point& from, const Point& end, double halfWidth,
+						int lineCap);
+	void			_Arc(const Point& center, double startAngle, double sweep,
+						double radius);
+	void			_Add(double x, double y);
+	bool			_KeepsInside(double distance) const;
+	void			_TakeOutline(std::vector<Path>& outlines);
+
+	double			fTolerance;
+
+	// Scratch buffers reused between calls.
+	std::vector<Point>	fLine;
+	std::vector<Point>	fReversed;
+	std::vector<Point>	fOutline;
+};
+
+}
+
+#endif
@@ -3,9 +3,9 @@
  * Distributed under the terms of the MIT License.
  */
 
-#include <sstream>
-#include <iomanip>
+#include <charconv>
 #include <cmath>
+#include <cstdio>
 
 #include "SVGWriter.h"
 #include "Utils.h"
@@ -14,8 +14,61 @@ namespace haiku {
 
 static const double HVIF_SCALE = 102.0;
 
+// Wide enough for any double in fixed notation.
+static const size_t kNumberBufferSize = 352;
+
+// Floating point to_chars() needs libstdc++ 11, MSVC 2019 or, on macOS,
+// libc++ and a deployment target of 13.3; other libraries go through
+// snprintf().
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define HAVE_FLOAT_TO_CHARS 1
+#endif
+
+static inline void
+AppendInteger(std::string& out, long value)
+{
+	char buffer[24];
+	std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	out.append(buffer, result.ptr);
+}
+
+// Fixed notation without the locale, trailing zeros and a bare point
+// dropped.
+static inline void
+AppendTrimmed(std::string& out, double value, int precision)
+{
+	char buffer[kNumberBufferSize];
+#ifdef HAVE_FLOAT_TO_CHARS
+	std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+		std::chars_format::fixed, precision);
+
+	char* end = result.ptr;
+#else
+	int length = snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+	if (length < 1 || length >= (int)sizeof(buffer)) {
+		buffer[0] = '0';
+		length = 1;
+	}
+
+	// The locale may have put a comma in place of the point.
+	char* end = buffer + length;
+	for (char* c = buffer; c < end; c++) {
+		if (*c == ',')
+			*c = '.';
+	}
+#endif
+
+	while (end[-1] == '0')
+		end--;
+	if (end[-1] == '.')
+		end--;
+
+	out.append(buffer, end);
+}
+
 SVGWriter::SVGWriter()
-	: fIdCounter(0), fIncludeNames(false), fCoordinateScale(HVIF_SCALE)
+	: fIdCounter(0), fIncludeNames(false), fCoordinateScale(HVIF_SCALE),
+	  fOutlineStrokes(false)
 {
 }
 
@@ -28,90 +81,83 @@ SVGWriter::Write(const Icon& icon)
 
 std::string
 SVGWriter::Write(const Icon& icon, const SVGWriterOptions& opts)
+{
+	std::string svg;
+	Write(icon, opts, svg);
+	return svg;
+}
+
+void
+SVGWriter::Write(const Icon& icon, const SVGWriterOptions& opts, std::string& output)
 {
 	fIncludeNames = opts.includeNames;
 	fCoordinateScale = opts.coordinateScale;
+	fOutlineStrokes = opts.outlineStrokes;
+	fOutliner.SetTolerance(opts.outlineTolerance);
 	fIdCounter = 0;
 
-	std::ostringstream svg;
-
-	svg << "<svg width=\"" << opts.width << "\" height=\"" << opts.height 
-		<< "\" viewBox=\"" << opts.viewBox << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+	// Roughly what a path point takes as a cubic segment, so most icons
+	// are written without growing the buffer.
+	size_t points = 0;
+	for (size_t i = 0; i < icon.paths.size(); ++i)
+		points += icon.paths[i].points.size();
+	output.reserve(output.size() + 256 + icon.shapes.size() * 160 + points * 40);
+
+	output += "<svg width=\"";
+	AppendInteger(output, opts.width);
+	output += "\" height=\"";
+	AppendInteger(output, opts.height);
+	output += "\" viewBox=\"";
+	output += opts.viewBox;
+	output += "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
 
 	for (size_t i = 0; i < icon.shapes.size(); ++i) {
 		if (icon.shapes[i].maxLOD < 3.99f)
 			continue;
-		svg << _ShapeToSVG(icon.shapes[i], icon, static_cast<int>(i));
+		_AppendShape(output, icon.shapes[i], icon, static_cast<int>(i));
 	}
 
-	svg << "</svg>";
-	return svg.str();
+	output += "</svg>";
 }
 
-std::string
-SVGWriter::_FormatCoord(double value)
+void
+SVGWriter::_AppendCoord(std::string& out, double value)
 {
 	double rounded = std::round(value * 100.0) / 100.0;
 	long intPart = static_cast<long>(rounded);
 
 	if (std::fabs(rounded - intPart) < 0.001) {
-		return utils::ToString(intPart);
+		AppendInteger(out, intPart);
+		return;
 	}
 
-	std::ostringstream oss;
-	oss << std::fixed << std::setprecision(2) << rounded;
-	std::string result = oss.str();
-
-	size_t dotPos = result.find('.');
-	if (dotPos != std::string::npos) {
-		size_t lastNonZero = result.find_last_not_of('0');
-		if (lastNonZero == dotPos) {
-			result = result.substr(0, dotPos);
-		} else if (lastNonZero != std::string::npos) {
-			result = result.substr(0, lastNonZero + 1);
-		}
-	}
-
-	return result;
+	AppendTrimmed(out, rounded, 2);
 }
 
-std::string
-SVGWriter::_FormatMatrix(double value)
+void
+SVGWriter::_AppendMatrix(std::string& out, double value)
 {
 	double rounded = std::round(value * 1000000.0) / 1000000.0;
 
 	if (std::fabs(rounded) < 1e-9) {
-		return "0";
-	}
-
-	std::ostringstream oss;
-	oss << std::fixed << std::setprecision(6) << rounded;
-	std::string result = oss.str();
-
-	size_t dotPos = result.find('.');
-	if (dotPos != std::string::npos) {
-		size_t lastNonZero = result.find_last_not_of('0');
-		if (lastNonZero == dotPos) {
-			result = result.substr(0, dotPos);
-		} else if (lastNonZero != std::string::npos) {
-			result = result.substr(0, lastNonZero + 1);
-		}
+		out += '0';
+		return;
 	}
 
-	return result;
+	AppendTrimmed(out, rounded, 6);
 }
 
-std::string
-SVGWriter::_ColorToCSS(const Color& color)
+void
+SVGWriter::_AppendColor(std::string& out, const Color& color)
 {
-	std::ostringstream css;
-	css << "#" << std::hex << std::setw(2) << std::setfill('0')
-		<< static_cast<int>(color.Red())
-		<< std::setw(2) << std::setfill('0')
-		<< static_cast<int>(color.Green())
-		<< std::setw(2) << std::setfill('0')
-		<< static_cast<int>(color.Blue());
-	return css.str();
+	static const char kHexDigits[] = "0123456789abcdef";
+	const uint8_t channels[3] = { color.Red(), color.Green(), color.Blue() };
+
+	out += '#';
+	for (int i = 0; i < 3; ++i) {
+		out += kHexDigits[channels[i] >> 4];
+		out += kHexDigits[channels[i] & 0x0f];
+	}
 }
 
 float
@@ -171,6 +217,28 @@ SVGWriter::_TransformPoint(double& x, double& y, const Shape& shape)
 	y = ty * HVIF_SCALE;
 }
 
+Path
+SVGWriter::_TransformPath(const Path& path, const Shape& shape)
+{
+	Path result = path;
+
+	for (size_t i = 0; i < result.points.size(); ++i) {
+		PathPoint& p = result.points[i];
+		double* coords[3][2] = {
+			{ &p.x, &p.y }, { &p.x_in, &p.y_in }, { &p.x_out, &p.y_out }
+		};
+		for (int j = 0; j < 3; ++j) {
+			double x = *coords[j][0] * fCoordinateScale;
+			double y = *coords[j][1] * fCoordinateScale;
+			_TransformPoint(x, y, shape);
+			*coords[j][0] = x / fCoordinateScale;
+			*coords[j][1] = y / fCoordinateScale;
+		}
+	}
+
+	return result;
+}
+
 double
 SVGWriter::_GetTransformScale(const Shape& shape)
 {
@@ -243,12 +311,11 @@ SVGWriter::_CombineGradientMatrix(const Gradient& grad, const Shape& shape)
 	return resultVec;
 }
 
-std::string
-SVGWriter::_GradientToSVG(const Gradient& grad, const std::string& id, 
+
+void
+SVGWriter::_AppendGradient(std::string& out, const Gradient& grad, const std::string& id,
 	const std::string& styleName, const Shape& shape)
 {
-	std::ostringstream svg;
-
 	bool isLinear = (grad.type == GRADIENT_LINEAR || grad.type == GRADIENT_CONIC || 
 					 grad.type == GRADIENT_XY || grad.type == GRADIENT_SQRT_XY ||
 					 grad.type == GRADIENT_DIAMOND);
@@ -256,112 +323,132 @@ SVGWriter::_GradientToSVG(const Gradient& grad, const std::string& id,
 					   grad.type == GRADIENT_SQRT_XY || grad.type == GRADIENT_DIAMOND);
 	bool isConic = (grad.type == GRADIENT_CONIC);
 
-	std::string tagName = isLinear ? "linearGradient" : "radialGradient";
+	const char* tagName = isLinear ? "linearGradient" : "radialGradient";
 
-	svg << "<" << tagName << " id=\"" << id << "\"";
+	out += '<';
+	out += tagName;
+	out += " id=\"";
+	out += id;
+	out += '"';
 
 	if (fIncludeNames && !styleName.empty()) {
-		svg << " data-name=\"" << styleName << "\"";
+		out += " data-name=\"";
+		out += styleName;
+		out += '"';
 	}
 
-	svg << " gradientUnits=\"userSpaceOnUse\"";
+	out += " gradientUnits=\"userSpaceOnUse\"";
 
 	std::vector<double> m = _CombineGradientMatrix(grad, shape);
-	
-	svg << " gradientTransform=\"matrix("
-		<< _FormatMatrix(m[0]) << ","
-		<< _FormatMatrix(m[1]) << ","
-		<< _FormatMatrix(m[2]) << ","
-		<< _FormatMatrix(m[3]) << ","
-		<< _FormatCoord(m[4] * HVIF_SCALE) << ","
-		<< _FormatCoord(m[5] * HVIF_SCALE) << ")\"";
+
+	out += " gradientTransform=\"matrix(";
+	for (int i = 0; i < 4; ++i) {
+		_AppendMatrix(out, m[i]);
+		out += ',';
+	}
+	_AppendCoord(out, m[4] * HVIF_SCALE);
+	out += ',';
+	_AppendCoord(out, m[5] * HVIF_SCALE);
+	out += ")\"";
 
 	long baseCoord = 6528;
 	long conicCoord = baseCoord * 1.52;
 
 	if (isLinear) {
-		if (isConic) {
-			svg << " x1=\"" << conicCoord << "\" x2=\"" << -conicCoord 
-				<< "\" y1=\"" << -baseCoord << "\" y2=\"" << -baseCoord << "\"";
-		} else if (isInverted) {
-			svg << " x1=\"" << baseCoord << "\" x2=\"" << -baseCoord 
-				<< "\" y1=\"" << -baseCoord << "\" y2=\"" << -baseCoord << "\"";
-		} else {
-			svg << " x1=\"" << -baseCoord << "\" x2=\"" << baseCoord 
-				<< "\" y1=\"" << -baseCoord << "\" y2=\"" << -baseCoord << "\"";
-		}
+		long x1 = -baseCoord;
+		if (isConic)
+			x1 = conicCoord;
+		else if (isInverted)
+			x1 = baseCoord;
+
+		out += " x1=\"";
+		AppendInteger(out, x1);
+		out += "\" x2=\"";
+		AppendInteger(out, -x1);
+		out += "\" y1=\"";
+		AppendInteger(out, -baseCoord);
+		out += "\" y2=\"";
+		AppendInteger(out, -baseCoord);
+		out += '"';
 	} else {
-		svg << " cx=\"0\" cy=\"0\" r=\"" << baseCoord << "\"";
+		out += " cx=\"0\" cy=\"0\" r=\"";
+		AppendInteger(out, baseCoord);
+		out += '"';
 	}
 
-	svg << ">\n";
+	out += ">\n";
 
 	for (size_t i = 0; i < grad.stops.size(); ++i) {
 		const ColorStop& stop = grad.stops[i];
-		std::string stopColor = _ColorToCSS(stop.color);
 		float alpha = _GetColorAlpha(stop.color);
 
-		svg << "<stop offset=\"" << _FormatCoord(stop.offset * 100.0)
-			<< "%\" stop-color=\"" << stopColor << "\"";
+		out += "<stop offset=\"";
+		_AppendCoord(out, stop.offset * 100.0);
+		out += "%\" stop-color=\"";
+		_AppendColor(out, stop.color);
+		out += '"';
 
 		if (alpha < 1.0f) {
-			svg << " stop-opacity=\"" << _FormatCoord(alpha) << "\"";
+			out += " stop-opacity=\"";
+			_AppendCoord(out, alpha);
+			out += '"';
 		}
 
-		svg << " />\n";
+		out += " />\n";
 	}
 
-	svg << "</" << tagName << ">\n";
-
-	return svg.str();
+	out += "</";
+	out += tagName;
+	out += ">\n";
 }
 
-std::string
-SVGWriter::_PathToSVG(const Path& path)
+void
+SVGWriter::_AppendPoint(std::string& out, double x, double y)
 {
-	std::ostringstream pathData;
+	_AppendCoord(out, x);
+	out += ' ';
+	_AppendCoord(out, y);
+}
 
+void
+SVGWriter::_AppendPath(std::string& out, const Path& path)
+{
 	if (path.points.empty())
-		return "";
+		return;
 
 	const PathPoint& first = path.points[0];
-	pathData << "M " << _FormatCoord(first.x * fCoordinateScale)
-	         << " " << _FormatCoord(first.y * fCoordinateScale);
+	out += "M ";
+	_AppendPoint(out, first.x * fCoordinateScale, first.y * fCoordinateScale);
 
 	for (size_t i = 1; i < path.points.size(); ++i) {
 		const PathPoint& prev = path.points[i - 1];
 		const PathPoint& curr = path.points[i];
 
-		pathData << " C "
-			<< _FormatCoord(prev.x_out * fCoordinateScale) << " "
-			<< _FormatCoord(prev.y_out * fCoordinateScale) << " "
-			<< _FormatCoord(curr.x_in * fCoordinateScale) << " "
-			<< _FormatCoord(curr.y_in * fCoordinateScale) << " "
-			<< _FormatCoord(curr.x * fCoordinateScale) << " "
-			<< _FormatCoord(curr.y * fCoordinateScale);
+		out += " C ";
+		_AppendPoint(out, prev.x_out * fCoordinateScale, prev.y_out * fCoordinateScale);
+		out += ' ';
+		_AppendPoint(out, curr.x_in * fCoordinateScale, curr.y_in * fCoordinateScale);
+		out += ' ';
+		_AppendPoint(out, curr.x * fCoordinateScale, curr.y * fCoordinateScale);
 	}
 
 	if (path.closed && path.points.size() > 1) {
 		const PathPoint& last = path.points[path.points.size() - 1];
-		pathData << " C "
-			<< _FormatCoord(last.x_out * fCoordinateScale) << " "
-			<< _FormatCoord(last.y_out * fCoordinateScale) << " "
-			<< _FormatCoord(first.x_in * fCoordinateScale) << " "
-			<< _FormatCoord(first.y_in * fCoordinateScale) << " "
-			<< _FormatCoord(first.x * fCoordinateScale) << " "
-			<< _FormatCoord(first.y * fCoordinateScale) << " Z";
+		out += " C ";
+		_AppendPoint(out, last.x_out * fCoordinateScale, last.y_out * fCoordinateScale);
+		out += ' ';
+		_AppendPoint(out, first.x_in * fCoordinateScale, first.y_in * fCoordinateScale);
+		out += ' ';
+		_AppendPoint(out, first.x * fCoordinateScale, first.y * fCoordinateScale);
+		out += " Z";
 	}
-
-	return pathData.str();
 }
 
-std::string
-SVGWriter::_PathToSVGTransformed(const Path& path, const Shape& shape)
+void
+SVGWriter::_AppendPathTransformed(std::string& out, const Path& path, const Shape& shape)
 {
-	std::ostringstream pathData;
-
 	if (path.points.empty())
-		return "";
+		return;
 
 	double sx = path.points[0].x * fCoordinateScale;
 	double sy = path.points[0].y * fCoordinateScale;
@@ -375,7 +462,8 @@ SVGWriter::_PathToSVGTransformed(const Path& path, const Shape& shape)
 	double siy = path.points[0].y_in * fCoordinateScale;
 	_TransformPoint(six, siy, shape);
 
-	pathData << "M " << _FormatCoord(sx) << " " << _FormatCoord(sy);
+	out += "M ";
+	_AppendPoint(out, sx, sy);
 
 	double pox = sox, poy = soy;
 
@@ -393,45 +481,61 @@ SVGWriter::_PathToSVGTransformed(const Path& path, const Shape& shape)
 		_TransformPoint(cix, ciy, shape);
 		_TransformPoint(cox, coy, shape);
 
-		pathData << " C "
-			<< _FormatCoord(pox) << " " << _FormatCoord(poy) << " "
-			<< _FormatCoord(cix) << " " << _FormatCoord(ciy) << " "
-			<< _FormatCoord(cx) << " " << _FormatCoord(cy);
+		out += " C ";
+		_AppendPoint(out, pox, poy);
+		out += ' ';
+		_AppendPoint(out, cix, ciy);
+		out += ' ';
+		_AppendPoint(out, cx, cy);
 
 		pox = cox;
 		poy = coy;
 	}
 
 	if (path.closed && path.points.size() > 1) {
-		pathData << " C "
-			<< _FormatCoord(pox) << " " << _FormatCoord(poy) << " "
-			<< _FormatCoord(six) << " " << _FormatCoord(siy) << " "
-			<< _FormatCoord(sx) << " " << _FormatCoord(sy) << " Z";
+		out += " C ";
+		_AppendPoint(out, pox, poy);
+		out += ' ';
+		_AppendPoint(out, six, siy);
+		out += ' ';
+		_AppendPoint(out, sx, sy);
+		out += " Z";
 	}
-
-	return pathData.str();
 }
 
-std::string
-SVGWriter::_ShapeToSVG(const Shape& shape, const Icon& icon, int shapeIndex)
+void
+SVGWriter::_AppendOutline(std::string& out, const Path& outline)
 {
-	std::ostringstream svg;
+	for (size_t i = 0; i < outline.points.size(); ++i) {
+		const PathPoint& p = outline.points[i];
+		out += (i == 0 ? "M " : " L ");
+		_AppendPoint(out, p.x * fCoordinateScale, p.y * fCoordinateScale);
+	}
+
+	if (!outline.points.empty())
+		out += " Z";
+}
 
+void
+SVGWriter::_AppendShape(std::string& out, const Shape& shape, const Icon& icon,
+	int shapeIndex)
+{
 	bool hasGeomTransform = _HasGeometricTransform(shape);
 
 	float opacity = 1.0f;
 	std::string fillColor;
-	std::string additionalDefs;
+	const Style* gradientStyle = NULL;
+	std::string gradientId;
 
 	if (shape.styleIndex >= 0 && shape.styleIndex < static_cast<int>(icon.styles.size())) {
 		const Style& style = icon.styles[shape.styleIndex];
 
 		if (style.isGradient) {
-			std::string gradientId = _GenerateID();
+			gradientStyle = &style;
+			gradientId = _GenerateID();
 			fillColor = "url(#" + gradientId + ")";
-			additionalDefs = _GradientToSVG(style.gradient, gradientId, style.name, shape);
 		} else {
-			fillColor = _ColorToCSS(style.solidColor);
+			_AppendColor(fillColor, style.solidColor);
 			opacity = _GetColorAlpha(style.solidColor);
 		}
 	}
@@ -458,74 +562,88 @@ SVGWriter::_ShapeToSVG(const Shape& shape, const Icon& icon, int shapeIndex)
 		strokeWidth *= _GetTransformScale(shape);
 	}
 
-	if (!additionalDefs.empty()) {
-		svg << "<g>\n";
-		svg << "<defs>\n" << additionalDefs << "</defs>\n";
+	if (gradientStyle != NULL) {
+		out += "<g>\n<defs>\n";
+		_AppendGradient(out, gradientStyle->gradient, gradientId, gradientStyle->name, shape);
+		out += "</defs>\n";
 	}
 
 	if (!shape.pathIndices.empty()) {
-		std::ostringstream pathD;
-		for (size_t i = 0; i < shape.pathIndices.size(); ++i) {
-			int pathIdx = shape.pathIndices[i];
-			if (pathIdx >= 0 && pathIdx < static_cast<int>(icon.paths.size())) {
-				if (hasGeomTransform) {
-					pathD << _PathToSVGTransformed(icon.paths[pathIdx], shape) << " ";
-				} else {
-					pathD << _PathToSVG(icon.paths[pathIdx]) << " ";
+		bool outline = isContour || (isStroke && fOutlineStrokes);
+
+		out += "<path id=\"shape_";
+		AppendInteger(out, shapeIndex);
+		out += "\" d=\"";
+
+		if (outline) {
+			// Drawn as the filled outline of the stroke or contour, on the
+			// transformed path like the SVG stroke would be.
+			Transformer outlineTrans = effectTrans;
+			if (hasGeomTransform)
+				outlineTrans.width *= _GetTransformScale(shape);
+
+			fOutlines.clear();
+			for (size_t i = 0; i < shape.pathIndices.size(); ++i) {
+				int pathIdx = shape.pathIndices[i];
+				if (pathIdx < 0 || pathIdx >= static_cast<int>(icon.paths.size()))
+					continue;
+
+				Path path = hasGeomTransform
+					? _TransformPath(icon.paths[pathIdx], shape) : icon.paths[pathIdx];
+				if (isContour)
+					fOutliner.Contour(path, outlineTrans, fOutlines);
+				else
+					fOutliner.Stroke(path, outlineTrans, fOutlines);
+			}
+
+			for (size_t i = 0; i < fOutlines.size(); ++i) {
+				_AppendOutline(out, fOutlines[i]);
+				out += ' ';
+			}
+		} else {
+			for (size_t i = 0; i < shape.pathIndices.size(); ++i) {
+				int pathIdx = shape.pathIndices[i];
+				if (pathIdx >= 0 && pathIdx < static_cast<int>(icon.paths.size())) {
+					if (hasGeomTransform)
+						_AppendPathTransformed(out, icon.paths[pathIdx], shape);
+					else
+						_AppendPath(out, icon.paths[pathIdx]);
+					out += ' ';
 				}
 			}
 		}
-		std::string d = pathD.str();
-
-		std::ostringstream styleStr;
-		styleStr << "stroke-width:" << _FormatCoord(strokeWidth) << ";";
-		styleStr << "stroke-linejoin:" << utils::GetLineJoinName(effectTrans.lineJoin) << ";";
-		styleStr << "stroke-linecap:" << utils::GetLineCapName(effectTrans.lineCap) << ";";
-
-		if (isContour) {
-			if (effectTrans.width < 0) {
-				styleStr << "stroke:black;fill:white;";
-			} else {
-				styleStr << "stroke:white;fill:white;";
-			}
 
-			std::string maskId = _GenerateID();
-			svg << "<mask id=\"" << maskId << "\" maskUnits=\"userSpaceOnUse\" x=\"0\" y=\"0\" width=\"6528\" height=\"6528\">\n";
-			svg << "<path d=\"" << d << "\" style=\"" << styleStr.str() << "\" />\n";
-			svg << "</mask>\n";
-			svg << "<rect x=\"0\" y=\"0\" width=\"6528\" height=\"6528\" fill=\"" << fillColor << "\" mask=\"url(#" << maskId << ")\"";
-			if (opacity < 1.0f) {
-				svg << " fill-opacity=\"" << _FormatCoord(opacity) << "\"";
-			}
-			svg << " />\n";
-		} else if (isStroke) {
-			styleStr << "stroke:" << fillColor << ";fill:none;";
+		out += "\" style=\"";
+		if (isStroke && !outline) {
+			out += "stroke-width:";
+			_AppendCoord(out, strokeWidth);
+			out += ";stroke-linejoin:";
+			out += utils::GetLineJoinName(effectTrans.lineJoin);
+			out += ";stroke-linecap:";
+			out += utils::GetLineCapName(effectTrans.lineCap);
+			out += ";stroke:";
+			out += fillColor;
+			out += ";fill:none;";
 			if (opacity < 1.0f) {
-				styleStr << "stroke-opacity:" << _FormatCoord(opacity) << ";";
+				out += "stroke-opacity:";
+				_AppendCoord(out, opacity);
+				out += ';';
 			}
-			
-			svg << "<path";
-			svg << " id=\"shape_" << shapeIndex << "\"";
-			svg << " d=\"" << d << "\"";
-			svg << " style=\"" << styleStr.str() << "\"";
-			svg << " />\n";
 		} else {
-			svg << "<path";
-			svg << " id=\"shape_" << shapeIndex << "\"";
-			svg << " d=\"" << d << "\"";
-			svg << " style=\"fill:" << fillColor << ";stroke:none;";
+			out += "fill:";
+			out += fillColor;
+			out += ";stroke:none;";
 			if (opacity < 1.0f) {
-				svg << "fill-opacity:" << _FormatCoord(opacity) << ";";
+				out += "fill-opacity:";
+				_AppendCoord(out, opacity);
+				out += ';';
 			}
-			svg << "\"";
-			svg << " />\n";
 		}
+		out += "\" />\n";
 	}
 
-	if (!additionalDefs.empty())
-		svg << "</g>\n";
-	
-	return svg.str();
+	if (gradientStyle != NULL)
+		out += "</g>\n";
 }
 
 std::string
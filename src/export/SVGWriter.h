@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include "HaikuIcon.h"
+#include "PathOutliner.h"
 
 namespace haiku {
 
@@ -19,12 +20,20 @@ struct SVGWriterOptions {
 	std::string		viewBox;
 	float			coordinateScale;
 
+	// Contour transformers are always drawn as filled outlines; with this
+	// set strokes are too, instead of as SVG strokes. The tolerance is how
+	// far flattened curves may stray, in icon units.
+	bool			outlineStrokes;
+	double			outlineTolerance;
+
 	SVGWriterOptions()
 		: width(64)
 		, height(64)
 		, includeNames(false)
 		, viewBox("0 0 6528 6528")
 		, coordinateScale(102.0f)
+		, outlineStrokes(false)
+		, outlineTolerance(0.01)
 	{}
 };
 
@@ -36,25 +45,39 @@ public:
 	std::string		Write(const Icon& icon, const SVGWriterOptions& opts);
 	std::string		Write(const Icon& icon);
 
+	// Appends the document to output, so a caller writing many icons can
+	// keep reusing one buffer.
+	void			Write(const Icon& icon, const SVGWriterOptions& opts,
+						std::string& output);
+
 private:
 	int				fIdCounter;
 	bool			fIncludeNames;
 	float			fCoordinateScale;
+	bool			fOutlineStrokes;
+	PathOutliner	fOutliner;
+	std::vector<Path>	fOutlines;
 
-	std::string		_FormatCoord(double value);
-	std::string		_FormatMatrix(double value);
-	std::string		_ColorToCSS(const Color& color);
+	void			_AppendCoord(std::string& out, double value);
+	void			_AppendMatrix(std::string& out, double value);
+	void			_AppendPoint(std::string& out, double x, double y);
+	void			_AppendColor(std::string& out, const Color& color);
 	float			_GetColorAlpha(const Color& color);
 
-	std::string		_GradientToSVG(const Gradient& grad, const std::string& id,
-						const std::string& styleName, const Shape& shape);
-	std::string		_PathToSVG(const Path& path);
-	std::string		_PathToSVGTransformed(const Path& path, const Shape& shape);
-	std::string		_ShapeToSVG(const Shape& shape, const Icon& icon, int shapeIndex);
+	void			_AppendGradient(std::string& out, const Gradient& grad,
+						const std::string& id, const std::string& styleName,
+						const Shape& shape);
+	void			_AppendPath(std::string& out, const Path& path);
+	void			_AppendPathTransformed(std::string& out, const Path& path,
+						const Shape& shape);
+	void			_AppendOutline(std::string& out, const Path& outline);
+	void			_AppendShape(std::string& out, const Shape& shape,
+						const Icon& icon, int shapeIndex);
 	std::string		_GenerateID();
 
 	bool			_HasGeometricTransform(const Shape& shape);
 	void			_TransformPoint(double& x, double& y, const Shape& shape);
+	Path			_TransformPath(const Path& path, const Shape& shape);
 	double			_GetTransformScale(const Shape& shape);
 	std::vector<double>	_CombineGradientMatrix(const Gradient& grad, const Shape& shape);
 };
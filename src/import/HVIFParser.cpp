@@ -18,6 +18,284 @@ struct GradientStopComparator {
 	}
 };
 
+// Reads the same layout as the HVIFParser methods below, keeping only what
+// HVIFSummary wants.
+class HVIFScanner {
+public:
+	HVIFScanner(const uint8_t* data, size_t size, HVIFSummary& summary)
+		: fData(data), fSize(size), fPos(0), fSummary(summary), fHasBounds(false)
+	{
+	}
+
+	bool Scan()
+	{
+		if (fSize < 4 || fData[0] != 0x6E || fData[1] != 0x63
+			|| fData[2] != 0x69 || fData[3] != 0x66) {
+			return _Fail("Not a valid HVIF file");
+		}
+		fPos = 4;
+
+		uint8_t count;
+		if (!_ReadByte(count))
+			return false;
+		fSummary.styleCount = count;
+		for (int i = 0; i < count; i++) {
+			if (!_ScanStyle())
+				return false;
+		}
+
+		if (!_ReadByte(count))
+			return false;
+		fSummary.pathCount = count;
+		for (int i = 0; i < count; i++) {
+			if (!_ScanPath())
+				return false;
+		}
+
+		if (!_ReadByte(count))
+			return false;
+		fSummary.shapeCount = count;
+		for (int i = 0; i < count; i++) {
+			if (!_ScanShape())
+				return false;
+		}
+
+		if (fPos != fSize)
+			return _Fail("Additional padding after hvif file");
+
+		return true;
+	}
+
+private:
+	bool _ScanStyle()
+	{
+		uint8_t tag;
+		if (!_ReadByte(tag))
+			return false;
+		if (tag != GRADIENT)
+			return _SkipColor(tag);
+
+		fSummary.gradientCount++;
+		uint8_t type, flags, stopCount;
+		if (!_ReadByte(type) || !_ReadByte(flags) || !_ReadByte(stopCount))
+			return false;
+
+		uint8_t colorFormat;
+		if (flags & GREYS)
+			colorFormat = (flags & NO_ALPHA) ? K : KA;
+		else
+			colorFormat = (flags & NO_ALPHA) ? RGB : RGBA;
+
+		if ((flags & TRANSFORM) && !_Skip(6 * 3))
+			return false;
+
+		for (int i = 0; i < stopCount; i++) {
+			if (!_Skip(1) || !_SkipColor(colorFormat))
+				return false;
+		}
+		return true;
+	}
+
+	bool _SkipColor(uint8_t tag)
+	{
+		switch (tag) {
+			case RGBA:
+				return _Skip(4);
+			case RGB:
+				return _Skip(3);
+			case KA:
+				return _Skip(2);
+			case K:
+				return _Skip(1);
+			default:
+				return _Fail("Unknown color format");
+		}
+	}
+
+	bool _ScanPath()
+	{
+		uint8_t flags, pointCount;
+		if (!_ReadByte(flags) || !_ReadByte(pointCount))
+			return false;
+
+		fSummary.pointCount += pointCount;
+		if (flags & POINTS)
+			return _ScanPoints(pointCount);
+		if (flags & COMMANDS)
+			return _ScanCommands(pointCount);
+		return _ScanPoints(pointCount * 3);
+	}
+
+	bool _ScanPoints(int count)
+	{
+		for (int i = 0; i < count; i++) {
+			float x, y;
+			if (!_ReadCoord(x) || !_ReadCoord(y))
+				return false;
+			_Include(x, y);
+		}
+		return true;
+	}
+
+	bool _ScanCommands(uint8_t pointCount)
+	{
+		size_t commandStart = fPos;
+		if (!_Skip((pointCount + 3) / 4))
+			return false;
+
+		float lastX = 0;
+		float lastY = 0;
+		for (int i = 0; i < pointCount; i++) {
+			uint8_t command = (fData[commandStart + i / 4] >> (2 * (i % 4))) & 0x03;
+			switch (command) {
+				case VLINE:
+					if (!_ReadCoord(lastX))
+						return false;
+					_Include(lastX, lastY);
+					break;
+
+				case HLINE:
+					if (!_ReadCoord(lastY))
+						return false;
+					_Include(lastX, lastY);
+					break;
+
+				case LINE:
+					if (!_ReadCoord(lastX) || !_ReadCoord(lastY))
+						return false;
+					_Include(lastX, lastY);
+					break;
+
+				case CURVE:
+					if (!_ReadCoord(lastX) || !_ReadCoord(lastY))
+						return false;
+					_Include(lastX, lastY);
+					if (!_ScanPoints(2))
+						return false;
+					break;
+			}
+		}
+		return true;
+	}
+
+	bool _ScanShape()
+	{
+		uint8_t tag, styleIndex, pathCount, flags;
+		if (!_ReadByte(tag))
+			return false;
+		if (tag != 0x0A)
+			return _Fail("Unknown shape tag");
+		if (!_ReadByte(styleIndex) || !_ReadByte(pathCount) || !_Skip(pathCount)
+			|| !_ReadByte(flags)) {
+			return false;
+		}
+
+		if (flags & MATRIX) {
+			if (!_Skip(6 * 3))
+				return false;
+			fSummary.hasShapeTransforms = true;
+		} else if (flags & TRANSLATE) {
+			float x, y;
+			if (!_ReadCoord(x) || !_ReadCoord(y))
+				return false;
+			fSummary.hasShapeTransforms = true;
+		}
+
+		if ((flags & LOD_SCALE) && !_Skip(2))
+			return false;
+
+		if (flags & TRANSFORMERS) {
+			uint8_t count;
+			if (!_ReadByte(count))
+				return false;
+			fSummary.transformerCount += count;
+			for (int i = 0; i < count; i++) {
+				uint8_t transformer;
+				if (!_ReadByte(transformer))
+					return false;
+				switch (transformer) {
+					case AFFINE:
+						if (!_Skip(6 * 3))
+							return false;
+						break;
+					case PERSPECTIVE:
+						if (!_Skip(9 * 3))
+							return false;
+						break;
+					case CONTOUR:
+					case STROKE:
+						if (!_Skip(3))
+							return false;
+						break;
+					default:
+						return _Fail("Unknown transformer tag");
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// Same values as HVIFParser::_ReadCoords().
+	bool _ReadCoord(float& value)
+	{
+		uint8_t v;
+		if (!_ReadByte(v))
+			return false;
+
+		if (v >= 128) {
+			uint8_t v2;
+			if (!_ReadByte(v2))
+				return false;
+			value = (((v & 127) << 8) + v2) - 128 * 102;
+		} else
+			value = v * 102 - 32 * 102;
+		return true;
+	}
+
+	void _Include(float x, float y)
+	{
+		if (!fHasBounds) {
+			fSummary.minX = fSummary.maxX = x;
+			fSummary.minY = fSummary.maxY = y;
+			fHasBounds = true;
+			return;
+		}
+		fSummary.minX = std::min(fSummary.minX, x);
+		fSummary.minY = std::min(fSummary.minY, y);
+		fSummary.maxX = std::max(fSummary.maxX, x);
+		fSummary.maxY = std::max(fSummary.maxY, y);
+	}
+
+	bool _ReadByte(uint8_t& value)
+	{
+		if (fPos >= fSize)
+			return _Fail("Unexpected end of file");
+		value = fData[fPos++];
+		return true;
+	}
+
+	bool _Skip(size_t count)
+	{
+		if (count > fSize - fPos)
+			return _Fail("Unexpected end of file");
+		fPos += count;
+		return true;
+	}
+
+	bool _Fail(const char* error)
+	{
+		fSummary.error = error;
+		return false;
+	}
+
+	const uint8_t*	fData;
+	size_t			fSize;
+	size_t			fPos;
+	HVIFSummary&	fSummary;
+	bool			fHasBounds;
+};
+
 HVIFParser::HVIFParser()
 	: fIcon(NULL), fData(NULL), fSize(0), fPos(0)
 {
@@ -51,8 +329,14 @@ HVIFParser::ParseFile(const std::string& filename)
 bool
 HVIFParser::ParseData(const std::vector<uint8_t>& data, const std::string& filename)
 {
-	fData = &data[0];
-	fSize = data.size();
+	return ParseData(data.empty() ? NULL : &data[0], data.size(), filename);
+}
+
+bool
+HVIFParser::ParseData(const uint8_t* data, size_t size, const std::string& filename)
+{
+	fData = data;
+	fSize = size;
 	fPos = 0;
 	fLastError.clear();
 
@@ -110,6 +394,18 @@ HVIFParser::ParseData(const std::vector<uint8_t>& data, const std::string& filen
 	return true;
 }
 
+bool
+HVIFParser::Scan(const uint8_t* data, size_t size, HVIFSummary& summary)
+{
+	summary = HVIFSummary();
+	if (data == NULL)
+		size = 0;
+
+	HVIFScanner scanner(data, size, summary);
+	summary.valid = scanner.Scan();
+	return summary.valid;
+}
+
 bool
 HVIFParser::IsValidHVIFFile(const std::string& filename)
 {
@@ -17,6 +17,14 @@ public:
 
 	bool					ParseFile(const std::string& filename);
 	bool					ParseData(const std::vector<uint8_t>& data, const std::string& filename = "");
+	// Reads the icon straight from data, which only has to stay valid for
+	// the call.
+	bool					ParseData(const uint8_t* data, size_t size,
+								const std::string& filename = "");
+
+	// Walks the icon with the same checks as ParseData() but allocates
+	// nothing and only counts what it finds; enough to index many icons.
+	static bool				Scan(const uint8_t* data, size_t size, HVIFSummary& summary);
 
 	static bool				IsValidHVIFFile(const std::string& filename);
 	static bool				IsValidHVIFData(const std::vector<uint8_t>& data);
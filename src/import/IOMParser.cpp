@@ -6,6 +6,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 #include "IOMParser.h"
 #include "Utils.h"
@@ -40,19 +41,43 @@ IOMParser::ParseFile(const std::string& filename)
 		return false;
 	}
 
-	char* buffer = new char[size];
-	file.read(buffer, size);
+	std::vector<char> buffer(size);
+	file.read(&buffer[0], size);
 	file.close();
 
+	if (!ParseBuffer(&buffer[0], size))
+		return false;
+
+	fIcon->filename = filename;
+	return true;
+}
+
+bool
+IOMParser::ParseBuffer(const void* data, size_t size)
+{
+	fLastError.clear();
+
+	const char* buffer = (const char*)data;
+	if (buffer == NULL || size < 4) {
+		_SetError("File too small");
+		return false;
+	}
+
 	if (buffer[0] != 'I' || buffer[1] != 'M' || buffer[2] != 'S' || buffer[3] != 'G') {
-		delete[] buffer;
 		_SetError("Not a valid IOM file (missing IMSG signature)");
 		return false;
 	}
 
+	// Haiku-format messages are read in place. Older layouts are converted
+	// by BMessage first and then viewed the same way.
+	haiku_compat::BMessageView view;
 	haiku_compat::BMessage message;
-	haiku_compat::status_t result = message.Unflatten(buffer + 4, size - 4);
-	delete[] buffer;
+	haiku_compat::status_t result = view.SetTo(buffer + 4, size - 4);
+	if (result == haiku_compat::B_BAD_DATA) {
+		result = message.Unflatten(buffer + 4, size - 4);
+		if (result == haiku_compat::B_OK)
+			result = view.SetTo(message);
+	}
 
 	if (result != haiku_compat::B_OK) {
 		_SetError("Failed to unflatten BMessage");
@@ -61,9 +86,9 @@ IOMParser::ParseFile(const std::string& filename)
 
 	delete fIcon;
 	fIcon = new Icon();
-	fIcon->filename = filename;
+	fIcon->filename = "<from memory>";
 
-	return _ParseMessage(message);
+	return _ParseMessage(view);
 }
 
 bool
@@ -75,20 +100,26 @@ IOMParser::ParseMessage(const haiku_compat::BMessage& message)
 
 	fLastError.clear();
 
-	return _ParseMessage(message);
+	haiku_compat::BMessageView view;
+	if (view.SetTo(message) != haiku_compat::B_OK) {
+		_SetError("Invalid BMessage");
+		return false;
+	}
+
+	return _ParseMessage(view);
 }
 
 bool
-IOMParser::_ParseMessage(const haiku_compat::BMessage& message)
+IOMParser::_ParseMessage(const haiku_compat::BMessageView& message)
 {
-	haiku_compat::BMessage stylesContainer, pathsContainer, shapesContainer;
+	haiku_compat::BMessageView stylesContainer, pathsContainer, shapesContainer;
 	
 	if (message.FindMessage("styles", &stylesContainer) == haiku_compat::B_OK) {
 		int32_t styleCount = 0;
 		stylesContainer.GetInfo("style", NULL, &styleCount);
 
+		haiku_compat::BMessageView styleMsg;
 		for (int32_t i = 0; i < styleCount; i++) {
-			haiku_compat::BMessage styleMsg;
 			if (stylesContainer.FindMessage("style", i, &styleMsg) == haiku_compat::B_OK) {
 				Style style;
 				if (_ParseStyle(styleMsg, style))
@@ -101,8 +132,8 @@ IOMParser::_ParseMessage(const haiku_compat::BMessage& message)
 		int32_t pathCount = 0;
 		pathsContainer.GetInfo("path", NULL, &pathCount);
 
+		haiku_compat::BMessageView pathMsg;
 		for (int32_t i = 0; i < pathCount; i++) {
-			haiku_compat::BMessage pathMsg;
 			if (pathsContainer.FindMessage("path", i, &pathMsg) == haiku_compat::B_OK) {
 				Path path;
 				if (_ParsePath(pathMsg, path))
@@ -115,8 +146,8 @@ IOMParser::_ParseMessage(const haiku_compat::BMessage& message)
 		int32_t shapeCount = 0;
 		shapesContainer.GetInfo("shape", NULL, &shapeCount);
 
+		haiku_compat::BMessageView shapeMsg;
 		for (int32_t i = 0; i < shapeCount; i++) {
-			haiku_compat::BMessage shapeMsg;
 			if (shapesContainer.FindMessage("shape", i, &shapeMsg) == haiku_compat::B_OK) {
 				Shape shape;
 				if (_ParseShape(shapeMsg, shape))
@@ -129,7 +160,7 @@ IOMParser::_ParseMessage(const haiku_compat::BMessage& message)
 }
 
 bool
-IOMParser::_ParseStyle(const haiku_compat::BMessage& styleMsg, Style& style)
+IOMParser::_ParseStyle(const haiku_compat::BMessageView& styleMsg, Style& style)
 {
 	const char* name = styleMsg.GetString("name", NULL);
 	if (name)
@@ -141,7 +172,7 @@ IOMParser::_ParseStyle(const haiku_compat::BMessage& styleMsg, Style& style)
 		style.color = (uint32_t)color;
 	}
 
-	haiku_compat::BMessage gradMsg;
+	haiku_compat::BMessageView gradMsg;
 	if (styleMsg.FindMessage("gradient", &gradMsg) == haiku_compat::B_OK) {
 		style.isGradient = true;
 		if (!_ParseGradient(gradMsg, style.gradient))
@@ -152,7 +183,7 @@ IOMParser::_ParseStyle(const haiku_compat::BMessage& styleMsg, Style& style)
 }
 
 bool
-IOMParser::_ParseGradient(const haiku_compat::BMessage& gradMsg, Gradient& gradient)
+IOMParser::_ParseGradient(const haiku_compat::BMessageView& gradMsg, Gradient& gradient)
 {
 	int32_t type, interp;
 	bool inherit;
@@ -197,7 +228,7 @@ IOMParser::_ParseGradient(const haiku_compat::BMessage& gradMsg, Gradient& gradi
 }
 
 bool
-IOMParser::_ParsePath(const haiku_compat::BMessage& pathMsg, Path& path)
+IOMParser::_ParsePath(const haiku_compat::BMessageView& pathMsg, Path& path)
 {
 	const char* name = pathMsg.GetString("name", NULL);
 	if (name)
@@ -209,6 +240,7 @@ IOMParser::_ParsePath(const haiku_compat::BMessage& pathMsg, Path& path)
 
 	int32_t pointCount = 0;
 	pathMsg.GetInfo("point", NULL, &pointCount);
+	path.points.reserve(pointCount);
 
 	for (int32_t i = 0; i < pointCount; i++) {
 		haiku_compat::BPoint point, pointIn, pointOut;
@@ -235,9 +267,9 @@ IOMParser::_ParsePath(const haiku_compat::BMessage& pathMsg, Path& path)
 }
 
 bool
-IOMParser::_ParseShape(const haiku_compat::BMessage& shapeMsg, Shape& shape)
+IOMParser::_ParseShape(const haiku_compat::BMessageView& shapeMsg, Shape& shape)
 {
-	shape.what = shapeMsg.what;
+	shape.what = shapeMsg.What();
 
 	const char* name = shapeMsg.GetString("name", NULL);
 	if (name)
@@ -281,8 +313,8 @@ IOMParser::_ParseShape(const haiku_compat::BMessage& shapeMsg, Shape& shape)
 
 	int32_t transCount = 0;
 	shapeMsg.GetInfo("transformer", NULL, &transCount);
+	haiku_compat::BMessageView transMsg;
 	for (int32_t i = 0; i < transCount; i++) {
-		haiku_compat::BMessage transMsg;
 		if (shapeMsg.FindMessage("transformer", i, &transMsg) == haiku_compat::B_OK) {
 			Transformer trans;
 			if (_ParseTransformer(transMsg, trans))
@@ -294,7 +326,7 @@ IOMParser::_ParseShape(const haiku_compat::BMessage& shapeMsg, Shape& shape)
 }
 
 bool
-IOMParser::_ParseTransformer(const haiku_compat::BMessage& transMsg, Transformer& transformer)
+IOMParser::_ParseTransformer(const haiku_compat::BMessageView& transMsg, Transformer& transformer)
 {
 	std::string name = transMsg.GetString("name", "");
 
@@ -8,6 +8,7 @@
 
 #include "IOMStructures.h"
 #include "BMessage.h"
+#include "BMessageView.h"
 
 namespace iom {
 
@@ -18,18 +19,19 @@ public:
 
 	bool				ParseFile(const std::string& filename);
 	bool				ParseMessage(const haiku_compat::BMessage& message);
+	bool				ParseBuffer(const void* data, size_t size);
 	
 	const Icon&			GetIcon() const { return *fIcon; }
 	Icon* 				TakeIcon() { Icon* icon = fIcon; fIcon = NULL; return icon; }
 	const std::string&	GetLastError() const { return fLastError; }
 
 private:
-	bool				_ParseMessage(const haiku_compat::BMessage& message);
-	bool				_ParseStyle(const haiku_compat::BMessage& styleMsg, Style& style);
-	bool				_ParseGradient(const haiku_compat::BMessage& gradMsg, Gradient& gradient);
-	bool				_ParsePath(const haiku_compat::BMessage& pathMsg, Path& path);
-	bool				_ParseShape(const haiku_compat::BMessage& shapeMsg, Shape& shape);
-	bool				_ParseTransformer(const haiku_compat::BMessage& transMsg, Transformer& transformer);
+	bool				_ParseMessage(const haiku_compat::BMessageView& message);
+	bool				_ParseStyle(const haiku_compat::BMessageView& styleMsg, Style& style);
+	bool				_ParseGradient(const haiku_compat::BMessageView& gradMsg, Gradient& gradient);
+	bool				_ParsePath(const haiku_compat::BMessageView& pathMsg, Path& path);
+	bool				_ParseShape(const haiku_compat::BMessageView& shapeMsg, Shape& shape);
+	bool				_ParseTransformer(const haiku_compat::BMessageView& transMsg, Transformer& transformer);
 
 	void				_SetError(const std::string& error);
 
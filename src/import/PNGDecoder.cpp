@@ -0,0 +1,850 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "PNGDecoder.h"
+
+namespace haiku {
+
+static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+static const size_t kReadSize = 64 * 1024;
+static const size_t kWindowSize = 32768;
+static const int kFastBits = 10;
+static const int kRowsPerCallback = 64;
+
+// Past the end of the data the bit reader feeds zero bytes, so a decode
+// can peek ahead; this many of them mean the stream is truncated.
+static const int kMaxPaddingBytes = 8;
+
+static const uint16_t kLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t kLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t kDistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t kDistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t kCodeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static inline uint32_t
+GetBigEndian(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Bytes of a file read in blocks, or of a buffer in memory.
+class ByteSource {
+public:
+	ByteSource(std::istream* stream, const uint8_t* data, size_t size)
+		: fStream(stream)
+		, fData(data)
+		, fSize(size)
+		, fPosition(0)
+	{
+	}
+
+	// The next byte, or -1 at the end.
+	inline int Byte()
+	{
+		if (fPosition == fSize && !_Fill())
+			return -1;
+		return fData[fPosition++];
+	}
+
+	bool Read(uint8_t* out, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			int value = Byte();
+			if (value < 0)
+				return false;
+			out[i] = (uint8_t)value;
+		}
+		return true;
+	}
+
+	bool Skip(size_t count)
+	{
+		while (count > 0) {
+			if (fPosition == fSize && !_Fill())
+				return false;
+			size_t step = std::min(count, fSize - fPosition);
+			fPosition += step;
+			count -= step;
+		}
+		return true;
+	}
+
+private:
+	bool _Fill()
+	{
+		if (fStream == NULL)
+			return false;
+
+		fBuffer.resize(kReadSize);
+		fStream->read(reinterpret_cast<char*>(&fBuffer[0]), fBuffer.size());
+		size_t count = (size_t)fStream->gcount();
+		if (count == 0)
+			return false;
+
+		fData = &fBuffer[0];
+		fSize = count;
+		fPosition = 0;
+		return true;
+	}
+
+	std::istream*			fStream;
+	const uint8_t*			fData;
+	size_t					fSize;
+	size_t					fPosition;
+	std::vector<uint8_t>	fBuffer;
+};
+
+// Canonical Huffman code: codes up to kFastBits long are looked up in one
+// step, longer ones are walked bit by bit.
+struct HuffmanTable {
+	uint16_t	fast[1 << kFastBits];
+	uint16_t	counts[16];
+	uint16_t	symbols[288];
+
+	bool Build(const uint8_t* lengths, int count)
+	{
+		memset(counts, 0, sizeof(counts));
+		memset(fast, 0, sizeof(fast));
+		for (int i = 0; i < count; i++)
+			counts[lengths[i]]++;
+		counts[0] = 0;
+
+		// Over-subscribed codes are invalid; incomplete ones are allowed,
+		// deflate uses them for a single distance code.
+		int left = 1;
+		for (int length = 1; length < 16; length++) {
+			left = (left << 1) - counts[length];
+			if (left < 0)
+				return false;
+		}
+
+		uint16_t offsets[16];
+		offsets[1] = 0;
+		for (int length = 1; length < 15; length++)
+			offsets[length + 1] = offsets[length] + counts[length];
+		for (int i = 0; i < count; i++) {
+			if (lengths[i] != 0)
+				symbols[offsets[lengths[i]]++] = (uint16_t)i;
+		}
+
+		int code = 0;
+		int index = 0;
+		for (int length = 1; length <= kFastBits; length++) {
+			for (int k = 0; k < counts[length]; k++, code++, index++) {
+				int reversed = 0;
+				for (int b = 0; b < length; b++)
+					reversed |= ((code >> b) & 1) << (length - 1 - b);
+
+				uint16_t entry = (uint16_t)((length << 9) | symbols[index]);
+				for (int r = reversed; r < (1 << kFastBits); r += 1 << length)
+					fast[r] = entry;
+			}
+			code <<= 1;
+		}
+
+		return true;
+	}
+};
+
+// Inflates the zlib stream spread over a PNG's IDAT chunks, handing out as
+// many bytes as asked for at a time.
+class IDATInflater {
+public:
+	explicit IDATInflater(ByteSource& source, size_t firstChunk)
+		: fSource(source)
+		, fChunkLeft(firstChunk)
+		, fChunksEnded(false)
+		, fBits(0)
+		, fBitCount(0)
+		, fPadding(0)
+		, fFailed(false)
+		, fStarted(false)
+		, fInBlock(false)
+		, fLastBlock(false)
+		, fStoredLeft(0)
+		, fMatchLeft(0)
+		, fMatchDistance(0)
+		, fWindow(kWindowSize)
+		, fWindowPosition(0)
+		, fTotalOut(0)
+	{
+	}
+
+	bool Failed() const { return fFailed; }
+
+	// Fills out with count bytes; returns fewer if the stream ends or is
+	// damaged.
+	size_t Read(uint8_t* out, size_t count)
+	{
+		if (!fStarted && !_ReadZlibHeader())
+			return 0;
+
+		size_t produced = 0;
+		while (produced < count && !fFailed) {
+			if (fMatchLeft > 0) {
+				size_t step = std::min((size_t)fMatchLeft, count - produced);
+				for (size_t i = 0; i < step; i++) {
+					uint8_t value = fWindow[(fWindowPosition - fMatchDistance) & (kWindowSize - 1)];
+					_Put(value);
+					out[produced++] = value;
+				}
+				fMatchLeft -= (int)step;
+				continue;
+			}
+
+			if (fStoredLeft > 0) {
+				int value = _Bits(8);
+				_Put((uint8_t)value);
+				out[produced++] = (uint8_t)value;
+				fStoredLeft--;
+				continue;
+			}
+
+			if (!fInBlock) {
+				if (fLastBlock || !_StartBlock())
+					break;
+				continue;
+			}
+
+			int symbol = _Decode(fLiterals);
+			if (symbol < 0)
+				break;
+
+			if (symbol < 256) {
+				_Put((uint8_t)symbol);
+				out[produced++] = (uint8_t)symbol;
+			} else if (symbol == 256) {
+				fInBlock = false;
+			} else {
+				symbol -= 257;
+				if (symbol >= 29)
+					return _Failed(produced);
+				fMatchLeft = kLengthBase[symbol] + _Bits(kLengthExtra[symbol]);
+
+				int distanceSymbol = _Decode(fDistances);
+				if (distanceSymbol < 0 || distanceSymbol >= 30)
+					return _Failed(produced);
+				fMatchDistance = kDistanceBase[distanceSymbol] + _Bits(kDistanceExtra[distanceSymbol]);
+				if ((size_t)fMatchDistance > fTotalOut)
+					return _Failed(produced);
+			}
+		}
+
+		return produced;
+	}
+
+private:
+	size_t _Failed(size_t produced)
+	{
+		fFailed = true;
+		return produced;
+	}
+
+	// Data bytes of the IDAT chunks in order, -1 after the last of them.
+	int _NextByte()
+	{
+		while (fChunkLeft == 0) {
+			uint8_t header[12];
+			if (fChunksEnded || !fSource.Skip(4) || !fSource.Read(header, 8)) {
+				fChunksEnded = true;
+				return -1;
+			}
+			if (memcmp(header + 4, "IDAT", 4) != 0) {
+				fChunksEnded = true;
+				return -1;
+			}
+			fChunkLeft = GetBigEndian(header);
+		}
+
+		fChunkLeft--;
+		return fSource.Byte();
+	}
+
+	inline void _Need(int count)
+	{
+		while (fBitCount < count) {
+			int value = _NextByte();
+			if (value < 0) {
+				if (++fPadding > kMaxPaddingBytes) {
+					fFailed = true;
+					return;
+				}
+				value = 0;
+			}
+			fBits |= (uint64_t)value << fBitCount;
+			fBitCount += 8;
+		}
+	}
+
+	inline int _Bits(int count)
+	{
+		if (count == 0)
+			return 0;
+		_Need(count);
+		int value = (int)(fBits & ((1U << count) - 1));
+		fBits >>= count;
+		fBitCount -= count;
+		return value;
+	}
+
+	inline void _Put(uint8_t value)
+	{
+		fWindow[fWindowPosition & (kWindowSize - 1)] = value;
+		fWindowPosition++;
+		fTotalOut++;
+	}
+
+	int _Decode(const HuffmanTable& table)
+	{
+		_Need(15);
+		if (fFailed)
+			return -1;
+
+		uint16_t entry = table.fast[fBits & ((1 << kFastBits) - 1)];
+		if (entry != 0) {
+			int length = entry >> 9;
+			fBits >>= length;
+			fBitCount -= length;
+			return entry & 0x1ff;
+		}
+
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		for (int length = 1; length < 16; length++) {
+			code |= (int)((fBits >> (length - 1)) & 1);
+			int count = table.counts[length];
+			if (code - count < first) {
+				fBits >>= length;
+				fBitCount -= length;
+				return table.symbols[index + (code - first)];
+			}
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+
+		fFailed = true;
+		return -1;
+	}
+
+	bool _ReadZlibHeader()
+	{
+		fStarted = true;
+		int method = _Bits(8);
+		int flags = _Bits(8);
+		if (fFailed || (method & 0x0f) != 8 || (method >> 4) > 7
+			|| ((method << 8) | flags) % 31 != 0 || (flags & 0x20) != 0) {
+			fFailed = true;
+			return false;
+		}
+		return true;
+	}
+
+	bool _StartBlock()
+	{
+		fLastBlock = _Bits(1) != 0;
+		int type = _Bits(2);
+
+		if (type == 0) {
+			// Stored: the rest of the current byte is dropped.
+			_Bits(fBitCount & 7);
+			int length = _Bits(16);
+			int inverse = _Bits(16);
+			if ((length ^ 0xffff) != inverse) {
+				fFailed = true;
+				return false;
+			}
+			fStoredLeft = length;
+		} else if (type == 1) {
+			uint8_t lengths[288 + 30];
+			for (int i = 0; i < 288; i++)
+				lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+			for (int i = 0; i < 30; i++)
+				lengths[288 + i] = 5;
+			fLiterals.Build(lengths, 288);
+			fDistances.Build(lengths + 288, 30);
+		} else if (type == 2) {
+			if (!_ReadDynamicTables())
+				return false;
+		} else {
+			fFailed = true;
+			return false;
+		}
+
+		fInBlock = type != 0;
+		return !fFailed;
+	}
+
+	bool _ReadDynamicTables()
+	{
+		int literalCount = _Bits(5) + 257;
+		int distanceCount = _Bits(5) + 1;
+		int codeLengthCount = _Bits(4) + 4;
+		if (literalCount > 286 || distanceCount > 30) {
+			fFailed = true;
+			return false;
+		}
+
+		uint8_t codeLengthLengths[19] = { 0 };
+		for (int i = 0; i < codeLengthCount; i++)
+			codeLengthLengths[kCodeLengthOrder[i]] = (uint8_t)_Bits(3);
+
+		HuffmanTable codeLengths;
+		if (!codeLengths.Build(codeLengthLengths, 19)) {
+			fFailed = true;
+			return false;
+		}
+
+		uint8_t lengths[286 + 30];
+		int total = literalCount + distanceCount;
+		int i = 0;
+		while (i < total) {
+			int symbol = _Decode(codeLengths);
+			if (symbol < 0)
+				return false;
+
+			if (symbol < 16) {
+				lengths[i++] = (uint8_t)symbol;
+				continue;
+			}
+
+			int value = 0;
+			int repeat;
+			if (symbol == 16) {
+				if (i == 0) {
+					fFailed = true;
+					return false;
+				}
+				value = lengths[i - 1];
+				repeat = 3 + _Bits(2);
+			} else if (symbol == 17)
+				repeat = 3 + _Bits(3);
+			else
+				repeat = 11 + _Bits(7);
+
+			if (i + repeat > total) {
+				fFailed = true;
+				return false;
+			}
+			for (; repeat > 0; repeat--)
+				lengths[i++] = (uint8_t)value;
+		}
+
+		if (lengths[256] == 0 || !fLiterals.Build(lengths, literalCount)
+			|| !fDistances.Build(lengths + literalCount, distanceCount)) {
+			fFailed = true;
+			return false;
+		}
+
+		return !fFailed;
+	}
+
+	ByteSource&				fSource;
+	size_t					fChunkLeft;
+	bool					fChunksEnded;
+
+	uint64_t				fBits;
+	int						fBitCount;
+	int						fPadding;
+	bool					fFailed;
+
+	bool					fStarted;
+	bool					fInBlock;
+	bool					fLastBlock;
+	int						fStoredLeft;
+	int						fMatchLeft;
+	int						fMatchDistance;
+	HuffmanTable			fLiterals;
+	HuffmanTable			fDistances;
+
+	std::vector<uint8_t>	fWindow;
+	size_t					fWindowPosition;
+	size_t					fTotalOut;
+};
+
+static void
+Unfilter(int filter, uint8_t* row, const uint8_t* previous, size_t size, size_t bpp)
+{
+	switch (filter) {
+		case 1:
+			for (size_t i = bpp; i < size; i++)
+				row[i] += row[i - bpp];
+			break;
+		case 2:
+			for (size_t i = 0; i < size; i++)
+				row[i] += previous[i];
+			break;
+		case 3:
+			for (size_t i = 0; i < size; i++) {
+				int left = i >= bpp ? row[i - bpp] : 0;
+				row[i] += (uint8_t)((left + previous[i]) >> 1);
+			}
+			break;
+		case 4:
+			for (size_t i = 0; i < size; i++) {
+				int left = i >= bpp ? row[i - bpp] : 0;
+				int up = previous[i];
+				int upLeft = i >= bpp ? previous[i - bpp] : 0;
+				int p = left + up - upLeft;
+				int pa = abs(p - left);
+				int pb = abs(p - up);
+				int pc = abs(p - upLeft);
+				row[i] += (uint8_t)((pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft));
+			}
+			break;
+	}
+}
+
+// Layout of the image, from its IHDR, PLTE and tRNS chunks.
+struct ImageFormat {
+	int			width;
+	int			height;
+	int			depth;
+	int			colorType;
+	int			channels;
+
+	uint8_t		palette[256][4];
+	int			paletteSize;
+
+	// Samples of the color that is transparent, for gray and RGB images.
+	bool		hasKey;
+	int			key[3];
+
+	// One sample from a row, at the image's bit depth.
+	inline int Sample(const uint8_t* row, size_t index) const
+	{
+		switch (depth) {
+			case 8:
+				return row[index];
+			case 16:
+				return (row[index * 2] << 8) | row[index * 2 + 1];
+			default:
+			{
+				size_t bit = index * depth;
+				return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+			}
+		}
+	}
+
+	inline uint8_t To8Bit(int value) const
+	{
+		switch (depth) {
+			case 16:
+				return (uint8_t)(value >> 8);
+			case 8:
+				return (uint8_t)value;
+			default:
+				return (uint8_t)(value * 255 / ((1 << depth) - 1));
+		}
+	}
+
+	void ConvertRow(const uint8_t* row, uint8_t* out) const
+	{
+		if (depth == 8 && colorType == 6) {
+			memcpy(out, row, (size_t)width * 4);
+			return;
+		}
+
+		for (int x = 0; x < width; x++, out += 4) {
+			size_t index = (size_t)x * channels;
+			switch (colorType) {
+				case 0:
+				{
+					int gray = Sample(row, index);
+					out[0] = out[1] = out[2] = To8Bit(gray);
+					out[3] = hasKey && gray == key[0] ? 0 : 255;
+					break;
+				}
+				case 2:
+				{
+					int red = Sample(row, index);
+					int green = Sample(row, index + 1);
+					int blue = Sample(row, index + 2);
+					out[0] = To8Bit(red);
+					out[1] = To8Bit(green);
+					out[2] = To8Bit(blue);
+					out[3] = hasKey && red == key[0] && green == key[1] && blue == key[2]
+						? 0 : 255;
+					break;
+				}
+				case 3:
+				{
+					int entry = Sample(row, index);
+					memcpy(out, palette[entry], 4);
+					break;
+				}
+				case 4:
+					out[0] = out[1] = out[2] = To8Bit(Sample(row, index));
+					out[3] = To8Bit(Sample(row, index + 1));
+					break;
+				case 6:
+					for (int c = 0; c < 4; c++)
+						out[c] = To8Bit(Sample(row, index + c));
+					break;
+			}
+		}
+	}
+};
+
+PNGDecoder::PNGDecoder()
+	: fRowCallback(NULL)
+	, fRowCallbackData(NULL)
+	, fCancel(NULL)
+	, fRowsDecoded(0)
+	, fUnsupported(false)
+	, fCancelled(false)
+{
+}
+
+void
+PNGDecoder::SetRowCallback(PNGRowCallback callback, void* userData)
+{
+	fRowCallback = callback;
+	fRowCallbackData = userData;
+}
+
+BitmapData
+PNGDecoder::Decode(std::istream& input)
+{
+	return _Decode(&input, NULL, 0);
+}
+
+BitmapData
+PNGDecoder::Decode(const uint8_t* data, size_t size)
+{
+	return _Decode(NULL, data, data == NULL ? 0 : size);
+}
+
+bool
+PNGDecoder::_Fail(const char* error)
+{
+	fError = error;
+	return false;
+}
+
+BitmapData
+PNGDecoder::_Decode(std::istream* stream, const uint8_t* data, size_t size)
+{
+	ByteSource source(stream, data, size);
+
+	fRowsDecoded = 0;
+	fUnsupported = false;
+	fCancelled = false;
+	fError.clear();
+
+	uint8_t signature[8];
+	if (!source.Read(signature, 8) || memcmp(signature, kSignature, 8) != 0) {
+		fUnsupported = true;
+		_Fail("Not a PNG image");
+		return BitmapData();
+	}
+
+	ImageFormat format;
+	memset(&format, 0, sizeof(format));
+	for (int i = 0; i < 256; i++)
+		format.palette[i][3] = 255;
+
+	// Chunks up to the first IDAT; everything after the image data is
+	// left unread.
+	bool haveHeader = false;
+	uint32_t dataLength = 0;
+	while (true) {
+		uint8_t header[8];
+		if (!source.Read(header, 8)) {
+			_Fail("Truncated PNG: no image data");
+			return BitmapData();
+		}
+
+		uint32_t length = GetBigEndian(header);
+		const uint8_t* type = header + 4;
+		if (length > 0x7fffffff) {
+			_Fail("Damaged PNG chunk");
+			return BitmapData();
+		}
+
+		if (memcmp(type, "IDAT", 4) == 0) {
+			dataLength = length;
+			break;
+		}
+
+		if (memcmp(type, "IEND", 4) == 0) {
+			_Fail("PNG without image data");
+			return BitmapData();
+		}
+
+		if (memcmp(type, "IHDR", 4) == 0) {
+			uint8_t data[13];
+			if (length != 13 || !source.Read(data, 13)) {
+				_Fail("Damaged PNG header");
+				return BitmapData();
+			}
+
+			uint32_t width = GetBigEndian(data);
+			uint32_t height = GetBigEndian(data + 4);
+			format.depth = data[8];
+			format.colorType = data[9];
+
+			static const int kChannels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+			int depth = format.depth;
+			bool validDepth = false;
+			switch (format.colorType) {
+				case 0:
+					validDepth = depth == 1 || depth == 2 || depth == 4 || depth == 8
+						|| depth == 16;
+					break;
+				case 3:
+					validDepth = depth == 1 || depth == 2 || depth == 4 || depth == 8;
+					break;
+				case 2:
+				case 4:
+				case 6:
+					validDepth = depth == 8 || depth == 16;
+					break;
+			}
+
+			if (!validDepth || data[10] != 0 || data[11] != 0) {
+				_Fail("Unsupported PNG pixel format");
+				return BitmapData();
+			}
+			if (data[12] != 0) {
+				fUnsupported = true;
+				_Fail("Interlaced PNG images cannot be decoded row by row");
+				return BitmapData();
+			}
+			if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX
+				|| (uint64_t)width * height > INT_MAX / 4) {
+				_Fail("PNG image too large");
+				return BitmapData();
+			}
+
+			format.width = (int)width;
+			format.height = (int)height;
+			format.channels = kChannels[format.colorType];
+			haveHeader = true;
+		} else if (memcmp(type, "PLTE", 4) == 0) {
+			uint8_t data[768];
+			if (length % 3 != 0 || length > sizeof(data) || !source.Read(data, length)) {
+				_Fail("Damaged PNG palette");
+				return BitmapData();
+			}
+
+			format.paletteSize = length / 3;
+			for (int i = 0; i < format.paletteSize; i++)
+				memcpy(format.palette[i], data + i * 3, 3);
+		} else if (memcmp(type, "tRNS", 4) == 0 && haveHeader) {
+			uint8_t data[256];
+			if (length > sizeof(data) || !source.Read(data, length)) {
+				_Fail("Damaged PNG transparency");
+				return BitmapData();
+			}
+
+			if (format.colorType == 3) {
+				for (uint32_t i = 0; i < length; i++)
+					format.palette[i][3] = data[i];
+			} else if (format.colorType == 0 && length >= 2) {
+				format.hasKey = true;
+				format.key[0] = (data[0] << 8) | data[1];
+			} else if (format.colorType == 2 && length >= 6) {
+				format.hasKey = true;
+				for (int c = 0; c < 3; c++)
+					format.key[c] = (data[c * 2] << 8) | data[c * 2 + 1];
+			}
+		} else if (!source.Skip(length)) {
+			_Fail("Truncated PNG");
+			return BitmapData();
+		}
+
+		// Checksums are not verified.
+		if (!source.Skip(4)) {
+			_Fail("Truncated PNG");
+			return BitmapData();
+		}
+	}
+
+	if (!haveHeader) {
+		_Fail("PNG without header");
+		return BitmapData();
+	}
+
+	const int width = format.width;
+	const int height = format.height;
+	const size_t pixelBytes = (size_t)width * height * 4;
+	BitmapData bitmap = BitmapData::Adopt(width, height,
+		static_cast<unsigned char*>(malloc(pixelBytes)), free);
+	unsigned char* pixels = bitmap.MutableBits();
+	if (pixels == NULL) {
+		_Fail("Out of memory");
+		return BitmapData();
+	}
+
+	const size_t bitsPerPixel = (size_t)format.channels * format.depth;
+	const size_t rowBytes = ((size_t)width * bitsPerPixel + 7) / 8;
+	const size_t filterDistance = std::max((size_t)1, bitsPerPixel / 8);
+
+	// Filter byte first, then the row; the previous row starts out zero.
+	std::vector<uint8_t> current(rowBytes + 1);
+	std::vector<uint8_t> previous(rowBytes + 1, 0);
+
+	IDATInflater inflater(source, dataLength);
+	int reported = 0;
+	for (int y = 0; y < height; y++) {
+		if (inflater.Read(&current[0], rowBytes + 1) != rowBytes + 1) {
+			_Fail(inflater.Failed() ? "Damaged PNG image data" : "Truncated PNG image data");
+			return BitmapData();
+		}
+
+		if (current[0] > 4) {
+			_Fail("Damaged PNG image data");
+			return BitmapData();
+		}
+
+		Unfilter(current[0], &current[1], &previous[1], rowBytes, filterDistance);
+		format.ConvertRow(&current[1], pixels + (size_t)y * width * 4);
+		current.swap(previous);
+		fRowsDecoded = y + 1;
+
+		if (fRowsDecoded - reported < kRowsPerCallback && fRowsDecoded < height)
+			continue;
+
+		if (fCancel != NULL && fCancel->load()) {
+			fCancelled = true;
+			_Fail("Decoding cancelled");
+			return BitmapData();
+		}
+
+		if (fRowCallback != NULL && !fRowCallback(pixels, width, reported,
+				fRowsDecoded - reported, fRowCallbackData)) {
+			fCancelled = true;
+			_Fail("Decoding stopped");
+			return BitmapData();
+		}
+		reported = fRowsDecoded;
+	}
+
+	return bitmap;
+}
+
+}
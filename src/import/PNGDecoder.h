@@ -0,0 +1,67 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef IMPORT_PNG_DECODER_H
+#define IMPORT_PNG_DECODER_H
+
+#include <atomic>
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <stdint.h>
+
+#include "BitmapData.h"
+
+namespace haiku {
+
+// Called with rows as soon as they are decoded: bits points at the first
+// RGBA pixel of the whole image, rows [firstRow, firstRow + rows) are final.
+// Returning false stops decoding.
+typedef bool (*PNGRowCallback)(const unsigned char* bits, int width,
+	int firstRow, int rows, void* userData);
+
+// Decodes PNG images to 8-bit RGBA row by row, straight into the buffer
+// the returned bitmap adopts. Compressed data is read as it is needed, so
+// memory use peaks at the decoded image plus a few rows and the 32 KiB
+// inflate window. Interlaced images cannot be decoded that way and are
+// rejected like anything that is not a PNG; Unsupported() tells those
+// apart from damaged files, which the caller may want to hand to another
+// decoder.
+class PNGDecoder {
+public:
+							PNGDecoder();
+
+	void					SetRowCallback(PNGRowCallback callback, void* userData);
+
+	// Checked between blocks of rows; decoding stops once it is set.
+	void					SetCancelFlag(const std::atomic<bool>* cancel)
+								{ fCancel = cancel; }
+
+	BitmapData				Decode(std::istream& input);
+	BitmapData				Decode(const uint8_t* data, size_t size);
+
+	int						RowsDecoded() const { return fRowsDecoded; }
+	bool					Unsupported() const { return fUnsupported; }
+	bool					WasCancelled() const { return fCancelled; }
+	const std::string&		Error() const { return fError; }
+
+private:
+	BitmapData				_Decode(std::istream* stream, const uint8_t* data,
+								size_t size);
+	bool					_Fail(const char* error);
+
+	PNGRowCallback			fRowCallback;
+	void*					fRowCallbackData;
+	const std::atomic<bool>* fCancel;
+
+	int						fRowsDecoded;
+	bool					fUnsupported;
+	bool					fCancelled;
+	std::string				fError;
+};
+
+}
+
+#endif
@@ -7,7 +7,7 @@
 #include <fstream>
 
 #include "PNGParser.h"
-#include "SVGParser.h"
+#include "TraceConverter.h"
 #include "ImageTracer.h"
 
 #ifdef __HAIKU__
@@ -21,10 +21,16 @@
 #include <String.h>
 #else
 #include "stb_image.h"
+#include "PNGDecoder.h"
 #endif
 
 namespace haiku {
 
+// Icons are 64 units across, so larger inputs are traced at four pixels
+// per unit instead of at full size.
+static const float kIconSize = 64.0f;
+static const int kTracePixelsPerUnit = 4;
+
 PNGParser::PNGParser()
 {
 #ifdef __HAIKU__
@@ -49,30 +55,27 @@ PNGParser::Parse(const std::string& file, Icon& icon, const PNGParseOptions& opt
 {
 	fLastError.clear();
 
-	BitmapData bitmap = _LoadBitmapFromFile(file);
+	BitmapData bitmap = _LoadBitmapFromFile(file, opts);
 	if (!bitmap.IsValid()) {
-		fLastError = "Failed to load PNG file: " + file;
+		if (opts.cancel != NULL && opts.cancel->load())
+			fLastError = "Vectorization cancelled";
+		else
+			fLastError = "Failed to load PNG file: " + file;
 		return false;
 	}
 
 	TracingOptions tracingOpts = _CreateTracingOptions(opts);
 	
 	ImageTracer tracer;
-	std::string svgString = tracer.BitmapToSvg(bitmap, tracingOpts);
-	
-	if (svgString.empty()) {
-		fLastError = "Vectorization failed";
+	IndexedBitmap traceData = tracer.BitmapToTraceData(bitmap, tracingOpts, opts.stats);
+	if (tracer.WasCancelled()) {
+		fLastError = "Vectorization cancelled";
 		return false;
 	}
 
-	SVGParser svgParser;
-	SVGParseOptions svgOpts;
-	svgOpts.targetSize = 64.0f;
-	svgOpts.preserveNames = false;
-	svgOpts.verbose = opts.verbose;
-
-	if (!svgParser.ParseString(svgString, icon, svgOpts)) {
-		fLastError = "SVG parsing failed after vectorization";
+	TraceConverter converter;
+	if (!converter.Convert(traceData, tracingOpts, icon, kIconSize)) {
+		fLastError = "Vectorization failed";
 		return false;
 	}
 
@@ -92,30 +95,27 @@ PNGParser::ParseBuffer(const std::vector<uint8_t>& data, Icon& icon, const PNGPa
 {
 	fLastError.clear();
 
-	BitmapData bitmap = _LoadBitmapFromBuffer(data);
+	BitmapData bitmap = _LoadBitmapFromBuffer(data, opts);
 	if (!bitmap.IsValid()) {
-		fLastError = "Failed to load PNG from buffer";
+		if (opts.cancel != NULL && opts.cancel->load())
+			fLastError = "Vectorization cancelled";
+		else
+			fLastError = "Failed to load PNG from buffer";
 		return false;
 	}
 
 	TracingOptions tracingOpts = _CreateTracingOptions(opts);
 	
 	ImageTracer tracer;
-	std::string svgString = tracer.BitmapToSvg(bitmap, tracingOpts);
-	
-	if (svgString.empty()) {
-		fLastError = "Vectorization failed";
+	IndexedBitmap traceData = tracer.BitmapToTraceData(bitmap, tracingOpts, opts.stats);
+	if (tracer.WasCancelled()) {
+		fLastError = "Vectorization cancelled";
 		return false;
 	}
 
-	SVGParser svgParser;
-	SVGParseOptions svgOpts;
-	svgOpts.targetSize = 64.0f;
-	svgOpts.preserveNames = false;
-	svgOpts.verbose = opts.verbose;
-
-	if (!svgParser.ParseString(svgString, icon, svgOpts)) {
-		fLastError = "SVG parsing failed after vectorization";
+	TraceConverter converter;
+	if (!converter.Convert(traceData, tracingOpts, icon, kIconSize)) {
+		fLastError = "Vectorization failed";
 		return false;
 	}
 
@@ -140,6 +140,11 @@ PNGParser::_CreateTracingOptions(const PNGParseOptions& opts)
 			break;
 	}
 
+	tracingOpts.fMaxTraceSize = (int)kIconSize * kTracePixelsPerUnit;
+	tracingOpts.fCancelFlag = opts.cancel;
+	tracingOpts.fTimeBudgetMs = opts.timeBudgetMs;
+	tracingOpts.fCubicFitting = opts.cubic;
+
 	if (opts.removeBackground) {
 		tracingOpts.fRemoveBackground = true;
 		tracingOpts.fBackgroundMethod = AUTO;
@@ -265,7 +270,7 @@ PNGParser::_GetIconGradientPreset()
 }
 
 BitmapData
-PNGParser::_LoadBitmapFromFile(const std::string& file)
+PNGParser::_LoadBitmapFromFile(const std::string& file, const PNGParseOptions& opts)
 {
 #ifdef __HAIKU__
 	BFile bfile(file.c_str(), B_READ_ONLY);
@@ -295,6 +300,18 @@ PNGParser::_LoadBitmapFromFile(const std::string& file)
 	delete bitmap;
 	return bitmapData;
 #else
+	if (opts.streamingDecode) {
+		std::ifstream input(file.c_str(), std::ios::binary);
+		if (!input.is_open())
+			return BitmapData();
+
+		PNGDecoder decoder;
+		decoder.SetCancelFlag(opts.cancel);
+		BitmapData bitmap = decoder.Decode(input);
+		if (bitmap.IsValid() || decoder.WasCancelled())
+			return bitmap;
+	}
+
 	int width, height, channels;
 	unsigned char* data = stbi_load(file.c_str(), &width, &height, &channels, 4);
 
@@ -302,15 +319,13 @@ PNGParser::_LoadBitmapFromFile(const std::string& file)
 		return BitmapData();
 	}
 
-	std::vector<unsigned char> bitmapData(data, data + (width * height * 4));
-	stbi_image_free(data);
-
-	return BitmapData(width, height, bitmapData);
+	return BitmapData::Adopt(width, height, data, stbi_image_free);
 #endif
 }
 
 BitmapData
-PNGParser::_LoadBitmapFromBuffer(const std::vector<uint8_t>& buffer)
+PNGParser::_LoadBitmapFromBuffer(const std::vector<uint8_t>& buffer,
+	const PNGParseOptions& opts)
 {
 #ifdef __HAIKU__
 	BMemoryIO memIO((void*)&buffer[0], buffer.size());
@@ -337,6 +352,17 @@ PNGParser::_LoadBitmapFromBuffer(const std::vector<uint8_t>& buffer)
 	delete bitmap;
 	return bitmapData;
 #else
+	if (buffer.empty())
+		return BitmapData();
+
+	if (opts.streamingDecode) {
+		PNGDecoder decoder;
+		decoder.SetCancelFlag(opts.cancel);
+		BitmapData bitmap = decoder.Decode(&buffer[0], buffer.size());
+		if (bitmap.IsValid() || decoder.WasCancelled())
+			return bitmap;
+	}
+
 	int width, height, channels;
 	unsigned char* data = stbi_load_from_memory(&buffer[0], buffer.size(), 
 		&width, &height, &channels, 4);
@@ -345,10 +371,7 @@ PNGParser::_LoadBitmapFromBuffer(const std::vector<uint8_t>& buffer)
 		return BitmapData();
 	}
 
-	std::vector<unsigned char> bitmapData(data, data + (width * height * 4));
-	stbi_image_free(data);
-
-	return BitmapData(width, height, bitmapData);
+	return BitmapData::Adopt(width, height, data, stbi_image_free);
 #endif
 }
 
@@ -6,12 +6,14 @@
 #ifndef IMPORT_PNG_PARSER_H
 #define IMPORT_PNG_PARSER_H
 
+#include <atomic>
 #include <string>
 #include <vector>
 
 #include "HaikuIcon.h"
 #include "BitmapData.h"
 #include "TracingOptions.h"
+#include "TracingStats.h"
 
 #ifdef __HAIKU__
 class BBitmap;
@@ -27,12 +29,29 @@ enum PNGVectorizationPreset {
 struct PNGParseOptions {
 	PNGVectorizationPreset	preset;
 	bool					removeBackground;
+	bool					cubic;
 	bool					verbose;
+	TracingStats*			stats;
+
+	// Decode PNG input row by row straight into the traced bitmap instead
+	// of through a whole-image decoder; other formats, interlaced images
+	// and files the row decoder rejects are decoded whole. Not used on
+	// Haiku, where the translators decode.
+	bool					streamingDecode;
+
+	// Passed on to TracingOptions::fCancelFlag and fTimeBudgetMs.
+	const std::atomic<bool>* cancel;
+	int						timeBudgetMs;
 
 	PNGParseOptions() 
 		: preset(PRESET_ICON)
 		, removeBackground(false)
+		, cubic(false)
 		, verbose(false) 
+		, stats(NULL)
+		, streamingDecode(true)
+		, cancel(NULL)
+		, timeBudgetMs(0)
 	{}
 };
 
@@ -59,8 +78,10 @@ private:
 	TracingOptions 
 				_GetIconGradientPreset();
 
-	BitmapData	_LoadBitmapFromFile(const std::string& file);
-	BitmapData	_LoadBitmapFromBuffer(const std::vector<uint8_t>& data);
+	BitmapData	_LoadBitmapFromFile(const std::string& file,
+					const PNGParseOptions& opts);
+	BitmapData	_LoadBitmapFromBuffer(const std::vector<uint8_t>& data,
+					const PNGParseOptions& opts);
 
 #ifdef __HAIKU__
 	BitmapData	_ConvertBBitmapToBitmapData(BBitmap* bitmap);
@@ -47,22 +47,7 @@ SVGParser::ParseString(const std::string& svg, Icon& icon)
 bool
 SVGParser::ParseString(const std::string& svg, Icon& icon, const SVGParseOptions& opts)
 {
-	std::vector<char> buffer;
-	buffer.reserve(svg.size() + 1);
-	for (size_t i = 0; i < svg.size(); ++i)
-		buffer.push_back(svg[i]);
-	buffer.push_back('\0');
-
-	NSVGimage* image = nsvgParse(&buffer[0], "px", 96.0f);
-	if (!image) {
-		if (opts.verbose)
-			std::cerr << "Error: Could not parse SVG data" << std::endl;
-		return false;
-	}
-
-	bool result = _ProcessImage(image, icon, opts);
-	nsvgDelete(image);
-	return result;
+	return ParseBuffer(svg.data(), svg.size(), icon, opts);
 }
 
 bool
@@ -75,8 +60,39 @@ SVGParser::ParseBuffer(const char* svgData, size_t dataSize, Icon& icon)
 bool
 SVGParser::ParseBuffer(const char* svgData, size_t dataSize, Icon& icon, const SVGParseOptions& opts)
 {
-	std::string svgString(svgData, dataSize);
-	return ParseString(svgString, icon, opts);
+	// nsvgParse writes into its input, so const data needs exactly one
+	// mutable, NUL-terminated copy.
+	std::vector<char> buffer(dataSize + 1);
+	if (dataSize > 0)
+		memcpy(&buffer[0], svgData, dataSize);
+	buffer[dataSize] = '\0';
+
+	return ParseInPlace(&buffer[0], icon, opts);
+}
+
+bool
+SVGParser::ParseInPlace(char* svgData, Icon& icon)
+{
+	SVGParseOptions opts;
+	return ParseInPlace(svgData, icon, opts);
+}
+
+bool
+SVGParser::ParseInPlace(char* svgData, Icon& icon, const SVGParseOptions& opts)
+{
+	if (svgData == NULL)
+		return false;
+
+	NSVGimage* image = nsvgParse(svgData, "px", 96.0f);
+	if (!image) {
+		if (opts.verbose)
+			std::cerr << "Error: Could not parse SVG data" << std::endl;
+		return false;
+	}
+
+	bool result = _ProcessImage(image, icon, opts);
+	nsvgDelete(image);
+	return result;
 }
 
 bool
@@ -94,7 +110,7 @@ SVGParser::_ProcessImage(NSVGimage* image, Icon& icon, const SVGParseOptions& op
 	state.ty = (opts.targetSize - svg_h * state.scale) / 2.0f;
 
 	if (opts.verbose) {
-		std::cout << "SVG dimensions: " << svg_w << "x" << svg_h 
+		std::cerr << "SVG dimensions: " << svg_w << "x" << svg_h 
 			<< ", scale: " << state.scale 
 			<< ", translate: (" << state.tx << ", " << state.ty << ")" << std::endl;
 	}
@@ -142,41 +158,31 @@ SVGParser::_ProcessShape(NSVGshape* shape, NSVGimage* image, ParseState& state)
 		hasStroke = true;
 	}
 
-	if (hasStroke) {
-		std::vector<int> strokePathIndices;
-		for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
-			int pathIndex = _ProcessPath(path, state);
-			if (pathIndex >= 0)
-				strokePathIndices.push_back(pathIndex);
-		}
+	if (!hasStroke && !hasFill)
+		return;
 
-		if (!strokePathIndices.empty()) {
-			Shape strokeShape;
-			strokeShape.styleIndex = strokeStyleIndex;
-			strokeShape.hasTransform = false;
-			strokeShape.pathIndices = strokePathIndices;
-			strokeShape.transformers.push_back(strokeTransformer);
-			strokeShape.name = shapeName;
-			state.icon->shapes.push_back(strokeShape);
-		}
+	std::vector<int> pathIndices;
+	_ProcessPaths(shape->paths, state, pathIndices);
+	if (pathIndices.empty())
+		return;
+
+	if (hasStroke) {
+		Shape strokeShape;
+		strokeShape.styleIndex = strokeStyleIndex;
+		strokeShape.hasTransform = false;
+		strokeShape.pathIndices = pathIndices;
+		strokeShape.transformers.push_back(strokeTransformer);
+		strokeShape.name = shapeName;
+		state.icon->shapes.push_back(strokeShape);
 	}
 
 	if (hasFill) {
-		std::vector<int> fillPathIndices;
-		for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
-			int pathIndex = _ProcessPath(path, state);
-			if (pathIndex >= 0)
-				fillPathIndices.push_back(pathIndex);
-		}
-
-		if (!fillPathIndices.empty()) {
-			Shape fillShape;
-			fillShape.styleIndex = fillStyleIndex;
-			fillShape.hasTransform = false;
-			fillShape.pathIndices = fillPathIndices;
-			fillShape.name = shapeName;
-			state.icon->shapes.push_back(fillShape);
-		}
+		Shape fillShape;
+		fillShape.styleIndex = fillStyleIndex;
+		fillShape.hasTransform = false;
+		fillShape.pathIndices = pathIndices;
+		fillShape.name = shapeName;
+		state.icon->shapes.push_back(fillShape);
 	}
 }
 
@@ -203,11 +209,7 @@ SVGParser::_ProcessMaskedShape(NSVGshape* shape, ParseState& state)
 			continue;
 
 		std::vector<int> pathIndices;
-		for (NSVGpath* path = maskShape->paths; path != NULL; path = path->next) {
-			int pathIndex = _ProcessPath(path, state);
-			if (pathIndex >= 0)
-				pathIndices.push_back(pathIndex);
-		}
+		_ProcessPaths(maskShape->paths, state, pathIndices);
 
 		if (pathIndices.empty())
 			continue;
@@ -230,11 +232,27 @@ SVGParser::_ProcessMaskedShape(NSVGshape* shape, ParseState& state)
 	}
 }
 
+void
+SVGParser::_ProcessPaths(NSVGpath* paths, ParseState& state, std::vector<int>& pathIndices)
+{
+	for (NSVGpath* path = paths; path != NULL; path = path->next) {
+		int pathIndex = _ProcessPath(path, state);
+		if (pathIndex >= 0)
+			pathIndices.push_back(pathIndex);
+	}
+}
+
 int
 SVGParser::_ProcessPath(NSVGpath* path, ParseState& state)
 {
-	if (path->npts < 2)
+	std::map<const NSVGpath*, int>::const_iterator cached = state.pathCache.find(path);
+	if (cached != state.pathCache.end())
+		return cached->second;
+
+	if (path->npts < 2) {
+		state.pathCache[path] = -1;
 		return -1;
+	}
 
 	Path iconPath;
 	iconPath.closed = path->closed;
@@ -297,6 +315,7 @@ SVGParser::_ProcessPath(NSVGpath* path, ParseState& state)
 
 	int pathIndex = static_cast<int>(state.icon->paths.size());
 	state.icon->paths.push_back(iconPath);
+	state.pathCache[path] = pathIndex;
 	return pathIndex;
 }
 
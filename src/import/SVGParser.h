@@ -6,6 +6,7 @@
 #ifndef IMPORT_SVG_PARSER_H
 #define IMPORT_SVG_PARSER_H
 
+#include <map>
 #include <string>
 #include <vector>
 #include "HaikuIcon.h"
@@ -38,6 +39,11 @@ public:
 	bool		ParseBuffer(const char* svgData, size_t dataSize, Icon& icon, const SVGParseOptions& opts);
 	bool		ParseBuffer(const char* svgData, size_t dataSize, Icon& icon);
 
+	// Parses a NUL-terminated buffer without copying it. The parser
+	// tokenizes in place, so the buffer contents are destroyed.
+	bool		ParseInPlace(char* svgData, Icon& icon, const SVGParseOptions& opts);
+	bool		ParseInPlace(char* svgData, Icon& icon);
+
 private:
 	struct ParseState {
 		float	scale;
@@ -45,12 +51,17 @@ private:
 		Icon*	icon;
 		bool	verbose;
 
+		// Icon path index for every NSVGpath already converted, so shapes
+		// that reference the same geometry (fill + stroke) share one path.
+		std::map<const NSVGpath*, int> pathCache;
+
 		ParseState() : scale(1.0f), tx(0.0f), ty(0.0f), icon(NULL), verbose(false) {}
 	};
 
 	bool		_ProcessImage(NSVGimage* image, Icon& icon, const SVGParseOptions& opts);
 	void		_ProcessShape(NSVGshape* shape, NSVGimage* image, ParseState& state);
 	void		_ProcessMaskedShape(NSVGshape* shape, ParseState& state);
+	void		_ProcessPaths(NSVGpath* paths, ParseState& state, std::vector<int>& pathIndices);
 	int			_ProcessPath(NSVGpath* path, ParseState& state);
 	int			_AddStyle(const NSVGpaint& paint, float opacity, ParseState& state);
 	Color		_NSVGColorToHaiku(unsigned int color, float opacity);
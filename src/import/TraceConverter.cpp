@@ -0,0 +1,358 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "TraceConverter.h"
+#include "HVIFStructures.h"
+#include "Utils.h"
+
+namespace haiku {
+
+// Geometry of a group is kept as one flat array in output coordinates:
+// every subpath starts with kMoveTo x y, followed by kLineTo x y,
+// kQuadTo cx cy x y or kCubicTo c1x c1y c2x c2y x y entries.
+static const double kMoveTo = 0.0;
+static const double kLineTo = 1.0;
+static const double kQuadTo = 2.0;
+static const double kCubicTo = 3.0;
+
+// Width of the outline SvgWriter puts around opaque shapes to close the
+// seams between neighbouring layers.
+static const double kSeamStrokeWidth = 1.5;
+
+bool
+TraceConverter::Convert(const IndexedBitmap& indexed, const TracingOptions& options,
+	Icon& icon, float targetSize)
+{
+	int width = static_cast<int>(indexed.Width() * options.fScale);
+	int height = static_cast<int>(indexed.Height() * options.fScale);
+	if (width <= 0 || height <= 0)
+		return false;
+
+	ConvertState state;
+	state.options = &options;
+	state.icon = &icon;
+	state.scale = targetSize / static_cast<double>(std::max(width, height));
+	state.tx = (targetSize - width * state.scale) / 2.0;
+	state.ty = (targetSize - height * state.scale) / 2.0;
+
+	float places = floor(options.fRoundCoordinates);
+	state.roundFactor = places == -1 ? 0.0 : pow(10.0, places);
+
+	bool removeDuplicates = options.fOptimizeSvg && options.fRemoveDuplicates;
+
+	const std::vector<std::vector<Segments> >& layers = indexed.Layers();
+	const std::vector<std::vector<unsigned char> >& palette = indexed.Palette();
+	const std::vector<std::vector<IndexedBitmap::LinearGradient> >& grads
+		= indexed.LinearGradients();
+
+	const std::vector<IndexedBitmap::RenderGroup> groups = indexed.RenderGroups();
+
+	std::vector<double> geometry;
+	std::vector<int> pathIndices;
+
+	for (size_t i = 0; i < groups.size(); i++) {
+		const IndexedBitmap::RenderGroup& group = groups[i];
+		int layer = group.layerIndex;
+		int parentPath = group.parentPathIndex;
+
+		geometry.clear();
+		for (size_t p = 0; p < group.pathIndices.size(); p++) {
+			const Segments& segments = layers[layer][group.pathIndices[p]];
+			if (!_HasEnoughPoints(segments))
+				continue;
+			_AppendGeometry(segments, state, geometry);
+		}
+
+		if (geometry.empty())
+			continue;
+
+		if (removeDuplicates && !state.emitted.insert(geometry).second)
+			continue;
+
+		int styleIndex = -1;
+		bool stroke = false;
+
+		if (layer < static_cast<int>(grads.size())
+			&& parentPath < static_cast<int>(grads[layer].size())
+			&& grads[layer][parentPath].valid) {
+			const IndexedBitmap::LinearGradient& g = grads[layer][parentPath];
+			styleIndex = _AddGradientStyle(g, state);
+			stroke = g.c1[3] >= 255 && g.c2[3] >= 255;
+		}
+
+		if (styleIndex < 0) {
+			styleIndex = _AddSolidStyle(palette[layer], state);
+			stroke = palette[layer][3] == 255;
+		}
+
+		pathIndices.clear();
+		size_t offset = 0;
+		while (offset < geometry.size()) {
+			int pathIndex;
+			offset = _AddPath(geometry, offset, state, &pathIndex);
+			pathIndices.push_back(pathIndex);
+		}
+
+		if (stroke) {
+			Transformer strokeTransformer;
+			strokeTransformer.type = TRANSFORMER_STROKE;
+			strokeTransformer.width = kSeamStrokeWidth * state.scale;
+			strokeTransformer.lineCap = hvif::ROUND_CAP;
+			strokeTransformer.lineJoin = hvif::ROUND;
+
+			Shape strokeShape;
+			strokeShape.styleIndex = styleIndex;
+			strokeShape.hasTransform = false;
+			strokeShape.pathIndices = pathIndices;
+			strokeShape.transformers.push_back(strokeTransformer);
+			icon.shapes.push_back(strokeShape);
+		}
+
+		Shape fillShape;
+		fillShape.styleIndex = styleIndex;
+		fillShape.hasTransform = false;
+		fillShape.pathIndices = pathIndices;
+		icon.shapes.push_back(fillShape);
+	}
+
+	return true;
+}
+
+bool
+TraceConverter::_HasEnoughPoints(const Segments& segments)
+{
+	// A subpath needs three distinct points to enclose any area.
+	if (segments.empty())
+		return false;
+
+	const double eps = 1e-6;
+	double xs[3], ys[3];
+	int found = 0;
+
+	for (int i = -1; i < static_cast<int>(segments.size()); i++) {
+		double x, y;
+		if (i < 0) {
+			x = segments[0][1];
+			y = segments[0][2];
+		} else if (segments[i][0] == 1.0) {
+			x = segments[i][3];
+			y = segments[i][4];
+		} else {
+			x = segments[i][5];
+			y = segments[i][6];
+		}
+
+		bool seen = false;
+		for (int j = 0; j < found; j++) {
+			if (std::fabs(xs[j] - x) < eps && std::fabs(ys[j] - y) < eps) {
+				seen = true;
+				break;
+			}
+		}
+
+		if (!seen) {
+			xs[found] = x;
+			ys[found] = y;
+			if (++found == 3)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+double
+TraceConverter::_Round(double value, const ConvertState& state)
+{
+	value *= state.options->fScale;
+	if (state.roundFactor == 0.0)
+		return value;
+	return floor(value * state.roundFactor + 0.5) / state.roundFactor;
+}
+
+void
+TraceConverter::_AppendGeometry(const Segments& segments, const ConvertState& state,
+	std::vector<double>& geometry)
+{
+	geometry.push_back(kMoveTo);
+	geometry.push_back(_Round(segments[0][1], state));
+	geometry.push_back(_Round(segments[0][2], state));
+
+	for (size_t i = 0; i < segments.size(); i++) {
+		const std::vector<double>& segment = segments[i];
+		if (segment[0] == 1.0) {
+			geometry.push_back(kLineTo);
+			geometry.push_back(_Round(segment[3], state));
+			geometry.push_back(_Round(segment[4], state));
+		} else if (segment[0] == 3.0 && segment.size() >= 9) {
+			geometry.push_back(kCubicTo);
+			geometry.push_back(_Round(segment[3], state));
+			geometry.push_back(_Round(segment[4], state));
+			geometry.push_back(_Round(segment[7], state));
+			geometry.push_back(_Round(segment[8], state));
+			geometry.push_back(_Round(segment[5], state));
+			geometry.push_back(_Round(segment[6], state));
+		} else {
+			geometry.push_back(kQuadTo);
+			geometry.push_back(_Round(segment[3], state));
+			geometry.push_back(_Round(segment[4], state));
+			geometry.push_back(_Round(segment[5], state));
+			geometry.push_back(_Round(segment[6], state));
+		}
+	}
+}
+
+size_t
+TraceConverter::_AddPath(const std::vector<double>& geometry, size_t offset,
+	ConvertState& state, int* pathIndex)
+{
+	const double s = state.scale;
+	const double tx = state.tx;
+	const double ty = state.ty;
+
+	Path iconPath;
+	iconPath.closed = true;
+
+	PathPoint first;
+	first.x = first.x_in = first.x_out = geometry[offset + 1] * s + tx;
+	first.y = first.y_in = first.y_out = geometry[offset + 2] * s + ty;
+	first.connected = false;
+	iconPath.points.push_back(first);
+
+	size_t i = offset + 3;
+	while (i < geometry.size() && geometry[i] != kMoveTo) {
+		PathPoint pt;
+		pt.connected = false;
+
+		if (geometry[i] == kLineTo) {
+			pt.x = geometry[i + 1] * s + tx;
+			pt.y = geometry[i + 2] * s + ty;
+			i += 3;
+
+			const PathPoint& last = iconPath.points.back();
+			if (pt.x == last.x && pt.y == last.y)
+				continue;
+
+			pt.x_in = pt.x_out = pt.x;
+			pt.y_in = pt.y_out = pt.y;
+		} else if (geometry[i] == kCubicTo) {
+			PathPoint& last = iconPath.points.back();
+			last.x_out = geometry[i + 1] * s + tx;
+			last.y_out = geometry[i + 2] * s + ty;
+
+			pt.x_in = geometry[i + 3] * s + tx;
+			pt.y_in = geometry[i + 4] * s + ty;
+			pt.x = pt.x_out = geometry[i + 5] * s + tx;
+			pt.y = pt.y_out = geometry[i + 6] * s + ty;
+			i += 7;
+		} else {
+			// Quadratic segments become cubic handles two thirds of the
+			// way towards the control point.
+			double cx = geometry[i + 1] * s + tx;
+			double cy = geometry[i + 2] * s + ty;
+			pt.x = geometry[i + 3] * s + tx;
+			pt.y = geometry[i + 4] * s + ty;
+			i += 5;
+
+			PathPoint& last = iconPath.points.back();
+			last.x_out = last.x + (cx - last.x) * 2.0 / 3.0;
+			last.y_out = last.y + (cy - last.y) * 2.0 / 3.0;
+
+			pt.x_in = pt.x + (cx - pt.x) * 2.0 / 3.0;
+			pt.y_in = pt.y + (cy - pt.y) * 2.0 / 3.0;
+			pt.x_out = pt.x;
+			pt.y_out = pt.y;
+		}
+
+		iconPath.points.push_back(pt);
+	}
+
+	if (iconPath.points.size() > 1) {
+		const PathPoint& last = iconPath.points.back();
+		PathPoint& start = iconPath.points[0];
+		if (utils::FloatEqual(static_cast<float>(start.x), static_cast<float>(last.x), 0.01f)
+			&& utils::FloatEqual(static_cast<float>(start.y), static_cast<float>(last.y), 0.01f)) {
+			start.x_in = last.x_in;
+			start.y_in = last.y_in;
+			iconPath.points.pop_back();
+		}
+	}
+
+	*pathIndex = static_cast<int>(state.icon->paths.size());
+	state.icon->paths.push_back(iconPath);
+	return i;
+}
+
+int
+TraceConverter::_AddSolidStyle(const std::vector<unsigned char>& color,
+	ConvertState& state)
+{
+	uint32_t argb = (static_cast<uint32_t>(color[3]) << 24)
+		| (static_cast<uint32_t>(color[0]) << 16)
+		| (static_cast<uint32_t>(color[1]) << 8)
+		| static_cast<uint32_t>(color[2]);
+
+	std::map<uint32_t, int>::const_iterator found = state.solidStyles.find(argb);
+	if (found != state.solidStyles.end())
+		return found->second;
+
+	Style style;
+	style.isGradient = false;
+	style.solidColor = Color(argb);
+
+	int styleIndex = static_cast<int>(state.icon->styles.size());
+	state.icon->styles.push_back(style);
+	state.solidStyles[argb] = styleIndex;
+	return styleIndex;
+}
+
+int
+TraceConverter::_AddGradientStyle(const IndexedBitmap::LinearGradient& gradient,
+	ConvertState& state)
+{
+	const double s = state.scale * state.options->fScale;
+	double x1 = gradient.x1 * s + state.tx;
+	double y1 = gradient.y1 * s + state.ty;
+	double x2 = gradient.x2 * s + state.tx;
+	double y2 = gradient.y2 * s + state.ty;
+
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	if (dx * dx + dy * dy < 1e-12)
+		return -1;
+
+	Style style;
+	style.isGradient = true;
+	style.gradient.type = GRADIENT_LINEAR;
+	style.gradient.interpolation = INTERPOLATION_LINEAR;
+
+	for (int i = 0; i < 2; i++) {
+		const unsigned char* c = i == 0 ? gradient.c1 : gradient.c2;
+		uint32_t argb = (static_cast<uint32_t>(c[3]) << 24)
+			| (static_cast<uint32_t>(c[0]) << 16)
+			| (static_cast<uint32_t>(c[1]) << 8)
+			| static_cast<uint32_t>(c[2]);
+		style.gradient.stops.push_back(ColorStop(Color(argb), static_cast<float>(i)));
+	}
+
+	// Icon gradients run from -64 to 64 along their x axis; map that span
+	// onto the line between the two end points.
+	style.gradient.transform.push_back(dx / 128.0);
+	style.gradient.transform.push_back(dy / 128.0);
+	style.gradient.transform.push_back(-dy / 128.0);
+	style.gradient.transform.push_back(dx / 128.0);
+	style.gradient.transform.push_back((x1 + x2) / 2.0);
+	style.gradient.transform.push_back((y1 + y2) / 2.0);
+	style.gradient.hasTransform = true;
+
+	int styleIndex = static_cast<int>(state.icon->styles.size());
+	state.icon->styles.push_back(style);
+	return styleIndex;
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef IMPORT_TRACE_CONVERTER_H
+#define IMPORT_TRACE_CONVERTER_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "HaikuIcon.h"
+#include "IndexedBitmap.h"
+#include "TracingOptions.h"
+
+namespace haiku {
+
+// Builds an icon straight from traced layers. Produces the same shapes,
+// paint order and colors the tracer's SVG output would give after going
+// through SVGParser, without formatting or parsing any text.
+class TraceConverter {
+public:
+				TraceConverter() {};
+				~TraceConverter() {};
+
+	bool		Convert(const IndexedBitmap& indexed, const TracingOptions& options,
+					Icon& icon, float targetSize = 64.0f);
+
+private:
+	typedef std::vector<std::vector<double> > Segments;
+
+	struct ConvertState {
+		const TracingOptions*	options;
+		Icon*		icon;
+		double		scale;
+		double		tx, ty;
+		double		roundFactor;
+
+		// Geometry of every group already emitted, so duplicate paths are
+		// dropped like OptimizeSvgString() drops repeated "d" attributes.
+		std::set<std::vector<double> > emitted;
+		std::map<uint32_t, int> solidStyles;
+
+		ConvertState() : options(NULL), icon(NULL), scale(1.0), tx(0.0), ty(0.0),
+			roundFactor(0.0) {}
+	};
+
+	bool		_HasEnoughPoints(const Segments& segments);
+	double		_Round(double value, const ConvertState& state);
+	void		_AppendGeometry(const Segments& segments, const ConvertState& state,
+					std::vector<double>& geometry);
+	size_t		_AddPath(const std::vector<double>& geometry, size_t offset,
+					ConvertState& state, int* pathIndex);
+	int			_AddSolidStyle(const std::vector<unsigned char>& color,
+					ConvertState& state);
+	int			_AddGradientStyle(const IndexedBitmap::LinearGradient& gradient,
+					ConvertState& state);
+};
+
+}
+
+#endif
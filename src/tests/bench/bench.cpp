@@ -0,0 +1,816 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "IconConverter.h"
+
+#if defined(HVIF_BENCH_TRACER) && !defined(__HAIKU__)
+#define BENCH_TRACER_STAGES 1
+#include "ImageTracer.h"
+#include "PNGDecoder.h"
+#include "SvgWriter.h"
+#include "VectorizationProgress.h"
+#include "stb_image.h"
+#endif
+
+using namespace haiku;
+
+// Global allocation counters. Every operator new in the process goes
+// through here, including allocations made on tracer worker threads.
+static std::atomic<unsigned long long> sAllocCount(0);
+static std::atomic<unsigned long long> sAllocBytes(0);
+
+void*
+operator new(std::size_t size)
+{
+	sAllocCount.fetch_add(1, std::memory_order_relaxed);
+	sAllocBytes.fetch_add(size, std::memory_order_relaxed);
+	void* ptr = std::malloc(size != 0 ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void*
+operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void
+operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+static long
+PeakRSSKiB()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (long)(counters.PeakWorkingSetSize / 1024);
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return (long)(usage.ru_maxrss / 1024);
+#else
+	return (long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+void PrintUsage(const char* prog)
+{
+	std::cerr << "Icon Converter Benchmark\n";
+	std::cerr << "Usage: " << prog << " <corpus-dir> [options]\n";
+	std::cerr << "\n";
+	std::cerr << "Runs every HVIF/IOM/SVG/PNG fixture in <corpus-dir> through all\n";
+	std::cerr << "IconConverter load/save paths and the ImageTracer stages, and\n";
+	std::cerr << "reports wall time, allocations, peak RSS and icons/s as JSON.\n";
+	std::cerr << "\n";
+	std::cerr << "Options:\n";
+	std::cerr << "  -n, --iterations <n>  Measured runs per fixture (default: 5)\n";
+	std::cerr << "  --warmup <n>          Unmeasured runs per fixture (default: 1)\n";
+	std::cerr << "  -o, --output <file>   Write JSON report to file (default: stdout)\n";
+	std::cerr << "  --baseline <file>     Compare against a previous JSON report\n";
+	std::cerr << "  --threshold <pct>     Allowed slowdown per stage (default: 10)\n";
+	std::cerr << "  --no-tracer           Skip the per-stage ImageTracer breakdown\n";
+	std::cerr << "  --seam-check <size>   Also trace PNGs in tiles of <size> and check\n";
+	std::cerr << "                        the seams against the untiled trace\n";
+	std::cerr << "  -v, --verbose         Show per-fixture progress\n";
+	std::cerr << "\n";
+	std::cerr << "Exit status is 2 when a stage regressed past the threshold, and 3\n";
+	std::cerr << "when a tiled trace left gaps along its seams.\n";
+	std::cerr << "\n";
+	std::cerr << "Examples:\n";
+	std::cerr << "  " << prog << " fixtures/ -o bench.json\n";
+	std::cerr << "  " << prog << " fixtures/ --baseline bench.json --threshold 5\n";
+	std::cerr << "  " << prog << " fixtures/ --seam-check 64\n";
+}
+
+struct StageStats {
+	std::string name;
+	int runs;
+	int failures;
+	double totalMs;
+	unsigned long long allocs;
+	unsigned long long allocBytes;
+	// How far the stage raised the peak RSS of the process, which is all
+	// the platforms report and which never goes down.
+	long peakRssGrowthKiB;
+
+	StageStats() : runs(0), failures(0), totalMs(0.0), allocs(0),
+		allocBytes(0), peakRssGrowthKiB(0) {}
+
+	double MsPerIcon() const { return runs > 0 ? totalMs / runs : 0.0; }
+	double IconsPerSecond() const
+		{ return totalMs > 0.0 ? runs * 1000.0 / totalMs : 0.0; }
+};
+
+class BenchReport {
+public:
+	StageStats& Stage(const std::string& name)
+	{
+		for (size_t i = 0; i < fStages.size(); i++) {
+			if (fStages[i].name == name)
+				return fStages[i];
+		}
+		fStages.push_back(StageStats());
+		fStages.back().name = name;
+		return fStages.back();
+	}
+
+	const std::vector<StageStats>& Stages() const { return fStages; }
+
+private:
+	std::vector<StageStats> fStages;
+};
+
+typedef std::chrono::steady_clock BenchClock;
+
+// Snapshot of the clock, allocation counters and peak RSS at the start of
+// a stage.
+struct StageProbe {
+	BenchClock::time_point start;
+	unsigned long long allocs;
+	unsigned long long allocBytes;
+	long peakRssKiB;
+
+	void Start()
+	{
+		peakRssKiB = PeakRSSKiB();
+		allocs = sAllocCount.load(std::memory_order_relaxed);
+		allocBytes = sAllocBytes.load(std::memory_order_relaxed);
+		start = BenchClock::now();
+	}
+
+	void Stop(StageStats& stats, bool ok)
+	{
+		BenchClock::time_point end = BenchClock::now();
+		stats.runs++;
+		if (!ok)
+			stats.failures++;
+		stats.totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+		stats.allocs += sAllocCount.load(std::memory_order_relaxed) - allocs;
+		stats.allocBytes += sAllocBytes.load(std::memory_order_relaxed) - allocBytes;
+		long rss = PeakRSSKiB();
+		if (rss > peakRssKiB)
+			stats.peakRssGrowthKiB += rss - peakRssKiB;
+	}
+};
+
+static std::string
+FormatKey(IconFormat format)
+{
+	switch (format) {
+		case FORMAT_HVIF: return "hvif";
+		case FORMAT_IOM: return "iom";
+		case FORMAT_SVG: return "svg";
+		case FORMAT_PNG: return "png";
+		default: return "unknown";
+	}
+}
+
+#ifdef BENCH_TRACER_STAGES
+
+static const char*
+TraceStageKey(int stage)
+{
+	switch (stage) {
+		case STAGE_STARTING: return "trace.start";
+		case STAGE_REMOVE_BACKGROUND: return "trace.background";
+		case STAGE_BLUR: return "trace.blur";
+		case STAGE_CREATE_PALETTE: return "trace.palette";
+		case STAGE_QUANTIZE_COLORS: return "trace.quantize";
+		case STAGE_MERGE_REGIONS: return "trace.merge_regions";
+		case STAGE_SCAN_PATHS: return "trace.scan_paths";
+		case STAGE_TRACE_PATHS: return "trace.trace_paths";
+		case STAGE_SIMPLIFY_VW: return "trace.simplify_vw";
+		case STAGE_FILTER_SMALL: return "trace.filter_small";
+		case STAGE_SIMPLIFY_DP: return "trace.simplify_dp";
+		case STAGE_SIMPLIFY_ADVANCED: return "trace.simplify_advanced";
+		case STAGE_DETECT_GEOMETRY: return "trace.detect_geometry";
+		case STAGE_UNIFY_EDGES: return "trace.unify_edges";
+		case STAGE_FIX_WINDING: return "trace.fix_winding";
+		case STAGE_DETECT_GRADIENTS: return "trace.detect_gradients";
+		case STAGE_COMPLETE: return "trace.complete";
+		default: return "trace.other";
+	}
+}
+
+// Progress callbacks arrive when a stage begins; the time until the next
+// stage change is attributed to the stage that was running.
+struct TraceRecorder {
+	BenchReport* report;
+	bool measured;
+	int currentStage;
+	StageProbe probe;
+
+	void Finish()
+	{
+		if (currentStage >= 0 && measured)
+			probe.Stop(report->Stage(TraceStageKey(currentStage)), true);
+		currentStage = -1;
+	}
+};
+
+static void
+TraceProgressCallback(int stage, int /*percent*/, void* userData)
+{
+	TraceRecorder* recorder = static_cast<TraceRecorder*>(userData);
+	if (recorder == NULL || stage == recorder->currentStage)
+		return;
+
+	recorder->Finish();
+	recorder->currentStage = stage;
+	recorder->probe.Start();
+}
+
+// Decodes like PNGParser: with PNGDecoder, and with stb_image for the
+// interlaced images it leaves out.
+static bool
+DecodeBitmap(const std::vector<uint8_t>& data, BitmapData& bitmap)
+{
+	PNGDecoder decoder;
+	bitmap = decoder.Decode(&data[0], data.size());
+	if (bitmap.IsValid())
+		return true;
+
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	unsigned char* pixels = stbi_load_from_memory(&data[0], (int)data.size(),
+		&width, &height, &channels, 4);
+	if (pixels == NULL)
+		return false;
+
+	bitmap = BitmapData::Adopt(width, height, pixels, stbi_image_free);
+	return bitmap.IsValid();
+}
+
+// Turns on every optional stage so each one shows up in the breakdown.
+static TracingOptions
+AllStagesOptions()
+{
+	TracingOptions opts;
+	opts.fRemoveBackground = true;
+	opts.fAggressiveSimplification = true;
+	opts.fDouglasPeuckerEnabled = true;
+	opts.fVisvalingamWhyattEnabled = true;
+	opts.fDetectGeometry = true;
+	opts.fFilterSmallObjects = true;
+	opts.fDetectGradients = true;
+	return opts;
+}
+
+static void
+RunTracerStages(const std::vector<uint8_t>& data, BenchReport& report, bool measured)
+{
+	StageProbe decodeProbe;
+	decodeProbe.Start();
+	BitmapData bitmap;
+	bool decoded = DecodeBitmap(data, bitmap);
+	if (measured)
+		decodeProbe.Stop(report.Stage("trace.decode"), decoded);
+	if (!decoded)
+		return;
+
+	TraceRecorder recorder;
+	recorder.report = &report;
+	recorder.measured = measured;
+	recorder.currentStage = -1;
+
+	TracingOptions opts = AllStagesOptions();
+	opts.SetProgressCallback(TraceProgressCallback, &recorder);
+
+	StageProbe total;
+	total.Start();
+
+	ImageTracer tracer;
+	IndexedBitmap indexed = tracer.BitmapToTraceData(bitmap, opts);
+	recorder.Finish();
+
+	StageProbe writeProbe;
+	writeProbe.Start();
+	SvgWriter writer;
+	std::string svg = writer.GenerateSvg(indexed, opts);
+	if (measured) {
+		writeProbe.Stop(report.Stage("trace.svg_output"), !svg.empty());
+		total.Stop(report.Stage("trace.total"), !svg.empty());
+	}
+}
+
+// How many more percent of the pixels along the seams a tiled trace may
+// leave uncovered than of the rest of the image. Pieces of a region
+// traced apart are fitted a little differently anywhere, but a seam the
+// pieces do not meet on leaves far more than that.
+static const double kSeamGapMargin = 8.0;
+
+// Appends the end of a traced segment, and points along it for curves.
+static void
+FlattenSegment(const std::vector<double>& segment, std::vector<double>& points)
+{
+	const int steps = segment[0] == 1.0 ? 1 : 8;
+	for (int s = 1; s <= steps; s++) {
+		double t = (double)s / steps;
+		double mt = 1.0 - t;
+		if (segment[0] == 1.0) {
+			points.push_back(segment[3]);
+			points.push_back(segment[4]);
+		} else if (segment[0] == 3.0 && segment.size() >= 9) {
+			points.push_back(mt * mt * mt * segment[1] + 3.0 * mt * mt * t * segment[3]
+				+ 3.0 * mt * t * t * segment[7] + t * t * t * segment[5]);
+			points.push_back(mt * mt * mt * segment[2] + 3.0 * mt * mt * t * segment[4]
+				+ 3.0 * mt * t * t * segment[8] + t * t * t * segment[6]);
+		} else {
+			points.push_back(mt * mt * segment[1] + 2.0 * mt * t * segment[3]
+				+ t * t * segment[5]);
+			points.push_back(mt * mt * segment[2] + 2.0 * mt * t * segment[4]
+				+ t * t * segment[6]);
+		}
+	}
+}
+
+// Marks the pixels whose centre lies inside any traced path. Paths are
+// traced with a pixel of border, so pixel (x, y) is centred on (x+1, y+1).
+static std::vector<bool>
+TracedCoverage(const IndexedBitmap& indexed, int width, int height)
+{
+	std::vector<bool> covered((size_t)width * height, false);
+	const std::vector<std::vector<std::vector<std::vector<double> > > >& layers =
+		indexed.Layers();
+
+	std::vector<double> points;
+	std::vector<double> crossings;
+	for (size_t k = 0; k < layers.size(); k++) {
+		for (size_t i = 0; i < layers[k].size(); i++) {
+			const std::vector<std::vector<double> >& path = layers[k][i];
+			if (path.empty())
+				continue;
+
+			points.clear();
+			points.push_back(path[0][1]);
+			points.push_back(path[0][2]);
+			for (size_t j = 0; j < path.size(); j++)
+				FlattenSegment(path[j], points);
+
+			const size_t count = points.size() / 2;
+			for (int y = 0; y < height; y++) {
+				double center = y + 1.0;
+				crossings.clear();
+				for (size_t p = 0; p < count; p++) {
+					size_t q = (p + 1) % count;
+					double y0 = points[2 * p + 1];
+					double y1 = points[2 * q + 1];
+					if ((y0 <= center) == (y1 <= center))
+						continue;
+					double x0 = points[2 * p];
+					double x1 = points[2 * q];
+					crossings.push_back(x0 + (center - y0) * (x1 - x0) / (y1 - y0));
+				}
+
+				std::sort(crossings.begin(), crossings.end());
+				for (size_t c = 0; c + 1 < crossings.size(); c += 2) {
+					int from = std::max(0, (int)std::ceil(crossings[c] - 1.0));
+					int to = std::min(width - 1, (int)std::floor(crossings[c + 1] - 1.0));
+					for (int x = from; x <= to; x++)
+						covered[(size_t)y * width + x] = true;
+				}
+			}
+		}
+	}
+	return covered;
+}
+
+// Whether a pixel column or row borders a seam between tiles.
+static bool
+NextToSeam(int position, int size, int tileSize)
+{
+	return position > 0 && position < size - 1
+		&& (position % tileSize == 0 || position % tileSize == tileSize - 1);
+}
+
+// Traces the fixture whole and in tiles, and fails when the tiled trace
+// leaves the pixels along the seams uncovered much more often than the
+// rest of the pixels the whole trace covers.
+static bool
+CheckSeams(const std::vector<uint8_t>& data, int tileSize, const std::string& file,
+	bool verbose)
+{
+	BitmapData bitmap;
+	if (!DecodeBitmap(data, bitmap))
+		return true;
+
+	const int width = bitmap.Width();
+	const int height = bitmap.Height();
+	if (width <= tileSize && height <= tileSize)
+		return true;
+
+	TracingOptions opts = AllStagesOptions();
+	ImageTracer wholeTracer;
+	std::vector<bool> whole = TracedCoverage(wholeTracer.BitmapToTraceData(bitmap, opts),
+		width, height);
+
+	opts.fTileSize = tileSize;
+	ImageTracer tiledTracer;
+	std::vector<bool> tiled = TracedCoverage(tiledTracer.BitmapToTraceData(bitmap, opts),
+		width, height);
+
+	int seamPixels = 0;
+	int seamGaps = 0;
+	int otherPixels = 0;
+	int otherGaps = 0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t index = (size_t)y * width + x;
+			bool gap = whole[index] && !tiled[index];
+			if (NextToSeam(x, width, tileSize) || NextToSeam(y, height, tileSize)) {
+				seamPixels++;
+				if (gap)
+					seamGaps++;
+			} else {
+				otherPixels++;
+				if (gap)
+					otherGaps++;
+			}
+		}
+	}
+
+	double seamPct = seamPixels > 0 ? seamGaps * 100.0 / seamPixels : 0.0;
+	double otherPct = otherPixels > 0 ? otherGaps * 100.0 / otherPixels : 0.0;
+	bool cracked = seamPct > otherPct + kSeamGapMargin;
+	if (cracked || verbose) {
+		char buf[256];
+		snprintf(buf, sizeof(buf), "  seams: %6.2f%% of pixels lost, %6.2f%% elsewhere%s  ",
+			seamPct, otherPct, cracked ? "  GAPS" : "");
+		std::cerr << buf << file << "\n";
+	}
+	return !cracked;
+}
+
+#endif
+
+static bool
+ReadFile(const std::string& path, std::vector<uint8_t>& data)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	file.seekg(0, std::ios::end);
+	std::streamoff size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	if (size <= 0)
+		return false;
+
+	data.resize((size_t)size);
+	file.read(reinterpret_cast<char*>(&data[0]), size);
+	return file.good();
+}
+
+static void
+RunFixture(const std::vector<uint8_t>& data, IconFormat format,
+	BenchReport& report, bool measured)
+{
+	static const IconFormat kOutputs[] = {
+		FORMAT_HVIF, FORMAT_IOM, FORMAT_SVG, FORMAT_PNG
+	};
+
+	StageProbe probe;
+	probe.Start();
+	Icon icon = IconConverter::LoadFromBuffer(data, format);
+	bool loaded = IconConverter::GetLastError().empty();
+	if (measured)
+		probe.Stop(report.Stage("load." + FormatKey(format)), loaded);
+	if (!loaded)
+		return;
+
+	for (size_t i = 0; i < sizeof(kOutputs) / sizeof(kOutputs[0]); i++) {
+		IconFormat output = kOutputs[i];
+		std::vector<uint8_t> buffer;
+
+		probe.Start();
+		bool saved = IconConverter::SaveToBuffer(icon, buffer, output);
+		if (measured)
+			probe.Stop(report.Stage("save." + FormatKey(output)), saved);
+		if (!saved || output == FORMAT_PNG)
+			continue;
+
+		probe.Start();
+		Icon reloaded = IconConverter::LoadFromBuffer(buffer, output);
+		if (measured) {
+			probe.Stop(report.Stage("reload." + FormatKey(output)),
+				IconConverter::GetLastError().empty());
+		}
+	}
+}
+
+static std::string
+JsonEscape(const std::string& text)
+{
+	std::string out;
+	for (size_t i = 0; i < text.size(); i++) {
+		char c = text[i];
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if ((unsigned char)c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+			out += buf;
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
+
+static void
+WriteReport(std::ostream& out, const BenchReport& report, const std::string& corpus,
+	int fixtures, int iterations, double wallMs)
+{
+	char buf[512];
+	out << "{\n";
+	out << "  \"corpus\": \"" << JsonEscape(corpus) << "\",\n";
+	out << "  \"fixtures\": " << fixtures << ",\n";
+	out << "  \"iterations\": " << iterations << ",\n";
+	snprintf(buf, sizeof(buf), "%.3f", wallMs);
+	out << "  \"wallMs\": " << buf << ",\n";
+	out << "  \"peakRssKiB\": " << PeakRSSKiB() << ",\n";
+	out << "  \"stages\": [\n";
+
+	const std::vector<StageStats>& stages = report.Stages();
+	for (size_t i = 0; i < stages.size(); i++) {
+		const StageStats& s = stages[i];
+		// One stage per line keeps the report easy to diff and to read back.
+		snprintf(buf, sizeof(buf),
+			"    {\"name\": \"%s\", \"runs\": %d, \"failures\": %d, "
+			"\"totalMs\": %.3f, \"msPerIcon\": %.4f, \"iconsPerSec\": %.2f, "
+			"\"allocs\": %llu, \"allocBytes\": %llu, \"peakRssGrowthKiB\": %ld}%s\n",
+			s.name.c_str(), s.runs, s.failures, s.totalMs, s.MsPerIcon(),
+			s.IconsPerSecond(), s.allocs, s.allocBytes, s.peakRssGrowthKiB,
+			i + 1 < stages.size() ? "," : "");
+		out << buf;
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+static bool
+ExtractNumber(const std::string& line, const char* key, double& value)
+{
+	std::string pattern = std::string("\"") + key + "\": ";
+	size_t pos = line.find(pattern);
+	if (pos == std::string::npos)
+		return false;
+	value = strtod(line.c_str() + pos + pattern.size(), NULL);
+	return true;
+}
+
+static bool
+ExtractString(const std::string& line, const char* key, std::string& value)
+{
+	std::string pattern = std::string("\"") + key + "\": \"";
+	size_t pos = line.find(pattern);
+	if (pos == std::string::npos)
+		return false;
+	pos += pattern.size();
+	size_t end = line.find('"', pos);
+	if (end == std::string::npos)
+		return false;
+	value = line.substr(pos, end - pos);
+	return true;
+}
+
+// Reads back the stage lines written by WriteReport and reports every
+// stage whose per-icon time grew by more than thresholdPct.
+static int
+CompareBaseline(const std::string& file, const BenchReport& report, double thresholdPct)
+{
+	std::ifstream in(file.c_str());
+	if (!in) {
+		std::cerr << "Error: Cannot open baseline " << file << "\n";
+		return -1;
+	}
+
+	int regressions = 0;
+	std::string line;
+	while (std::getline(in, line)) {
+		std::string name;
+		double baseMs = 0.0;
+		if (!ExtractString(line, "name", name) || !ExtractNumber(line, "msPerIcon", baseMs))
+			continue;
+
+		const std::vector<StageStats>& stages = report.Stages();
+		for (size_t i = 0; i < stages.size(); i++) {
+			if (stages[i].name != name)
+				continue;
+
+			double currentMs = stages[i].MsPerIcon();
+			double deltaPct = baseMs > 0.0 ? (currentMs - baseMs) * 100.0 / baseMs : 0.0;
+			bool regressed = deltaPct > thresholdPct;
+			if (regressed)
+				regressions++;
+
+			char buf[256];
+			snprintf(buf, sizeof(buf), "  %-26s %10.4f -> %10.4f ms  %+7.1f%%%s\n",
+				name.c_str(), baseMs, currentMs, deltaPct,
+				regressed ? "  REGRESSION" : "");
+			std::cerr << buf;
+			break;
+		}
+	}
+
+	return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::string corpus = argv[1];
+	std::string outputFile;
+	std::string baselineFile;
+	int iterations = 5;
+	int warmup = 1;
+	double threshold = 10.0;
+	bool tracerStages = true;
+	int seamTileSize = 0;
+	bool verbose = false;
+
+	for (int i = 2; i < argc; i++) {
+		if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--iterations") == 0) && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+			if (iterations < 1) {
+				std::cerr << "Error: Iterations must be positive\n";
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			warmup = atoi(argv[++i]);
+			if (warmup < 0)
+				warmup = 0;
+		} else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc) {
+			outputFile = argv[++i];
+		} else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			baselineFile = argv[++i];
+		} else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+			threshold = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--no-tracer") == 0) {
+			tracerStages = false;
+		} else if (strcmp(argv[i], "--seam-check") == 0 && i + 1 < argc) {
+			seamTileSize = atoi(argv[++i]);
+			if (seamTileSize < 16) {
+				std::cerr << "Error: Tile size must be at least 16\n";
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+			verbose = true;
+		} else {
+			std::cerr << "Error: Unknown option " << argv[i] << "\n";
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<std::string> files;
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it(corpus, ec), end; !ec && it != end; it.increment(ec)) {
+		if (it->is_regular_file())
+			files.push_back(it->path().string());
+	}
+	if (ec) {
+		std::cerr << "Error: Cannot read corpus directory " << corpus << "\n";
+		return 1;
+	}
+	std::sort(files.begin(), files.end());
+
+	BenchReport report;
+	int fixtures = 0;
+	int crackedFixtures = 0;
+	BenchClock::time_point start = BenchClock::now();
+
+	for (size_t f = 0; f < files.size(); f++) {
+		IconFormat format = IconConverter::DetectFormat(files[f]);
+		if (format != FORMAT_HVIF && format != FORMAT_IOM
+			&& format != FORMAT_SVG && format != FORMAT_PNG) {
+			continue;
+		}
+
+		std::vector<uint8_t> data;
+		if (!ReadFile(files[f], data)) {
+			std::cerr << "Warning: Cannot read " << files[f] << "\n";
+			continue;
+		}
+
+		if (verbose)
+			std::cerr << "[" << FormatKey(format) << "] " << files[f] << "\n";
+
+#ifdef BENCH_TRACER_STAGES
+		bool traceable = tracerStages && format == FORMAT_PNG;
+#else
+		(void)tracerStages;
+		(void)seamTileSize;
+#endif
+
+		for (int run = 0; run < warmup + iterations; run++) {
+			bool measured = run >= warmup;
+			RunFixture(data, format, report, measured);
+#ifdef BENCH_TRACER_STAGES
+			if (traceable)
+				RunTracerStages(data, report, measured);
+#endif
+		}
+#ifdef BENCH_TRACER_STAGES
+		if (traceable && seamTileSize > 0
+			&& !CheckSeams(data, seamTileSize, files[f], verbose)) {
+			crackedFixtures++;
+		}
+#endif
+		fixtures++;
+	}
+
+	double wallMs = std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+
+	if (fixtures == 0) {
+		std::cerr << "Error: No HVIF/IOM/SVG/PNG fixtures found in " << corpus << "\n";
+		return 1;
+	}
+
+	if (outputFile.empty()) {
+		WriteReport(std::cout, report, corpus, fixtures, iterations, wallMs);
+	} else {
+		std::ofstream out(outputFile.c_str());
+		if (!out) {
+			std::cerr << "Error: Cannot write " << outputFile << "\n";
+			return 1;
+		}
+		WriteReport(out, report, corpus, fixtures, iterations, wallMs);
+	}
+
+	if (!baselineFile.empty()) {
+		std::cerr << "Baseline comparison (threshold " << threshold << "%):\n";
+		int regressions = CompareBaseline(baselineFile, report, threshold);
+		if (regressions < 0)
+			return 1;
+		if (regressions > 0) {
+			std::cerr << regressions << " stage(s) regressed\n";
+			return 2;
+		}
+	}
+
+	if (crackedFixtures > 0) {
+		std::cerr << crackedFixtures << " fixture(s) traced with gaps along tile seams\n";
+		return 3;
+	}
+
+	return 0;
+}
@@ -4,33 +4,88 @@
  */
 
 #include <iostream>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 #include "IconConverter.h"
+#include "ConversionCache.h"
+#include "IconArchive.h"
+#include "HVIFParser.h"
+
+// Limits for a single --serve request, so a broken client cannot make the
+// server allocate without bound.
+static const uint32_t kMaxRequestArgs = 64 * 1024;
+static const uint32_t kMaxRequestData = 64 * 1024 * 1024;
 
 void PrintUsage(const char* prog)
 {
 	std::cerr << "Usage: " << prog << " <input> <output> [options]\n";
+	std::cerr << "       " << prog << " --serve | --listen <path> [options]\n";
+	std::cerr << "       " << prog << " pack <archive> <input>... [options]\n";
+	std::cerr << "       " << prog << " unpack <archive> <directory> [name]... [options]\n";
+	std::cerr << "       " << prog << " list <archive> [-v]\n";
 	std::cerr << "\n";
 	std::cerr << "Input format is auto-detected by file signature.\n";
 	std::cerr << "Output format is determined by -f option or file extension.\n";
+	std::cerr << "Use - as <input> or <output> for stdin or stdout; writing to stdout needs -f.\n";
 	std::cerr << "\n";
 	std::cerr << "Options:\n";
 	std::cerr << "  -f, --format <fmt>       Output format: hvif, iom, svg, png (default: auto)\n";
 	std::cerr << "  -v, --verbose            Show conversion details\n";
 	std::cerr << "  --names                  Preserve element names\n";
+	std::cerr << "  --cache-dir <dir>        Reuse results of earlier conversions stored in <dir>\n";
 	std::cerr << "\n";
 	std::cerr << "SVG/PNG output options:\n";
 	std::cerr << "  --width <n>              Output width (default: 64)\n";
 	std::cerr << "  --height <n>             Output height (default: 64)\n";
 	std::cerr << "  --scale <f>              PNG scale factor (default: 1.0)\n";
+	std::cerr << "  --png-effort <level>     PNG compression: store, fast, default, max\n";
 	std::cerr << "\n";
 	std::cerr << "PNG input options:\n";
 	std::cerr << "  --preset <name>          Vectorization preset:\n";
 	std::cerr << "                           - icon (default): simple icons, no gradients\n";
 	std::cerr << "                           - icon-gradient: icons with gradient support\n";
 	std::cerr << "  --remove-bg              Remove background from PNG (auto-detect)\n";
+	std::cerr << "  --cubic                  Trace with cubic instead of quadratic curves\n";
+	std::cerr << "  --stats <file>           Write per-stage tracing statistics as JSON\n";
+	std::cerr << "                           (for other input, PNG output encoding costs)\n";
+	std::cerr << "  --time-budget <ms>       Finish tracing with cheaper settings after this long\n";
+	std::cerr << "\n";
+	std::cerr << "Server mode:\n";
+	std::cerr << "  --serve                  Answer conversion requests on stdin/stdout\n";
+#ifndef _WIN32
+	std::cerr << "  --listen <path>          Answer conversion requests on a Unix socket\n";
+#endif
+	std::cerr << "  A request is a 32-bit big-endian length and that many bytes of options\n";
+	std::cerr << "  (as above, separated by spaces), then a length and the input data.\n";
+	std::cerr << "  The reply is a 32-bit status (0 = success), a length and the output,\n";
+	std::cerr << "  or the error message. Output defaults to hvif.\n";
+	std::cerr << "\n";
+	std::cerr << "Archives:\n";
+	std::cerr << "  pack                     Pack files, or all files below directories, into one\n";
+	std::cerr << "                           archive; other formats are converted to HVIF first\n";
+	std::cerr << "  unpack                   Extract all or the named icons, converted with -f\n";
+	std::cerr << "  list                     Print name, size, style, path and shape counts of\n";
+	std::cerr << "                           each icon without decoding it\n";
+	std::cerr << "  --no-dedup               Store identical icons once per name\n";
 	std::cerr << "\n";
 	std::cerr << "Other:\n";
 	std::cerr << "  --detect                 Only detect and print input format\n";
@@ -41,6 +96,9 @@ void PrintUsage(const char* prog)
 	std::cerr << "  " << prog << " icon.hvif icon.png --width 128 --height 128\n";
 	std::cerr << "  " << prog << " icon.png icon.hvif --preset icon-gradient\n";
 	std::cerr << "  " << prog << " logo.png logo.svg --preset icon-gradient --remove-bg\n";
+	std::cerr << "  " << prog << " - - -f svg < icon.hvif > icon.svg\n";
+	std::cerr << "  " << prog << " pack icons.hvpk icons/\n";
+	std::cerr << "  " << prog << " unpack icons.hvpk out/ apps/Tracker -f svg\n";
 	std::cerr << "  " << prog << " unknown.file --detect\n";
 }
 
@@ -61,81 +119,623 @@ haiku::PNGVectorizationPreset ParsePresetString(const std::string& preset)
 	return haiku::PRESET_ICON;
 }
 
+// Options that shape a single conversion, shared by the command line and
+// --serve requests. Returns 1 if args[i] is one of them, 0 if it is not,
+// and -1 with a message if its argument is missing.
+int ParseConvertOption(const std::vector<std::string>& args, size_t& i,
+	haiku::ConvertOptions& opts, haiku::IconFormat& outputFormat, std::string& error)
+{
+	const std::string& arg = args[i];
+	bool hasValue = i + 1 < args.size();
+
+	if (arg == "-f" || arg == "--format") {
+		if (!hasValue) {
+			error = arg + " requires an argument";
+			return -1;
+		}
+		outputFormat = ParseFormatString(args[++i]);
+	} else if (arg == "--names") {
+		opts.preserveNames = true;
+	} else if (arg == "--width") {
+		if (!hasValue) {
+			error = "--width requires an argument";
+			return -1;
+		}
+		opts.svgWidth = std::atoi(args[++i].c_str());
+		opts.pngWidth = opts.svgWidth;
+		if (opts.svgWidth <= 0) {
+			opts.svgWidth = 64;
+			opts.pngWidth = 64;
+		}
+	} else if (arg == "--height") {
+		if (!hasValue) {
+			error = "--height requires an argument";
+			return -1;
+		}
+		opts.svgHeight = std::atoi(args[++i].c_str());
+		opts.pngHeight = opts.svgHeight;
+		if (opts.svgHeight <= 0) {
+			opts.svgHeight = 64;
+			opts.pngHeight = 64;
+		}
+	} else if (arg == "--scale") {
+		if (!hasValue) {
+			error = "--scale requires an argument";
+			return -1;
+		}
+		opts.pngScale = static_cast<float>(std::atof(args[++i].c_str()));
+		if (opts.pngScale <= 0.0f) opts.pngScale = 1.0f;
+	} else if (arg == "--png-effort") {
+		if (!hasValue) {
+			error = "--png-effort requires an argument";
+			return -1;
+		}
+		if (!haiku::PNGEffortFromName(args[++i].c_str(), opts.pngEffort)) {
+			error = "Unknown PNG effort " + args[i];
+			return -1;
+		}
+	} else if (arg == "--preset") {
+		if (!hasValue) {
+			error = "--preset requires an argument";
+			return -1;
+		}
+		opts.pngPreset = ParsePresetString(args[++i]);
+	} else if (arg == "--remove-bg") {
+		opts.pngRemoveBackground = true;
+	} else if (arg == "--cubic") {
+		opts.pngCubic = true;
+	} else if (arg == "--time-budget") {
+		if (!hasValue) {
+			error = "--time-budget requires an argument";
+			return -1;
+		}
+		opts.pngTimeBudgetMs = std::atoi(args[++i].c_str());
+	} else
+		return 0;
+
+	return 1;
+}
+
+void SetBinaryMode()
+{
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+bool ReadInput(const std::string& file, std::vector<uint8_t>& data)
+{
+	if (file != "-") {
+		std::ifstream f(file.c_str(), std::ios::binary);
+		if (!f.is_open())
+			return false;
+		data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		return !f.bad();
+	}
+
+	uint8_t chunk[64 * 1024];
+	size_t count;
+	while ((count = fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+		data.insert(data.end(), chunk, chunk + count);
+	return !ferror(stdin);
+}
+
+bool WriteOutput(const std::string& file, const std::vector<uint8_t>& data)
+{
+	if (file != "-") {
+		std::ofstream f(file.c_str(), std::ios::binary);
+		if (!data.empty())
+			f.write(reinterpret_cast<const char*>(&data[0]), data.size());
+		return f.good();
+	}
+
+	if (!data.empty() && fwrite(&data[0], 1, data.size(), stdout) != data.size())
+		return false;
+	return fflush(stdout) == 0;
+}
+
+// Reads a big-endian 32-bit value. A clean end of input before the first
+// byte leaves 'ended' set.
+bool ReadLength(FILE* in, uint32_t& value, bool& ended)
+{
+	uint8_t bytes[4];
+	size_t count = fread(bytes, 1, 4, in);
+	ended = count == 0 && feof(in);
+	if (count != 4)
+		return false;
+
+	value = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16)
+		| ((uint32_t)bytes[2] << 8) | bytes[3];
+	return true;
+}
+
+bool WriteReply(FILE* out, uint32_t status, const void* data, size_t size)
+{
+	uint8_t header[8];
+	for (int i = 0; i < 4; i++) {
+		header[i] = (uint8_t)(status >> (24 - i * 8));
+		header[4 + i] = (uint8_t)((uint32_t)size >> (24 - i * 8));
+	}
+
+	if (fwrite(header, 1, sizeof(header), out) != sizeof(header))
+		return false;
+	if (size > 0 && fwrite(data, 1, size, out) != size)
+		return false;
+	return fflush(out) == 0;
+}
+
+bool WriteError(FILE* out, const std::string& message)
+{
+	return WriteReply(out, 1, message.data(), message.size());
+}
+
+// Answers requests until the client closes its end. Every request starts
+// from the options the server was started with.
+void Serve(FILE* in, FILE* out, const haiku::ConvertOptions& baseOpts)
+{
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> output;
+
+	for (;;) {
+		uint32_t length;
+		bool ended;
+		if (!ReadLength(in, length, ended)) {
+			if (!ended)
+				std::cerr << "Error: Truncated request\n";
+			return;
+		}
+
+		if (length > kMaxRequestArgs) {
+			WriteError(out, "Request options too long");
+			return;
+		}
+
+		std::string line(length, '\0');
+		if (length > 0 && fread(&line[0], 1, length, in) != length) {
+			std::cerr << "Error: Truncated request\n";
+			return;
+		}
+
+		if (!ReadLength(in, length, ended)) {
+			std::cerr << "Error: Truncated request\n";
+			return;
+		}
+
+		if (length > kMaxRequestData) {
+			WriteError(out, "Request data too large");
+			return;
+		}
+
+		data.resize(length);
+		if (length > 0 && fread(&data[0], 1, length, in) != length) {
+			std::cerr << "Error: Truncated request\n";
+			return;
+		}
+
+		std::vector<std::string> args;
+		std::istringstream words(line);
+		std::string word;
+		while (words >> word)
+			args.push_back(word);
+
+		haiku::ConvertOptions opts = baseOpts;
+		haiku::IconFormat outputFormat = haiku::FORMAT_HVIF;
+		std::string error;
+		for (size_t i = 0; i < args.size() && error.empty(); i++) {
+			if (ParseConvertOption(args, i, opts, outputFormat, error) == 0)
+				error = "Unknown option " + args[i];
+		}
+
+		bool sent;
+		if (!error.empty()) {
+			sent = WriteError(out, error);
+		} else if (!haiku::IconConverter::ConvertBuffer(data, haiku::FORMAT_AUTO,
+				output, outputFormat, opts)) {
+			sent = WriteError(out, haiku::IconConverter::GetLastError());
+		} else {
+			sent = WriteReply(out, 0, output.empty() ? NULL : &output[0], output.size());
+		}
+
+		if (opts.verbose) {
+			std::cerr << "Request: " << data.size() << " bytes -> "
+				<< (error.empty() ? output.size() : 0) << " bytes\n";
+		}
+
+		if (!sent)
+			return;
+
+		output.clear();
+	}
+}
+
+#ifndef _WIN32
+// Serves one connection at a time; IconConverter keeps its last error in
+// shared state, so conversions are not run concurrently.
+int Listen(const std::string& path, const haiku::ConvertOptions& opts)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Error: Socket path too long: " << path << "\n";
+		return 1;
+	}
+	strcpy(address.sun_path, path.c_str());
+
+	// Only a socket left behind by an earlier server is replaced.
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path.c_str());
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) != 0
+		|| listen(server, 8) != 0) {
+		std::cerr << "Error: Cannot listen on " << path << ": " << strerror(errno) << "\n";
+		if (server >= 0)
+			close(server);
+		return 1;
+	}
+
+	// A client that goes away mid-reply must not take the server with it.
+	signal(SIGPIPE, SIG_IGN);
+
+	for (;;) {
+		int client = accept(server, NULL, NULL);
+		if (client < 0) {
+			if (errno == EINTR)
+				continue;
+			std::cerr << "Error: accept failed: " << strerror(errno) << "\n";
+			break;
+		}
+
+		int clientOut = dup(client);
+		FILE* in = fdopen(client, "rb");
+		FILE* out = clientOut >= 0 ? fdopen(clientOut, "wb") : NULL;
+		if (in != NULL && out != NULL)
+			Serve(in, out, opts);
+
+		if (in != NULL) fclose(in); else close(client);
+		if (out != NULL) fclose(out); else if (clientOut >= 0) close(clientOut);
+	}
+
+	close(server);
+	unlink(path.c_str());
+	return 1;
+}
+#endif
+
+std::string ExtensionFor(haiku::IconFormat format)
+{
+	switch (format) {
+		case haiku::FORMAT_IOM: return ".iom";
+		case haiku::FORMAT_SVG: return ".svg";
+		case haiku::FORMAT_PNG: return ".png";
+		default: return ".hvif";
+	}
+}
+
+void PrintSummary(const hvif::HVIFSummary& summary, const char* indent)
+{
+	if (!summary.valid) {
+		std::cout << indent << "Invalid: " << summary.error << "\n";
+		return;
+	}
+
+	std::cout << indent << "Styles: " << summary.styleCount
+		<< " (" << summary.gradientCount << " gradients)\n";
+	std::cout << indent << "Paths: " << summary.pathCount
+		<< " (" << summary.pointCount << " points)\n";
+	std::cout << indent << "Shapes: " << summary.shapeCount
+		<< " (" << summary.transformerCount << " transformers"
+		<< (summary.hasShapeTransforms ? ", transformed" : "") << ")\n";
+	if (summary.HasBounds()) {
+		std::cout << indent << "Bounds: " << summary.minX << "," << summary.minY
+			<< " - " << summary.maxX << "," << summary.maxY << "\n";
+	}
+}
+
+// Packs the given files under their own names and the files below the
+// given directories under their paths relative to them. HVIF input is
+// stored as it is, anything else converted first and named .hvif.
+int Pack(const std::vector<std::string>& args)
+{
+	haiku::ConvertOptions opts;
+	haiku::IconFormat outputFormat = haiku::FORMAT_AUTO;
+	haiku::IconArchiveWriter writer;
+	std::string archive;
+	std::vector<std::pair<std::string, std::filesystem::path> > inputs;
+
+	for (size_t i = 2; i < args.size(); i++) {
+		std::string error;
+		if (args[i] == "--no-dedup") {
+			writer.SetDeduplicate(false);
+		} else if (args[i] == "-v" || args[i] == "--verbose") {
+			opts.verbose = true;
+		} else if (int parsed = ParseConvertOption(args, i, opts, outputFormat, error)) {
+			if (parsed < 0) {
+				std::cerr << "Error: " << error << "\n";
+				return 1;
+			}
+		} else if (archive.empty()) {
+			archive = args[i];
+		} else {
+			std::error_code code;
+			std::filesystem::path input(args[i]);
+			if (std::filesystem::is_directory(input, code)) {
+				std::filesystem::recursive_directory_iterator it(input, code), end;
+				for (; !code && it != end; it.increment(code)) {
+					if (it->is_regular_file(code)) {
+						inputs.push_back(std::make_pair(
+							it->path().lexically_relative(input).generic_string(), it->path()));
+					}
+				}
+			} else
+				inputs.push_back(std::make_pair(input.filename().generic_string(), input));
+
+			if (code) {
+				std::cerr << "Error: Cannot read " << args[i] << ": " << code.message() << "\n";
+				return 1;
+			}
+		}
+	}
+
+	if (archive.empty() || inputs.empty()) {
+		std::cerr << "Error: pack needs an archive and at least one input\n";
+		return 1;
+	}
+
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> converted;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		std::string name = inputs[i].first;
+		std::string file = inputs[i].second.string();
+
+		data.clear();
+		if (!ReadInput(file, data)) {
+			std::cerr << "Error: Failed to read " << file << "\n";
+			return 1;
+		}
+
+		const std::vector<uint8_t>* icon = &data;
+		if (haiku::IconConverter::DetectFormat(data) == haiku::FORMAT_HVIF) {
+			hvif::HVIFSummary summary;
+			if (!hvif::HVIFParser::Scan(&data[0], data.size(), summary)) {
+				std::cerr << "Error: " << file << ": " << summary.error << "\n";
+				return 1;
+			}
+		} else {
+			converted.clear();
+			if (!haiku::IconConverter::ConvertBuffer(data, haiku::FORMAT_AUTO, converted,
+					haiku::FORMAT_HVIF, opts)) {
+				std::cerr << "Error: " << file << ": "
+					<< haiku::IconConverter::GetLastError() << "\n";
+				return 1;
+			}
+			name = std::filesystem::path(name).replace_extension(".hvif").generic_string();
+			icon = &converted;
+		}
+
+		if (!writer.Add(name, *icon)) {
+			std::cerr << "Error: " << writer.GetLastError() << "\n";
+			return 1;
+		}
+	}
+
+	if (!writer.Write(archive)) {
+		std::cerr << "Error: " << writer.GetLastError() << "\n";
+		return 1;
+	}
+
+	if (opts.verbose) {
+		std::cout << "Packed " << writer.CountIcons() << " icons (" << writer.CountDistinct()
+			<< " distinct) into " << archive << "\n";
+	}
+	return 0;
+}
+
+// Writes all icons of the archive, or the named ones, below a directory.
+// Names that would lead outside of it are refused.
+int Unpack(const std::vector<std::string>& args)
+{
+	haiku::ConvertOptions opts;
+	haiku::IconFormat outputFormat = haiku::FORMAT_AUTO;
+	std::string archivePath;
+	std::string directory;
+	std::vector<std::string> names;
+
+	for (size_t i = 2; i < args.size(); i++) {
+		std::string error;
+		if (args[i] == "-v" || args[i] == "--verbose") {
+			opts.verbose = true;
+		} else if (int parsed = ParseConvertOption(args, i, opts, outputFormat, error)) {
+			if (parsed < 0) {
+				std::cerr << "Error: " << error << "\n";
+				return 1;
+			}
+		} else if (archivePath.empty()) {
+			archivePath = args[i];
+		} else if (directory.empty()) {
+			directory = args[i];
+		} else
+			names.push_back(args[i]);
+	}
+
+	if (archivePath.empty() || directory.empty()) {
+		std::cerr << "Error: unpack needs an archive and a directory\n";
+		return 1;
+	}
+
+	haiku::IconArchive archive;
+	if (!archive.Open(archivePath)) {
+		std::cerr << "Error: " << archive.GetLastError() << "\n";
+		return 1;
+	}
+
+	if (names.empty()) {
+		for (size_t i = 0; i < archive.CountIcons(); i++)
+			names.push_back(archive.NameAt(i));
+	}
+
+	bool convert = outputFormat != haiku::FORMAT_AUTO && outputFormat != haiku::FORMAT_HVIF;
+	std::vector<uint8_t> output;
+	for (size_t i = 0; i < names.size(); i++) {
+		const uint8_t* data;
+		size_t size;
+		if (!archive.Find(names[i], data, size)) {
+			std::cerr << "Error: No icon named " << names[i] << " in " << archivePath << "\n";
+			return 1;
+		}
+
+		std::filesystem::path relative = std::filesystem::path(names[i]).lexically_normal();
+		if (relative.empty() || relative.has_root_path() || *relative.begin() == "..") {
+			std::cerr << "Error: Refusing to write icon named " << names[i] << "\n";
+			return 1;
+		}
+
+		output.assign(data, data + size);
+		if (convert) {
+			std::vector<uint8_t> icon;
+			icon.swap(output);
+			if (!haiku::IconConverter::ConvertBuffer(icon, haiku::FORMAT_HVIF, output,
+					outputFormat, opts)) {
+				std::cerr << "Error: " << names[i] << ": "
+					<< haiku::IconConverter::GetLastError() << "\n";
+				return 1;
+			}
+			relative.replace_extension(ExtensionFor(outputFormat));
+		}
+
+		std::filesystem::path target = std::filesystem::path(directory) / relative;
+		std::error_code code;
+		std::filesystem::create_directories(target.parent_path(), code);
+		if (!WriteOutput(target.string(), output)) {
+			std::cerr << "Error: Failed to write " << target.string() << "\n";
+			return 1;
+		}
+	}
+
+	if (opts.verbose)
+		std::cout << "Unpacked " << names.size() << " icons into " << directory << "\n";
+	return 0;
+}
+
+// One line per icon, or the full summary of each with -v.
+int List(const std::vector<std::string>& args)
+{
+	bool verbose = false;
+	std::string archivePath;
+	for (size_t i = 2; i < args.size(); i++) {
+		if (args[i] == "-v" || args[i] == "--verbose")
+			verbose = true;
+		else if (archivePath.empty())
+			archivePath = args[i];
+		else {
+			std::cerr << "Error: Unknown option: " << args[i] << "\n";
+			return 1;
+		}
+	}
+
+	haiku::IconArchive archive;
+	if (!archive.Open(archivePath)) {
+		std::cerr << "Error: " << archive.GetLastError() << "\n";
+		return 1;
+	}
+
+	int invalid = 0;
+	for (size_t i = 0; i < archive.CountIcons(); i++) {
+		const uint8_t* data;
+		size_t size;
+		archive.DataAt(i, data, size);
+
+		hvif::HVIFSummary summary;
+		if (!hvif::HVIFParser::Scan(data, size, summary))
+			invalid++;
+
+		if (verbose) {
+			std::cout << archive.NameAt(i) << " (" << size << " bytes)\n";
+			PrintSummary(summary, "  ");
+		} else {
+			std::cout << archive.NameAt(i) << "\t" << size << "\t"
+				<< summary.styleCount << "\t" << summary.pathCount << "\t"
+				<< summary.shapeCount << (summary.valid ? "" : "\tinvalid") << "\n";
+		}
+	}
+
+	return invalid > 0 ? 1 : 0;
+}
+
 int main(int argc, char** argv)
 {
 	if (argc < 2) {
 		PrintUsage(argv[0]);
 		return 1;
 	}
-	
+
+	std::vector<std::string> args(argv, argv + argc);
+	if (args[1] == "pack")
+		return Pack(args);
+	if (args[1] == "unpack")
+		return Unpack(args);
+	if (args[1] == "list")
+		return List(args);
+
 	std::string inFile;
 	std::string outFile;
 	haiku::IconFormat outputFormat = haiku::FORMAT_AUTO;
 	bool detectOnly = false;
-	
+	bool serve = false;
+	std::string listenPath;
+	std::string statsFile;
+	TracingStats stats;
+	haiku::PNGWriterStats writeStats;
+	haiku::ConversionCache cache;
+
 	haiku::ConvertOptions opts;
-	
-	for (int i = 1; i < argc; ++i) {
-		std::string arg = argv[i];
-		
+
+	for (size_t i = 1; i < args.size(); ++i) {
+		const std::string& arg = args[i];
+		std::string error;
+
 		if (arg == "-h" || arg == "--help") {
 			PrintUsage(argv[0]);
 			return 0;
 		} else if (arg == "--detect") {
 			detectOnly = true;
-		} else if (arg == "-f" || arg == "--format") {
-			if (i + 1 < argc) {
-				outputFormat = ParseFormatString(argv[++i]);
-			} else {
-				std::cerr << "Error: " << arg << " requires an argument\n";
-				return 1;
-			}
 		} else if (arg == "-v" || arg == "--verbose") {
 			opts.verbose = true;
-		} else if (arg == "--names") {
-			opts.preserveNames = true;
-		} else if (arg == "--width") {
-			if (i + 1 < argc) {
-				opts.svgWidth = std::atoi(argv[++i]);
-				opts.pngWidth = opts.svgWidth;
-				if (opts.svgWidth <= 0) {
-					opts.svgWidth = 64;
-					opts.pngWidth = 64;
-				}
+		} else if (arg == "--serve") {
+			serve = true;
+		} else if (arg == "--listen") {
+			if (i + 1 < args.size()) {
+				listenPath = args[++i];
 			} else {
-				std::cerr << "Error: --width requires an argument\n";
+				std::cerr << "Error: --listen requires an argument\n";
 				return 1;
 			}
-		} else if (arg == "--height") {
-			if (i + 1 < argc) {
-				opts.svgHeight = std::atoi(argv[++i]);
-				opts.pngHeight = opts.svgHeight;
-				if (opts.svgHeight <= 0) {
-					opts.svgHeight = 64;
-					opts.pngHeight = 64;
-				}
+		} else if (arg == "--stats") {
+			if (i + 1 < args.size()) {
+				statsFile = args[++i];
+				opts.pngStats = &stats;
+				opts.pngWriteStats = &writeStats;
 			} else {
-				std::cerr << "Error: --height requires an argument\n";
+				std::cerr << "Error: --stats requires an argument\n";
 				return 1;
 			}
-		} else if (arg == "--scale") {
-			if (i + 1 < argc) {
-				opts.pngScale = static_cast<float>(std::atof(argv[++i]));
-				if (opts.pngScale <= 0.0f) opts.pngScale = 1.0f;
+		} else if (arg == "--cache-dir") {
+			if (i + 1 < args.size()) {
+				cache.SetDirectory(args[++i]);
+				opts.cache = &cache;
 			} else {
-				std::cerr << "Error: --scale requires an argument\n";
+				std::cerr << "Error: --cache-dir requires an argument\n";
 				return 1;
 			}
-		} else if (arg == "--preset") {
-			if (i + 1 < argc) {
-				opts.pngPreset = ParsePresetString(argv[++i]);
-			} else {
-				std::cerr << "Error: --preset requires an argument\n";
+		} else if (int parsed = ParseConvertOption(args, i, opts, outputFormat, error)) {
+			if (parsed < 0) {
+				std::cerr << "Error: " << error << "\n";
 				return 1;
 			}
-		} else if (arg == "--remove-bg") {
-			opts.pngRemoveBackground = true;
-		} else if (arg[0] == '-') {
+		} else if (arg[0] == '-' && arg != "-") {
 			std::cerr << "Error: Unknown option " << arg << "\n";
 			PrintUsage(argv[0]);
 			return 1;
@@ -151,20 +751,63 @@ int main(int argc, char** argv)
 			}
 		}
 	}
-	
+
+	if (serve || !listenPath.empty()) {
+		// Statistics describe a single run; the cache and verbosity carry
+		// over to every request.
+		opts.pngStats = NULL;
+		opts.pngWriteStats = NULL;
+		if (!listenPath.empty()) {
+#ifdef _WIN32
+			std::cerr << "Error: --listen is not supported on this platform\n";
+			return 1;
+#else
+			return Listen(listenPath, opts);
+#endif
+		}
+
+		SetBinaryMode();
+		Serve(stdin, stdout, opts);
+		return 0;
+	}
+
 	if (inFile.empty()) {
 		std::cerr << "Error: No input file specified\n";
 		PrintUsage(argv[0]);
 		return 1;
 	}
-	
+
+	bool streamed = inFile == "-" || outFile == "-";
+	if (streamed)
+		SetBinaryMode();
+
+	std::vector<uint8_t> input;
+	if (inFile == "-" && !ReadInput(inFile, input)) {
+		std::cerr << "Error: Failed to read standard input\n";
+		return 1;
+	}
+
 	if (detectOnly) {
-		haiku::IconFormat detectedFormat = haiku::IconConverter::DetectFormat(inFile);
+		haiku::IconFormat detectedFormat = inFile == "-"
+			? haiku::IconConverter::DetectFormat(input)
+			: haiku::IconConverter::DetectFormat(inFile);
 		std::cout << "File: " << inFile << "\n";
 		std::cout << "Detected format: " << haiku::IconConverter::FormatToString(detectedFormat) << "\n";
-		
-		if (opts.verbose && detectedFormat != haiku::FORMAT_PNG && detectedFormat != haiku::FORMAT_UNKNOWN) {
-			haiku::Icon icon = haiku::IconConverter::Load(inFile, detectedFormat);
+
+		if (opts.verbose && detectedFormat == haiku::FORMAT_HVIF) {
+			std::vector<uint8_t> data;
+			if (inFile == "-")
+				data = input;
+			else
+				ReadInput(inFile, data);
+			hvif::HVIFSummary summary;
+			hvif::HVIFParser::Scan(data.empty() ? NULL : &data[0], data.size(), summary);
+			PrintSummary(summary, "  ");
+		} else if (opts.verbose && detectedFormat != haiku::FORMAT_PNG
+			&& detectedFormat != haiku::FORMAT_UNKNOWN) {
+			haiku::Icon icon = inFile == "-"
+				? haiku::IconConverter::LoadFromBuffer(input, detectedFormat)
+				: haiku::IconConverter::Load(inFile, detectedFormat);
 			if (haiku::IconConverter::GetLastError().empty()) {
 				std::cout << "  Styles: " << icon.styles.size() << "\n";
 				std::cout << "  Paths: " << icon.paths.size() << "\n";
@@ -173,44 +816,97 @@ int main(int argc, char** argv)
 		}
 		return 0;
 	}
-	
+
 	if (outFile.empty()) {
 		std::cerr << "Error: No output file specified\n";
 		PrintUsage(argv[0]);
 		return 1;
 	}
-	
-	if (!haiku::IconConverter::Convert(inFile, outFile, outputFormat, opts)) {
+
+	if (outFile == "-" && outputFormat == haiku::FORMAT_AUTO) {
+		std::cerr << "Error: Writing to standard output needs -f\n";
+		return 1;
+	}
+
+	if (streamed) {
+		haiku::IconFormat inputFormat = haiku::FORMAT_AUTO;
+		if (inFile != "-") {
+			inputFormat = haiku::IconConverter::DetectFormat(inFile);
+			if (!ReadInput(inFile, input)) {
+				std::cerr << "Error: Failed to read " << inFile << "\n";
+				return 1;
+			}
+		}
+
+		if (outputFormat == haiku::FORMAT_AUTO)
+			outputFormat = haiku::IconConverter::DetectFormatByExtension(outFile);
+
+		std::vector<uint8_t> output;
+		if (!haiku::IconConverter::ConvertBuffer(input, inputFormat, output, outputFormat, opts)) {
+			std::cerr << "Error: " << haiku::IconConverter::GetLastError() << std::endl;
+			return 1;
+		}
+
+		if (!WriteOutput(outFile, output)) {
+			std::cerr << "Error: Failed to write " << (outFile == "-" ? "standard output" : outFile) << "\n";
+			return 1;
+		}
+	} else if (!haiku::IconConverter::Convert(inFile, outFile, outputFormat, opts)) {
 		std::cerr << "Error: " << haiku::IconConverter::GetLastError() << std::endl;
 		return 1;
 	}
-	
+
+	if (!statsFile.empty()) {
+		if (cache.Hits() > 0) {
+			std::cerr << "Warning: No statistics, result came from the cache\n";
+		} else if (!stats.Stage(STAGE_STARTING).ran && writeStats.encodedBytes == 0) {
+			std::cerr << "Warning: No statistics, input is not a bitmap and output is not PNG\n";
+		} else {
+			std::ofstream file(statsFile.c_str());
+			bool traced = stats.Stage(STAGE_STARTING).ran;
+			if (!(file << (traced ? stats.ToJson() : writeStats.ToJson()))) {
+				std::cerr << "Error: Failed to write statistics: " << statsFile << "\n";
+				return 1;
+			}
+		}
+	}
+
+	// With the icon on standard output, messages go to standard error.
+	std::ostream& log = outFile == "-" ? std::cerr : std::cout;
+
 	if (opts.verbose) {
-		haiku::Icon icon = haiku::IconConverter::Load(inFile, haiku::FORMAT_AUTO);
-		std::cout << "Conversion successful!\n";
-		std::cout << "  Styles: " << icon.styles.size() << "\n";
-		std::cout << "  Paths: " << icon.paths.size() << "\n";
-		std::cout << "  Shapes: " << icon.shapes.size() << "\n";
-		
-		haiku::IconFormat inputFormat = haiku::IconConverter::DetectFormat(inFile);
+		haiku::Icon icon = inFile == "-"
+			? haiku::IconConverter::LoadFromBuffer(input, haiku::FORMAT_AUTO)
+			: haiku::IconConverter::Load(inFile, haiku::FORMAT_AUTO);
+		log << "Conversion successful!\n";
+		log << "  Styles: " << icon.styles.size() << "\n";
+		log << "  Paths: " << icon.paths.size() << "\n";
+		log << "  Shapes: " << icon.shapes.size() << "\n";
+
+		haiku::IconFormat inputFormat = inFile == "-"
+			? haiku::IconConverter::DetectFormat(input)
+			: haiku::IconConverter::DetectFormat(inFile);
 		if (inputFormat == haiku::FORMAT_PNG) {
-			std::cout << "  PNG preset: ";
+			log << "  PNG preset: ";
 			switch (opts.pngPreset) {
 				case haiku::PRESET_ICON:
-					std::cout << "icon (simple, no gradients)";
+					log << "icon (simple, no gradients)";
 					break;
 				case haiku::PRESET_ICON_GRADIENT:
-					std::cout << "icon-gradient (with gradient support)";
+					log << "icon-gradient (with gradient support)";
 					break;
 			}
-			std::cout << "\n";
+			log << "\n";
 			if (opts.pngRemoveBackground) {
-				std::cout << "  Background removal: enabled\n";
+				log << "  Background removal: enabled\n";
+			}
+			if (opts.pngCubic) {
+				log << "  Curve fitting: cubic\n";
 			}
 		}
-	} else {
+	} else if (outFile != "-") {
 		std::cout << "Successfully converted " << inFile << " to " << outFile << "\n";
 	}
-	
+
 	return 0;
 }
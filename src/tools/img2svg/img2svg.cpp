@@ -6,6 +6,7 @@
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
+#include <fstream>
 
 #include "ImageTracer.h"
 #include "VectorizationProgress.h"
@@ -71,12 +72,14 @@ PrintUsage(const char* programName)
 
 	std::cout << "General options:\n";
 	std::cout << "  --verbose                    Show detailed progress information\n";
+	std::cout << "  --stats <file>               Write per-stage timing and memory statistics as JSON\n";
 	std::cout << "\n";
 
 	std::cout << "Basic tracing parameters:\n";
 	std::cout << "  --ltres <value>              Line threshold (default: " << defaults.fLineThreshold << ")\n";
 	std::cout << "  --pathomit <value>           Path omit threshold (default: " << defaults.fPathOmitThreshold << ")\n";
 	std::cout << "  --qtres <value>              Quadratic threshold (default: " << defaults.fQuadraticThreshold << ")\n";
+	std::cout << "  --cubic <value>              Fit cubic curves (0=off, 1=on, default: " << (int)defaults.fCubicFitting << ")\n";
 	std::cout << "\n";
 
 	std::cout << "Color quantization:\n";
@@ -96,6 +99,12 @@ PrintUsage(const char* programName)
 	std::cout << "  --bg_ratio <value>           Minimum background ratio (default: " << defaults.fMinBackgroundRatio << ")\n";
 	std::cout << "\n";
 
+	std::cout << "Large images:\n";
+	std::cout << "  --trace_size <value>         Trace at most this many pixels across (0=full size, default: " << defaults.fMaxTraceSize << ")\n";
+	std::cout << "  --tile_size <value>          Trace in tiles of this many pixels (0=off, default: " << defaults.fTileSize << ")\n";
+	std::cout << "  --time_budget <ms>           Finish with cheaper settings after this long (0=no limit, default: " << defaults.fTimeBudgetMs << ")\n";
+	std::cout << "\n";
+
 	std::cout << "Path simplification:\n";
 	std::cout << "  --aggressive_simplify <value> Aggressive path simplification (0=off, 1=on, default: " << (int)defaults.fAggressiveSimplification << ")\n";
 	std::cout << "  --collinear_tolerance <value> Tolerance for merging collinear segments (default: " << defaults.fCollinearTolerance << ")\n";
@@ -258,10 +267,7 @@ LoadBitmapData(const std::string& filename)
 		return BitmapData();
 	}
 
-	std::vector<unsigned char> bitmapData(data, data + (width * height * 4));
-	stbi_image_free(data);
-
-	return BitmapData(width, height, bitmapData);
+	return BitmapData::Adopt(width, height, data, stbi_image_free);
 }
 #endif
 
@@ -290,17 +296,22 @@ main(int argc, char* argv[])
 
 	TracingOptions options;
 	bool verboseProgress = false;
+	std::string statsFile;
 
 	for (int i = 3; i < argc; i++) {
 		if (strcmp(argv[i], "--verbose") == 0) {
 			verboseProgress = true;
 		} else if (i + 1 < argc) {
-			if (strcmp(argv[i], "--ltres") == 0) {
+			if (strcmp(argv[i], "--stats") == 0) {
+				statsFile = argv[++i];
+			} else if (strcmp(argv[i], "--ltres") == 0) {
 				options.fLineThreshold = ParseFloat(argv[++i]);
 			} else if (strcmp(argv[i], "--qtres") == 0) {
 				options.fQuadraticThreshold = ParseFloat(argv[++i]);
 			} else if (strcmp(argv[i], "--pathomit") == 0) {
 				options.fPathOmitThreshold = ParseFloat(argv[++i]);
+			} else if (strcmp(argv[i], "--cubic") == 0) {
+				options.fCubicFitting = ParseFloat(argv[++i]) > 0.5f;
 			} else if (strcmp(argv[i], "--colors") == 0) {
 				options.fNumberOfColors = ParseFloat(argv[++i]);
 			} else if (strcmp(argv[i], "--colorquantcycles") == 0) {
@@ -332,6 +343,12 @@ main(int argc, char* argv[])
 				options.fBackgroundTolerance = (int)ParseFloat(argv[++i]);
 			} else if (strcmp(argv[i], "--bg_ratio") == 0) {
 				options.fMinBackgroundRatio = ParseFloat(argv[++i]);
+			} else if (strcmp(argv[i], "--trace_size") == 0) {
+				options.fMaxTraceSize = (int)ParseFloat(argv[++i]);
+			} else if (strcmp(argv[i], "--tile_size") == 0) {
+				options.fTileSize = (int)ParseFloat(argv[++i]);
+			} else if (strcmp(argv[i], "--time_budget") == 0) {
+				options.fTimeBudgetMs = (int)ParseFloat(argv[++i]);
 			} else if (strcmp(argv[i], "--douglas") == 0) {
 				options.fDouglasPeuckerEnabled = ParseFloat(argv[++i]) > 0.5f;
 			} else if (strcmp(argv[i], "--douglas_tolerance") == 0) {
@@ -407,14 +424,26 @@ main(int argc, char* argv[])
 		}
 
 		ImageTracer tracer;
-		std::string svgData = tracer.BitmapToSvg(bitmap, options);
+		TracingStats stats;
+		std::string svgData = tracer.BitmapToSvg(bitmap, options, &stats);
 
 		if (!tracer.SaveSvg(outputFile, svgData)) {
 			std::cerr << "Error: Failed to save SVG file: " << outputFile << std::endl;
 			return 1;
 		}
 
+		if (!statsFile.empty()) {
+			std::ofstream file(statsFile.c_str());
+			if (!(file << stats.ToJson())) {
+				std::cerr << "Error: Failed to write statistics: " << statsFile << std::endl;
+				return 1;
+			}
+		}
+
 		std::cout << "Conversion completed successfully!" << std::endl;
+		if (tracer.WasOverBudget()) {
+			std::cout << "Time budget exceeded, finished with fallback settings" << std::endl;
+		}
 		if (options.fRemoveBackground) {
 			std::cout << "Background removal applied using method " << (int)options.fBackgroundMethod << std::endl;
 		}
@@ -6,10 +6,12 @@
 #include <climits>
 
 #include "BitmapData.h"
+#include "MathUtils.h"
 
 BitmapData::BitmapData()
 	: fWidth(0)
 	, fHeight(0)
+	, fBorrowedBits(NULL)
 {
 }
 
@@ -17,33 +19,114 @@ BitmapData::BitmapData(int width, int height, const std::vector<unsigned char>&
 	: fWidth(width)
 	, fHeight(height)
 	, fData(data)
+	, fBorrowedBits(NULL)
 {
-	if (fWidth < 0 || fHeight < 0) {
-		fWidth = 0;
-		fHeight = 0;
-		fData.clear();
+	if (!_CheckSize())
 		return;
-	}
 
-	if (fWidth > 0 && fHeight > INT_MAX / fWidth) {
-		fWidth = 0;
-		fHeight = 0;
-		fData.clear();
+	size_t requiredSize = static_cast<size_t>(fWidth * fHeight) * 4;
+
+	if (fData.size() != requiredSize)
+		fData.resize(requiredSize, 0);
+}
+
+BitmapData::BitmapData(int width, int height, const unsigned char* bits)
+	: fWidth(width)
+	, fHeight(height)
+	, fBorrowedBits(NULL)
+{
+	if (!_CheckSize() || bits == NULL)
 		return;
-	}
 
-	int pixelCount = fWidth * fHeight;
-	if (pixelCount > INT_MAX / 4) {
+	fData.assign(bits, bits + static_cast<size_t>(fWidth * fHeight) * 4);
+}
+
+BitmapData
+BitmapData::Borrow(int width, int height, const unsigned char* bits)
+{
+	BitmapData bitmap;
+	bitmap.fWidth = width;
+	bitmap.fHeight = height;
+	if (bitmap._CheckSize() && bits != NULL)
+		bitmap.fBorrowedBits = bits;
+	return bitmap;
+}
+
+BitmapData
+BitmapData::Borrow(const BitmapData& bitmap)
+{
+	return Borrow(bitmap.Width(), bitmap.Height(), bitmap.Bits());
+}
+
+BitmapData
+BitmapData::Adopt(int width, int height, unsigned char* bits, PixelDeleter deleter)
+{
+	BitmapData bitmap;
+	if (bits == NULL)
+		return bitmap;
+
+	bitmap.fAdoptedBits.reset(bits, deleter);
+	bitmap.fWidth = width;
+	bitmap.fHeight = height;
+	bitmap._CheckSize();
+	return bitmap;
+}
+
+bool
+BitmapData::_CheckSize()
+{
+	if (fWidth < 0 || fHeight < 0
+		|| (fWidth > 0 && fHeight > INT_MAX / fWidth)
+		|| fWidth * fHeight > INT_MAX / 4) {
 		fWidth = 0;
 		fHeight = 0;
 		fData.clear();
-		return;
+		fAdoptedBits.reset();
+		return false;
 	}
 
-	size_t requiredSize = static_cast<size_t>(pixelCount) * 4;
+	return true;
+}
 
-	if (fData.size() != requiredSize)
-		fData.resize(requiredSize, 0);
+const unsigned char*
+BitmapData::Bits() const
+{
+	if (fBorrowedBits != NULL)
+		return fBorrowedBits;
+	if (fAdoptedBits)
+		return fAdoptedBits.get();
+	return fData.empty() ? NULL : &fData[0];
+}
+
+const std::vector<unsigned char>&
+BitmapData::Data() const
+{
+	static const std::vector<unsigned char> kNoData;
+
+	if (fBorrowedBits != NULL || fAdoptedBits)
+		return kNoData;
+	return fData;
+}
+
+unsigned char*
+BitmapData::MutableBits()
+{
+	if (fBorrowedBits != NULL)
+		return NULL;
+
+	if (fAdoptedBits) {
+		if (fAdoptedBits.use_count() == 1)
+			return fAdoptedBits.get();
+
+		// Shared with a copy: write to pixels of our own instead.
+		const unsigned char* bits = fAdoptedBits.get();
+		fData.assign(bits, bits + static_cast<size_t>(fWidth * fHeight) * 4);
+		fAdoptedBits.reset();
+	}
+
+	if (fData.empty())
+		return NULL;
+	return &fData[0];
 }
 
 bool
@@ -61,6 +144,9 @@ BitmapData::IsValid() const
 
 	size_t requiredSize = static_cast<size_t>(pixelCount) * 4;
 
+	if (fBorrowedBits != NULL || fAdoptedBits)
+		return true;
+
 	return fData.size() == requiredSize;
 }
 
@@ -70,11 +156,11 @@ BitmapData::GetPixelComponent(int x, int y, int component) const
 	if (x < 0 || x >= fWidth || y < 0 || y >= fHeight || component < 0 || component > 3)
 		return 0;
 
-	int index = (y * fWidth + x) * 4 + component;
-	if (index >= static_cast<int>(fData.size()))
+	const unsigned char* bits = Bits();
+	if (bits == NULL)
 		return 0;
 
-	return fData[index];
+	return bits[(y * fWidth + x) * 4 + component];
 }
 
 void
@@ -83,9 +169,41 @@ BitmapData::SetPixelComponent(int x, int y, int component, unsigned char value)
 	if (x < 0 || x >= fWidth || y < 0 || y >= fHeight || component < 0 || component > 3)
 		return;
 
-	int index = (y * fWidth + x) * 4 + component;
-	if (index >= static_cast<int>(fData.size()))
+	unsigned char* bits = MutableBits();
+	if (bits == NULL)
 		return;
 
-	fData[index] = value;
+	bits[(y * fWidth + x) * 4 + component] = value;
+}
+
+PackedPixelView::PackedPixelView(const BitmapData& bitmap, int transparentValue)
+	: fWidth(bitmap.Width())
+	, fHeight(bitmap.Height())
+	, fBits(bitmap.Bits())
+	, fRows(NULL)
+	, fTransparentValue(transparentValue)
+{
+}
+
+PackedPixelView::PackedPixelView(const std::vector<std::vector<int> >& rows)
+	: fWidth(rows.empty() ? 0 : (int)rows[0].size())
+	, fHeight((int)rows.size())
+	, fBits(NULL)
+	, fRows(&rows)
+	, fTransparentValue(0)
+{
+}
+
+int
+PackedPixelView::Pixel(int x, int y) const
+{
+	if (fRows != NULL)
+		return (*fRows)[y][x];
+
+	const unsigned char* p = fBits + ((size_t)y * fWidth + x) * 4;
+	if (MathUtils::IsTransparent(p[3]))
+		return fTransparentValue;
+
+	return (int)(((unsigned int)p[3] << 24) | ((unsigned int)p[0] << 16)
+		| ((unsigned int)p[1] << 8) | p[2]);
 }
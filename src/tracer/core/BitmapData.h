@@ -6,26 +6,80 @@
 #ifndef BITMAP_DATA_H
 #define BITMAP_DATA_H
 
+#include <cstddef>
+#include <memory>
 #include <vector>
 
+// RGBA pixels, either owned, adopted or borrowed. A borrowed bitmap (see
+// Borrow()) only points at pixels kept alive by someone else and is
+// read-only; copying it copies the pointer, not the pixels. An adopted
+// bitmap (see Adopt()) owns a buffer allocated elsewhere and frees it with
+// the given deleter; copies share the buffer until one of them asks for
+// MutableBits(), which then gets pixels of its own.
 class BitmapData {
 public:
+	typedef void			(*PixelDeleter)(void* bits);
+
 							BitmapData();
 							BitmapData(int width, int height, 
 									const std::vector<unsigned char>& data);
+							BitmapData(int width, int height,
+									const unsigned char* bits);
+
+	static BitmapData		Borrow(int width, int height,
+									const unsigned char* bits);
+	static BitmapData		Borrow(const BitmapData& bitmap);
+
+	// Takes ownership of width * height * 4 bytes at bits, like the buffer
+	// an image decoder returns; deleter is called on them once no bitmap
+	// uses them any more, even if the size is rejected.
+	static BitmapData		Adopt(int width, int height, unsigned char* bits,
+									PixelDeleter deleter);
 
 	int						Width() const { return fWidth; }
 	int						Height() const { return fHeight; }
-	const std::vector<unsigned char>& Data() const { return fData; }
+
+	const unsigned char*	Bits() const;
+	// Deprecated, use Bits(). Only an owned bitmap has a vector to return;
+	// borrowed and adopted bitmaps return an empty one.
+	const std::vector<unsigned char>& Data() const;
+	unsigned char*			MutableBits();
+	bool					IsBorrowed() const { return fBorrowedBits != NULL; }
 
 	bool					IsValid() const;
 	unsigned char			GetPixelComponent(int x, int y, int component) const;
 	void					SetPixelComponent(int x, int y, int component, unsigned char value);
 
 private:
+	bool					_CheckSize();
+
 	int						fWidth;
 	int						fHeight;
 	std::vector<unsigned char> fData;
+	std::shared_ptr<unsigned char> fAdoptedBits;
+	const unsigned char*	fBorrowedBits;
+};
+
+// Read-only view of pixels packed as 0xAARRGGBB. Over a bitmap nothing is
+// copied; pixels are packed as they are read and transparent ones read as
+// the given value.
+class PackedPixelView {
+public:
+							PackedPixelView(const BitmapData& bitmap,
+									int transparentValue);
+							PackedPixelView(const std::vector<std::vector<int> >& rows);
+
+	int						Width() const { return fWidth; }
+	int						Height() const { return fHeight; }
+
+	int						Pixel(int x, int y) const;
+
+private:
+	int						fWidth;
+	int						fHeight;
+	const unsigned char*	fBits;
+	const std::vector<std::vector<int> >* fRows;
+	int						fTransparentValue;
 };
 
 #endif
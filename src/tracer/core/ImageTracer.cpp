@@ -7,6 +7,8 @@
 #include <fstream>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "ImageTracer.h"
 #include "ColorQuantizer.h"
@@ -19,10 +21,13 @@
 #include "BackgroundRemover.h"
 #include "VisvalingamWhyatt.h"
 #include "GradientDetector.h"
+#include "ImagePyramid.h"
 #include "RegionMerger.h"
 #include "MathUtils.h"
+#include "ParallelUtils.h"
 #include "PathHierarchy.h"
 #include "SharedEdgeRegistry.h"
+#include "TileSeams.h"
 #include "VectorizationProgress.h"
 
 static void
@@ -33,7 +38,17 @@ _ReportProgress(const TracingOptions& options, int stage, int percent)
 	}
 }
 
+static void
+_BeginStage(const TracingOptions& options, TracingStats* stats, int stage, int percent)
+{
+	if (stats != NULL)
+		stats->BeginStage(stage);
+	_ReportProgress(options, stage, percent);
+}
+
 ImageTracer::ImageTracer()
+	: fCancelled(false)
+	, fOverBudget(false)
 {
 }
 
@@ -42,158 +57,490 @@ ImageTracer::~ImageTracer()
 }
 
 std::string
-ImageTracer::BitmapToSvg(const BitmapData& bitmap, const TracingOptions& options)
+ImageTracer::BitmapToSvg(const BitmapData& bitmap, const TracingOptions& options,
+	TracingStats* stats)
 {
-	IndexedBitmap indexedBitmap = BitmapToTraceData(bitmap, options);
+	IndexedBitmap indexedBitmap = BitmapToTraceData(bitmap, options, stats);
+	if (fCancelled)
+		return std::string();
+
+	// Paths traced at a reduced working resolution are scaled back up to
+	// the size of the input.
+	TracingOptions outputOptions = options;
+	int longest = std::max(indexedBitmap.Width(), indexedBitmap.Height());
+	if (longest > 0 && longest < std::max(bitmap.Width(), bitmap.Height()))
+		outputOptions.fScale *= (float)std::max(bitmap.Width(), bitmap.Height()) / longest;
+
 	SvgWriter svgWriter;
-	std::string svgString = svgWriter.GenerateSvg(indexedBitmap, options);
+	std::string svgString = svgWriter.GenerateSvg(indexedBitmap, outputOptions);
 
 	if (options.fOptimizeSvg) {
-		svgString = svgWriter.OptimizeSvgString(svgString, options);
+		svgString = svgWriter.OptimizeSvgString(svgString, outputOptions);
 	}
 
 	return svgString;
 }
 
 IndexedBitmap
-ImageTracer::BitmapToTraceData(const BitmapData& bitmap, const TracingOptions& options)
+ImageTracer::BitmapToTraceData(const BitmapData& bitmap, const TracingOptions& options,
+	TracingStats* stats)
 {
-	_ReportProgress(options, STAGE_STARTING, 0);
-
-	BitmapData processedBitmap = bitmap;
+	if (stats != NULL) {
+		stats->Reset();
+		stats->fInputWidth = bitmap.Width();
+		stats->fInputHeight = bitmap.Height();
+	}
 
-	if (options.fRemoveBackground) {
-		_ReportProgress(options, STAGE_REMOVE_BACKGROUND, 5);
+	// The stages read a private copy of the options, so a run that goes
+	// over its time budget can switch the rest of them to the fallback.
+	TracingOptions current = options;
+	fCancelled = false;
+	fOverBudget = false;
+	fDeadline = std::chrono::steady_clock::now()
+		+ std::chrono::milliseconds(std::max(options.fTimeBudgetMs, 0));
+
+	_BeginStage(current, stats, STAGE_STARTING, 0);
+
+	// Stages that change pixels share one private copy of the input and
+	// work on it in place; without them the caller's pixels are only read.
+	// Everything after this is done at the working resolution.
+	BitmapData processedBitmap = BitmapData::Borrow(bitmap);
+	if (current.fMaxTraceSize > 0
+		&& std::max(bitmap.Width(), bitmap.Height()) > current.fMaxTraceSize) {
+		ImagePyramid pyramid;
+		processedBitmap = pyramid.Reduce(bitmap, current.fMaxTraceSize);
+	} else if (current.fRemoveBackground || current.fBlurRadius >= 1.0f)
+		processedBitmap = BitmapData(bitmap.Width(), bitmap.Height(), bitmap.Bits());
+
+	if (current.fRemoveBackground) {
+		if (!_Checkpoint(current, stats))
+			return IndexedBitmap();
+		_BeginStage(current, stats, STAGE_REMOVE_BACKGROUND, 5);
 		BackgroundRemover remover;
-		remover.SetColorTolerance(options.fBackgroundTolerance);
-		remover.SetMinBackgroundRatio(options.fMinBackgroundRatio);
-		processedBitmap = remover.RemoveBackground(processedBitmap,
-												  options.fBackgroundMethod,
-												  options.fBackgroundTolerance);
+		remover.SetColorTolerance(current.fBackgroundTolerance);
+		remover.SetMinBackgroundRatio(current.fMinBackgroundRatio);
+		remover.RemoveBackgroundInPlace(processedBitmap,
+										current.fBackgroundMethod,
+										current.fBackgroundTolerance);
 	}
 
-	if (options.fBlurRadius > 0) {
-		_ReportProgress(options, STAGE_BLUR, 10);
+	if (current.fBlurRadius > 0) {
+		if (!_Checkpoint(current, stats))
+			return IndexedBitmap();
+		_BeginStage(current, stats, STAGE_BLUR, 10);
 		SelectiveBlur blur;
-		processedBitmap = blur.BlurBitmap(processedBitmap,
-										options.fBlurRadius,
-										options.fBlurDelta);
+		blur.BlurBitmapInPlace(processedBitmap,
+							current.fBlurRadius,
+							current.fBlurDelta);
 	}
 
-	_ReportProgress(options, STAGE_CREATE_PALETTE, 15);
+	if (stats != NULL) {
+		stats->fWorkingWidth = processedBitmap.Width();
+		stats->fWorkingHeight = processedBitmap.Height();
+	}
+
+	if (!_Checkpoint(current, stats))
+		return IndexedBitmap();
+	_BeginStage(current, stats, STAGE_CREATE_PALETTE, 15);
 	std::vector<std::vector<unsigned char> > palette =
-		_CreatePalette(processedBitmap, static_cast<int>(options.fNumberOfColors), options);
+		_CreatePalette(processedBitmap, static_cast<int>(current.fNumberOfColors), current);
 
-	_ReportProgress(options, STAGE_QUANTIZE_COLORS, 25);
+	if (!_Checkpoint(current, stats))
+		return IndexedBitmap();
+	_BeginStage(current, stats, STAGE_QUANTIZE_COLORS, 25);
 	ColorQuantizer quantizer;
-	IndexedBitmap indexedBitmap = quantizer.QuantizeColors(processedBitmap, palette, options);
-
-	if (options.fDetectGradients) {
-		_ReportProgress(options, STAGE_MERGE_REGIONS, 30);
+	IndexedBitmap indexedBitmap = quantizer.QuantizeColors(processedBitmap, palette, current);
+	if (stats != NULL)
+		stats->fPaletteSize = (int)indexedBitmap.Palette().size();
+
+	if (!_Checkpoint(current, stats))
+		return IndexedBitmap();
+	if (current.fDetectGradients) {
+		_BeginStage(current, stats, STAGE_MERGE_REGIONS, 30);
 		RegionMerger merger;
-		indexedBitmap = merger.MergeRegions(indexedBitmap, processedBitmap, options);
+		indexedBitmap = merger.MergeRegions(indexedBitmap, processedBitmap, current);
+		if (!_Checkpoint(current, stats))
+			return IndexedBitmap();
+	}
+
+	TracedLayers layers;
+	if (current.fTileSize > 0 && (indexedBitmap.Width() > current.fTileSize
+			|| indexedBitmap.Height() > current.fTileSize)) {
+		layers = _TraceTiles(indexedBitmap, current, stats);
+	} else
+		layers = _TraceLayers(indexedBitmap, current, stats, NULL);
+
+	if (!_Checkpoint(current, stats))
+		return IndexedBitmap();
+	_BeginStage(current, stats, STAGE_UNIFY_EDGES, 80);
+	SharedEdgeRegistry registry(16.0);
+	registry.RegisterPaths(layers, indexedBitmap);
+	registry.UnifyCoordinates(0.15);
+	registry.UpdatePaths(layers);
+	if (stats != NULL) {
+		stats->fRegistryPoints = (int)registry.PointCount();
+		stats->SetPathCounts(STAGE_UNIFY_EDGES, layers);
+	}
+
+	indexedBitmap.SetLayers(layers);
+
+	if (!_Checkpoint(current, stats))
+		return IndexedBitmap();
+	_BeginStage(current, stats, STAGE_FIX_WINDING, 85);
+	PathHierarchy hierarchy;
+	hierarchy.AnalyzeHierarchy(indexedBitmap);
+
+	_FixWindingOrder(indexedBitmap);
+
+	if (!_Checkpoint(current, stats))
+		return IndexedBitmap();
+	if (current.fDetectGradients) {
+		_BeginStage(current, stats, STAGE_DETECT_GRADIENTS, 90);
+		GradientDetector grad;
+		std::vector<std::vector<IndexedBitmap::LinearGradient> > grads =
+			grad.DetectLinearGradients(indexedBitmap, processedBitmap, layers, current);
+		indexedBitmap.SetLinearGradients(grads);
 	}
 
-	_ReportProgress(options, STAGE_SCAN_PATHS, 35);
+	_ReportProgress(current, STAGE_COMPLETE, 100);
+	if (stats != NULL)
+		stats->Finish();
+
+	return indexedBitmap;
+}
+
+static void
+_CountInternodes(TracingStats* stats, int stage,
+	const std::vector<std::vector<std::vector<std::vector<double> > > >& internodes)
+{
+	if (stats == NULL)
+		return;
+
+	int paths = 0;
+	int points = 0;
+	for (size_t k = 0; k < internodes.size(); k++) {
+		for (size_t i = 0; i < internodes[k].size(); i++) {
+			if (internodes[k][i].empty())
+				continue;
+			paths++;
+			points += (int)internodes[k][i].size();
+		}
+	}
+
+	stats->SetPathCounts(stage, paths, points);
+}
+
+// Whether a path comes within a pixel of a seam, in which case it is only
+// a piece of an outline cut by the tile.
+static bool
+_TouchesSeam(const std::vector<std::vector<double> >& path, const TileSeams& seams)
+{
+	for (size_t j = 0; j < path.size(); j++) {
+		const std::vector<double>& seg = path[j];
+		for (size_t c = 1; c + 1 < seg.size(); c += 2) {
+			if (seg[0] == 1.0 && c > 3)
+				break;
+			if (seg[c] <= seams.Left() + 1.0 || seg[c] >= seams.Right() - 1.0
+				|| seg[c + 1] <= seams.Top() + 1.0 || seg[c + 1] >= seams.Bottom() - 1.0)
+				return true;
+		}
+	}
+	return false;
+}
+
+// Direction code of a step between internodes, numbered as PathScanner
+// does: east is 0, counting clockwise, and 8 for no step at all.
+static double
+_Direction(const std::vector<double>& from, const std::vector<double>& to)
+{
+	static const double kDirections[3][3] = {
+		{ 5, 4, 3 },
+		{ 6, 8, 2 },
+		{ 7, 0, 1 }
+	};
+	int dx = to[0] > from[0] ? 2 : (to[0] < from[0] ? 0 : 1);
+	int dy = to[1] > from[1] ? 2 : (to[1] < from[1] ? 0 : 1);
+	return kDirections[dx][dy];
+}
+
+// Internodes cut the corner where an outline turns off a seam onto a row
+// or column of pixel edges, one of them on the seam and the next one
+// diagonally off it. The outline on the other side of the seam goes
+// through the corner instead, so it is put back on both sides.
+static void
+_AddSeamCorners(std::vector<std::vector<std::vector<std::vector<double> > > >& layers,
+	const TileSeams& seams)
+{
+	std::vector<std::vector<double> > cornered;
+	for (size_t k = 0; k < layers.size(); k++) {
+		for (size_t i = 0; i < layers[k].size(); i++) {
+			std::vector<std::vector<double> >& path = layers[k][i];
+			if (!seams.Touches(path))
+				continue;
+
+			cornered.clear();
+			for (size_t j = 0; j < path.size(); j++) {
+				const std::vector<double>& point = path[j];
+				const std::vector<double>& next = path[(j + 1) % path.size()];
+				cornered.push_back(point);
+				if (std::fabs(next[0] - point[0]) != 1.0
+					|| std::fabs(next[1] - point[1]) != 1.0) {
+					continue;
+				}
+
+				std::vector<double> corner(point);
+				if (seams.OnVertical(point[0]) || seams.OnHorizontal(next[1]))
+					corner[1] = next[1];
+				else if (seams.OnVertical(next[0]) || seams.OnHorizontal(point[1]))
+					corner[0] = next[0];
+				else
+					continue;
+
+				cornered.back()[2] = _Direction(point, corner);
+				corner[2] = _Direction(corner, next);
+				cornered.push_back(corner);
+			}
+			path.swap(cornered);
+		}
+	}
+}
+
+ImageTracer::TracedLayers
+ImageTracer::_TraceLayers(const IndexedBitmap& indexed, const TracingOptions& options,
+	TracingStats* stats, const TileSeams* seams)
+{
+	_BeginStage(options, stats, STAGE_SCAN_PATHS, 35);
 	PathScanner pathScanner;
 	std::vector<std::vector<std::vector<int> > > rawLayers =
-		pathScanner.CreateLayers(indexedBitmap);
+		pathScanner.CreateLayers(indexed);
 
 	std::vector<std::vector<std::vector<std::vector<int> > > > batchPaths =
 		pathScanner.ScanLayerPaths(rawLayers, options);
 
+	if (options.IsCancelled())
+		return TracedLayers();
+
 	std::vector<std::vector<std::vector<std::vector<double> > > > batchInternodes =
 		pathScanner.CreateInternodes(batchPaths);
+	if (seams != NULL)
+		_AddSeamCorners(batchInternodes, *seams);
+	_CountInternodes(stats, STAGE_SCAN_PATHS, batchInternodes);
 
 	if (options.fVisvalingamWhyattEnabled) {
-		_ReportProgress(options, STAGE_SIMPLIFY_VW, 45);
+		_BeginStage(options, stats, STAGE_SIMPLIFY_VW, 45);
 		VisvalingamWhyatt vw;
-		batchInternodes = vw.BatchSimplifyLayerInternodes(batchInternodes, options.fVisvalingamWhyattTolerance);
+		if (seams != NULL) {
+			std::vector<bool> pinned;
+			for (size_t k = 0; k < batchInternodes.size(); k++) {
+				for (size_t i = 0; i < batchInternodes[k].size(); i++) {
+					std::vector<std::vector<double> >& path = batchInternodes[k][i];
+					pinned.assign(path.size(), false);
+					for (size_t j = 0; j < path.size(); j++)
+						pinned[j] = seams->Contains(path[j]);
+					path = vw.SimplifyPath(path, options.fVisvalingamWhyattTolerance, &pinned);
+				}
+			}
+		} else {
+			batchInternodes = vw.BatchSimplifyLayerInternodes(batchInternodes,
+				options.fVisvalingamWhyattTolerance);
+		}
+		_CountInternodes(stats, STAGE_SIMPLIFY_VW, batchInternodes);
 	}
 
-	_ReportProgress(options, STAGE_TRACE_PATHS, 50);
+	_BeginStage(options, stats, STAGE_TRACE_PATHS, 50);
 	PathTracer tracer;
-	std::vector<std::vector<std::vector<std::vector<double> > > > layers(batchInternodes.size());
+	tracer.SetCubicFitting(options.fCubicFitting);
+	tracer.SetSeams(seams);
+	TracedLayers layers(batchInternodes.size());
 	for (int k = 0; k < static_cast<int>(batchInternodes.size()); k++) {
+		if (options.IsCancelled())
+			return TracedLayers();
 		layers[k] = tracer.BatchTracePaths(batchInternodes[k],
 										  options.fLineThreshold,
 										  options.fQuadraticThreshold);
 	}
+	if (stats != NULL)
+		stats->SetPathCounts(STAGE_TRACE_PATHS, layers);
+
+	if (options.fFilterSmallObjects) {
+		_BeginStage(options, stats, STAGE_FILTER_SMALL, 60);
+		PathSimplifier simplifier;
+		simplifier.SetSeams(seams);
+		layers = simplifier.BatchFilterSmallObjects(layers, options);
+		if (stats != NULL)
+			stats->SetPathCounts(STAGE_FILTER_SMALL, layers);
+	}
 
-	bool needSimplification = options.fFilterSmallObjects ||
-							   options.fDouglasPeuckerEnabled ||
-							   options.fCollinearTolerance > 0 ||
-							   options.fMinSegmentLength > 0 ||
-							   options.fCurveSmoothing > 0;
-
-	SharedEdgeRegistry* masterRegistry = NULL;
+	if (options.fDouglasPeuckerEnabled) {
+		_BeginStage(options, stats, STAGE_SIMPLIFY_DP, 65);
+		PathSimplifier simplifier;
+		simplifier.SetSeams(seams);
+		layers = simplifier.BatchLayerDouglasPeucker(layers, options);
+		if (stats != NULL)
+			stats->SetPathCounts(STAGE_SIMPLIFY_DP, layers);
+	}
 
-	try {
-		masterRegistry = new SharedEdgeRegistry(16.0);
+	// The shape refinements below are left out once the time budget is
+	// spent; the caller switches to the fallback at its next checkpoint.
+	if (options.IsCancelled() || _OutOfTime(options))
+		return layers;
+
+	if (options.fCollinearTolerance > 0 ||
+		options.fMinSegmentLength > 0 ||
+		options.fCurveSmoothing > 0) {
+
+		_BeginStage(options, stats, STAGE_SIMPLIFY_ADVANCED, 70);
+		SharedEdgeRegistry registry(16.0);
+		registry.RegisterPaths(layers, indexed);
+		registry.UnifyCoordinates(0.25);
+
+		PathSimplifier simplifier;
+		simplifier.SetSeams(seams);
+		layers = simplifier.BatchTracePathsWithSimplification(layers, options, &registry);
+		if (stats != NULL)
+			stats->SetPathCounts(STAGE_SIMPLIFY_ADVANCED, layers);
+	}
 
-		if (needSimplification) {
-			if (options.fFilterSmallObjects) {
-				_ReportProgress(options, STAGE_FILTER_SMALL, 60);
-				PathSimplifier simplifier;
-				layers = simplifier.BatchFilterSmallObjects(layers, options);
-			}
+	if (options.fDetectGeometry) {
+		_BeginStage(options, stats, STAGE_DETECT_GEOMETRY, 75);
+		GeometryDetector detector;
+		layers = detector.BatchLayerGeometryDetection(layers, options);
+		if (stats != NULL)
+			stats->SetPathCounts(STAGE_DETECT_GEOMETRY, layers);
+	}
 
-			if (options.fDouglasPeuckerEnabled) {
-				_ReportProgress(options, STAGE_SIMPLIFY_DP, 65);
-				PathSimplifier simplifier;
-				layers = simplifier.BatchLayerDouglasPeucker(layers, options);
-			}
+	return layers;
+}
 
-			if (options.fCollinearTolerance > 0 ||
-				options.fMinSegmentLength > 0 ||
-				options.fCurveSmoothing > 0) {
+ImageTracer::TracedLayers
+ImageTracer::_TraceTiles(const IndexedBitmap& indexed, const TracingOptions& options,
+	TracingStats* stats)
+{
+	// Every tile is cut from the shared index array with a transparent
+	// border, so regions are closed off at the tile edges exactly as at
+	// the image edges. Only the edge-code grids and paths of the tiles in
+	// flight are held at once. The pieces of a region that crosses a seam
+	// meet on the seam, where no stage moves their points (see TileSeams),
+	// and have their points unified with the rest of the image afterwards.
+	const int tileSize = std::max(options.fTileSize, 16);
+	const int width = indexed.Width();
+	const int height = indexed.Height();
+	const int columns = (width + tileSize - 1) / tileSize;
+	const int rows = (height + tileSize - 1) / tileSize;
+	const int tileCount = columns * rows;
+
+	const std::vector<std::vector<int> >& array = indexed.Array();
+	const std::vector<std::vector<unsigned char> >& palette = indexed.Palette();
+
+	// Tiles do not check the time budget themselves, so that all of them
+	// are traced with the same settings and still meet at the seams.
+	// Geometry detection needs whole outlines and runs once all tiles are
+	// in.
+	TracingOptions tileOptions = options;
+	tileOptions.fProgressCallback = NULL;
+	tileOptions.fTimeBudgetMs = 0;
+	tileOptions.fDetectGeometry = false;
+
+	_BeginStage(options, stats, STAGE_SCAN_PATHS, 35);
+	MathUtils::Init();
+
+	std::vector<TracedLayers> tiles(tileCount);
+	std::vector<std::vector<std::vector<bool> > > seamPaths(tileCount);
+	std::atomic<int> nextTile(0);
+	int numWorkers = (int)std::thread::hardware_concurrency();
+	if (numWorkers < 1) numWorkers = 1;
+	if (numWorkers > tileCount) numWorkers = tileCount;
+
+	ParallelUtils::ParallelFor(0, numWorkers, [&](int) {
+		for (int t = nextTile++; t < tileCount; t = nextTile++) {
+			if (tileOptions.IsCancelled())
+				break;
 
-				_ReportProgress(options, STAGE_SIMPLIFY_ADVANCED, 70);
-				masterRegistry->RegisterPaths(layers, indexedBitmap);
-				masterRegistry->UnifyCoordinates(0.25);
+			int originX = (t % columns) * tileSize;
+			int originY = (t / columns) * tileSize;
+			int tileWidth = std::min(tileSize, width - originX);
+			int tileHeight = std::min(tileSize, height - originY);
+
+			std::vector<std::vector<int> > tileArray(tileHeight + 2,
+				std::vector<int>(tileWidth + 2, -1));
+			for (int y = 1; y <= tileHeight; y++) {
+				const std::vector<int>& row = array[originY + y];
+				std::copy(row.begin() + originX + 1,
+					row.begin() + originX + tileWidth + 1,
+					tileArray[y].begin() + 1);
+			}
 
-				PathSimplifier simplifier;
-				layers = simplifier.BatchTracePathsWithSimplification(layers, options, masterRegistry);
+			// Pixel edges lie on half coordinates; image edges are no seams.
+			TileSeams seams(originX > 0 ? 0.5 : -HUGE_VAL,
+				originY > 0 ? 0.5 : -HUGE_VAL,
+				originX + tileWidth < width ? tileWidth + 0.5 : HUGE_VAL,
+				originY + tileHeight < height ? tileHeight + 0.5 : HUGE_VAL);
+
+			IndexedBitmap tile(tileArray, palette);
+			TracedLayers& layers = tiles[t] = _TraceLayers(tile, tileOptions, NULL, &seams);
+
+			seamPaths[t].resize(layers.size());
+			for (size_t k = 0; k < layers.size(); k++) {
+				seamPaths[t][k].resize(layers[k].size());
+				for (size_t i = 0; i < layers[k].size(); i++) {
+					seamPaths[t][k][i] = _TouchesSeam(layers[k][i], seams);
+					for (size_t j = 0; j < layers[k][i].size(); j++) {
+						std::vector<double>& seg = layers[k][i][j];
+						for (size_t c = 1; c + 1 < seg.size(); c += 2) {
+							seg[c] += originX;
+							seg[c + 1] += originY;
+						}
+					}
+				}
 			}
 		}
-
-		if (options.fDetectGeometry) {
-			_ReportProgress(options, STAGE_DETECT_GEOMETRY, 75);
-			GeometryDetector detector;
-			layers = detector.BatchLayerGeometryDetection(layers, options);
+	});
+
+	TracedLayers layers(palette.size());
+	std::vector<std::vector<bool> > onSeam(palette.size());
+	for (int t = 0; t < tileCount; t++) {
+		for (size_t k = 0; k < tiles[t].size() && k < layers.size(); k++) {
+			layers[k].insert(layers[k].end(), tiles[t][k].begin(), tiles[t][k].end());
+			onSeam[k].insert(onSeam[k].end(), seamPaths[t][k].begin(),
+				seamPaths[t][k].end());
 		}
-
-		_ReportProgress(options, STAGE_UNIFY_EDGES, 80);
-		masterRegistry->RegisterPaths(layers, indexedBitmap);
-		masterRegistry->UnifyCoordinates(0.15);
-		masterRegistry->UpdatePaths(layers);
-
-		delete masterRegistry;
-		masterRegistry = NULL;
-
-	} catch (...) {
-		delete masterRegistry;
-		throw;
+		TracedLayers().swap(tiles[t]);
 	}
 
-	indexedBitmap.SetLayers(layers);
+	if (stats != NULL) {
+		stats->fTiles = tileCount;
+		stats->SetPathCounts(STAGE_SCAN_PATHS, layers);
+	}
 
-	_ReportProgress(options, STAGE_FIX_WINDING, 85);
-	PathHierarchy hierarchy;
-	hierarchy.AnalyzeHierarchy(indexedBitmap);
+	// Pieces cut by a seam are left as they are: fitted as shapes of their
+	// own, their ends would move off the seam and open a crack.
+	if (options.fDetectGeometry && !options.IsCancelled() && !_OutOfTime(options)) {
+		_BeginStage(options, stats, STAGE_DETECT_GEOMETRY, 75);
+		TracedLayers whole(layers.size());
+		for (size_t k = 0; k < layers.size(); k++) {
+			for (size_t i = 0; i < layers[k].size(); i++) {
+				if (onSeam[k][i])
+					continue;
+				whole[k].push_back(std::vector<std::vector<double> >());
+				whole[k].back().swap(layers[k][i]);
+			}
+		}
 
-	_FixWindingOrder(indexedBitmap);
+		GeometryDetector detector;
+		whole = detector.BatchLayerGeometryDetection(whole, options);
 
-	if (options.fDetectGradients) {
-		_ReportProgress(options, STAGE_DETECT_GRADIENTS, 90);
-		GradientDetector grad;
-		std::vector<std::vector<IndexedBitmap::LinearGradient> > grads =
-			grad.DetectLinearGradients(indexedBitmap, processedBitmap, layers, options);
-		indexedBitmap.SetLinearGradients(grads);
+		for (size_t k = 0; k < layers.size(); k++) {
+			size_t next = 0;
+			for (size_t i = 0; i < layers[k].size(); i++) {
+				if (!onSeam[k][i])
+					layers[k][i].swap(whole[k][next++]);
+			}
+		}
+		if (stats != NULL)
+			stats->SetPathCounts(STAGE_DETECT_GEOMETRY, layers);
 	}
 
-	_ReportProgress(options, STAGE_COMPLETE, 100);
-	return indexedBitmap;
+	return layers;
 }
 
 void
@@ -388,36 +735,20 @@ ImageTracer::_SelectRepresentativeColor(const std::vector<PixelSample>& samples,
 std::vector<std::vector<unsigned char> >
 ImageTracer::_CreatePalette(const BitmapData& bitmap, int colorCount, const TracingOptions& options)
 {
-	bool hasTransparency = false;
+	const unsigned char* bits = bitmap.Bits();
+	size_t pixelCount = (size_t)bitmap.Width() * bitmap.Height();
 
-	for (int y = 0; y < bitmap.Height(); y++) {
-		for (int x = 0; x < bitmap.Width(); x++) {
-			unsigned char a = bitmap.GetPixelComponent(x, y, 3);
-			if (MathUtils::IsTransparent(a)) {
-				hasTransparency = true;
-				break;
-			}
+	bool hasTransparency = false;
+	for (size_t i = 0; i < pixelCount; i++) {
+		if (MathUtils::IsTransparent(bits[i * 4 + 3])) {
+			hasTransparency = true;
+			break;
 		}
-		if (hasTransparency) break;
 	}
 
-	std::vector<std::vector<int> > pixels(bitmap.Height());
-	for (int y = 0; y < bitmap.Height(); y++) {
-		pixels[y].resize(bitmap.Width());
-		for (int x = 0; x < bitmap.Width(); x++) {
-			int r = bitmap.GetPixelComponent(x, y, 0);
-			int g = bitmap.GetPixelComponent(x, y, 1);
-			int b = bitmap.GetPixelComponent(x, y, 2);
-			int a = bitmap.GetPixelComponent(x, y, 3);
-
-			if (MathUtils::IsTransparent((unsigned char)a)) {
-				pixels[y][x] = -1;
-				continue;
-			}
-
-			pixels[y][x] = (a << 24) | (r << 16) | (g << 8) | b;
-		}
-	}
+	// Transparent pixels read as -1 and are skipped by the quantizer and
+	// the refinement below.
+	PackedPixelView pixels(bitmap, -1);
 
 	ColorQuantizer quantizer;
 	std::vector<int> initialPalette = quantizer.QuantizeImageMasked(pixels, colorCount, -1);
@@ -440,17 +771,23 @@ ImageTracer::_CreatePalette(const BitmapData& bitmap, int colorCount, const Trac
 	int consecutiveSmallChanges = 0;
 
 	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		// Every pass leaves a usable palette, so refinement simply stops
+		// when the run is cancelled or out of time.
+		if (options.IsCancelled() || _OutOfTime(options))
+			break;
+
 		std::vector<std::vector<PixelSample> > colorSamples(bytePalette.size());
 
 		for (int y = 0; y < bitmap.Height(); y++) {
 			for (int x = 0; x < bitmap.Width(); x++) {
-				if (pixels[y][x] == -1)
+				if (pixels.Pixel(x, y) == -1)
 					continue;
 
-				int r = bitmap.GetPixelComponent(x, y, 0);
-				int g = bitmap.GetPixelComponent(x, y, 1);
-				int b = bitmap.GetPixelComponent(x, y, 2);
-				int a = bitmap.GetPixelComponent(x, y, 3);
+				const unsigned char* p = bits + ((size_t)y * bitmap.Width() + x) * 4;
+				int r = p[0];
+				int g = p[1];
+				int b = p[2];
+				int a = p[3];
 
 				if (MathUtils::IsTransparent((unsigned char)a))
 					continue;
@@ -534,3 +871,47 @@ ImageTracer::_CreatePalette(const BitmapData& bitmap, int colorCount, const Trac
 
 	return finalPalette;
 }
+
+bool
+ImageTracer::_Checkpoint(TracingOptions& options, TracingStats* stats)
+{
+	if (options.IsCancelled()) {
+		fCancelled = true;
+		if (stats != NULL) {
+			stats->fCancelled = true;
+			stats->Finish();
+		}
+		return false;
+	}
+
+	if (!fOverBudget && _OutOfTime(options)) {
+		fOverBudget = true;
+		_UseFallback(options);
+		if (stats != NULL)
+			stats->fOverBudget = true;
+	}
+
+	return true;
+}
+
+bool
+ImageTracer::_OutOfTime(const TracingOptions& options) const
+{
+	return options.fTimeBudgetMs > 0
+		&& std::chrono::steady_clock::now() >= fDeadline;
+}
+
+void
+ImageTracer::_UseFallback(TracingOptions& options)
+{
+	// Keep what every result needs and drop the refinements: a single
+	// palette pass, no spatial smoothing, region merging or gradients, and
+	// no simplification or shape fitting beyond Douglas-Peucker.
+	options.fColorQuantizationCycles = 1;
+	options.fSpatialCoherence = false;
+	options.fDetectGradients = false;
+	options.fCollinearTolerance = 0;
+	options.fMinSegmentLength = 0;
+	options.fCurveSmoothing = 0;
+	options.fDetectGeometry = false;
+}
@@ -6,12 +6,16 @@
 #ifndef IMAGE_TRACER_H
 #define IMAGE_TRACER_H
 
+#include <chrono>
 #include <string>
 #include <vector>
 
 #include "BitmapData.h"
 #include "IndexedBitmap.h"
 #include "TracingOptions.h"
+#include "TracingStats.h"
+
+class TileSeams;
 
 class ImageTracer {
 public:
@@ -19,15 +23,24 @@ public:
 							~ImageTracer();
 
 	std::string				BitmapToSvg(const BitmapData& bitmap,
-									const TracingOptions& options = TracingOptions());
+									const TracingOptions& options = TracingOptions(),
+									TracingStats* stats = NULL);
 
 	IndexedBitmap			BitmapToTraceData(const BitmapData& bitmap,
-									const TracingOptions& options = TracingOptions());
+									const TracingOptions& options = TracingOptions(),
+									TracingStats* stats = NULL);
 
 	bool					SaveSvg(const std::string& filename,
 									const std::string& svgData);
 
+	// State of the last run: a cancelled run returns no paths, one that
+	// ran out of time finished with the fallback settings.
+	bool					WasCancelled() const { return fCancelled; }
+	bool					WasOverBudget() const { return fOverBudget; }
+
 private:
+	typedef std::vector<std::vector<std::vector<std::vector<double> > > > TracedLayers;
+
 	struct PixelSample {
 		unsigned char r, g, b, a;
 		double saturation;
@@ -55,7 +68,23 @@ private:
 													  unsigned char& outA,
 													  int colorCount);
 
+	TracedLayers			_TraceLayers(const IndexedBitmap& indexed,
+									const TracingOptions& options,
+									TracingStats* stats,
+									const TileSeams* seams);
+	TracedLayers			_TraceTiles(const IndexedBitmap& indexed,
+									const TracingOptions& options,
+									TracingStats* stats);
+
 	void					_FixWindingOrder(IndexedBitmap& indexed);
+
+	bool					_Checkpoint(TracingOptions& options, TracingStats* stats);
+	bool					_OutOfTime(const TracingOptions& options) const;
+	static void				_UseFallback(TracingOptions& options);
+
+	std::chrono::steady_clock::time_point fDeadline;
+	bool					fCancelled;
+	bool					fOverBudget;
 };
 
 #endif
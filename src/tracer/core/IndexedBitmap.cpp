@@ -3,7 +3,11 @@
  * Distributed under the terms of the MIT License.
  */
 
+#include <algorithm>
+#include <map>
+
 #include "IndexedBitmap.h"
+#include "MathUtils.h"
 
 IndexedBitmap::IndexedBitmap()
 	: fWidth(0)
@@ -30,3 +34,121 @@ IndexedBitmap::SetLayers(const std::vector<std::vector<std::vector<std::vector<d
 {
 	fLayers = layers;
 }
+
+bool
+IndexedBitmap::_IsHoleTransparent(const std::vector<std::vector<double> >& path) const
+{
+	if (path.empty()) return true;
+
+	double minX = 1e9, maxX = -1e9, minY = 1e9, maxY = -1e9;
+	for (size_t i = 0; i < path.size(); i++) {
+		if (path[i].size() < 2) continue;
+		minX = std::min(minX, path[i][1]);
+		maxX = std::max(maxX, path[i][1]);
+		minY = std::min(minY, path[i][2]);
+		maxY = std::max(maxY, path[i][2]);
+	}
+
+	for (int steps = 0; steps < 5; steps++) {
+		double checkY = minY + (maxY - minY) * (0.3 + 0.1 * steps);
+		int y = (int)checkY;
+		if (y < 0 || y >= fHeight) continue;
+
+		std::vector<double> intersections;
+		for (size_t i = 0; i < path.size(); i++) {
+			double x1 = path[i][1], y1 = path[i][2];
+			double x2, y2;
+			if (path[i][0] == 1.0) { x2 = path[i][3]; y2 = path[i][4]; }
+			else { x2 = path[i][5]; y2 = path[i][6]; }
+
+			if ((y1 > checkY) != (y2 > checkY)) {
+				double x = (x2 - x1) * (checkY - y1) / (y2 - y1) + x1;
+				intersections.push_back(x);
+			}
+		}
+
+		std::sort(intersections.begin(), intersections.end());
+
+		for (size_t i = 0; i < intersections.size(); i += 2) {
+			if (i + 1 >= intersections.size()) break;
+			double midX = (intersections[i] + intersections[i+1]) * 0.5;
+			int x = (int)midX;
+			if (x < 0 || x >= fWidth) continue;
+
+			int idx = fArray[y+1][x+1];
+			if (idx < 0)
+				return true;
+
+			const std::vector<unsigned char>& p = fPalette[idx];
+			if (MathUtils::IsTransparent(p[3])) return true;
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::vector<IndexedBitmap::RenderGroup>
+IndexedBitmap::RenderGroups() const
+{
+	std::vector<RenderGroup> renderQueue;
+	std::vector<std::map<int, std::vector<int> > > layerHoles(fLayers.size());
+
+	for (size_t k = 0; k < fLayers.size(); k++) {
+		if (k < fPalette.size() && fPalette[k][3] == 0) {
+			continue; // Skip transparent layers
+		}
+		if (k >= fPathMetadata.size()) continue;
+
+		for (size_t i = 0; i < fLayers[k].size(); i++) {
+			if (fLayers[k][i].empty()) continue;
+			if (i >= fPathMetadata[k].size()) continue;
+
+			if (fPathMetadata[k][i].isHole) {
+				int parent = fPathMetadata[k][i].parentPathIndex;
+				if (parent != -1) {
+					layerHoles[k][parent].push_back((int)i);
+				}
+			}
+		}
+	}
+
+	for (size_t k = 0; k < fLayers.size(); k++) {
+		if (k < fPalette.size() && fPalette[k][3] == 0) {
+			continue;
+		}
+		if (k >= fPathMetadata.size()) continue;
+
+		for (size_t i = 0; i < fLayers[k].size(); i++) {
+			if (fLayers[k][i].empty()) continue;
+			if (i >= fPathMetadata[k].size()) continue;
+
+			if (!fPathMetadata[k][i].isHole) {
+				RenderGroup group;
+				group.layerIndex = (int)k;
+				group.parentPathIndex = (int)i;
+				group.area = fPathMetadata[k][i].area;
+
+				group.pathIndices.push_back((int)i);
+
+				if (layerHoles[k].count((int)i)) {
+					const std::vector<int>& holes = layerHoles[k][(int)i];
+					for (size_t h = 0; h < holes.size(); h++) {
+						int holeIdx = holes[h];
+						if (_IsHoleTransparent(fLayers[k][holeIdx])) {
+							group.pathIndices.push_back(holeIdx);
+						}
+					}
+				}
+
+				renderQueue.push_back(group);
+			}
+		}
+	}
+
+	// Sort groups by parent area descending
+	std::sort(renderQueue.begin(), renderQueue.end());
+
+	return renderQueue;
+}
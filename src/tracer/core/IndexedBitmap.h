@@ -41,6 +41,20 @@ public:
 		}
 	};
 
+	// An outer path together with the holes that have to be cut out of it,
+	// i.e. the holes whose inside is transparent rather than covered by
+	// another layer.
+	struct RenderGroup {
+		int layerIndex;
+		int parentPathIndex;
+		double area;
+		std::vector<int> pathIndices;
+
+		bool operator<(const RenderGroup& other) const {
+			return area > other.area;
+		}
+	};
+
 								IndexedBitmap();
 								IndexedBitmap(const std::vector<std::vector<int> >& indexArray,
 											const std::vector<std::vector<unsigned char> >& palette);
@@ -60,7 +74,13 @@ public:
 	const std::vector<std::vector<PathMetadata> >& PathsMetadata() const { return fPathMetadata; }
 	void						SetPathMetadata(const std::vector<std::vector<PathMetadata> >& metadata) { fPathMetadata = metadata; }
 
+	// Paint order shared by every output: groups of visible layers, the
+	// largest outer path first.
+	std::vector<RenderGroup>	RenderGroups() const;
+
 private:
+	bool						_IsHoleTransparent(const std::vector<std::vector<double> >& path) const;
+
 	int							fWidth;
 	int							fHeight;
 	std::vector<std::vector<int> > fArray;
@@ -16,6 +16,7 @@ TracingOptions::SetDefaults()
 	fLineThreshold = 2.0f;
 	fQuadraticThreshold = 0.5f;
 	fPathOmitThreshold = 10.0f;
+	fCubicFitting = false;
 
 	fNumberOfColors = 8.0f;
 	fColorQuantizationCycles = 16.0f;
@@ -26,6 +27,8 @@ TracingOptions::SetDefaults()
 	fCustomDescription = "";
 	fUseViewBox = false;
 
+	fMaxTraceSize = 0;
+
 	fBlurRadius = 0.0f;
 	fBlurDelta = 20.0f;
 
@@ -85,6 +88,11 @@ TracingOptions::SetDefaults()
 	fSpatialCoherenceRadius = 2;
 	fSpatialCoherencePasses = 2;
 
+	fTileSize = 0;
+
+	fCancelFlag = NULL;
+	fTimeBudgetMs = 0;
+
 	fProgressCallback = NULL;
 	fProgressUserData = NULL;
 }
@@ -95,3 +103,15 @@ TracingOptions::SetProgressCallback(ProgressCallback callback, void* userData)
 	fProgressCallback = callback;
 	fProgressUserData = userData;
 }
+
+void
+TracingOptions::SetCancelFlag(const std::atomic<bool>* flag)
+{
+	fCancelFlag = flag;
+}
+
+bool
+TracingOptions::IsCancelled() const
+{
+	return fCancelFlag != NULL && fCancelFlag->load(std::memory_order_relaxed);
+}
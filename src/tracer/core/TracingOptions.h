@@ -6,6 +6,7 @@
 #ifndef TRACING_OPTIONS_H
 #define TRACING_OPTIONS_H
 
+#include <atomic>
 #include <string>
 
 #include "BackgroundRemover.h"
@@ -17,12 +18,18 @@ public:
 
 	void					SetDefaults();
 	void					SetProgressCallback(ProgressCallback callback, void* userData);
+	void					SetCancelFlag(const std::atomic<bool>* flag);
+
+	bool					IsCancelled() const;
 
 	// Basic tracing parameters
 	float					fLineThreshold;
 	float					fQuadraticThreshold;
 	float					fPathOmitThreshold;
 
+	// Curve fitting, cubic instead of quadratic segments
+	bool					fCubicFitting;
+
 	// Color quantization
 	float					fNumberOfColors;
 	float					fColorQuantizationCycles;
@@ -34,6 +41,9 @@ public:
 	std::string				fCustomDescription;
 	bool					fUseViewBox;
 
+	// Working resolution, longest side in pixels (0 = full size)
+	int						fMaxTraceSize;
+
 	// Preprocessing
 	float					fBlurRadius;
 	float					fBlurDelta;
@@ -106,6 +116,15 @@ public:
 	int						fSpatialCoherenceRadius;
 	int						fSpatialCoherencePasses;
 
+	// Tiled tracing, tile edge in pixels (0 = off)
+	int						fTileSize;
+
+	// Cancellation and time budget. The flag may be set from any thread to
+	// abandon the run. Once the budget (milliseconds, 0 = none) is spent,
+	// the remaining stages run with cheaper settings.
+	const std::atomic<bool>* fCancelFlag;
+	int						fTimeBudgetMs;
+
 	// Progress callback
 	ProgressCallback		fProgressCallback;
 	void*					fProgressUserData;
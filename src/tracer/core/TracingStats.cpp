@@ -0,0 +1,257 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif !defined(__HAIKU__)
+#include <sys/resource.h>
+#endif
+
+#include "TracingStats.h"
+
+static const char*
+_StageKey(int stage)
+{
+	switch (stage) {
+		case STAGE_STARTING: return "starting";
+		case STAGE_REMOVE_BACKGROUND: return "remove_background";
+		case STAGE_BLUR: return "blur";
+		case STAGE_CREATE_PALETTE: return "create_palette";
+		case STAGE_QUANTIZE_COLORS: return "quantize_colors";
+		case STAGE_MERGE_REGIONS: return "merge_regions";
+		case STAGE_SCAN_PATHS: return "scan_paths";
+		case STAGE_TRACE_PATHS: return "trace_paths";
+		case STAGE_SIMPLIFY_VW: return "simplify_vw";
+		case STAGE_FILTER_SMALL: return "filter_small";
+		case STAGE_SIMPLIFY_DP: return "simplify_dp";
+		case STAGE_SIMPLIFY_ADVANCED: return "simplify_advanced";
+		case STAGE_DETECT_GEOMETRY: return "detect_geometry";
+		case STAGE_UNIFY_EDGES: return "unify_edges";
+		case STAGE_FIX_WINDING: return "fix_winding";
+		case STAGE_DETECT_GRADIENTS: return "detect_gradients";
+		case STAGE_COMPLETE: return "complete";
+		default: return "unknown";
+	}
+}
+
+TracingStats::TracingStats()
+{
+	Reset();
+}
+
+void
+TracingStats::Reset()
+{
+	fInputWidth = 0;
+	fInputHeight = 0;
+	fWorkingWidth = 0;
+	fWorkingHeight = 0;
+	fPaletteSize = 0;
+	fTiles = 0;
+	fRegistryPoints = 0;
+	fCancelled = false;
+	fOverBudget = false;
+
+	for (int i = 0; i <= STAGE_COMPLETE; i++)
+		fStages[i] = StageStats();
+	fOrder.clear();
+
+	fCurrentStage = -1;
+	fStageWall = 0;
+	fStageCpu = 0;
+	fStagePeak = 0;
+	fPeakBytes = 0;
+}
+
+void
+TracingStats::BeginStage(int stage)
+{
+	Finish();
+
+	if (stage < 0 || stage > STAGE_COMPLETE)
+		return;
+
+	if (!fStages[stage].ran)
+		fOrder.push_back(stage);
+
+	fStages[stage].ran = true;
+	fCurrentStage = stage;
+	fStageWall = _WallMs();
+	fStageCpu = _CpuMs();
+	fStagePeak = _PeakBytes();
+}
+
+void
+TracingStats::Finish()
+{
+	if (fCurrentStage < 0)
+		return;
+
+	StageStats& stats = fStages[fCurrentStage];
+	stats.wallMs += _WallMs() - fStageWall;
+	stats.cpuMs += _CpuMs() - fStageCpu;
+	fPeakBytes = _PeakBytes();
+	if (fPeakBytes > fStagePeak)
+		stats.peakGrowthBytes += fPeakBytes - fStagePeak;
+	fCurrentStage = -1;
+}
+
+void
+TracingStats::SetPathCounts(int stage, const Layers& layers)
+{
+	int paths = 0;
+	int segments = 0;
+	for (size_t k = 0; k < layers.size(); k++) {
+		for (size_t i = 0; i < layers[k].size(); i++) {
+			if (layers[k][i].empty())
+				continue;
+			paths++;
+			segments += (int)layers[k][i].size();
+		}
+	}
+
+	SetPathCounts(stage, paths, segments);
+}
+
+void
+TracingStats::SetPathCounts(int stage, int paths, int segments)
+{
+	if (stage < 0 || stage > STAGE_COMPLETE)
+		return;
+
+	fStages[stage].paths = paths;
+	fStages[stage].segments = segments;
+}
+
+double
+TracingStats::TotalWallMs() const
+{
+	double total = 0;
+	for (int i = 0; i <= STAGE_COMPLETE; i++)
+		total += fStages[i].wallMs;
+	return total;
+}
+
+double
+TracingStats::TotalCpuMs() const
+{
+	double total = 0;
+	for (int i = 0; i <= STAGE_COMPLETE; i++)
+		total += fStages[i].cpuMs;
+	return total;
+}
+
+std::string
+TracingStats::ToJson() const
+{
+	char number[32];
+	std::ostringstream out;
+
+	out << "{\n";
+	out << "  \"input\": { \"width\": " << fInputWidth
+		<< ", \"height\": " << fInputHeight << " },\n";
+	out << "  \"working\": { \"width\": " << fWorkingWidth
+		<< ", \"height\": " << fWorkingHeight << " },\n";
+	out << "  \"palette_size\": " << fPaletteSize << ",\n";
+	out << "  \"tiles\": " << fTiles << ",\n";
+	out << "  \"registry_points\": " << fRegistryPoints << ",\n";
+	out << "  \"cancelled\": " << (fCancelled ? "true" : "false") << ",\n";
+	out << "  \"over_budget\": " << (fOverBudget ? "true" : "false") << ",\n";
+	snprintf(number, sizeof(number), "%.3f", TotalWallMs());
+	out << "  \"wall_ms\": " << number << ",\n";
+	snprintf(number, sizeof(number), "%.3f", TotalCpuMs());
+	out << "  \"cpu_ms\": " << number << ",\n";
+	out << "  \"process_peak_bytes\": " << fPeakBytes << ",\n";
+	out << "  \"stages\": [";
+
+	bool first = true;
+	int paths = -1;
+	int segments = -1;
+	// Stages are listed in the order they ran, so the counts before a
+	// stage are the ones the previous stage left.
+	for (size_t i = 0; i < fOrder.size(); i++) {
+		const StageStats& stage = fStages[fOrder[i]];
+
+		out << (first ? "\n" : ",\n");
+		first = false;
+
+		out << "    { \"stage\": \"" << _StageKey(fOrder[i]) << "\"";
+		snprintf(number, sizeof(number), "%.3f", stage.wallMs);
+		out << ", \"wall_ms\": " << number;
+		snprintf(number, sizeof(number), "%.3f", stage.cpuMs);
+		out << ", \"cpu_ms\": " << number;
+		out << ", \"peak_growth_bytes\": " << stage.peakGrowthBytes;
+
+		if (stage.paths >= 0) {
+			if (paths >= 0) {
+				out << ", \"paths_before\": " << paths
+					<< ", \"segments_before\": " << segments;
+			}
+			out << ", \"paths\": " << stage.paths
+				<< ", \"segments\": " << stage.segments;
+			paths = stage.paths;
+			segments = stage.segments;
+		}
+
+		out << " }";
+	}
+
+	out << "\n  ]\n}\n";
+	return out.str();
+}
+
+double
+TracingStats::_WallMs()
+{
+	return std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double
+TracingStats::_CpuMs()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) / 10000.0;
+#else
+	return (double)std::clock() * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+size_t
+TracingStats::_PeakBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (size_t)counters.PeakWorkingSetSize;
+	return 0;
+#elif defined(__HAIKU__)
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef TRACING_STATS_H
+#define TRACING_STATS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "VectorizationProgress.h"
+
+// Cost of one ImageTracer run, broken down by VectorizationStage. A stage
+// lasts from its BeginStage() to the next one (or Finish()). The platform
+// only reports the peak resident size of the whole process (0 where it
+// does not), which never goes down; a stage records how far it raised that
+// peak, and the run the peak at its end. In tiled mode all the work done
+// per tile is counted under STAGE_SCAN_PATHS.
+class TracingStats {
+public:
+	struct StageStats {
+		bool				ran;
+		double				wallMs;
+		double				cpuMs;
+		size_t				peakGrowthBytes;
+
+		// Paths and segments left after the stage, -1 where the stage does
+		// not touch paths. Before tracing, segments counts internode points.
+		int					paths;
+		int					segments;
+
+		StageStats()
+			: ran(false), wallMs(0), cpuMs(0), peakGrowthBytes(0),
+			  paths(-1), segments(-1) {}
+	};
+
+	typedef std::vector<std::vector<std::vector<std::vector<double> > > > Layers;
+
+							TracingStats();
+
+	void					Reset();
+
+	void					BeginStage(int stage);
+	void					Finish();
+
+	void					SetPathCounts(int stage, const Layers& layers);
+	void					SetPathCounts(int stage, int paths, int segments);
+
+	const StageStats&		Stage(int stage) const { return fStages[stage]; }
+	double					TotalWallMs() const;
+	double					TotalCpuMs() const;
+	size_t					PeakBytes() const { return fPeakBytes; }
+
+	std::string				ToJson() const;
+
+	int						fInputWidth;
+	int						fInputHeight;
+	int						fWorkingWidth;
+	int						fWorkingHeight;
+	int						fPaletteSize;
+	int						fTiles;
+	int						fRegistryPoints;
+	bool					fCancelled;
+	bool					fOverBudget;
+
+private:
+	static double			_CpuMs();
+	static size_t			_PeakBytes();
+	static double			_WallMs();
+
+	StageStats				fStages[STAGE_COMPLETE + 1];
+	std::vector<int>		fOrder;
+	int						fCurrentStage;
+	double					fStageWall;
+	double					fStageCpu;
+	size_t					fStagePeak;
+	size_t					fPeakBytes;
+};
+
+#endif
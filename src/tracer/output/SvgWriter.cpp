@@ -9,12 +9,10 @@
 #include <iomanip>
 #include <algorithm>
 #include <cmath>
-#include <map>
 #include <set>
 #include <iostream>
 
 #include "SvgWriter.h"
-#include "MathUtils.h"
 
 static inline bool _NearlyEqual(double a, double b, double eps)
 {
@@ -145,6 +143,13 @@ SvgWriter::_WriteSvgPathString(std::ostringstream& stream,
 			if (segments[pointIndex][0] == 1.0) {
 				stream << " L " << segments[pointIndex][3] * scale << " "
 					   << segments[pointIndex][4] * scale;
+			} else if (segments[pointIndex][0] == 3.0) {
+				stream << " C " << segments[pointIndex][3] * scale << " "
+					   << segments[pointIndex][4] * scale << " "
+					   << segments[pointIndex][7] * scale << " "
+					   << segments[pointIndex][8] * scale << " "
+					   << segments[pointIndex][5] * scale << " "
+					   << segments[pointIndex][6] * scale;
 			} else {
 				stream << " Q " << segments[pointIndex][3] * scale << " "
 					   << segments[pointIndex][4] * scale << " "
@@ -157,6 +162,13 @@ SvgWriter::_WriteSvgPathString(std::ostringstream& stream,
 			if (segments[pointIndex][0] == 1.0) {
 				stream << " L " << _RoundToDecimal(static_cast<float>(segments[pointIndex][3] * scale), roundCoordinates) << " "
 					   << _RoundToDecimal(static_cast<float>(segments[pointIndex][4] * scale), roundCoordinates);
+			} else if (segments[pointIndex][0] == 3.0) {
+				stream << " C " << _RoundToDecimal(static_cast<float>(segments[pointIndex][3] * scale), roundCoordinates) << " "
+					   << _RoundToDecimal(static_cast<float>(segments[pointIndex][4] * scale), roundCoordinates) << " "
+					   << _RoundToDecimal(static_cast<float>(segments[pointIndex][7] * scale), roundCoordinates) << " "
+					   << _RoundToDecimal(static_cast<float>(segments[pointIndex][8] * scale), roundCoordinates) << " "
+					   << _RoundToDecimal(static_cast<float>(segments[pointIndex][5] * scale), roundCoordinates) << " "
+					   << _RoundToDecimal(static_cast<float>(segments[pointIndex][6] * scale), roundCoordinates);
 			} else {
 				stream << " Q " << _RoundToDecimal(static_cast<float>(segments[pointIndex][3] * scale), roundCoordinates) << " "
 					   << _RoundToDecimal(static_cast<float>(segments[pointIndex][4] * scale), roundCoordinates) << " "
@@ -242,6 +254,13 @@ SvgWriter::_WriteSvgCompoundPath(std::ostringstream& stream,
 				if (segments[j][0] == 1.0) {
 					stream << " L " << segments[j][3] * scale << " "
 						   << segments[j][4] * scale;
+				} else if (segments[j][0] == 3.0) {
+					stream << " C " << segments[j][3] * scale << " "
+						   << segments[j][4] * scale << " "
+						   << segments[j][7] * scale << " "
+						   << segments[j][8] * scale << " "
+						   << segments[j][5] * scale << " "
+						   << segments[j][6] * scale;
 				} else {
 					stream << " Q " << segments[j][3] * scale << " "
 						   << segments[j][4] * scale << " "
@@ -254,6 +273,13 @@ SvgWriter::_WriteSvgCompoundPath(std::ostringstream& stream,
 				if (segments[j][0] == 1.0) {
 					stream << " L " << _RoundToDecimal(static_cast<float>(segments[j][3] * scale), roundCoordinates) << " "
 						   << _RoundToDecimal(static_cast<float>(segments[j][4] * scale), roundCoordinates);
+				} else if (segments[j][0] == 3.0) {
+					stream << " C " << _RoundToDecimal(static_cast<float>(segments[j][3] * scale), roundCoordinates) << " "
+						   << _RoundToDecimal(static_cast<float>(segments[j][4] * scale), roundCoordinates) << " "
+						   << _RoundToDecimal(static_cast<float>(segments[j][7] * scale), roundCoordinates) << " "
+						   << _RoundToDecimal(static_cast<float>(segments[j][8] * scale), roundCoordinates) << " "
+						   << _RoundToDecimal(static_cast<float>(segments[j][5] * scale), roundCoordinates) << " "
+						   << _RoundToDecimal(static_cast<float>(segments[j][6] * scale), roundCoordinates);
 				} else {
 					stream << " Q " << _RoundToDecimal(static_cast<float>(segments[j][3] * scale), roundCoordinates) << " "
 						   << _RoundToDecimal(static_cast<float>(segments[j][4] * scale), roundCoordinates) << " "
@@ -293,75 +319,6 @@ SvgWriter::_WriteLinearGradientDef(std::ostringstream& defs,
 	defs << "</linearGradient>";
 }
 
-struct RenderGroup {
-	int layerIndex;
-	int parentPathIndex;
-	double area;
-	std::vector<int> pathIndices;
-
-	bool operator<(const RenderGroup& other) const {
-		return area > other.area;
-	}
-};
-
-bool
-SvgWriter::_IsHoleTransparent(const std::vector<std::vector<double> >& path,
-							  const IndexedBitmap& indexed)
-{
-	if (path.empty()) return true;
-
-	double minX = 1e9, maxX = -1e9, minY = 1e9, maxY = -1e9;
-	for (size_t i = 0; i < path.size(); i++) {
-		if (path[i].size() < 2) continue;
-		minX = std::min(minX, path[i][1]);
-		maxX = std::max(maxX, path[i][1]);
-		minY = std::min(minY, path[i][2]);
-		maxY = std::max(maxY, path[i][2]);
-	}
-
-	int w = indexed.Width();
-	int h = indexed.Height();
-
-	for (int steps = 0; steps < 5; steps++) {
-		double checkY = minY + (maxY - minY) * (0.3 + 0.1 * steps);
-		int y = (int)checkY;
-		if (y < 0 || y >= h) continue;
-
-		std::vector<double> intersections;
-		for (size_t i = 0; i < path.size(); i++) {
-			double x1 = path[i][1], y1 = path[i][2];
-			double x2, y2;
-			if (path[i][0] == 1.0) { x2 = path[i][3]; y2 = path[i][4]; }
-			else { x2 = path[i][5]; y2 = path[i][6]; }
-
-			if ((y1 > checkY) != (y2 > checkY)) {
-				double x = (x2 - x1) * (checkY - y1) / (y2 - y1) + x1;
-				intersections.push_back(x);
-			}
-		}
-
-		std::sort(intersections.begin(), intersections.end());
-
-		for (size_t i = 0; i < intersections.size(); i += 2) {
-			if (i + 1 >= intersections.size()) break;
-			double midX = (intersections[i] + intersections[i+1]) * 0.5;
-			int x = (int)midX;
-			if (x < 0 || x >= w) continue;
-
-			int idx = indexed.Array()[y+1][x+1];
-			if (idx < 0)
-				return true;
-
-			const std::vector<unsigned char>& p = indexed.Palette()[idx];
-			if (MathUtils::IsTransparent(p[3])) return true;
-
-			return false;
-		}
-	}
-
-	return true;
-}
-
 std::string
 SvgWriter::GenerateSvg(const IndexedBitmap& indexedBitmap, const TracingOptions& options)
 {
@@ -416,69 +373,11 @@ SvgWriter::GenerateSvg(const IndexedBitmap& indexedBitmap, const TracingOptions&
 	}
 
 	const std::vector<std::vector<std::vector<std::vector<double> > > >& layers = indexedBitmap.Layers();
-	const std::vector<std::vector<IndexedBitmap::PathMetadata> >& metadata = indexedBitmap.PathsMetadata();
-
-	std::vector<RenderGroup> renderQueue;
-	std::vector<std::map<int, std::vector<int> > > layerHoles(layers.size());
-
-	for (size_t k = 0; k < layers.size(); k++) {
-		if (k < indexedBitmap.Palette().size() && indexedBitmap.Palette()[k][3] == 0) {
-			continue; // Skip transparent layers
-		}
-		if (k >= metadata.size()) continue;
-
-		for (size_t i = 0; i < layers[k].size(); i++) {
-			if (layers[k][i].empty()) continue;
-			if (i >= metadata[k].size()) continue;
-
-			if (metadata[k][i].isHole) {
-				int parent = metadata[k][i].parentPathIndex;
-				if (parent != -1) {
-					layerHoles[k][parent].push_back((int)i);
-				}
-			}
-		}
-	}
-
-	for (size_t k = 0; k < layers.size(); k++) {
-		if (k < indexedBitmap.Palette().size() && indexedBitmap.Palette()[k][3] == 0) {
-			continue;
-		}
-		if (k >= metadata.size()) continue;
-
-		for (size_t i = 0; i < layers[k].size(); i++) {
-			if (layers[k][i].empty()) continue;
-			if (i >= metadata[k].size()) continue;
-
-			if (!metadata[k][i].isHole) {
-				RenderGroup group;
-				group.layerIndex = (int)k;
-				group.parentPathIndex = (int)i;
-				group.area = metadata[k][i].area;
-
-				group.pathIndices.push_back((int)i);
-
-				if (layerHoles[k].count((int)i)) {
-					const std::vector<int>& holes = layerHoles[k][(int)i];
-					for (size_t h = 0; h < holes.size(); h++) {
-						int holeIdx = holes[h];
-						if (_IsHoleTransparent(layers[k][holeIdx], indexedBitmap)) {
-							group.pathIndices.push_back(holeIdx);
-						}
-					}
-				}
-
-				renderQueue.push_back(group);
-			}
-		}
-	}
-
-	// Sort groups by parent area descending
-	std::sort(renderQueue.begin(), renderQueue.end());
+	const std::vector<IndexedBitmap::RenderGroup> renderQueue = indexedBitmap.RenderGroups();
 
 	std::string description;
 	for (size_t i = 0; i < renderQueue.size(); ++i) {
-		const RenderGroup& group = renderQueue[i];
+		const IndexedBitmap::RenderGroup& group = renderQueue[i];
 		int layer = group.layerIndex;
 		int parentPath = group.parentPathIndex;
 
@@ -49,9 +49,6 @@ private:
 										const TracingOptions& options);
 
 	std::string				_HexColor(unsigned char r, unsigned char g, unsigned char b);
-
-	bool					_IsHoleTransparent(const std::vector<std::vector<double> >& path,
-											  const IndexedBitmap& indexed);
 };
 
 #endif
@@ -28,6 +28,19 @@ BackgroundRemover::RemoveBackground(const BitmapData& bitmap,
 	if (!bitmap.IsValid())
 		return bitmap;
 
+	BitmapData result(bitmap.Width(), bitmap.Height(), bitmap.Bits());
+	RemoveBackgroundInPlace(result, method, tolerance);
+	return result;
+}
+
+void
+BackgroundRemover::RemoveBackgroundInPlace(BitmapData& bitmap,
+									BackgroundDetectionMethod method,
+									int tolerance)
+{
+	if (!bitmap.IsValid() || bitmap.IsBorrowed())
+		return;
+
 	ColorKey backgroundColor;
 
 	switch (method) {
@@ -40,7 +53,7 @@ BackgroundRemover::RemoveBackground(const BitmapData& bitmap,
 			break;
 	}
 
-	return _ApplyBackgroundRemoval(bitmap, backgroundColor, tolerance);
+	_ApplyBackgroundRemoval(bitmap, backgroundColor, tolerance);
 }
 
 ColorKey
@@ -260,12 +273,11 @@ BackgroundRemover::_CalculateConnectivityScore(const BitmapData& bitmap, const C
 	return static_cast<double>(maxArea) / totalPixels;
 }
 
-BitmapData
-BackgroundRemover::_ApplyBackgroundRemoval(const BitmapData& bitmap, const ColorKey& backgroundColor, int tolerance) const
+void
+BackgroundRemover::_ApplyBackgroundRemoval(BitmapData& bitmap, const ColorKey& backgroundColor, int tolerance) const
 {
 	int width = bitmap.Width();
 	int height = bitmap.Height();
-	std::vector<unsigned char> newData = bitmap.Data();
 
 	std::vector<std::vector<bool> > visited(height, std::vector<bool>(width, false));
 	std::vector<std::vector<bool> > toRemove(height, std::vector<bool>(width, false));
@@ -302,16 +314,17 @@ BackgroundRemover::_ApplyBackgroundRemoval(const BitmapData& bitmap, const Color
 		}
 	}
 
+	// Pixels are only cleared once every region is marked, so the flood
+	// fills above never see their own changes.
+	unsigned char* bits = bitmap.MutableBits();
 	for (int y = 0; y < height; y++) {
 		for (int x = 0; x < width; x++) {
 			if (toRemove[y][x]) {
-				int index = (y * width + x) * 4;
-				newData[index + 3] = 0;
+				size_t index = ((size_t)y * width + x) * 4;
+				bits[index + 3] = 0;
 			}
 		}
 	}
-
-	return BitmapData(width, height, newData);
 }
 
 ColorKey
@@ -40,6 +40,12 @@ public:
 											BackgroundDetectionMethod method,
 											int tolerance);
 
+	// Same as RemoveBackground(), clearing the alpha of background pixels
+	// in the given (owned) bitmap instead of returning a copy.
+	void					RemoveBackgroundInPlace(BitmapData& bitmap,
+											BackgroundDetectionMethod method,
+											int tolerance);
+
 	void					SetColorTolerance(int tolerance) { fColorTolerance = tolerance; }
 	void					SetMinBackgroundRatio(double ratio) { fMinBackgroundRatio = ratio; }
 
@@ -57,7 +63,7 @@ private:
 	double					_CalculateEdgeScore(const BitmapData& bitmap, const ColorKey& color, int tolerance) const;
 	double					_CalculateConnectivityScore(const BitmapData& bitmap, const ColorKey& color, int tolerance) const;
 
-	BitmapData				_ApplyBackgroundRemoval(const BitmapData& bitmap, const ColorKey& backgroundColor, int tolerance) const;
+	void					_ApplyBackgroundRemoval(BitmapData& bitmap, const ColorKey& backgroundColor, int tolerance) const;
 
 	ColorKey				_GetPixelColor(const BitmapData& bitmap, int x, int y) const;
 	void					_FloodFillMark(const BitmapData& bitmap, int startX, int startY,
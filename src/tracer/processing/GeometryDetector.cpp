@@ -3,11 +3,14 @@
  * Distributed under the terms of the MIT License.
  */
 
+#include <atomic>
 #include <cmath>
 #include <algorithm>
+#include <limits>
 
 #include "GeometryDetector.h"
 #include "MathUtils.h"
+#include "ParallelUtils.h"
 
 static inline double _Clamp(double v, double lo, double hi)
 {
@@ -16,6 +19,19 @@ static inline double _Clamp(double v, double lo, double hi)
 	return v;
 }
 
+// Cubic pieces needed for a sweep, a quarter turn each at most; a sweep
+// just past a quarter turn from summed angles still counts as one.
+static inline int _ArcPieces(double sweep)
+{
+	return std::max(1, static_cast<int>(std::ceil(std::fabs(sweep) / (M_PI / 2.0) - 0.01)));
+}
+
+static inline double _Cross(const std::vector<double>& o, const std::vector<double>& a,
+	const std::vector<double>& b)
+{
+	return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
+
 GeometryDetector::GeometryDetector()
 {
 }
@@ -218,58 +234,129 @@ GeometryDetector::_RefineCircleGaussNewton(const std::vector<std::vector<double>
 	return true;
 }
 
-std::vector<std::vector<double> >
-GeometryDetector::_ConvertSegmentsToPoints(const std::vector<std::vector<double> >& segments)
+void
+GeometryDetector::_FlattenSegments(const std::vector<std::vector<double> >& segments,
+	std::vector<double>& xy) const
 {
-	std::vector<std::vector<double> > points;
-	points.reserve(segments.size() * 5);
+	xy.clear();
+	xy.reserve(segments.size() * 10);
 
 	for (int i = 0; i < static_cast<int>(segments.size()); i++) {
-		if (segments[i].size() < 4) continue;
+		const std::vector<double>& segment = segments[i];
+		if (segment.size() < 4) continue;
 
 		if (i == 0) {
-			std::vector<double> startPoint(2);
-			startPoint[0] = segments[i][1];
-			startPoint[1] = segments[i][2];
-			points.push_back(startPoint);
+			xy.push_back(segment[1]);
+			xy.push_back(segment[2]);
 		}
 
-		if (segments[i][0] == 1.0) {
-			std::vector<double> endPoint(2);
-			endPoint[0] = segments[i][3];
-			endPoint[1] = segments[i][4];
-			points.push_back(endPoint);
-		} else if (segments[i][0] == 2.0) {
-			double x0 = segments[i][1], y0 = segments[i][2];
-			double x1 = segments[i][3], y1 = segments[i][4];
-			double x2 = segments[i][5], y2 = segments[i][6];
-
-			double ts[3];
-			ts[0] = 0.25;
-			ts[1] = 0.5;
-			ts[2] = 0.75;
-
-			for (int ti = 0; ti < 3; ti++) {
-				double t = ts[ti];
+		if (segment[0] == 1.0) {
+			xy.push_back(segment[3]);
+			xy.push_back(segment[4]);
+		} else if (segment[0] == 2.0) {
+			double x0 = segment[1], y0 = segment[2];
+			double x1 = segment[3], y1 = segment[4];
+			double x2 = segment[5], y2 = segment[6];
+
+			for (int ti = 1; ti <= 3; ti++) {
+				double t = ti * 0.25;
 				double mt = 1.0 - t;
-				double bx = mt * mt * x0 + 2.0 * mt * t * x1 + t * t * x2;
-				double by = mt * mt * y0 + 2.0 * mt * t * y1 + t * t * y2;
-				std::vector<double> quadPoint(2);
-				quadPoint[0] = bx;
-				quadPoint[1] = by;
-				points.push_back(quadPoint);
+				xy.push_back(mt * mt * x0 + 2.0 * mt * t * x1 + t * t * x2);
+				xy.push_back(mt * mt * y0 + 2.0 * mt * t * y1 + t * t * y2);
 			}
 
-			std::vector<double> endPoint(2);
-			endPoint[0] = x2;
-			endPoint[1] = y2;
-			points.push_back(endPoint);
+			xy.push_back(x2);
+			xy.push_back(y2);
+		} else if (segment[0] == 3.0 && segment.size() >= 9) {
+			double x0 = segment[1], y0 = segment[2];
+			double x1 = segment[3], y1 = segment[4];
+			double x2 = segment[7], y2 = segment[8];
+			double x3 = segment[5], y3 = segment[6];
+
+			for (int ti = 1; ti <= 3; ti++) {
+				double t = ti * 0.25;
+				double mt = 1.0 - t;
+				xy.push_back(mt * mt * mt * x0 + 3.0 * mt * mt * t * x1
+					+ 3.0 * mt * t * t * x2 + t * t * t * x3);
+				xy.push_back(mt * mt * mt * y0 + 3.0 * mt * mt * t * y1
+					+ 3.0 * mt * t * t * y2 + t * t * t * y3);
+			}
+
+			xy.push_back(x3);
+			xy.push_back(y3);
 		}
 	}
+}
 
+std::vector<std::vector<double> >
+GeometryDetector::_ConvertSegmentsToPoints(const std::vector<std::vector<double> >& segments)
+{
+	std::vector<double> xy;
+	_FlattenSegments(segments, xy);
+
+	std::vector<std::vector<double> > points(xy.size() / 2, std::vector<double>(2));
+	for (size_t i = 0; i < points.size(); i++) {
+		points[i][0] = xy[2 * i];
+		points[i][1] = xy[2 * i + 1];
+	}
 	return points;
 }
 
+// Everything the detectors rule shapes out by, in one pass over the flat
+// points. The deepest dent counts how far a node lies inside the line
+// between its neighbours, against the way the outline turns.
+GeometryDetector::PathProfile
+GeometryDetector::_Profile(const std::vector<double>& xy) const
+{
+	PathProfile profile;
+	int n = static_cast<int>(xy.size() / 2);
+
+	double minX = xy[0], maxX = xy[0];
+	double minY = xy[1], maxY = xy[1];
+	double area2 = 0.0;
+	double perimeter = 0.0;
+	for (int i = 0; i < n; i++) {
+		double x = xy[2 * i], y = xy[2 * i + 1];
+		int j = (i + 1) % n;
+		double nx = xy[2 * j], ny = xy[2 * j + 1];
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		area2 += x * ny - nx * y;
+		perimeter += std::sqrt((nx - x) * (nx - x) + (ny - y) * (ny - y));
+	}
+
+	double orientation = area2 >= 0.0 ? 1.0 : -1.0;
+	double maxDent = 0.0;
+	for (int i = 0; i < n; i++) {
+		int h = (i + n - 1) % n;
+		int j = (i + 1) % n;
+		double ax = xy[2 * i] - xy[2 * h], ay = xy[2 * i + 1] - xy[2 * h + 1];
+		double bx = xy[2 * j] - xy[2 * i], by = xy[2 * j + 1] - xy[2 * i + 1];
+		double turn = (ax * by - ay * bx) * orientation;
+		if (turn >= 0.0)
+			continue;
+
+		double cx = xy[2 * j] - xy[2 * h], cy = xy[2 * j + 1] - xy[2 * h + 1];
+		double chord = std::sqrt(cx * cx + cy * cy);
+		if (chord > 1e-12)
+			maxDent = std::max(maxDent, -turn / chord);
+	}
+
+	double gapX = xy[0] - xy[2 * (n - 1)];
+	double gapY = xy[1] - xy[2 * (n - 1) + 1];
+
+	profile.count = n;
+	profile.closingGap = std::sqrt(gapX * gapX + gapY * gapY);
+	profile.width = maxX - minX;
+	profile.height = maxY - minY;
+	profile.area = std::fabs(area2) / 2.0;
+	profile.perimeter = perimeter;
+	profile.maxDent = maxDent;
+	return profile;
+}
+
 bool
 GeometryDetector::_IsClosedPath(const std::vector<std::vector<double> >& points, double tolerance)
 {
@@ -379,6 +466,152 @@ GeometryDetector::_PolygonAreaAbs(const std::vector<std::vector<double> >& point
 	return std::fabs(0.5 * area2);
 }
 
+std::vector<std::vector<double> >
+GeometryDetector::_ConvexHull(const std::vector<std::vector<double> >& points) const
+{
+	std::vector<std::vector<double> > sorted(points);
+	std::sort(sorted.begin(), sorted.end());
+
+	int n = static_cast<int>(sorted.size());
+	if (n < 3)
+		return sorted;
+
+	std::vector<std::vector<double> > hull(2 * n);
+	int k = 0;
+	for (int i = 0; i < n; i++) {
+		while (k >= 2 && _Cross(hull[k - 2], hull[k - 1], sorted[i]) <= 0)
+			k--;
+		hull[k++] = sorted[i];
+	}
+	for (int i = n - 2, lower = k + 1; i >= 0; i--) {
+		while (k >= lower && _Cross(hull[k - 2], hull[k - 1], sorted[i]) <= 0)
+			k--;
+		hull[k++] = sorted[i];
+	}
+
+	hull.resize(k - 1);
+	return hull;
+}
+
+std::vector<std::vector<double> >
+GeometryDetector::_Densify(const std::vector<std::vector<double> >& points, double step,
+	bool closed) const
+{
+	std::vector<std::vector<double> > dense;
+	int n = static_cast<int>(points.size());
+	if (n == 0)
+		return dense;
+
+	dense.reserve(n * 2);
+	int edges = closed ? n : n - 1;
+	for (int i = 0; i < edges; i++) {
+		const std::vector<double>& a = points[i];
+		const std::vector<double>& b = points[(i + 1) % n];
+		double length = std::sqrt((b[0] - a[0]) * (b[0] - a[0]) + (b[1] - a[1]) * (b[1] - a[1]));
+		int pieces = std::max(1, static_cast<int>(std::ceil(length / step)));
+		for (int j = 0; j < pieces; j++) {
+			double t = static_cast<double>(j) / pieces;
+			std::vector<double> point(2);
+			point[0] = a[0] + (b[0] - a[0]) * t;
+			point[1] = a[1] + (b[1] - a[1]) * t;
+			dense.push_back(point);
+		}
+	}
+	if (!closed)
+		dense.push_back(points[n - 1]);
+
+	return dense;
+}
+
+// Signed distance from the outline of a rounded rectangle centered on the
+// origin, negative inside.
+double
+GeometryDetector::_RoundedRectDistance(double u, double v, double halfWidth,
+	double halfHeight, double radius) const
+{
+	double qx = std::fabs(u) - (halfWidth - radius);
+	double qy = std::fabs(v) - (halfHeight - radius);
+	double ox = std::max(qx, 0.0);
+	double oy = std::max(qy, 0.0);
+	return std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0) - radius;
+}
+
+void
+GeometryDetector::_AppendEllipticArc(std::vector<std::vector<double> >& segments,
+	double cx, double cy, double rx, double ry, double angle,
+	double fromAngle, double toAngle) const
+{
+	double sweep = toAngle - fromAngle;
+	int pieces = _ArcPieces(sweep);
+	double step = sweep / pieces;
+	double k = 4.0 / 3.0 * std::tan(step / 4.0);
+	double cosA = std::cos(angle);
+	double sinA = std::sin(angle);
+
+	for (int i = 0; i < pieces; i++) {
+		double t1 = fromAngle + i * step;
+		double t2 = (i == pieces - 1) ? toAngle : t1 + step;
+
+		// Points and tangents of the unit circle, scaled to the radii and
+		// turned by the angle of the ellipse.
+		double u1 = rx * std::cos(t1), v1 = ry * std::sin(t1);
+		double du1 = -rx * std::sin(t1), dv1 = ry * std::cos(t1);
+		double u2 = rx * std::cos(t2), v2 = ry * std::sin(t2);
+		double du2 = -rx * std::sin(t2), dv2 = ry * std::cos(t2);
+
+		double c1u = u1 + k * du1, c1v = v1 + k * dv1;
+		double c2u = u2 - k * du2, c2v = v2 - k * dv2;
+
+		std::vector<double> segment(9);
+		segment[0] = 3.0;
+		segment[1] = cx + u1 * cosA - v1 * sinA;
+		segment[2] = cy + u1 * sinA + v1 * cosA;
+		segment[3] = cx + c1u * cosA - c1v * sinA;
+		segment[4] = cy + c1u * sinA + c1v * cosA;
+		segment[5] = cx + u2 * cosA - v2 * sinA;
+		segment[6] = cy + u2 * sinA + v2 * cosA;
+		segment[7] = cx + c2u * cosA - c2v * sinA;
+		segment[8] = cy + c2u * sinA + c2v * cosA;
+		segments.push_back(segment);
+	}
+}
+
+void
+GeometryDetector::_AppendLine(std::vector<std::vector<double> >& segments,
+	double x1, double y1, double x2, double y2) const
+{
+	if (std::fabs(x2 - x1) < 1e-9 && std::fabs(y2 - y1) < 1e-9)
+		return;
+
+	std::vector<double> segment(7, 0.0);
+	segment[0] = 1.0;
+	segment[1] = x1;
+	segment[2] = y1;
+	segment[3] = x2;
+	segment[4] = y2;
+	segments.push_back(segment);
+}
+
+void
+GeometryDetector::_ReverseSegments(std::vector<std::vector<double> >& segments) const
+{
+	std::reverse(segments.begin(), segments.end());
+	for (size_t i = 0; i < segments.size(); i++) {
+		std::vector<double>& segment = segments[i];
+		if (segment[0] == 1.0) {
+			std::swap(segment[1], segment[3]);
+			std::swap(segment[2], segment[4]);
+		} else {
+			std::swap(segment[1], segment[5]);
+			std::swap(segment[2], segment[6]);
+			if (segment[0] == 3.0 && segment.size() >= 9) {
+				std::swap(segment[3], segment[7]);
+				std::swap(segment[4], segment[8]);
+			}
+		}
+	}
+}
+
 bool
 GeometryDetector::DetectLine(const std::vector<std::vector<double> >& path, float tolerance, Line& result)
 {
@@ -438,6 +671,16 @@ GeometryDetector::DetectCircle(const std::vector<std::vector<double> >& path,
 	if (maxError > tolerance || avgError > tolerance * 0.8)
 		return false;
 
+	// The nodes of a rounded square all lie close to one circle while the
+	// middle of its sides does not, so the points between them count too.
+	std::vector<std::vector<double> > dense = _Densify(path, std::max(1.0, (double)tolerance), true);
+	for (size_t i = 0; i < dense.size(); i++) {
+		double deltaX = dense[i][0] - centerX;
+		double deltaY = dense[i][1] - centerY;
+		if (std::fabs(std::sqrt(deltaX * deltaX + deltaY * deltaY) - radius) > tolerance)
+			return false;
+	}
+
 	double rSafe = std::max(1.0, radius);
 	double s = std::min(0.25, std::max(0.0, tolerance / rSafe));
 
@@ -485,6 +728,322 @@ GeometryDetector::DetectCircle(const std::vector<std::vector<double> >& path,
 	return true;
 }
 
+bool
+GeometryDetector::DetectRectangle(const std::vector<std::vector<double> >& path,
+								float tolerance, RectangleShape& result)
+{
+	if (path.size() < 4 || !_IsClosedPath(path, tolerance * 2))
+		return false;
+
+	// The sides dominate the outline of the hull, so the mean edge direction
+	// folded into a quarter turn is the angle of the rectangle; stair steps
+	// along turned sides do not reach the hull.
+	std::vector<std::vector<double> > hull = _ConvexHull(path);
+	if (hull.size() < 3)
+		return false;
+
+	double sumCos = 0.0, sumSin = 0.0;
+	for (size_t i = 0; i < hull.size(); i++) {
+		const std::vector<double>& a = hull[i];
+		const std::vector<double>& b = hull[(i + 1) % hull.size()];
+		double dx = b[0] - a[0];
+		double dy = b[1] - a[1];
+		double length = std::sqrt(dx * dx + dy * dy);
+		double direction = 4.0 * std::atan2(dy, dx);
+		sumCos += length * std::cos(direction);
+		sumSin += length * std::sin(direction);
+	}
+	if (sumCos == 0.0 && sumSin == 0.0)
+		return false;
+
+	double angle = std::atan2(sumSin, sumCos) / 4.0;
+
+	double minU = 0, maxU = 0, minV = 0, maxV = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		double cosA = std::cos(angle);
+		double sinA = std::sin(angle);
+		minU = maxU = path[0][0] * cosA + path[0][1] * sinA;
+		minV = maxV = path[0][1] * cosA - path[0][0] * sinA;
+		for (size_t i = 1; i < path.size(); i++) {
+			double u = path[i][0] * cosA + path[i][1] * sinA;
+			double v = path[i][1] * cosA - path[i][0] * sinA;
+			minU = std::min(minU, u);
+			maxU = std::max(maxU, u);
+			minV = std::min(minV, v);
+			maxV = std::max(maxV, v);
+		}
+
+		// Keep rectangles that are all but upright exactly upright.
+		double extent = std::max(maxU - minU, maxV - minV);
+		if (pass > 0 || angle == 0.0 || std::fabs(std::sin(angle)) * extent > tolerance * 0.5)
+			break;
+		angle = 0.0;
+	}
+
+	double halfWidth = (maxU - minU) / 2.0;
+	double halfHeight = (maxV - minV) / 2.0;
+	if (halfWidth < tolerance || halfHeight < tolerance)
+		return false;
+
+	double centerU = (minU + maxU) / 2.0;
+	double centerV = (minV + maxV) / 2.0;
+	double cosA = std::cos(angle);
+	double sinA = std::sin(angle);
+
+	// Whatever the corner radius, the outline stays inside the box and the
+	// middle of a corner is at most r (1 - 1 / sqrt(2)) from its sides, so
+	// the nodes alone rule out most shapes before the outline is sampled.
+	double maxInset = tolerance + (1.0 - M_SQRT1_2) * std::min(halfWidth, halfHeight);
+	for (size_t i = 0; i < path.size(); i++) {
+		double u = path[i][0] * cosA + path[i][1] * sinA - centerU;
+		double v = path[i][1] * cosA - path[i][0] * sinA - centerV;
+		double distance = _RoundedRectDistance(u, v, halfWidth, halfHeight, 0.0);
+		if (distance > tolerance || distance < -maxInset)
+			return false;
+	}
+
+	// Points between the nodes count as well, or a polygon with all its
+	// nodes on the outline, like an octagon in its box, would pass.
+	std::vector<std::vector<double> > dense = _Densify(path, std::max(1.0, (double)tolerance), true);
+
+	// A corner rounded by r keeps the outline r (sqrt(2) - 1) away from the
+	// corner of the box. The middle two of the four corners decide, so a
+	// single notch or spike does not.
+	double cornerDistance[4] = { 1e300, 1e300, 1e300, 1e300 };
+	for (size_t i = 0; i < dense.size(); i++) {
+		double u = dense[i][0] * cosA + dense[i][1] * sinA - centerU;
+		double v = dense[i][1] * cosA - dense[i][0] * sinA - centerV;
+		int corner = (u > 0.0 ? 1 : 0) + (v > 0.0 ? 2 : 0);
+		double du = std::fabs(u) - halfWidth;
+		double dv = std::fabs(v) - halfHeight;
+		cornerDistance[corner] = std::min(cornerDistance[corner], std::sqrt(du * du + dv * dv));
+	}
+	std::sort(cornerDistance, cornerDistance + 4);
+	double rounded = (cornerDistance[1] + cornerDistance[2]) / 2.0 / (M_SQRT2 - 1.0);
+	rounded = std::min(rounded, std::min(halfWidth, halfHeight));
+
+	// Noise at the corners looks like a little rounding, so sharp corners
+	// win unless rounding halves the error.
+	double radii[2] = { 0.0, rounded >= tolerance * 0.5 ? rounded : 0.0 };
+	double errors[2];
+	bool fits[2];
+	for (int candidate = 0; candidate < 2; candidate++) {
+		double maxError = 0.0;
+		double avgError = 0.0;
+		for (size_t i = 0; i < dense.size(); i++) {
+			double u = dense[i][0] * cosA + dense[i][1] * sinA - centerU;
+			double v = dense[i][1] * cosA - dense[i][0] * sinA - centerV;
+			double error = std::fabs(_RoundedRectDistance(u, v, halfWidth, halfHeight,
+				radii[candidate]));
+			maxError = std::max(maxError, error);
+			avgError += error;
+		}
+		avgError /= dense.size();
+
+		errors[candidate] = maxError;
+		fits[candidate] = maxError <= tolerance && avgError <= tolerance * 0.5;
+	}
+
+	int chosen = fits[1] && (!fits[0] || errors[1] < errors[0] * 0.5) ? 1 : 0;
+	if (!fits[chosen])
+		return false;
+
+	double radius = radii[chosen];
+	double maxError = errors[chosen];
+
+	result.centerX = centerU * cosA - centerV * sinA;
+	result.centerY = centerU * sinA + centerV * cosA;
+	result.halfWidth = halfWidth;
+	result.halfHeight = halfHeight;
+	result.angle = angle;
+	result.cornerRadius = radius;
+	result.error = maxError;
+	return true;
+}
+
+bool
+GeometryDetector::DetectEllipse(const std::vector<std::vector<double> >& path,
+								float tolerance, float minRadius, float maxRadius,
+								EllipseShape& result)
+{
+	if (path.size() < 6 || !_IsClosedPath(path, tolerance * 2))
+		return false;
+
+	// Least squares conic A x^2 + B xy + C y^2 + D x + E y = 1 through the
+	// points, moved to their centroid and scaled to unit size so the origin
+	// lies inside and the normal equations stay well conditioned.
+	int n = static_cast<int>(path.size());
+	double meanX = 0.0, meanY = 0.0;
+	for (int i = 0; i < n; i++) {
+		meanX += path[i][0];
+		meanY += path[i][1];
+	}
+	meanX /= n;
+	meanY /= n;
+
+	double scale = 0.0;
+	for (int i = 0; i < n; i++) {
+		double dx = path[i][0] - meanX;
+		double dy = path[i][1] - meanY;
+		scale += dx * dx + dy * dy;
+	}
+	scale = std::sqrt(scale / n);
+	if (scale < 1e-6)
+		return false;
+
+	double M[5][5] = { { 0 } };
+	double B[5] = { 0 };
+	for (int i = 0; i < n; i++) {
+		double x = (path[i][0] - meanX) / scale;
+		double y = (path[i][1] - meanY) / scale;
+		double row[5] = { x * x, x * y, y * y, x, y };
+		for (int j = 0; j < 5; j++) {
+			for (int k = 0; k < 5; k++)
+				M[j][k] += row[j] * row[k];
+			B[j] += row[j];
+		}
+	}
+
+	double X[5];
+	if (!MathUtils::Solve5x5(M, B, X))
+		return false;
+
+	double a = X[0], b = X[1], c = X[2], d = X[3], e = X[4];
+	double determinant = 4.0 * a * c - b * b;
+	if (determinant <= 1e-12)
+		return false;
+
+	double x0 = (b * e - 2.0 * c * d) / determinant;
+	double y0 = (b * d - 2.0 * a * e) / determinant;
+	double f = a * x0 * x0 + b * x0 * y0 + c * y0 * y0 + d * x0 + e * y0 - 1.0;
+
+	double angle = 0.5 * std::atan2(b, a - c);
+	double cosA = std::cos(angle);
+	double sinA = std::sin(angle);
+	double lambda1 = a * cosA * cosA + b * cosA * sinA + c * sinA * sinA;
+	double lambda2 = a * sinA * sinA - b * cosA * sinA + c * cosA * cosA;
+	if (-f / lambda1 <= 0.0 || -f / lambda2 <= 0.0)
+		return false;
+
+	double rx = std::sqrt(-f / lambda1) * scale;
+	double ry = std::sqrt(-f / lambda2) * scale;
+	double cx = meanX + x0 * scale;
+	double cy = meanY + y0 * scale;
+	if (!std::isfinite(rx) || !std::isfinite(ry) || !std::isfinite(cx) || !std::isfinite(cy))
+		return false;
+	if (std::min(rx, ry) < minRadius || std::max(rx, ry) > maxRadius)
+		return false;
+
+	double ellipseArea = M_PI * rx * ry;
+	if (std::fabs(_PolygonAreaAbs(path) - ellipseArea) > ellipseArea * 0.1)
+		return false;
+
+	// Distances to the curve estimated to first order, from the value of
+	// the implicit function and its gradient; the nodes are checked before
+	// the points between them.
+	std::vector<std::vector<double> > dense;
+	double maxError = 0.0;
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass > 0)
+			dense = _Densify(path, std::max(1.0, (double)tolerance), true);
+		const std::vector<std::vector<double> >& points = pass > 0 ? dense : path;
+
+		maxError = 0.0;
+		double avgError = 0.0;
+		for (size_t i = 0; i < points.size(); i++) {
+			double dx = points[i][0] - cx;
+			double dy = points[i][1] - cy;
+			double u = dx * cosA + dy * sinA;
+			double v = dy * cosA - dx * sinA;
+			double value = (u * u) / (rx * rx) + (v * v) / (ry * ry) - 1.0;
+			double gu = 2.0 * u / (rx * rx);
+			double gv = 2.0 * v / (ry * ry);
+			double gradient = std::sqrt(gu * gu + gv * gv);
+			double error = gradient > 1e-12 ? std::fabs(value) / gradient : std::max(rx, ry);
+			maxError = std::max(maxError, error);
+			avgError += error;
+		}
+		avgError /= points.size();
+
+		// The average only counts over the evenly spread points.
+		if (maxError > tolerance || (pass > 0 && avgError > tolerance * 0.5))
+			return false;
+	}
+
+	result = EllipseShape(cx, cy, rx, ry, angle, maxError);
+	return true;
+}
+
+bool
+GeometryDetector::DetectArc(const std::vector<std::vector<double> >& path,
+							float tolerance, float minRadius, float maxRadius, ArcShape& result)
+{
+	if (path.size() < 3)
+		return false;
+
+	double cx, cy, r;
+	if (!_FitCircleKasa(path, cx, cy, r))
+		return false;
+	_RefineCircleGaussNewton(path, cx, cy, r, 5);
+	if (!std::isfinite(cx) || !std::isfinite(cy) || !std::isfinite(r))
+		return false;
+	if (r < minRadius || r > maxRadius)
+		return false;
+
+	std::vector<std::vector<double> > dense;
+	double maxError = 0.0;
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass > 0)
+			dense = _Densify(path, std::max(1.0, (double)tolerance), false);
+		const std::vector<std::vector<double> >& points = pass > 0 ? dense : path;
+
+		maxError = 0.0;
+		double avgError = 0.0;
+		for (size_t i = 0; i < points.size(); i++) {
+			double dx = points[i][0] - cx;
+			double dy = points[i][1] - cy;
+			double error = std::fabs(std::sqrt(dx * dx + dy * dy) - r);
+			maxError = std::max(maxError, error);
+			avgError += error;
+		}
+		avgError /= points.size();
+
+		// The average only counts over the evenly spread points.
+		if (maxError > tolerance || (pass > 0 && avgError > tolerance * 0.5))
+			return false;
+	}
+
+	// The points have to run around the center one way.
+	double sweep = 0.0;
+	double previous = _AngleFromCenter(cx, cy, path[0][0], path[0][1]);
+	double startAngle = previous;
+	for (size_t i = 1; i < path.size(); i++) {
+		double current = _AngleFromCenter(cx, cy, path[i][0], path[i][1]);
+		double delta = current - previous;
+		if (delta > M_PI)
+			delta -= 2.0 * M_PI;
+		else if (delta < -M_PI)
+			delta += 2.0 * M_PI;
+
+		if (sweep != 0.0 && delta * sweep < 0.0 && std::fabs(delta) * r > tolerance)
+			return false;
+
+		sweep += delta;
+		previous = current;
+	}
+
+	if (std::fabs(sweep) >= 2.0 * M_PI)
+		return false;
+
+	result.centerX = cx;
+	result.centerY = cy;
+	result.radius = r;
+	result.startAngle = startAngle;
+	result.sweep = sweep;
+	result.error = maxError;
+	return true;
+}
+
 std::vector<std::vector<double> >
 GeometryDetector::CreateLineSegment(const Line& line)
 {
@@ -504,126 +1063,271 @@ GeometryDetector::CreateLineSegment(const Line& line)
 }
 
 std::vector<std::vector<double> >
-GeometryDetector::CreateCircleSegment(const Circle& circle, double startAngle, bool clockwise)
+GeometryDetector::CreateRectangleSegment(const RectangleShape& rect, bool clockwise)
 {
 	std::vector<std::vector<double> > segments;
 
-	int numSegments;
-	if (circle.radius <= 10) {
-		numSegments = 4;
-	} else if (circle.radius <= 50) {
-		numSegments = 6;
-	} else if (circle.radius <= 100) {
-		numSegments = 8;
-	} else {
-		numSegments = std::min(16, static_cast<int>(circle.radius / 20.0));
+	double r = rect.cornerRadius;
+	double a = rect.halfWidth - r;
+	double b = rect.halfHeight - r;
+	double cosA = std::cos(rect.angle);
+	double sinA = std::sin(rect.angle);
+
+	// Corners of the box, or centers of the rounded corners, in the order
+	// the outline passes them, each followed by the side after it.
+	const double corners[4][2] = { { a, b }, { -a, b }, { -a, -b }, { a, -b } };
+	for (int i = 0; i < 4; i++) {
+		double u = corners[i][0];
+		double v = corners[i][1];
+		double x = rect.centerX + u * cosA - v * sinA;
+		double y = rect.centerY + u * sinA + v * cosA;
+		double turn = i * M_PI / 2.0;
+
+		if (r > 0.0)
+			_AppendEllipticArc(segments, x, y, r, r, rect.angle, turn, turn + M_PI / 2.0);
+
+		const double* next = corners[(i + 1) % 4];
+		double su = u + r * std::cos(turn + M_PI / 2.0);
+		double sv = v + r * std::sin(turn + M_PI / 2.0);
+		double eu = next[0] + r * std::cos(turn + M_PI / 2.0);
+		double ev = next[1] + r * std::sin(turn + M_PI / 2.0);
+		_AppendLine(segments,
+			rect.centerX + su * cosA - sv * sinA, rect.centerY + su * sinA + sv * cosA,
+			rect.centerX + eu * cosA - ev * sinA, rect.centerY + eu * sinA + ev * cosA);
 	}
-	if (numSegments < 3) numSegments = 3;
-
-	double angleStepAbs = 2.0 * M_PI / static_cast<double>(numSegments);
-	double angleStep = clockwise ? angleStepAbs : -angleStepAbs;
-
-	double xStart = circle.centerX + circle.radius * std::cos(startAngle);
-	double yStart = circle.centerY + circle.radius * std::sin(startAngle);
 
-	for (int i = 0; i < numSegments; i++) {
-		double a1 = startAngle + i * angleStep;
-		double a2 = a1 + angleStep;
+	if (!clockwise)
+		_ReverseSegments(segments);
 
-		double x1 = circle.centerX + circle.radius * std::cos(a1);
-		double y1 = circle.centerY + circle.radius * std::sin(a1);
-		double x2 = circle.centerX + circle.radius * std::cos(a2);
-		double y2 = circle.centerY + circle.radius * std::sin(a2);
-
-		double half = 0.5 * angleStep;
-		double midAngle = a1 + half;
-		double c = std::cos(half);
-		double controlRadius = (std::fabs(c) < 1e-6) ? circle.radius : (circle.radius / c);
-
-		double cx = circle.centerX + controlRadius * std::cos(midAngle);
-		double cy = circle.centerY + controlRadius * std::sin(midAngle);
+	return segments;
+}
 
-		if (i == numSegments - 1) {
-			x2 = xStart;
-			y2 = yStart;
-		}
+std::vector<std::vector<double> >
+GeometryDetector::CreateEllipseSegment(const EllipseShape& ellipse, double startAngle,
+	bool clockwise)
+{
+	std::vector<std::vector<double> > segments;
+	double endAngle = startAngle + (clockwise ? 2.0 * M_PI : -2.0 * M_PI);
+	_AppendEllipticArc(segments, ellipse.centerX, ellipse.centerY, ellipse.radiusX,
+		ellipse.radiusY, ellipse.angle, startAngle, endAngle);
 
-		std::vector<double> segment(7);
-		segment[0] = 2.0;
-		segment[1] = x1;
-		segment[2] = y1;
-		segment[3] = cx;
-		segment[4] = cy;
-		segment[5] = x2;
-		segment[6] = y2;
+	segments.back()[5] = segments.front()[1];
+	segments.back()[6] = segments.front()[2];
+	return segments;
+}
 
-		segments.push_back(segment);
-	}
+std::vector<std::vector<double> >
+GeometryDetector::CreateCircleSegment(const Circle& circle, double startAngle, bool clockwise)
+{
+	EllipseShape round(circle.centerX, circle.centerY, circle.radius, circle.radius, 0.0,
+		circle.error);
+	return CreateEllipseSegment(round, startAngle, clockwise);
+}
 
+std::vector<std::vector<double> >
+GeometryDetector::CreateArcSegment(const ArcShape& arc)
+{
+	std::vector<std::vector<double> > segments;
+	_AppendEllipticArc(segments, arc.centerX, arc.centerY, arc.radius, arc.radius, 0.0,
+		arc.startAngle, arc.startAngle + arc.sweep);
 	return segments;
 }
 
-std::vector<std::vector<std::vector<double> > >
-GeometryDetector::BatchGeometryDetection(const std::vector<std::vector<std::vector<double> > >& paths,
-										const TracingOptions& options)
+// Adds up the turns at the nodes of run from index first on, or returns
+// NaN at a turn against the sum so far that dents the run deeper than an
+// arc within the tolerance could.
+double
+GeometryDetector::_RunTurning(const std::vector<std::vector<double> >& run, size_t first,
+	double turning, double tolerance) const
 {
-	std::vector<std::vector<std::vector<double> > > detectedPaths;
+	for (size_t i = std::max(first, (size_t)1); i + 1 < run.size(); i++) {
+		const std::vector<double>& a = run[i - 1];
+		const std::vector<double>& b = run[i];
+		const std::vector<double>& c = run[i + 1];
+		double turn = (b[0] - a[0]) * (c[1] - b[1]) - (b[1] - a[1]) * (c[0] - b[0]);
+		double chord = std::sqrt((c[0] - a[0]) * (c[0] - a[0]) + (c[1] - a[1]) * (c[1] - a[1]));
+		if (turn * turning < 0.0 && chord > 1e-12 && std::fabs(turn) / chord > tolerance * 2.0)
+			return std::numeric_limits<double>::quiet_NaN();
+		turning += turn;
+	}
+	return turning;
+}
 
-	for (int i = 0; i < static_cast<int>(paths.size()); i++) {
-		if (paths[i].empty()) {
-			detectedPaths.push_back(paths[i]);
+// Replaces runs of curves that follow one circle with as few cubic arcs as
+// cover the turn. Lines are left alone, and the ends of a run stay where
+// they were so the rest of the outline still meets them.
+std::vector<std::vector<double> >
+GeometryDetector::_ReplaceArcs(const std::vector<std::vector<double> >& segments,
+	const TracingOptions& options)
+{
+	int n = static_cast<int>(segments.size());
+	std::vector<std::vector<std::vector<double> > > samples(n);
+	for (int i = 0; i < n; i++) {
+		if (segments[i][0] == 1.0)
 			continue;
-		}
+		std::vector<std::vector<double> > single(1, segments[i]);
+		samples[i] = _ConvertSegmentsToPoints(single);
+		samples[i].erase(samples[i].begin());
+	}
 
-		std::vector<std::vector<double> > pathPoints = _ConvertSegmentsToPoints(paths[i]);
+	std::vector<std::vector<double> > result;
+	result.reserve(n);
+
+	int i = 0;
+	while (i < n) {
+		int bestLength = 0;
+		ArcShape best;
+
+		if (segments[i][0] != 1.0) {
+			std::vector<std::vector<double> > run(1, std::vector<double>(2));
+			run[0][0] = segments[i][1];
+			run[0][1] = segments[i][2];
+			run.insert(run.end(), samples[i].begin(), samples[i].end());
+
+			double turning = _RunTurning(run, 1, 0.0, options.fLineTolerance);
+			for (int j = i + 1; j < n && segments[j][0] != 1.0; j++) {
+				size_t added = run.size();
+				run.insert(run.end(), samples[j].begin(), samples[j].end());
+
+				// A node bending deeply against the run ends it without a fit.
+				turning = _RunTurning(run, added - 1, turning, options.fLineTolerance);
+				if (std::isnan(turning))
+					break;
+
+				ArcShape arc;
+				if (!DetectArc(run, options.fLineTolerance, options.fMinCircleRadius,
+						options.fMaxCircleRadius, arc)) {
+					break;
+				}
+
+				int length = j - i + 1;
+				if (std::fabs(arc.sweep) >= M_PI / 4.0 && _ArcPieces(arc.sweep) < length) {
+					best = arc;
+					bestLength = length;
+				}
+			}
+		}
 
-		if (pathPoints.size() < 3) {
-			detectedPaths.push_back(paths[i]);
+		if (bestLength == 0) {
+			result.push_back(segments[i]);
+			i++;
 			continue;
 		}
 
-		double minX = pathPoints[0][0], maxX = pathPoints[0][0];
-		double minY = pathPoints[0][1], maxY = pathPoints[0][1];
+		std::vector<std::vector<double> > arc = CreateArcSegment(best);
+		const std::vector<double>& last = segments[i + bestLength - 1];
+		arc.front()[1] = segments[i][1];
+		arc.front()[2] = segments[i][2];
+		arc.back()[5] = last[0] == 1.0 ? last[3] : last[5];
+		arc.back()[6] = last[0] == 1.0 ? last[4] : last[6];
+		result.insert(result.end(), arc.begin(), arc.end());
+		i += bestLength;
+	}
 
-		for (size_t j = 0; j < pathPoints.size(); j++) {
-			minX = std::min(minX, pathPoints[j][0]);
-			maxX = std::max(maxX, pathPoints[j][0]);
-			minY = std::min(minY, pathPoints[j][1]);
-			maxY = std::max(maxY, pathPoints[j][1]);
-		}
+	return result;
+}
 
-		double objectWidth = maxX - minX;
-		double objectHeight = maxY - minY;
-		double maxObjectSize = std::max(objectWidth, objectHeight);
+// Runs the detectors that the profile of the outline leaves a chance, in
+// the order circle, rectangle, ellipse, line. An outline that follows one
+// of the convex shapes within a tolerance does not dent in by much more
+// than twice that tolerance. Circles also need a bounding box of aspect
+// 1.6 at most, as DetectCircle requires, and an outline not much longer
+// than their circumference.
+std::vector<std::vector<double> >
+GeometryDetector::_DetectPath(const std::vector<std::vector<double> >& path,
+	const TracingOptions& options)
+{
+	if (path.empty())
+		return path;
+
+	std::vector<double> xy;
+	_FlattenSegments(path, xy);
+	if (xy.size() < 6)
+		return path;
+
+	PathProfile profile = _Profile(xy);
+
+	double circleTol = options.fCircleTolerance;
+	double lineTol = options.fLineTolerance;
+	double longSide = std::max(profile.width, profile.height);
+	double shortSide = std::max(1e-6, std::min(profile.width, profile.height));
+	double roundness = profile.perimeter > 0.0
+		? 4.0 * M_PI * profile.area / (profile.perimeter * profile.perimeter) : 0.0;
+
+	bool circleCandidate = profile.count >= 6 && profile.closingGap <= circleTol * 2.0
+		&& longSide / shortSide <= 1.6 && roundness >= 0.3 && profile.maxDent <= circleTol * 2.0;
+	bool rectangleCandidate = profile.count >= 4 && profile.closingGap <= lineTol * 2.0
+		&& profile.maxDent <= lineTol * 2.0;
+	bool ellipseCandidate = profile.count >= 6 && profile.closingGap <= circleTol * 2.0
+		&& profile.maxDent <= circleTol * 2.0;
+
+	std::vector<std::vector<double> > pathPoints(profile.count, std::vector<double>(2));
+	for (int j = 0; j < profile.count; j++) {
+		pathPoints[j][0] = xy[2 * j];
+		pathPoints[j][1] = xy[2 * j + 1];
+	}
 
-		double closedTol = options.fCircleTolerance * 2.0;
+	double signedArea = _SignedArea(pathPoints);
+	bool clockwise = (signedArea > 0.0);
 
-		double signedArea = _SignedArea(pathPoints);
-		bool clockwise = (signedArea > 0.0);
+	Circle circle;
+	if (circleCandidate && DetectCircle(pathPoints, options.fCircleTolerance,
+			options.fMinCircleRadius, options.fMaxCircleRadius, circle)) {
 
-		Circle circle;
-		if (_IsClosedPath(pathPoints, closedTol) && DetectCircle(pathPoints, options.fCircleTolerance,
-						options.fMinCircleRadius, options.fMaxCircleRadius, circle)) {
+		double startAngle = _AngleFromCenter(circle.centerX, circle.centerY,
+												pathPoints.front()[0], pathPoints.front()[1]);
 
-			double startAngle = _AngleFromCenter(circle.centerX, circle.centerY,
-													pathPoints.front()[0], pathPoints.front()[1]);
+		double circleDiameter = circle.radius * 2.0;
+		if (circleDiameter <= longSide * 1.5)
+			return CreateCircleSegment(circle, startAngle, clockwise);
+	}
 
-			double circleDiameter = circle.radius * 2.0;
-			if (circleDiameter <= maxObjectSize * 1.5) {
-				detectedPaths.push_back(CreateCircleSegment(circle, startAngle, clockwise));
-				continue;
-			}
-		}
+	RectangleShape rect;
+	if (rectangleCandidate && DetectRectangle(pathPoints, options.fLineTolerance, rect))
+		return CreateRectangleSegment(rect, clockwise);
+
+	EllipseShape ellipse;
+	if (ellipseCandidate && DetectEllipse(pathPoints, options.fCircleTolerance,
+			options.fMinCircleRadius, options.fMaxCircleRadius, ellipse)) {
+		double dx = pathPoints.front()[0] - ellipse.centerX;
+		double dy = pathPoints.front()[1] - ellipse.centerY;
+		double u = dx * std::cos(ellipse.angle) + dy * std::sin(ellipse.angle);
+		double v = dy * std::cos(ellipse.angle) - dx * std::sin(ellipse.angle);
+		double startAngle = std::atan2(v / ellipse.radiusY, u / ellipse.radiusX);
+		return CreateEllipseSegment(ellipse, startAngle, clockwise);
+	}
 
-		Line line;
-		if (DetectLine(pathPoints, options.fLineTolerance, line)) {
-			detectedPaths.push_back(CreateLineSegment(line));
-			continue;
-		}
+	Line line;
+	if (DetectLine(pathPoints, options.fLineTolerance, line))
+		return CreateLineSegment(line);
+
+	return _ReplaceArcs(path, options);
+}
 
-		detectedPaths.push_back(paths[i]);
+std::vector<std::vector<std::vector<double> > >
+GeometryDetector::BatchGeometryDetection(const std::vector<std::vector<std::vector<double> > >& paths,
+										const TracingOptions& options)
+{
+	std::vector<std::vector<std::vector<double> > > detectedPaths(paths.size());
+	if (paths.empty())
+		return detectedPaths;
+
+	std::atomic<int> nextPath(0);
+	int numWorkers = (int)std::thread::hardware_concurrency();
+	if (numWorkers < 1) numWorkers = 1;
+	if (numWorkers > (int)paths.size()) numWorkers = (int)paths.size();
+
+	if (numWorkers == 1) {
+		for (size_t i = 0; i < paths.size(); i++)
+			detectedPaths[i] = _DetectPath(paths[i], options);
+		return detectedPaths;
 	}
 
+	ParallelUtils::ParallelFor(0, numWorkers, [&](int) {
+		for (int i = nextPath++; i < (int)paths.size(); i = nextPath++)
+			detectedPaths[i] = _DetectPath(paths[i], options);
+	});
+
 	return detectedPaths;
 }
 
@@ -631,10 +1335,41 @@ std::vector<std::vector<std::vector<std::vector<double> > > >
 GeometryDetector::BatchLayerGeometryDetection(const std::vector<std::vector<std::vector<std::vector<double> > > >& layers,
 											const TracingOptions& options)
 {
-	std::vector<std::vector<std::vector<std::vector<double> > > > detectedLayers;
+	std::vector<std::vector<std::vector<std::vector<double> > > > detectedLayers(layers.size());
+	std::vector<std::pair<int, int> > jobs;
+	for (int k = 0; k < static_cast<int>(layers.size()); k++) {
+		detectedLayers[k].resize(layers[k].size());
+		for (int i = 0; i < static_cast<int>(layers[k].size()); i++)
+			jobs.push_back(std::make_pair(k, i));
+	}
 
-	for (int k = 0; k < static_cast<int>(layers.size()); k++)
-		detectedLayers.push_back(BatchGeometryDetection(layers[k], options));
+	if (jobs.empty())
+		return detectedLayers;
+
+	// Path sizes vary widely, so workers pull paths from a shared counter
+	// instead of taking fixed blocks.
+	std::atomic<int> nextJob(0);
+	int numWorkers = (int)std::thread::hardware_concurrency();
+	if (numWorkers < 1) numWorkers = 1;
+	if (numWorkers > (int)jobs.size()) numWorkers = (int)jobs.size();
+
+	// A single job, or a single core, is not worth a thread.
+	if (numWorkers == 1) {
+		for (size_t j = 0; j < jobs.size(); j++) {
+			int k = jobs[j].first;
+			int i = jobs[j].second;
+			detectedLayers[k][i] = _DetectPath(layers[k][i], options);
+		}
+		return detectedLayers;
+	}
+
+	ParallelUtils::ParallelFor(0, numWorkers, [&](int) {
+		for (int j = nextJob++; j < (int)jobs.size(); j = nextJob++) {
+			int k = jobs[j].first;
+			int i = jobs[j].second;
+			detectedLayers[k][i] = _DetectPath(layers[k][i], options);
+		}
+	});
 
 	return detectedLayers;
 }
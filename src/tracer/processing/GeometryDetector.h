@@ -28,6 +28,39 @@ struct Line {
 								: startX(x1), startY(y1), endX(x2), endY(y2), error(e) {}
 };
 
+// Rectangle turned by angle (radians) about its center, with rounded
+// corners when cornerRadius is above zero.
+struct RectangleShape {
+	double					centerX, centerY, halfWidth, halfHeight;
+	double					angle, cornerRadius;
+	double					error;
+
+							RectangleShape() : centerX(0), centerY(0), halfWidth(0), halfHeight(0),
+								angle(0), cornerRadius(0), error(0) {}
+};
+
+struct EllipseShape {
+	double					centerX, centerY, radiusX, radiusY;
+	double					angle;
+	double					error;
+
+							EllipseShape() : centerX(0), centerY(0), radiusX(0), radiusY(0),
+								angle(0), error(0) {}
+							EllipseShape(double x, double y, double rx, double ry, double a, double e)
+								: centerX(x), centerY(y), radiusX(rx), radiusY(ry), angle(a), error(e) {}
+};
+
+// Part of a circle from startAngle over sweep radians, positive sweeps
+// turning from +x towards +y.
+struct ArcShape {
+	double					centerX, centerY, radius;
+	double					startAngle, sweep;
+	double					error;
+
+							ArcShape() : centerX(0), centerY(0), radius(0), startAngle(0), sweep(0),
+								error(0) {}
+};
+
 class GeometryDetector {
 public:
 							GeometryDetector();
@@ -39,13 +72,36 @@ public:
 	bool					DetectCircle(const std::vector<std::vector<double> >& path,
 									float tolerance, float minRadius, float maxRadius, 
 									Circle& result);
+
+	bool					DetectRectangle(const std::vector<std::vector<double> >& path,
+									float tolerance, RectangleShape& result);
+
+	bool					DetectEllipse(const std::vector<std::vector<double> >& path,
+									float tolerance, float minRadius, float maxRadius,
+									EllipseShape& result);
+
+	// Fits an open run of points.
+	bool					DetectArc(const std::vector<std::vector<double> >& path,
+									float tolerance, float minRadius, float maxRadius,
+									ArcShape& result);
    
 	std::vector<std::vector<double> >
 							CreateLineSegment(const Line& line);
 
+	// The following emit cubic segments, one per quarter turn at most.
 	std::vector<std::vector<double> >
 							CreateCircleSegment(const Circle& circle, double startAngle, bool clockwise);
 
+	std::vector<std::vector<double> >
+							CreateRectangleSegment(const RectangleShape& rect, bool clockwise);
+
+	std::vector<std::vector<double> >
+							CreateEllipseSegment(const EllipseShape& ellipse, double startAngle,
+								bool clockwise);
+
+	std::vector<std::vector<double> >
+							CreateArcSegment(const ArcShape& arc);
+
 	std::vector<std::vector<std::vector<double> > >
 							BatchGeometryDetection(const std::vector<std::vector<std::vector<double> > >& paths,
 												const TracingOptions& options);
@@ -55,6 +111,22 @@ public:
 												const TracingOptions& options);
 
 private:
+	struct PathProfile {
+		int					count;
+		double				closingGap;
+		double				width, height;
+		double				area, perimeter;
+		double				maxDent;
+	};
+
+	std::vector<std::vector<double> >
+							_DetectPath(const std::vector<std::vector<double> >& path,
+								const TracingOptions& options);
+
+	void					_FlattenSegments(const std::vector<std::vector<double> >& segments,
+								std::vector<double>& xy) const;
+	PathProfile				_Profile(const std::vector<double>& xy) const;
+
 	double					_PerpendicularDistance(const std::vector<double>& point,
 												const std::vector<double>& lineStart,
 												const std::vector<double>& lineEnd);
@@ -90,6 +162,32 @@ private:
 										double cx, double cy) const;
 
 	double					_PolygonAreaAbs(const std::vector<std::vector<double> >& points) const;
+
+	std::vector<std::vector<double> >
+							_ConvexHull(const std::vector<std::vector<double> >& points) const;
+
+	std::vector<std::vector<double> >
+							_Densify(const std::vector<std::vector<double> >& points, double step,
+								bool closed) const;
+
+	double					_RoundedRectDistance(double u, double v, double halfWidth,
+								double halfHeight, double radius) const;
+
+	void					_AppendEllipticArc(std::vector<std::vector<double> >& segments,
+								double cx, double cy, double rx, double ry, double angle,
+								double fromAngle, double toAngle) const;
+
+	void					_AppendLine(std::vector<std::vector<double> >& segments,
+								double x1, double y1, double x2, double y2) const;
+
+	void					_ReverseSegments(std::vector<std::vector<double> >& segments) const;
+
+	double					_RunTurning(const std::vector<std::vector<double> >& run,
+								size_t first, double turning, double tolerance) const;
+
+	std::vector<std::vector<double> >
+							_ReplaceArcs(const std::vector<std::vector<double> >& segments,
+								const TracingOptions& options);
 };
 
 #endif
@@ -6,9 +6,13 @@
 #include <cmath>
 #include <cfloat>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
 
 #include "GradientDetector.h"
 #include "MathUtils.h"
+#include "ParallelUtils.h"
 
 static inline double sqr(double v) { return v * v; }
 
@@ -52,25 +56,6 @@ GradientDetector::_Bounds(const std::vector<std::vector<double> >& pts,
 	}
 }
 
-bool
-GradientDetector::_PointInPolygon(double x, double y,
-								  const std::vector<std::vector<double> >& poly)
-{
-	bool inside = false;
-	size_t n = poly.size();
-	if (n == 0) return false;
-	for (size_t i = 0, j = n - 1; i < n; j = i++) {
-		double xi = poly[i][0], yi = poly[i][1];
-		double xj = poly[j][0], yj = poly[j][1];
-		bool cond = ((yi > y) != (yj > y));
-		double denom = (yj - yi);
-		if (denom == 0.0) denom = 1e-12;
-		double xint = (xj - xi) * (y - yi) / denom + xi;
-		if (cond && (x < xint)) inside = !inside;
-	}
-	return inside;
-}
-
 void
 GradientDetector::_FlattenPath(const std::vector<std::vector<double> >& segments,
 							   std::vector<std::vector<double> >& outPoints,
@@ -95,11 +80,19 @@ GradientDetector::_FlattenPath(const std::vector<std::vector<double> >& segments
 			double x1 = seg[1], y1 = seg[2];
 			double cx = seg[3], cy = seg[4];
 			double x2 = seg[5], y2 = seg[6];
+			bool cubic = type == 3 && seg.size() >= 9;
+			double dx = cubic ? seg[7] : 0.0, dy = cubic ? seg[8] : 0.0;
 			for (int i = 0; i <= n; i++) {
 				double t = (double)i / (double)n;
 				double it = 1.0 - t;
-				double x = it*it*x1 + 2.0*it*t*cx + t*t*x2;
-				double y = it*it*y1 + 2.0*it*t*cy + t*t*y2;
+				double x, y;
+				if (cubic) {
+					x = it*it*it*x1 + 3.0*it*it*t*cx + 3.0*it*t*t*dx + t*t*t*x2;
+					y = it*it*it*y1 + 3.0*it*it*t*cy + 3.0*it*t*t*dy + t*t*t*y2;
+				} else {
+					x = it*it*x1 + 2.0*it*t*cx + t*t*x2;
+					y = it*it*y1 + 2.0*it*t*cy + t*t*y2;
+				}
 				if (outPoints.empty() || i > 0) {
 					std::vector<double> p(2);
 					p[0] = x; p[1] = y;
@@ -141,94 +134,76 @@ GradientDetector::_PointSegmentDistance(double px, double py, double x1, double
 	return std::sqrt(dx*dx + dy*dy);
 }
 
-double
-GradientDetector::_DistanceToPolygon(double px, double py, const std::vector<std::vector<double> >& poly)
+void
+GradientDetector::_AccumulateSample(SampleSums& s, double x, double y, double w, const double c[4])
 {
-	if (poly.size() < 2) return 0.0;
-	double best = DBL_MAX;
-	for (size_t i = 0, j = 1; j < poly.size(); i = j, j++) {
-		double d = _PointSegmentDistance(px, py, poly[i][0], poly[i][1], poly[j][0], poly[j][1]);
-		if (d < best) best = d;
+	if (s.count == 0) {
+		s.minX = s.maxX = x;
+		s.minY = s.maxY = y;
+	} else {
+		if (x < s.minX) s.minX = x;
+		if (x > s.maxX) s.maxX = x;
+		if (y < s.minY) s.minY = y;
+		if (y > s.maxY) s.maxY = y;
+	}
+	s.count++;
+
+	s.W   += w;
+	s.Wx  += w * x;
+	s.Wy  += w * y;
+	s.Wxx += w * x * x;
+	s.Wyy += w * y * y;
+	s.Wxy += w * x * y;
+
+	for (int ch = 0; ch < 4; ch++) {
+		double wv = w * c[ch];
+		s.Wc[ch]  += wv;
+		s.Wcx[ch] += wv * x;
+		s.Wcy[ch] += wv * y;
+		s.Wcc[ch] += wv * c[ch];
 	}
-	return best;
 }
 
 double
-GradientDetector::_ComputeVariance(const std::vector<double>& vals, const std::vector<double>& weights)
+GradientDetector::_ComputeVariance(const SampleSums& s, int channel)
 {
-	if (vals.empty()) return 0.0;
+	if (s.count == 0 || s.W < 1e-12) return 0.0;
 
-	double sumW = 0.0, sumVal = 0.0;
-	for (size_t i = 0; i < vals.size(); i++) {
-		double w = (i < weights.size()) ? weights[i] : 1.0;
-		sumW += w;
-		sumVal += w * vals[i];
-	}
-
-	if (sumW < 1e-12) return 0.0;
-	double mean = sumVal / sumW;
-
-	double variance = 0.0;
-	for (size_t i = 0; i < vals.size(); i++) {
-		double w = (i < weights.size()) ? weights[i] : 1.0;
-		double dev = vals[i] - mean;
-		variance += w * dev * dev;
-	}
-
-	return variance / sumW;
+	double mean = s.Wc[channel] / s.W;
+	double variance = s.Wcc[channel] / s.W - mean * mean;
+	return variance > 0.0 ? variance : 0.0;
 }
 
 bool
-GradientDetector::_ComputeChannelGradient(const std::vector<double>& vx,
-										  const std::vector<double>& vy,
-										  const std::vector<double>& vw,
-										  const std::vector<double>& vals,
+GradientDetector::_ComputeChannelGradient(const SampleSums& s,
+										  int channel,
 										  double& outGradX,
 										  double& outGradY,
 										  double& outR2)
 {
-	if (vx.size() < 10) return false;
-
-	double minX = vx[0], maxX = vx[0];
-	double minY = vy[0], maxY = vy[0];
-	for (size_t i = 1; i < vx.size(); i++) {
-		if (vx[i] < minX) minX = vx[i];
-		if (vx[i] > maxX) maxX = vx[i];
-		if (vy[i] < minY) minY = vy[i];
-		if (vy[i] > maxY) maxY = vy[i];
-	}
-	double rangeX = maxX - minX;
-	double rangeY = maxY - minY;
-	if (rangeX < 1e-6) rangeX = 1.0;
-	if (rangeY < 1e-6) rangeY = 1.0;
-
-	std::vector<double> normX(vx.size());
-	std::vector<double> normY(vy.size());
-	for (size_t i = 0; i < vx.size(); i++) {
-		normX[i] = (vx[i] - minX) / rangeX;
-		normY[i] = (vy[i] - minY) / rangeY;
-	}
+	if (s.count < 10) return false;
 
-	double W = 0.0, Wx = 0.0, Wy = 0.0, Wxx = 0.0, Wyy = 0.0, Wxy = 0.0;
-	double Wv = 0.0, Wvx = 0.0, Wvy = 0.0;
-
-	for (size_t i = 0; i < normX.size(); i++) {
-		double w = vw[i];
-		double x = normX[i];
-		double y = normY[i];
-		double v = vals[i];
-
-		W   += w;
-		Wx  += w * x;
-		Wy  += w * y;
-		Wxx += w * x * x;
-		Wyy += w * y * y;
-		Wxy += w * x * y;
-
-		Wv  += w * v;
-		Wvx += w * v * x;
-		Wvy += w * v * y;
-	}
+	// All samples on one row or column: the plane fit is singular.
+	double rangeX = s.maxX - s.minX;
+	double rangeY = s.maxY - s.minY;
+	if (rangeX < 1e-6 || rangeY < 1e-6)
+		return false;
+
+	// Moments in coordinates normalized to [0, 1] over the sample extent,
+	// derived from the raw moments to keep the 3x3 system well conditioned.
+	double mx = s.minX, my = s.minY;
+
+	double W   = s.W;
+	double Wx  = (s.Wx - mx * W) / rangeX;
+	double Wy  = (s.Wy - my * W) / rangeY;
+	double Wxx = (s.Wxx - 2.0 * mx * s.Wx + mx * mx * W) / (rangeX * rangeX);
+	double Wyy = (s.Wyy - 2.0 * my * s.Wy + my * my * W) / (rangeY * rangeY);
+	double Wxy = (s.Wxy - my * s.Wx - mx * s.Wy + mx * my * W) / (rangeX * rangeY);
+
+	double Wv  = s.Wc[channel];
+	double Wvx = (s.Wcx[channel] - mx * Wv) / rangeX;
+	double Wvy = (s.Wcy[channel] - my * Wv) / rangeY;
+	double Wvv = s.Wcc[channel];
 
 	double M[3][3] = { { W,   Wx,  Wy },
 					   { Wx,  Wxx, Wxy },
@@ -243,16 +218,10 @@ GradientDetector::_ComputeChannelGradient(const std::vector<double>& vx,
 	outGradX = X[1] / rangeX;
 	outGradY = X[2] / rangeY;
 
-	double mean_v = Wv / W;
-	double ss_tot = 0.0, ss_res = 0.0;
-
-	for (size_t i = 0; i < normX.size(); i++) {
-		double w = vw[i];
-		double predicted = X[0] + X[1] * normX[i] + X[2] * normY[i];
-
-		ss_tot += w * (vals[i] - mean_v) * (vals[i] - mean_v);
-		ss_res += w * (vals[i] - predicted) * (vals[i] - predicted);
-	}
+	double ss_tot = Wvv - Wv * Wv / W;
+	double ss_res = Wvv - 2.0 * (X[0] * Wv + X[1] * Wvx + X[2] * Wvy)
+		+ X[0] * X[0] * W + X[1] * X[1] * Wxx + X[2] * X[2] * Wyy
+		+ 2.0 * (X[0] * X[1] * Wx + X[0] * X[2] * Wy + X[1] * X[2] * Wxy);
 
 	outR2 = (ss_tot > 1e-12) ? (1.0 - ss_res / ss_tot) : 0.0;
 
@@ -260,12 +229,7 @@ GradientDetector::_ComputeChannelGradient(const std::vector<double>& vx,
 }
 
 bool
-GradientDetector::_ComputeRobustDirection(const std::vector<double>& vx,
-										  const std::vector<double>& vy,
-										  const std::vector<double>& vw,
-										  const std::vector<double>& vr,
-										  const std::vector<double>& vg,
-										  const std::vector<double>& vb,
+GradientDetector::_ComputeRobustDirection(const SampleSums& s,
 										  double& outDirX,
 										  double& outDirY,
 										  double& outConfidence)
@@ -274,16 +238,16 @@ GradientDetector::_ComputeRobustDirection(const std::vector<double>& vx,
 	double gradGx = 0.0, gradGy = 0.0, R2g = 0.0;
 	double gradBx = 0.0, gradBy = 0.0, R2b = 0.0;
 
-	bool okR = _ComputeChannelGradient(vx, vy, vw, vr, gradRx, gradRy, R2r);
-	bool okG = _ComputeChannelGradient(vx, vy, vw, vg, gradGx, gradGy, R2g);
-	bool okB = _ComputeChannelGradient(vx, vy, vw, vb, gradBx, gradBy, R2b);
+	bool okR = _ComputeChannelGradient(s, 0, gradRx, gradRy, R2r);
+	bool okG = _ComputeChannelGradient(s, 1, gradGx, gradGy, R2g);
+	bool okB = _ComputeChannelGradient(s, 2, gradBx, gradBy, R2b);
 
 	if (!okR && !okG && !okB)
 		return false;
 
-	double varR = _ComputeVariance(vr, vw);
-	double varG = _ComputeVariance(vg, vw);
-	double varB = _ComputeVariance(vb, vw);
+	double varR = _ComputeVariance(s, 0);
+	double varG = _ComputeVariance(s, 1);
+	double varB = _ComputeVariance(s, 2);
 
 	double magR = std::sqrt(gradRx * gradRx + gradRy * gradRy);
 	double magG = std::sqrt(gradGx * gradGx + gradGy * gradGy);
@@ -304,64 +268,58 @@ GradientDetector::_ComputeRobustDirection(const std::vector<double>& vx,
 	outDirX = 0.0;
 	outDirY = 0.0;
 
-	std::vector<double> directions[3][2];
+	double directions[3][2];
 	int validChannels = 0;
 
 	if (okR && magR > 1e-6) {
-		double ux = gradRx / magR;
-		double uy = gradRy / magR;
-		directions[validChannels][0].push_back(ux);
-		directions[validChannels][1].push_back(uy);
+		directions[validChannels][0] = gradRx / magR;
+		directions[validChannels][1] = gradRy / magR;
 		validChannels++;
 	}
 	if (okG && magG > 1e-6) {
-		double ux = gradGx / magG;
-		double uy = gradGy / magG;
-		directions[validChannels][0].push_back(ux);
-		directions[validChannels][1].push_back(uy);
+		directions[validChannels][0] = gradGx / magG;
+		directions[validChannels][1] = gradGy / magG;
 		validChannels++;
 	}
 	if (okB && magB > 1e-6) {
-		double ux = gradBx / magB;
-		double uy = gradBy / magB;
-		directions[validChannels][0].push_back(ux);
-		directions[validChannels][1].push_back(uy);
+		directions[validChannels][0] = gradBx / magB;
+		directions[validChannels][1] = gradBy / magB;
 		validChannels++;
 	}
 
 	if (validChannels >= 2) {
-		double dot01 = directions[0][0][0] * directions[1][0][0] +
-					   directions[0][1][0] * directions[1][1][0];
+		double dot01 = directions[0][0] * directions[1][0] +
+					   directions[0][1] * directions[1][1];
 		if (dot01 < 0) {
-			directions[1][0][0] = -directions[1][0][0];
-			directions[1][1][0] = -directions[1][1][0];
+			directions[1][0] = -directions[1][0];
+			directions[1][1] = -directions[1][1];
 		}
 
 		if (validChannels >= 3) {
-			double dot02 = directions[0][0][0] * directions[2][0][0] +
-						   directions[0][1][0] * directions[2][1][0];
+			double dot02 = directions[0][0] * directions[2][0] +
+						   directions[0][1] * directions[2][1];
 			if (dot02 < 0) {
-				directions[2][0][0] = -directions[2][0][0];
-				directions[2][1][0] = -directions[2][1][0];
+				directions[2][0] = -directions[2][0];
+				directions[2][1] = -directions[2][1];
 			}
 		}
 	}
 
 	if (okR && magR > 1e-6) {
-		double ux = (validChannels > 0) ? directions[0][0][0] : gradRx / magR;
-		double uy = (validChannels > 0) ? directions[0][1][0] : gradRy / magR;
+		double ux = (validChannels > 0) ? directions[0][0] : gradRx / magR;
+		double uy = (validChannels > 0) ? directions[0][1] : gradRy / magR;
 		outDirX += weightR * ux;
 		outDirY += weightR * uy;
 	}
 	if (okG && magG > 1e-6) {
-		double ux = (validChannels > 1) ? directions[1][0][0] : gradGx / magG;
-		double uy = (validChannels > 1) ? directions[1][1][0] : gradGy / magG;
+		double ux = (validChannels > 1) ? directions[1][0] : gradGx / magG;
+		double uy = (validChannels > 1) ? directions[1][1] : gradGy / magG;
 		outDirX += weightG * ux;
 		outDirY += weightG * uy;
 	}
 	if (okB && magB > 1e-6) {
-		double ux = (validChannels > 2) ? directions[2][0][0] : gradBx / magB;
-		double uy = (validChannels > 2) ? directions[2][1][0] : gradBy / magB;
+		double ux = (validChannels > 2) ? directions[2][0] : gradBx / magB;
+		double uy = (validChannels > 2) ? directions[2][1] : gradBy / magB;
 		outDirX += weightB * ux;
 		outDirY += weightB * uy;
 	}
@@ -441,142 +399,185 @@ GradientDetector::_DetectForPath(int layerIndex,
 		adaptiveStride = 1;
 	}
 
-	std::vector<double> vx, vy, vw;
-	std::vector<double> vr, vg, vb, va;
+	// Scanline coverage: active edges are those within the border band of
+	// the current row. They provide both the even-odd crossings for the
+	// inside test and an exact distance field clamped at the band width,
+	// which is all the border weight below depends on.
+	const double kBorderBand = 3.0;
+
+	std::vector<PolyEdge> edges;
+	edges.reserve(poly.size());
+	for (size_t i = 0; i + 1 < poly.size(); i++) {
+		PolyEdge e;
+		e.x1 = poly[i][0];     e.y1 = poly[i][1];
+		e.x2 = poly[i + 1][0]; e.y2 = poly[i + 1][1];
+		e.minX = std::min(e.x1, e.x2); e.maxX = std::max(e.x1, e.x2);
+		e.minY = std::min(e.y1, e.y2); e.maxY = std::max(e.y1, e.y2);
+		edges.push_back(e);
+	}
+
+	std::sort(edges.begin(), edges.end(),
+		[](const PolyEdge& l, const PolyEdge& r) { return l.minY < r.minY; });
+
+	int columns = (xe >= xs) ? (xe - xs) / adaptiveStride + 1 : 0;
+
+	std::vector<size_t> active;
+	std::vector<double> crossings;
+	std::vector<double> rowDist(columns > 0 ? columns : 0);
+	size_t nextEdge = 0;
+
+	struct RowExtent {
+		double y, xFirst, xLast;
+	};
+	std::vector<RowExtent> rowExtents;
+
+	bool useLinear = options.fGradientUseLinearRGB;
+	SampleSums sums;
+
+	for (int y = ys; y <= ye && columns > 0; y += adaptiveStride) {
+		double py = (double)y + 0.5;
 
-	for (int y = ys; y <= ye; y += adaptiveStride) {
-		for (int x = xs; x <= xe; x += adaptiveStride) {
+		while (nextEdge < edges.size() && edges[nextEdge].minY - kBorderBand <= py)
+			active.push_back(nextEdge++);
+
+		size_t kept = 0;
+		for (size_t i = 0; i < active.size(); i++) {
+			if (edges[active[i]].maxY + kBorderBand >= py)
+				active[kept++] = active[i];
+		}
+		active.resize(kept);
+
+		crossings.clear();
+		for (size_t i = 0; i < active.size(); i++) {
+			const PolyEdge& e = edges[active[i]];
+			if ((e.y2 > py) != (e.y1 > py)) {
+				double denom = (e.y1 - e.y2);
+				if (denom == 0.0) denom = 1e-12;
+				crossings.push_back((e.x1 - e.x2) * (py - e.y2) / denom + e.x2);
+			}
+		}
+		if (crossings.empty())
+			continue;
+
+		std::sort(crossings.begin(), crossings.end());
+
+		std::fill(rowDist.begin(), rowDist.end(), kBorderBand);
+		for (size_t i = 0; i < active.size(); i++) {
+			const PolyEdge& e = edges[active[i]];
+			double lo = std::ceil((e.minX - kBorderBand - 0.5 - xs) / adaptiveStride);
+			double hi = std::floor((e.maxX + kBorderBand - 0.5 - xs) / adaptiveStride);
+			int c0 = lo < 0.0 ? 0 : (int)lo;
+			int c1 = hi > columns - 1 ? columns - 1 : (int)hi;
+			for (int c = c0; c <= c1; c++) {
+				double px = (double)(xs + c * adaptiveStride) + 0.5;
+				double d = _PointSegmentDistance(px, py, e.x1, e.y1, e.x2, e.y2);
+				if (d < rowDist[c])
+					rowDist[c] = d;
+			}
+		}
+
+		const unsigned char* row = src.Bits() + (size_t)y * src.Width() * 4;
+		size_t crossed = 0;
+		bool rowHasSamples = false;
+		RowExtent extent;
+
+		for (int c = 0; c < columns; c++) {
+			int x = xs + c * adaptiveStride;
 			double px = (double)x + 0.5;
-			double py = (double)y + 0.5;
 
-			if (!_PointInPolygon(px, py, poly))
+			while (crossed < crossings.size() && crossings[crossed] <= px)
+				crossed++;
+			if (((crossings.size() - crossed) & 1) == 0)
 				continue;
 
-			unsigned char r8 = src.GetPixelComponent(x, y, 0);
-			unsigned char g8 = src.GetPixelComponent(x, y, 1);
-			unsigned char b8 = src.GetPixelComponent(x, y, 2);
-			unsigned char a8 = src.GetPixelComponent(x, y, 3);
+			const unsigned char* p = &row[(size_t)x * 4];
+			unsigned char a8 = p[3];
 
 			if (MathUtils::IsTransparent(a8))
 				continue;
 
-			double dist = _DistanceToPolygon(px, py, poly);
-			double wBorder = dist / 3.0;
+			double wBorder = rowDist[c] / kBorderBand;
 			if (wBorder > 1.0) wBorder = 1.0;
 			if (wBorder < 0.1) wBorder = 0.1;
 			double wAlpha = (double)a8 / 255.0;
 			double w = wBorder * wBorder * wAlpha;
 
-			double r = (double)r8;
-			double g = (double)g8;
-			double b = (double)b8;
-			double a = (double)a8;
-
-			if (options.fGradientUseLinearRGB) {
-				r = MathUtils::SRGBToLinear(r);
-				g = MathUtils::SRGBToLinear(g);
-				b = MathUtils::SRGBToLinear(b);
+			double color[4];
+			if (useLinear) {
+				color[0] = MathUtils::SRGBToLinearLUT(p[0]);
+				color[1] = MathUtils::SRGBToLinearLUT(p[1]);
+				color[2] = MathUtils::SRGBToLinearLUT(p[2]);
+			} else {
+				color[0] = (double)p[0];
+				color[1] = (double)p[1];
+				color[2] = (double)p[2];
 			}
+			color[3] = (double)a8;
+
+			double lx = (double)(x - xs);
+			double ly = (double)(y - ys);
+			_AccumulateSample(sums, lx, ly, w, color);
 
-			vx.push_back((double)x);
-			vy.push_back((double)y);
-			vw.push_back(w);
-			vr.push_back(r);
-			vg.push_back(g);
-			vb.push_back(b);
-			va.push_back(a);
+			if (!rowHasSamples) {
+				extent.y = ly;
+				extent.xFirst = lx;
+				rowHasSamples = true;
+			}
+			extent.xLast = lx;
 		}
+
+		if (rowHasSamples)
+			rowExtents.push_back(extent);
 	}
 
 	int minSamples = options.fGradientMinSamples;
-	if ((int)vx.size() < minSamples)
+	if (sums.count < minSamples)
 		return result;
 
 	double dirX = 0.0, dirY = 0.0, confidence = 0.0;
-	if (!_ComputeRobustDirection(vx, vy, vw, vr, vg, vb, dirX, dirY, confidence))
+	if (!_ComputeRobustDirection(sums, dirX, dirY, confidence))
 		return result;
 
 	double minConfidence = 0.3;
 	if (confidence < minConfidence)
 		return result;
 
-	std::vector<double> tvals(vx.size());
-	double Wt = 0.0, Wtt = 0.0, W = 0.0;
-	for (size_t i = 0; i < vx.size(); i++) {
-		double t = vx[i] * dirX + vy[i] * dirY;
-		tvals[i] = t;
-		double w = vw[i];
-		W   += w;
-		Wt  += w * t;
-		Wtt += w * t * t;
-	}
+	// Fit each channel along t = (x, y) . dir. The projected sums follow
+	// from the planar moments, so no second pass over samples is needed.
+	double W = sums.W;
+	double Wt = dirX * sums.Wx + dirY * sums.Wy;
+	double Wtt = dirX * dirX * sums.Wxx + 2.0 * dirX * dirY * sums.Wxy + dirY * dirY * sums.Wyy;
 
 	double denom = W * Wtt - Wt * Wt;
 	if (std::fabs(denom) < 1e-12)
 		return result;
 
-	double Wr = 0.0, Wrt = 0.0;
-	double Wg = 0.0, Wgt = 0.0;
-	double Wb = 0.0, Wbt = 0.0;
-	double Wa = 0.0, Wat = 0.0;
-
-	for (size_t i = 0; i < vx.size(); i++) {
-		double w = vw[i];
-		double t = tvals[i];
-		double r = vr[i], g = vg[i], b = vb[i], a = va[i];
-
-		Wr += w * r; Wrt += w * r * t;
-		Wg += w * g; Wgt += w * g * t;
-		Wb += w * b; Wbt += w * b * t;
-		Wa += w * a; Wat += w * a * t;
+	double slope[4], intercept[4], R2[4], ssTot[4];
+	for (int ch = 0; ch < 4; ch++) {
+		double Wc = sums.Wc[ch];
+		double Wct = dirX * sums.Wcx[ch] + dirY * sums.Wcy[ch];
+		slope[ch] = (W * Wct - Wt * Wc) / denom;
+		intercept[ch] = (Wc - slope[ch] * Wt) / W;
+
+		double ss_tot = sums.Wcc[ch] - Wc * Wc / W;
+		double ss_res = sums.Wcc[ch] - intercept[ch] * Wc - slope[ch] * Wct;
+		ssTot[ch] = ss_tot;
+		R2[ch] = (ss_tot <= 1e-12) ? 0.0 : (1.0 - ss_res / ss_tot);
 	}
 
-	double br = (W * Wrt - Wt * Wr) / denom;
-	double ar = (Wr - br * Wt) / W;
-
-	double bg = (W * Wgt - Wt * Wg) / denom;
-	double ag = (Wg - bg * Wt) / W;
-
-	double bb = (W * Wbt - Wt * Wb) / denom;
-	double ab = (Wb - bb * Wt) / W;
-
-	double ba = (W * Wat - Wt * Wa) / denom;
-	double aa = (Wa - ba * Wt) / W;
-
-	double mean_r = Wr / W;
-	double mean_g = Wg / W;
-	double mean_b = Wb / W;
-
-	double ss_tot_r = 0.0, ss_res_r = 0.0;
-	double ss_tot_g = 0.0, ss_res_g = 0.0;
-	double ss_tot_b = 0.0, ss_res_b = 0.0;
-
-	for (size_t i = 0; i < vx.size(); i++) {
-		double w = vw[i];
-		double t = tvals[i];
-
-		double pr = ar + br * t;
-		double pg = ag + bg * t;
-		double pb = ab + bb * t;
-
-		ss_tot_r += w * (vr[i] - mean_r) * (vr[i] - mean_r);
-		ss_tot_g += w * (vg[i] - mean_g) * (vg[i] - mean_g);
-		ss_tot_b += w * (vb[i] - mean_b) * (vb[i] - mean_b);
-
-		ss_res_r += w * (vr[i] - pr) * (vr[i] - pr);
-		ss_res_g += w * (vg[i] - pg) * (vg[i] - pg);
-		ss_res_b += w * (vb[i] - pb) * (vb[i] - pb);
-	}
-
-	double R2r = (ss_tot_r <= 1e-12) ? 0.0 : (1.0 - ss_res_r / ss_tot_r);
-	double R2g = (ss_tot_g <= 1e-12) ? 0.0 : (1.0 - ss_res_g / ss_tot_g);
-	double R2b = (ss_tot_b <= 1e-12) ? 0.0 : (1.0 - ss_res_b / ss_tot_b);
+	double ar = intercept[0], br = slope[0];
+	double ag = intercept[1], bg = slope[1];
+	double ab = intercept[2], bb = slope[2];
+	double aa = intercept[3], ba = slope[3];
 
 	double wsum = 0.0;
 	double R2total = 0.0;
-	if (ss_tot_r > 1e-12) { R2total += R2r * ss_tot_r; wsum += ss_tot_r; }
-	if (ss_tot_g > 1e-12) { R2total += R2g * ss_tot_g; wsum += ss_tot_g; }
-	if (ss_tot_b > 1e-12) { R2total += R2b * ss_tot_b; wsum += ss_tot_b; }
+	for (int ch = 0; ch < 3; ch++) {
+		if (ssTot[ch] > 1e-12) {
+			R2total += R2[ch] * ssTot[ch];
+			wsum += ssTot[ch];
+		}
+	}
 	if (wsum > 0.0) R2total /= wsum; else R2total = 0.0;
 
 	double minR2Total = (options.fGradientMinR2 > options.fGradientMinR2Total)
@@ -587,9 +588,14 @@ GradientDetector::_DetectForPath(int layerIndex,
 		return result;
 
 	double tmin_samples = DBL_MAX, tmax_samples = -DBL_MAX;
-	for (size_t i = 0; i < tvals.size(); i++) {
-		if (tvals[i] < tmin_samples) tmin_samples = tvals[i];
-		if (tvals[i] > tmax_samples) tmax_samples = tvals[i];
+	for (size_t i = 0; i < rowExtents.size(); i++) {
+		const RowExtent& e = rowExtents[i];
+		double t1 = e.xFirst * dirX + e.y * dirY;
+		double t2 = e.xLast * dirX + e.y * dirY;
+		if (t1 < tmin_samples) tmin_samples = t1;
+		if (t1 > tmax_samples) tmax_samples = t1;
+		if (t2 < tmin_samples) tmin_samples = t2;
+		if (t2 > tmax_samples) tmax_samples = t2;
 	}
 
 	double gradientLength = tmax_samples - tmin_samples;
@@ -653,15 +659,35 @@ GradientDetector::DetectLinearGradients(const IndexedBitmap& indexed,
 {
 	std::vector<std::vector<IndexedBitmap::LinearGradient> > out;
 	out.resize(layers.size());
+
+	std::vector<std::pair<int, int> > jobs;
 	for (size_t k = 0; k < layers.size(); k++) {
 		out[k].resize(layers[k].size());
 		for (size_t i = 0; i < layers[k].size(); i++) {
-			if (layers[k][i].empty()) {
-				out[k][i] = IndexedBitmap::LinearGradient();
-				continue;
-			}
-			out[k][i] = _DetectForPath((int)k, layers[k][i], indexed, sourceBitmap, options);
+			if (!layers[k][i].empty())
+				jobs.push_back(std::make_pair((int)k, (int)i));
 		}
 	}
+
+	if (jobs.empty())
+		return out;
+
+	MathUtils::Init();
+
+	// Path sizes vary widely, so workers pull jobs from a shared counter
+	// instead of taking fixed blocks.
+	std::atomic<int> nextJob(0);
+	int numWorkers = (int)std::thread::hardware_concurrency();
+	if (numWorkers < 1) numWorkers = 1;
+	if (numWorkers > (int)jobs.size()) numWorkers = (int)jobs.size();
+
+	ParallelUtils::ParallelFor(0, numWorkers, [&](int) {
+		for (int j = nextJob++; j < (int)jobs.size(); j = nextJob++) {
+			int k = jobs[j].first;
+			int i = jobs[j].second;
+			out[k][i] = _DetectForPath(k, layers[k][i], indexed, sourceBitmap, options);
+		}
+	});
+
 	return out;
 }
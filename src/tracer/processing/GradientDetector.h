@@ -24,11 +24,31 @@ public:
 							  const TracingOptions& options);
 
 private:
+	// Weighted moments of the sampled pixels of one path. Coordinates are
+	// relative to the sampling origin; channels are R, G, B, A.
+	struct SampleSums {
+		int			count;
+		double		W, Wx, Wy, Wxx, Wyy, Wxy;
+		double		Wc[4], Wcx[4], Wcy[4], Wcc[4];
+		double		minX, minY, maxX, maxY;
+
+		SampleSums()
+			: count(0), W(0), Wx(0), Wy(0), Wxx(0), Wyy(0), Wxy(0),
+			  minX(0), minY(0), maxX(0), maxY(0)
+		{
+			for (int c = 0; c < 4; c++)
+				Wc[c] = Wcx[c] = Wcy[c] = Wcc[c] = 0.0;
+		}
+	};
+
+	struct PolyEdge {
+		double x1, y1, x2, y2;
+		double minX, minY, maxX, maxY;
+	};
+
 	void		_FlattenPath(const std::vector<std::vector<double>>& segments,
 							 std::vector<std::vector<double>>& outPoints,
 							 int maxSubdiv);
-	bool		_PointInPolygon(double x, double y,
-								const std::vector<std::vector<double>>& polygon);
 	void		_Bounds(const std::vector<std::vector<double>>& pts,
 						double& minX, double& minY, double& maxX, double& maxY);
 
@@ -37,25 +57,18 @@ private:
 	double		_L2rgb(const unsigned char a[3], const unsigned char b[3]);
 
 	double		_PointSegmentDistance(double px, double py, double x1, double y1, double x2, double y2);
-	double		_DistanceToPolygon(double px, double py, const std::vector<std::vector<double> >& poly);
 
-	double		_ComputeVariance(const std::vector<double>& vals,
-	                            const std::vector<double>& weights);
+	void		_AccumulateSample(SampleSums& s, double x, double y, double w, const double c[4]);
+
+	double		_ComputeVariance(const SampleSums& s, int channel);
 
-	bool		_ComputeChannelGradient(const std::vector<double>& vx,
-	                               const std::vector<double>& vy,
-	                               const std::vector<double>& vw,
-	                               const std::vector<double>& vals,
+	bool		_ComputeChannelGradient(const SampleSums& s,
+	                               int channel,
 	                               double& outGradX,
 	                               double& outGradY,
 	                               double& outR2);
 
-	bool		_ComputeRobustDirection(const std::vector<double>& vx,
-	                               const std::vector<double>& vy,
-	                               const std::vector<double>& vw,
-	                               const std::vector<double>& vr,
-	                               const std::vector<double>& vg,
-	                               const std::vector<double>& vb,
+	bool		_ComputeRobustDirection(const SampleSums& s,
 	                               double& outDirX,
 	                               double& outDirY,
 	                               double& outConfidence);
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "ImagePyramid.h"
+
+struct Coverage {
+	int		source;
+	double	weight;
+};
+
+// Source pixels covered by each target pixel along one axis, with the
+// covered fraction of each.
+static void
+_BuildCoverage(int sourceSize, int targetSize, std::vector<int>& starts,
+	std::vector<Coverage>& spans)
+{
+	double step = (double)sourceSize / targetSize;
+	starts.resize(targetSize + 1);
+	spans.clear();
+
+	for (int t = 0; t < targetSize; t++) {
+		starts[t] = (int)spans.size();
+		double begin = t * step;
+		double end = (t + 1) * step;
+		int first = (int)floor(begin);
+		int last = std::min((int)ceil(end), sourceSize);
+		for (int s = first; s < last; s++) {
+			double weight = std::min(end, s + 1.0) - std::max(begin, (double)s);
+			if (weight > 1e-9) {
+				Coverage c = { s, weight };
+				spans.push_back(c);
+			}
+		}
+	}
+	starts[targetSize] = (int)spans.size();
+}
+
+// Alpha-weighted mean of a block of pixels, so transparent pixels do not
+// pull the color of their neighbours.
+static inline void
+_Accumulate(const unsigned char* p, double weight, double mean[4],
+	double& totalWeight)
+{
+	double alpha = p[3] * weight;
+	mean[0] += p[0] * alpha;
+	mean[1] += p[1] * alpha;
+	mean[2] += p[2] * alpha;
+	mean[3] += alpha;
+	totalWeight += weight;
+}
+
+static inline void
+_Finish(double mean[4], double totalWeight)
+{
+	if (mean[3] > 0) {
+		mean[0] /= mean[3];
+		mean[1] /= mean[3];
+		mean[2] /= mean[3];
+	}
+	mean[3] /= totalWeight;
+}
+
+static inline void
+_Closer(const unsigned char* p, const double mean[4],
+	const unsigned char*& best, int& bestDistance)
+{
+	int distance = 0;
+	for (int i = 0; i < 4; i++) {
+		int d = p[i] - (int)(mean[i] + 0.5);
+		distance += d * d;
+	}
+
+	if (best == NULL || distance < bestDistance) {
+		best = p;
+		bestDistance = distance;
+	}
+}
+
+ImagePyramid::ImagePyramid()
+{
+}
+
+ImagePyramid::~ImagePyramid()
+{
+}
+
+void
+ImagePyramid::WorkingSize(int width, int height, int maxSize,
+	int& outWidth, int& outHeight)
+{
+	outWidth = width;
+	outHeight = height;
+
+	int longest = std::max(width, height);
+	if (maxSize <= 0 || longest <= maxSize)
+		return;
+
+	double scale = (double)maxSize / longest;
+	outWidth = std::max(1, (int)(width * scale + 0.5));
+	outHeight = std::max(1, (int)(height * scale + 0.5));
+}
+
+BitmapData
+ImagePyramid::Reduce(const BitmapData& bitmap, int maxSize)
+{
+	int width, height;
+	WorkingSize(bitmap.Width(), bitmap.Height(), maxSize, width, height);
+
+	BitmapData level = BitmapData::Borrow(bitmap);
+	while (level.Width() / 2 >= width && level.Height() / 2 >= height)
+		level = _Halve(level);
+
+	if (level.Width() != width || level.Height() != height)
+		return _Resample(level, width, height);
+
+	if (level.IsBorrowed())
+		return BitmapData(width, height, level.Bits());
+
+	return level;
+}
+
+BitmapData
+ImagePyramid::_Halve(const BitmapData& bitmap)
+{
+	const int width = bitmap.Width();
+	const int height = bitmap.Height();
+	const int halfWidth = width / 2;
+	const int halfHeight = height / 2;
+	const unsigned char* bits = bitmap.Bits();
+
+	BitmapData result(halfWidth, halfHeight, std::vector<unsigned char>());
+	unsigned char* out = result.MutableBits();
+
+	for (int y = 0; y < halfHeight; y++) {
+		// An odd last row or column goes into the last target pixel.
+		int y1 = (y == halfHeight - 1) ? height : y * 2 + 2;
+		for (int x = 0; x < halfWidth; x++) {
+			int x1 = (x == halfWidth - 1) ? width : x * 2 + 2;
+
+			double mean[4] = { 0, 0, 0, 0 };
+			double weight = 0;
+			for (int sy = y * 2; sy < y1; sy++) {
+				const unsigned char* p = bits + ((size_t)sy * width + x * 2) * 4;
+				for (int sx = x * 2; sx < x1; sx++, p += 4)
+					_Accumulate(p, 1.0, mean, weight);
+			}
+			_Finish(mean, weight);
+
+			const unsigned char* best = NULL;
+			int bestDistance = 0;
+			for (int sy = y * 2; sy < y1; sy++) {
+				const unsigned char* p = bits + ((size_t)sy * width + x * 2) * 4;
+				for (int sx = x * 2; sx < x1; sx++, p += 4)
+					_Closer(p, mean, best, bestDistance);
+			}
+
+			memcpy(out + ((size_t)y * halfWidth + x) * 4, best, 4);
+		}
+	}
+
+	return result;
+}
+
+BitmapData
+ImagePyramid::_Resample(const BitmapData& bitmap, int width, int height)
+{
+	const int sourceWidth = bitmap.Width();
+	const unsigned char* bits = bitmap.Bits();
+
+	std::vector<int> columnStarts, rowStarts;
+	std::vector<Coverage> columns, rows;
+	_BuildCoverage(sourceWidth, width, columnStarts, columns);
+	_BuildCoverage(bitmap.Height(), height, rowStarts, rows);
+
+	BitmapData result(width, height, std::vector<unsigned char>());
+	unsigned char* out = result.MutableBits();
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			double mean[4] = { 0, 0, 0, 0 };
+			double weight = 0;
+			for (int r = rowStarts[y]; r < rowStarts[y + 1]; r++) {
+				const unsigned char* row = bits + (size_t)rows[r].source * sourceWidth * 4;
+				for (int c = columnStarts[x]; c < columnStarts[x + 1]; c++) {
+					_Accumulate(row + columns[c].source * 4,
+						rows[r].weight * columns[c].weight, mean, weight);
+				}
+			}
+			_Finish(mean, weight);
+
+			const unsigned char* best = NULL;
+			int bestDistance = 0;
+			for (int r = rowStarts[y]; r < rowStarts[y + 1]; r++) {
+				const unsigned char* row = bits + (size_t)rows[r].source * sourceWidth * 4;
+				for (int c = columnStarts[x]; c < columnStarts[x + 1]; c++)
+					_Closer(row + columns[c].source * 4, mean, best, bestDistance);
+			}
+
+			memcpy(out + ((size_t)y * width + x) * 4, best, 4);
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef IMAGE_PYRAMID_H
+#define IMAGE_PYRAMID_H
+
+#include "BitmapData.h"
+
+// Reduces a bitmap to a working resolution for tracing. The image is
+// halved while that stays above the requested size, then resampled down
+// to it. Each target pixel takes the source pixel of its area that is
+// closest to the area's mean color: flat regions and gradients come out
+// as averaged, but hard edges stay hard and no blended colors are added
+// for the palette to pick up.
+class ImagePyramid {
+public:
+							ImagePyramid();
+							~ImagePyramid();
+
+	// Size the longest side of the bitmap is reduced to.
+	static void				WorkingSize(int width, int height, int maxSize,
+									int& outWidth, int& outHeight);
+
+	BitmapData				Reduce(const BitmapData& bitmap, int maxSize);
+
+private:
+	BitmapData				_Halve(const BitmapData& bitmap);
+	BitmapData				_Resample(const BitmapData& bitmap,
+									int width, int height);
+};
+
+#endif
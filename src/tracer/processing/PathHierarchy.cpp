@@ -68,7 +68,7 @@ PathHierarchy::_BuildBoundsForLayer(
 			if (y2 < bounds[i].minY) bounds[i].minY = y2;
 			if (y2 > bounds[i].maxY) bounds[i].maxY = y2;
 
-			if (seg[0] == 2.0 && seg.size() >= 7) {
+			if (seg[0] >= 2.0 && seg.size() >= 7) {
 				double cx = seg[3];
 				double cy = seg[4];
 				if (cx < bounds[i].minX) bounds[i].minX = cx;
@@ -76,6 +76,15 @@ PathHierarchy::_BuildBoundsForLayer(
 				if (cy < bounds[i].minY) bounds[i].minY = cy;
 				if (cy > bounds[i].maxY) bounds[i].maxY = cy;
 			}
+
+			if (seg[0] == 3.0 && seg.size() >= 9) {
+				double cx = seg[7];
+				double cy = seg[8];
+				if (cx < bounds[i].minX) bounds[i].minX = cx;
+				if (cx > bounds[i].maxX) bounds[i].maxX = cx;
+				if (cy < bounds[i].minY) bounds[i].minY = cy;
+				if (cy > bounds[i].maxY) bounds[i].maxY = cy;
+			}
 		}
 
 		bounds[i].area = (bounds[i].maxX - bounds[i].minX) * (bounds[i].maxY - bounds[i].minY);
@@ -200,6 +209,11 @@ PathHierarchy::ReversePathSegments(std::vector<std::vector<double> >& path)
 			path[i][2] = path[i][6];
 			path[i][5] = tx;
 			path[i][6] = ty;
+		} else if (path[i][0] == 3.0 && path[i].size() >= 9) {
+			std::swap(path[i][1], path[i][5]);
+			std::swap(path[i][2], path[i][6]);
+			std::swap(path[i][3], path[i][7]);
+			std::swap(path[i][4], path[i][8]);
 		}
 	}
 }
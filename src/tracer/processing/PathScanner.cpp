@@ -108,6 +108,9 @@ PathScanner::ScanPaths(std::vector<std::vector<int> >& layerArray, const Tracing
 	bool keepHolePaths = options.fKeepHolePaths;
 
 	for (int j = 0; j < height; j++) {
+		if (options.IsCancelled())
+			break;
+
 		for (int i = 0; i < width; i++) {
 			if (layerArray[j][i] != 0 && layerArray[j][i] != 15) {
 				positionX = i;
@@ -190,6 +193,9 @@ PathScanner::ScanLayerPaths(const std::vector<std::vector<std::vector<int>>>& la
 {
 	std::vector<std::vector<std::vector<std::vector<int>>>> batchPaths;
 	for (int k = 0; k < static_cast<int>(layers.size()); k++) {
+		if (options.IsCancelled())
+			break;
+
 		std::vector<std::vector<int>> layerCopy = layers[k];
 		batchPaths.push_back(ScanPaths(layerCopy, options));
 	}
@@ -10,8 +10,10 @@
 #include "PathSimplifier.h"
 #include "PathTracer.h"
 #include "SharedEdgeRegistry.h"
+#include "TileSeams.h"
 
 PathSimplifier::PathSimplifier()
+	: fSeams(NULL)
 {
 }
 
@@ -19,6 +21,12 @@ PathSimplifier::~PathSimplifier()
 {
 }
 
+bool
+PathSimplifier::_IsPinned(const std::vector<double>& point) const
+{
+	return fSeams != NULL && fSeams->Contains(point);
+}
+
 double
 PathSimplifier::_PerpendicularDistance(const std::vector<double>& point,
 									const std::vector<double>& lineStart,
@@ -146,6 +154,11 @@ PathSimplifier::DouglasPeuckerWithProtection(const std::vector<std::vector<doubl
 		}
 	}
 
+	// A last run of adjacent points only added its start
+	const std::vector<double>& last = path.back();
+	if (result.back()[0] != last[0] || result.back()[1] != last[1])
+		result.push_back(last);
+
 	return result;
 }
 
@@ -158,7 +171,7 @@ PathSimplifier::DouglasPeucker(const std::vector<std::vector<double> >& path,
 	if (path.size() <= 2)
 		return path;
 
-	if (!curveProtection)
+	if (!curveProtection && fSeams == NULL)
 		return DouglasPeuckerSimple(path, tolerance);
 
 	// Mark points with high curvature as protected
@@ -167,6 +180,12 @@ PathSimplifier::DouglasPeucker(const std::vector<std::vector<double> >& path,
 	protectedPoints[path.size() - 1] = true; // Always protect end
 
 	for (int i = 1; i < static_cast<int>(path.size()) - 1; i++) {
+		if (_IsPinned(path[i])) {
+			protectedPoints[i] = true;
+			continue;
+		}
+		if (!curveProtection)
+			continue;
 		double curvature = _CalculateCurvature(path[i-1], path[i], path[i+1]);
 		if (curvature > curvatureThreshold) {
 			protectedPoints[i] = true;
@@ -378,6 +397,7 @@ PathSimplifier::SimplifyPath(const std::vector<std::vector<double> >& path,
 		for (size_t i = 1; i < result.size(); i++) {
 			bool isProtected = (protectedPoints && i < protectedPoints->size())
 							   ? (*protectedPoints)[i] : false;
+			isProtected = isProtected || _IsPinned(result[i]);
 
 			const std::vector<double>& prev = temp.back();
 			const std::vector<double>& curr = result[i];
@@ -403,7 +423,7 @@ PathSimplifier::SimplifyPath(const std::vector<std::vector<double> >& path,
 				bool isProtected = (protectedPoints && i < protectedPoints->size())
 								   ? (*protectedPoints)[i] : false;
 
-				if (isProtected) continue;
+				if (isProtected || _IsPinned(temp[i])) continue;
 
 				double weight = 0.3f; // Smoothing weight
 				smoothed[i][0] = (1.0f - 2*weight) * temp[i][0] +
@@ -425,7 +445,7 @@ PathSimplifier::SimplifyPath(const std::vector<std::vector<double> >& path,
 			bool isProtected = (protectedPoints && i < protectedPoints->size())
 							   ? (*protectedPoints)[i] : false;
 
-			if (isProtected) {
+			if (isProtected || _IsPinned(result[i])) {
 				temp.push_back(result[i]);
 				continue;
 			}
@@ -460,7 +480,15 @@ PathSimplifier::SimplifyPath(const std::vector<std::vector<double> >& path,
 			tolerance *= 1.5f;
 		}
 
-		result = DouglasPeuckerWithProtection(result, tolerance, *protectedPoints);
+		if (fSeams != NULL) {
+			std::vector<bool> pinned(result.size(), false);
+			for (size_t i = 0; i < result.size(); i++) {
+				pinned[i] = _IsPinned(result[i])
+					|| (protectedPoints->size() == result.size() && (*protectedPoints)[i]);
+			}
+			result = DouglasPeuckerWithProtection(result, tolerance, pinned);
+		} else
+			result = DouglasPeuckerWithProtection(result, tolerance, *protectedPoints);
 	}
 
 	return result;
@@ -605,7 +633,9 @@ PathSimplifier::FilterSmallObjects(const std::vector<std::vector<std::vector<dou
 
 		ObjectMetrics metrics = CalculateObjectMetrics(pathPoints);
 
-		if (!IsObjectTooSmall(metrics, options)) {
+		// A piece cut by a seam may belong to a large object.
+		if (!IsObjectTooSmall(metrics, options)
+			|| (fSeams != NULL && fSeams->Touches(pathPoints))) {
 			filteredPaths.push_back(paths[i]);
 		} else {
 			removedCount++;
@@ -635,6 +665,9 @@ PathSimplifier::BatchTracePathsWithSimplification(
 	const SharedEdgeRegistry* registry)
 {
 	std::vector<std::vector<std::vector<std::vector<double> > > > simplifiedLayers;
+	PathTracer tracer;
+	tracer.SetCubicFitting(options.fCubicFitting);
+	tracer.SetSeams(fSeams);
 
 	for (int k = 0; k < static_cast<int>(layers.size()); k++) {
 		std::vector<std::vector<std::vector<double> > > layerPaths;
@@ -677,7 +710,6 @@ PathSimplifier::BatchTracePathsWithSimplification(
 					SimplifyPath(pathPoints, options, &protectedPoints);
 
 				if (simplified.size() >= 2) {
-					PathTracer tracer;
 					std::vector<std::vector<double> > tracedPath = tracer.TracePath(simplified,
 										options.fLineThreshold,	options.fQuadraticThreshold);
 					layerPaths.push_back(tracedPath);
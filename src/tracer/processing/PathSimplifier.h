@@ -12,6 +12,7 @@
 
 class BoundaryTracker;
 class SharedEdgeRegistry;
+class TileSeams;
 
 struct ObjectMetrics {
 	double                  area;
@@ -33,6 +34,11 @@ public:
 							PathSimplifier();
 							~PathSimplifier();
 
+	// Paths of a tile keep their points on the seams, and pieces cut by a
+	// seam are not filtered out as small objects.
+	void					SetSeams(const TileSeams* seams)
+								{ fSeams = seams; }
+
 	std::vector<std::vector<double> >
 							DouglasPeuckerSimple(const std::vector<std::vector<double> >& path, float tolerance);
 
@@ -97,6 +103,10 @@ private:
 	std::vector<bool>		_ConvertSegmentsToSharedMarks(
 								const std::vector<std::vector<double> >& segments,
 								const std::vector<bool>& sharedSegments);
+
+	bool					_IsPinned(const std::vector<double>& point) const;
+
+	const TileSeams*		fSeams;
 };
 
 #endif
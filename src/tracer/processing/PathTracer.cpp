@@ -3,12 +3,259 @@
  * Distributed under the terms of the MIT License.
  */
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 
 #include "PathTracer.h"
 #include "SharedEdgeRegistry.h"
+#include "TileSeams.h"
+
+static const size_t kSegmentStride = 9;
+
+// A point is a corner where the outline turns by more than this (cosine of
+// 60 degrees) between the points kCornerSpan before and after it.
+static const double kCornerCosine = 0.5;
+static const int kCornerSpan = 2;
+
+// Points ahead of a corner that set the tangent leaving it.
+static const int kTangentSpan = 2;
+
+// Newton steps tried on the parameters of a fit that nearly passes.
+static const int kMaxReparameterize = 4;
+
+// The cubic fitter works on the outline without repeated points, stored
+// flat as x, y pairs.
+static inline const double*
+_Point(const double* points, int index)
+{
+	return points + index * 2;
+}
+
+static inline bool
+_Normalize(double vector[2])
+{
+	double length = sqrt(vector[0] * vector[0] + vector[1] * vector[1]);
+	if (length < 1e-12)
+		return false;
+	vector[0] /= length;
+	vector[1] /= length;
+	return true;
+}
+
+static inline bool
+_UnitDirection(const double* from, const double* to, double direction[2])
+{
+	direction[0] = to[0] - from[0];
+	direction[1] = to[1] - from[1];
+	return _Normalize(direction);
+}
+
+static inline void
+_Bezier(const double control[4][2], double t, double point[2])
+{
+	double mt = 1.0 - t;
+	double b0 = mt * mt * mt;
+	double b1 = 3.0 * mt * mt * t;
+	double b2 = 3.0 * mt * t * t;
+	double b3 = t * t * t;
+	point[0] = b0 * control[0][0] + b1 * control[1][0] + b2 * control[2][0] + b3 * control[3][0];
+	point[1] = b0 * control[0][1] + b1 * control[1][1] + b2 * control[2][1] + b3 * control[3][1];
+}
+
+// Points of a closed outline wrap around; its last point repeats the first.
+static inline const double*
+_PointAt(const double* points, int count, int index, bool closed)
+{
+	if (closed) {
+		count--;
+		index = ((index % count) + count) % count;
+	} else if (index < 0) {
+		index = 0;
+	} else if (index >= count) {
+		index = count - 1;
+	}
+	return _Point(points, index);
+}
+
+// Cosine of the turn at a point, 1 where there is none to measure.
+static double
+_TurnCosine(const double* points, int count, int index, bool closed)
+{
+	const double* point = _Point(points, index);
+	double in[2], out[2];
+	if (!_UnitDirection(_PointAt(points, count, index - kCornerSpan, closed), point, in)
+		|| !_UnitDirection(point, _PointAt(points, count, index + kCornerSpan, closed), out)) {
+		return 1.0;
+	}
+	return in[0] * out[0] + in[1] * out[1];
+}
+
+// Unit tangent at from, pointing towards the point kTangentSpan steps
+// away in the direction of to, or the next point if that one doubles back.
+static void
+_Tangent(const double* points, int from, int to, double tangent[2])
+{
+	int step = to > from ? 1 : -1;
+	int ahead = abs(to - from) > kTangentSpan ? from + step * kTangentSpan : to;
+	if (!_UnitDirection(_Point(points, from), _Point(points, ahead), tangent)
+		&& !_UnitDirection(_Point(points, from), _Point(points, from + step), tangent)) {
+		tangent[0] = step;
+		tangent[1] = 0;
+	}
+}
+
+static double
+_SegmentDistance2(const double point[2], const double* a, const double* b)
+{
+	double dx = b[0] - a[0];
+	double dy = b[1] - a[1];
+	double length2 = dx * dx + dy * dy;
+	double t = 0;
+	if (length2 > 1e-12) {
+		t = ((point[0] - a[0]) * dx + (point[1] - a[1]) * dy) / length2;
+		t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+	}
+	double ex = a[0] + dx * t - point[0];
+	double ey = a[1] + dy * t - point[1];
+	return ex * ex + ey * ey;
+}
+
+// Least squares fit of the two inner control points along the given
+// tangents (Schneider, "An Algorithm for Automatically Fitting Digitized
+// Curves", Graphics Gems, 1990).
+static void
+_GenerateCubic(const double* points, int first, int last,
+	const double* parameters, const double startTangent[2],
+	const double endTangent[2], double control[4][2])
+{
+	const double* start = _Point(points, first);
+	const double* end = _Point(points, last);
+
+	double c00 = 0, c01 = 0, c11 = 0, x0 = 0, x1 = 0;
+	for (int i = first; i <= last; i++) {
+		const double* point = _Point(points, i);
+		double t = parameters[i - first];
+		double mt = 1.0 - t;
+		double b0 = mt * mt * mt;
+		double b1 = 3.0 * mt * mt * t;
+		double b2 = 3.0 * mt * t * t;
+		double b3 = t * t * t;
+
+		double a0x = startTangent[0] * b1, a0y = startTangent[1] * b1;
+		double a1x = endTangent[0] * b2, a1y = endTangent[1] * b2;
+
+		double dx = point[0] - (start[0] * (b0 + b1) + end[0] * (b2 + b3));
+		double dy = point[1] - (start[1] * (b0 + b1) + end[1] * (b2 + b3));
+
+		c00 += a0x * a0x + a0y * a0y;
+		c01 += a0x * a1x + a0y * a1y;
+		c11 += a1x * a1x + a1y * a1y;
+		x0 += a0x * dx + a0y * dy;
+		x1 += a1x * dx + a1y * dy;
+	}
+
+	double chordX = end[0] - start[0];
+	double chordY = end[1] - start[1];
+	double chord = sqrt(chordX * chordX + chordY * chordY);
+
+	double determinant = c00 * c11 - c01 * c01;
+	double startAlpha = 0, endAlpha = 0;
+	if (fabs(determinant) > 1e-12) {
+		startAlpha = (x0 * c11 - x1 * c01) / determinant;
+		endAlpha = (c00 * x1 - c01 * x0) / determinant;
+	}
+
+	// Handles that point backwards, vanish or cross each other along the
+	// chord make loops and cusps; fall back to a third of the chord.
+	double epsilon = 1e-6 * chord;
+	double reach = (startTangent[0] * chordX + startTangent[1] * chordY) * startAlpha
+		- (endTangent[0] * chordX + endTangent[1] * chordY) * endAlpha;
+	if (startAlpha < epsilon || endAlpha < epsilon || reach > chord * chord)
+		startAlpha = endAlpha = chord / 3.0;
+
+	control[0][0] = start[0];
+	control[0][1] = start[1];
+	control[1][0] = start[0] + startTangent[0] * startAlpha;
+	control[1][1] = start[1] + startTangent[1] * startAlpha;
+	control[2][0] = end[0] + endTangent[0] * endAlpha;
+	control[2][1] = end[1] + endTangent[1] * endAlpha;
+	control[3][0] = end[0];
+	control[3][1] = end[1];
+}
+
+// Largest squared distance of a point from its place on the curve, or of
+// the curve between two neighbouring points from the line joining them,
+// so sparse points cannot hide a bulge.
+static double
+_MaxError(const double* points, int first, int last,
+	const double* parameters, const double control[4][2], int& worstPoint)
+{
+	double maxError = 0;
+	worstPoint = (first + last) / 2;
+	for (int i = first; i < last; i++) {
+		double point[2];
+		double error;
+		if (i > first) {
+			_Bezier(control, parameters[i - first], point);
+			const double* input = _Point(points, i);
+			double dx = point[0] - input[0];
+			double dy = point[1] - input[1];
+			error = dx * dx + dy * dy;
+			if (error > maxError) {
+				maxError = error;
+				worstPoint = i;
+			}
+		}
+
+		_Bezier(control, (parameters[i - first] + parameters[i + 1 - first]) / 2.0, point);
+		error = _SegmentDistance2(point, _Point(points, i), _Point(points, i + 1));
+		if (error > maxError) {
+			maxError = error;
+			worstPoint = i > first ? i : i + 1;
+		}
+	}
+	return maxError;
+}
+
+// One Newton-Raphson step moving every parameter towards the point on the
+// curve closest to its input point.
+static void
+_Reparameterize(const double* points, int first, int last,
+	double* parameters, const double control[4][2])
+{
+	for (int i = first + 1; i < last; i++) {
+		const double* input = _Point(points, i);
+		double t = parameters[i - first];
+		double mt = 1.0 - t;
+
+		double point[2];
+		_Bezier(control, t, point);
+
+		double d1[2], d2[2];
+		for (int axis = 0; axis < 2; axis++) {
+			d1[axis] = 3.0 * (mt * mt * (control[1][axis] - control[0][axis])
+				+ 2.0 * mt * t * (control[2][axis] - control[1][axis])
+				+ t * t * (control[3][axis] - control[2][axis]));
+			d2[axis] = 6.0 * (mt * (control[2][axis] - 2.0 * control[1][axis] + control[0][axis])
+				+ t * (control[3][axis] - 2.0 * control[2][axis] + control[1][axis]));
+		}
+
+		double dx = point[0] - input[0];
+		double dy = point[1] - input[1];
+		double numerator = dx * d1[0] + dy * d1[1];
+		double denominator = d1[0] * d1[0] + d1[1] * d1[1] + dx * d2[0] + dy * d2[1];
+		if (fabs(denominator) < 1e-12)
+			continue;
+
+		t -= numerator / denominator;
+		parameters[i - first] = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+	}
+}
 
 PathTracer::PathTracer()
+	: fCubicFitting(false)
+	, fSeams(NULL)
 {
 }
 
@@ -37,9 +284,68 @@ PathTracer::TracePath(const std::vector<std::vector<double> >& path, float lineT
 		return segments;
 	}
 
+	if (fSeams != NULL && fSeams->Touches(path))
+		return _TraceBetweenAnchors(path, lineThreshold, quadraticThreshold);
+
+	if (fCubicFitting)
+		return _FitCubicSequence(path, lineThreshold, quadraticThreshold);
+
 	return _FitSequence(path, lineThreshold, quadraticThreshold, 0, pathLength, 0);
 }
 
+std::vector<std::vector<double> >
+PathTracer::_TraceBetweenAnchors(const std::vector<std::vector<double> >& path,
+	float lineThreshold, float quadraticThreshold)
+{
+	// The path is closed; it may repeat its first point at the end.
+	int count = path.size();
+	if (path[count - 1][0] == path[0][0] && path[count - 1][1] == path[0][1])
+		count--;
+
+	std::vector<int> anchors;
+	for (int i = 0; i < count; i++) {
+		if (fSeams->IsAnchor(path[(i + count - 1) % count], path[i], path[(i + 1) % count]))
+			anchors.push_back(i);
+	}
+
+	if (anchors.empty() || count < 3) {
+		if (fCubicFitting)
+			return _FitCubicSequence(path, lineThreshold, quadraticThreshold);
+		return _FitSequence(path, lineThreshold, quadraticThreshold, 0, path.size(), 0);
+	}
+
+	// Every part runs from an anchor to the next one, the last one back
+	// around to the first.
+	std::vector<std::vector<double> > segments;
+	std::vector<std::vector<double> > part;
+	for (size_t a = 0; a < anchors.size(); a++) {
+		int first = anchors[a];
+		int last = a + 1 < anchors.size() ? anchors[a + 1] : anchors[0] + count;
+
+		part.clear();
+		for (int i = first; i <= last; i++)
+			part.push_back(path[i % count]);
+
+		std::vector<std::vector<double> > fitted;
+		if (part.size() == 2) {
+			std::vector<double> segment(7, 0.0);
+			segment[0] = 1.0;
+			segment[1] = part[0][0];
+			segment[2] = part[0][1];
+			segment[3] = part[1][0];
+			segment[4] = part[1][1];
+			fitted.push_back(segment);
+		} else if (fCubicFitting) {
+			fitted = _FitCubicSequence(part, lineThreshold, quadraticThreshold);
+		} else {
+			fitted = _FitSequence(part, lineThreshold, quadraticThreshold, 0, part.size(), 0);
+		}
+		segments.insert(segments.end(), fitted.begin(), fitted.end());
+	}
+
+	return segments;
+}
+
 std::vector<std::vector<double> >
 PathTracer::TracePathWithEdgeInfo(
 	const std::vector<std::vector<double> >& path,
@@ -80,6 +386,7 @@ PathTracer::BatchTracePaths(const std::vector<std::vector<std::vector<double> >
 							float lineThreshold, float quadraticThreshold)
 {
 	std::vector<std::vector<std::vector<double> > > tracedPaths;
+	tracedPaths.reserve(internodePaths.size());
 	for (int k = 0; k < static_cast<int>(internodePaths.size()); k++) {
 		if (!internodePaths[k].empty()) {
 			tracedPaths.push_back(TracePath(internodePaths[k], lineThreshold, quadraticThreshold));
@@ -95,17 +402,40 @@ PathTracer::_FitSequence(const std::vector<std::vector<double> >& path,
 						float lineThreshold, float quadraticThreshold,
 						int sequenceStart, int sequenceEnd, int depth)
 {
-	std::vector<std::vector<double> > segment;
+	// Ranges that do not fit are split in two and both halves are fitted
+	// in turn. The right half is pushed first, so segments come out in
+	// path order, as the fitter used to produce them recursively.
+	fSegments.clear();
+	fStack.clear();
+
+	Range range = { sequenceStart, sequenceEnd, depth };
+	fStack.push_back(range);
+	while (!fStack.empty()) {
+		range = fStack.back();
+		fStack.pop_back();
+		_FitRange(path, lineThreshold, quadraticThreshold, range);
+	}
+
+	return _TakeSegments();
+}
+
+void
+PathTracer::_FitRange(const std::vector<std::vector<double> >& path,
+					float lineThreshold, float quadraticThreshold,
+					const Range& range)
+{
+	int sequenceStart = range.start;
+	int sequenceEnd = range.end;
 	int pathLength = path.size();
 
 	if (sequenceStart < 0 || sequenceEnd <= sequenceStart || sequenceStart >= pathLength)
-		return segment;
+		return;
 
 	if (sequenceEnd > pathLength)
 		sequenceEnd = pathLength;
 
 	if ((sequenceEnd - sequenceStart) < 2)
-		return segment;
+		return;
 
 	bool isClosed = false;
 	if (sequenceStart == 0 && sequenceEnd == pathLength) {
@@ -116,17 +446,20 @@ PathTracer::_FitSequence(const std::vector<std::vector<double> >& path,
 		}
 	}
 
+	const std::vector<double>& first = path[sequenceStart];
+	const std::vector<double>& last = path[sequenceEnd - 1];
+
 	int errorPoint = sequenceStart;
 	bool curvePass = true;
 	double pointX, pointY, distance2, errorValue = 0;
 	double totalLength = static_cast<double>(sequenceEnd - sequenceStart);
-	double velocityX = (path[(sequenceEnd - 1) % pathLength][0] - path[sequenceStart][0]) / totalLength;
-	double velocityY = (path[(sequenceEnd - 1) % pathLength][1] - path[sequenceStart][1]) / totalLength;
+	double velocityX = (path[(sequenceEnd - 1) % pathLength][0] - first[0]) / totalLength;
+	double velocityY = (path[(sequenceEnd - 1) % pathLength][1] - first[1]) / totalLength;
 
 	for (int pointIndex = sequenceStart + 1; pointIndex < sequenceEnd - 1; pointIndex++) {
 		double pointLength = pointIndex - sequenceStart;
-		pointX = path[sequenceStart][0] + (velocityX * pointLength);
-		pointY = path[sequenceStart][1] + (velocityY * pointLength);
+		pointX = first[0] + (velocityX * pointLength);
+		pointY = first[1] + (velocityY * pointLength);
 		distance2 = ((path[pointIndex][0] - pointX) * (path[pointIndex][0] - pointX)) +
 				   ((path[pointIndex][1] - pointY) * (path[pointIndex][1] - pointY));
 		if (distance2 > lineThreshold) {
@@ -139,123 +472,305 @@ PathTracer::_FitSequence(const std::vector<std::vector<double> >& path,
 	}
 
 	if (curvePass) {
-		std::vector<double> thisSegment(7);
-		thisSegment[0] = 1.0;
-		thisSegment[1] = path[sequenceStart][0];
-		thisSegment[2] = path[sequenceStart][1];
-		thisSegment[3] = path[sequenceEnd - 1][0];
-		thisSegment[4] = path[sequenceEnd - 1][1];
-
-		if (isClosed) {
-			thisSegment[3] = thisSegment[1];
-			thisSegment[4] = thisSegment[2];
+		if (isClosed)
+			_Emit(1.0, first[0], first[1], first[0], first[1], 0.0, 0.0);
+		else
+			_Emit(1.0, first[0], first[1], last[0], last[1], 0.0, 0.0);
+		return;
+	}
+
+	int splitPoint;
+	bool splitHalfway = (sequenceEnd - sequenceStart) < 4;
+
+	if (!splitHalfway) {
+		int fitPoint = errorPoint;
+		curvePass = true;
+		errorValue = 0;
+
+		double t = static_cast<double>(fitPoint - sequenceStart) / totalLength;
+		double t1 = (1.0 - t) * (1.0 - t);
+		double t2 = 2.0 * (1.0 - t) * t;
+		double t3 = t * t;
+
+		splitHalfway = fabs(t2) < 0.001;
+		if (!splitHalfway) {
+			double controlPointX = (((t1 * first[0]) + (t3 * last[0])) - path[fitPoint][0]) / (-t2);
+			double controlPointY = (((t1 * first[1]) + (t3 * last[1])) - path[fitPoint][1]) / (-t2);
+
+			for (int pointIndex = sequenceStart + 1; pointIndex < sequenceEnd - 1; pointIndex++) {
+				t = static_cast<double>(pointIndex - sequenceStart) / totalLength;
+				t1 = (1.0 - t) * (1.0 - t);
+				t2 = 2.0 * (1.0 - t) * t;
+				t3 = t * t;
+				pointX = (t1 * first[0]) + (t2 * controlPointX) + (t3 * last[0]);
+				pointY = (t1 * first[1]) + (t2 * controlPointY) + (t3 * last[1]);
+
+				distance2 = ((path[pointIndex][0] - pointX) * (path[pointIndex][0] - pointX)) +
+						   ((path[pointIndex][1] - pointY) * (path[pointIndex][1] - pointY));
+
+				if (distance2 > quadraticThreshold)
+					curvePass = false;
+
+				if (distance2 > errorValue) {
+					errorPoint = pointIndex;
+					errorValue = distance2;
+				}
+			}
+
+			if (curvePass) {
+				_Emit(2.0, first[0], first[1], controlPointX, controlPointY,
+					last[0], last[1]);
+				return;
+			}
+
+			if (range.depth > 50) {
+				_Emit(1.0, first[0], first[1], last[0], last[1], 0.0, 0.0);
+				return;
+			}
 		}
+	}
 
-		thisSegment[5] = 0.0;
-		thisSegment[6] = 0.0;
-		segment.push_back(thisSegment);
-		return segment;
+	if (splitHalfway) {
+		splitPoint = (sequenceStart + sequenceEnd) / 2;
+	} else {
+		splitPoint = (sequenceStart + errorPoint) / 2;
+		if (splitPoint <= sequenceStart) splitPoint = sequenceStart + 1;
+		if (splitPoint >= sequenceEnd - 1) splitPoint = sequenceEnd - 2;
+
+		if (splitPoint <= sequenceStart || splitPoint >= sequenceEnd - 1) {
+			_Emit(1.0, first[0], first[1], last[0], last[1], 0.0, 0.0);
+			return;
+		}
 	}
 
-	if ((sequenceEnd - sequenceStart) < 4) {
-		int midPoint = (sequenceStart + sequenceEnd) / 2;
-		std::vector<std::vector<double> > result1 = _FitSequence(path, lineThreshold, quadraticThreshold, sequenceStart, midPoint + 1, depth + 1);
-		std::vector<std::vector<double> > result2 = _FitSequence(path, lineThreshold, quadraticThreshold, midPoint, sequenceEnd, depth + 1);
-		segment.insert(segment.end(), result1.begin(), result1.end());
-		segment.insert(segment.end(), result2.begin(), result2.end());
-		return segment;
+	Range right = { splitPoint, sequenceEnd, range.depth + 1 };
+	Range left = { sequenceStart, splitPoint + 1, range.depth + 1 };
+	fStack.push_back(right);
+	fStack.push_back(left);
+}
+
+void
+PathTracer::_Emit(double type, double x1, double y1, double x2, double y2,
+	double x3, double y3)
+{
+	fSegments.push_back(type);
+	fSegments.push_back(x1);
+	fSegments.push_back(y1);
+	fSegments.push_back(x2);
+	fSegments.push_back(y2);
+	fSegments.push_back(x3);
+	fSegments.push_back(y3);
+	fSegments.push_back(0.0);
+	fSegments.push_back(0.0);
+}
+
+std::vector<std::vector<double> >
+PathTracer::_FitCubicSequence(const std::vector<std::vector<double> >& path,
+							float lineThreshold, float quadraticThreshold)
+{
+	fSegments.clear();
+	fCubicStack.clear();
+	fCorners.clear();
+	fPoints.clear();
+
+	for (size_t i = 0; i < path.size(); i++) {
+		size_t size = fPoints.size();
+		if (size == 0 || fPoints[size - 2] != path[i][0] || fPoints[size - 1] != path[i][1]) {
+			fPoints.push_back(path[i][0]);
+			fPoints.push_back(path[i][1]);
+		}
 	}
 
-	int fitPoint = errorPoint;
-	curvePass = true;
-	errorValue = 0;
-
-	double t = static_cast<double>(fitPoint - sequenceStart) / totalLength;
-	double t1 = (1.0 - t) * (1.0 - t);
-	double t2 = 2.0 * (1.0 - t) * t;
-	double t3 = t * t;
-
-	if (fabs(t2) < 0.001) {
-		int midPoint = (sequenceStart + sequenceEnd) / 2;
-		std::vector<std::vector<double> > result1 = _FitSequence(path, lineThreshold, quadraticThreshold, sequenceStart, midPoint + 1, depth + 1);
-		std::vector<std::vector<double> > result2 = _FitSequence(path, lineThreshold, quadraticThreshold, midPoint, sequenceEnd, depth + 1);
-		segment.insert(segment.end(), result1.begin(), result1.end());
-		segment.insert(segment.end(), result2.begin(), result2.end());
-		return segment;
+	const double* points = &fPoints[0];
+	int count = fPoints.size() / 2;
+	if (count < 2)
+		return _TakeSegments();
+
+	const double* start = _Point(points, 0);
+	const double* end = _Point(points, count - 1);
+	bool isClosed = count > 3 && start[0] == end[0] && start[1] == end[1];
+
+	// Corners are the strongest turn among their neighbours, so a corner
+	// cut diagonally by the pixel grid yields one split, not two.
+	fCorners.push_back(0);
+	for (int i = 1; i < count - 1; i++) {
+		double turn = _TurnCosine(points, count, i, isClosed);
+		if (turn < kCornerCosine
+			&& turn <= _TurnCosine(points, count, i - 1, isClosed)
+			&& turn < _TurnCosine(points, count, i + 1, isClosed)) {
+			fCorners.push_back(i);
+		}
 	}
+	fCorners.push_back(count - 1);
+
+	// Without a corner at the seam of a closed outline, both ends share
+	// the tangent through it.
+	double seamTangent[2] = { 0, 0 };
+	bool smoothSeam = isClosed && _TurnCosine(points, count, 0, true) >= kCornerCosine
+		&& _UnitDirection(_PointAt(points, count, -1, true), _Point(points, 1), seamTangent);
+
+	// Curves may stray as far as lines do: internodes sit on the pixel
+	// grid, and holding a cubic closer than that only makes it follow the
+	// steps.
+	float curveThreshold = std::max(lineThreshold, quadraticThreshold);
+
+	for (size_t c = 0; c + 1 < fCorners.size(); c++) {
+		CubicRange range;
+		range.first = fCorners[c];
+		range.last = fCorners[c + 1];
+		range.depth = 0;
+
+		start = _Point(points, range.first);
+		end = _Point(points, range.last);
+
+		// Straight parts between corners become lines, tested as in
+		// _FitRange().
+		bool straight = true;
+		double length = range.last - range.first;
+		for (int i = range.first + 1; i < range.last && straight; i++) {
+			const double* point = _Point(points, i);
+			double t = (i - range.first) / length;
+			double lx = start[0] + (end[0] - start[0]) * t - point[0];
+			double ly = start[1] + (end[1] - start[1]) * t - point[1];
+			straight = lx * lx + ly * ly <= lineThreshold;
+		}
 
-	double controlPointX = (((t1 * path[sequenceStart][0]) + (t3 * path[sequenceEnd - 1][0])) - path[fitPoint][0]) / (-t2);
-	double controlPointY = (((t1 * path[sequenceStart][1]) + (t3 * path[sequenceEnd - 1][1])) - path[fitPoint][1]) / (-t2);
+		if (straight) {
+			_Emit(1.0, start[0], start[1], end[0], end[1], 0.0, 0.0);
+			continue;
+		}
 
-	for (int pointIndex = sequenceStart + 1; pointIndex < sequenceEnd - 1; pointIndex++) {
-		t = static_cast<double>(pointIndex - sequenceStart) / totalLength;
-		t1 = (1.0 - t) * (1.0 - t);
-		t2 = 2.0 * (1.0 - t) * t;
-		t3 = t * t;
-		pointX = (t1 * path[sequenceStart][0]) + (t2 * controlPointX) + (t3 * path[sequenceEnd - 1][0]);
-		pointY = (t1 * path[sequenceStart][1]) + (t2 * controlPointY) + (t3 * path[sequenceEnd - 1][1]);
+		if (smoothSeam && range.first == 0) {
+			range.startTangent[0] = seamTangent[0];
+			range.startTangent[1] = seamTangent[1];
+		} else
+			_Tangent(points, range.first, range.last, range.startTangent);
+
+		if (smoothSeam && range.last == count - 1) {
+			range.endTangent[0] = -seamTangent[0];
+			range.endTangent[1] = -seamTangent[1];
+		} else
+			_Tangent(points, range.last, range.first, range.endTangent);
+
+		fCubicStack.push_back(range);
+		while (!fCubicStack.empty()) {
+			range = fCubicStack.back();
+			fCubicStack.pop_back();
+			_FitCubicRange(curveThreshold, range);
+		}
+	}
 
-		distance2 = ((path[pointIndex][0] - pointX) * (path[pointIndex][0] - pointX)) +
-				   ((path[pointIndex][1] - pointY) * (path[pointIndex][1] - pointY));
+	return _TakeSegments();
+}
 
-		if (distance2 > quadraticThreshold)
-			curvePass = false;
+void
+PathTracer::_FitCubicRange(float curveThreshold, const CubicRange& range)
+{
+	const double* points = &fPoints[0];
+	int first = range.first;
+	int last = range.last;
+
+	// Nothing between two points tells a curve from a line.
+	if (last - first < 2) {
+		const double* start = _Point(points, first);
+		const double* end = _Point(points, last);
+		_Emit(1.0, start[0], start[1], end[0], end[1], 0.0, 0.0);
+		return;
+	}
 
-		if (distance2 > errorValue) {
-			errorPoint = pointIndex;
-			errorValue = distance2;
-		}
+	fParameters.resize(last - first + 1);
+	double* parameters = &fParameters[0];
+
+	parameters[0] = 0.0;
+	for (int i = first + 1; i <= last; i++) {
+		const double* previous = _Point(points, i - 1);
+		const double* point = _Point(points, i);
+		double dx = point[0] - previous[0];
+		double dy = point[1] - previous[1];
+		parameters[i - first] = parameters[i - first - 1] + sqrt(dx * dx + dy * dy);
 	}
 
-	if (curvePass) {
-		std::vector<double> thisSegment(7);
-		thisSegment[0] = 2.0;
-		thisSegment[1] = path[sequenceStart][0];
-		thisSegment[2] = path[sequenceStart][1];
-		thisSegment[3] = controlPointX;
-		thisSegment[4] = controlPointY;
-		thisSegment[5] = path[sequenceEnd - 1][0];
-		thisSegment[6] = path[sequenceEnd - 1][1];
-		segment.push_back(thisSegment);
-		return segment;
+	double total = parameters[last - first];
+	for (int i = first + 1; i <= last; i++)
+		parameters[i - first] /= total;
+
+	double control[4][2];
+	_GenerateCubic(points, first, last, parameters, range.startTangent,
+		range.endTangent, control);
+
+	int worstPoint;
+	double error = _MaxError(points, first, last, parameters, control, worstPoint);
+
+	if (error >= curveThreshold && error < curveThreshold * 4.0) {
+		for (int iteration = 0; iteration < kMaxReparameterize; iteration++) {
+			_Reparameterize(points, first, last, parameters, control);
+			_GenerateCubic(points, first, last, parameters, range.startTangent,
+				range.endTangent, control);
+			error = _MaxError(points, first, last, parameters, control, worstPoint);
+			if (error < curveThreshold)
+				break;
+		}
 	}
 
-	if (depth > 50) {
-		std::vector<double> thisSegment(7);
-		thisSegment[0] = 1.0;
-		thisSegment[1] = path[sequenceStart][0];
-		thisSegment[2] = path[sequenceStart][1];
-		thisSegment[3] = path[sequenceEnd - 1][0];
-		thisSegment[4] = path[sequenceEnd - 1][1];
-		thisSegment[5] = 0.0;
-		thisSegment[6] = 0.0;
-		segment.push_back(thisSegment);
-		return segment;
+	if (error < curveThreshold || range.depth > 50) {
+		_EmitCubic(control);
+		return;
 	}
 
-	int splitPoint = (sequenceStart + errorPoint) / 2;
-	if (splitPoint <= sequenceStart) splitPoint = sequenceStart + 1;
-	if (splitPoint >= sequenceEnd - 1) splitPoint = sequenceEnd - 2;
-
-	if (splitPoint <= sequenceStart || splitPoint >= sequenceEnd - 1) {
-		std::vector<double> thisSegment(7);
-		thisSegment[0] = 1.0;
-		thisSegment[1] = path[sequenceStart][0];
-		thisSegment[2] = path[sequenceStart][1];
-		thisSegment[3] = path[sequenceEnd - 1][0];
-		thisSegment[4] = path[sequenceEnd - 1][1];
-		thisSegment[5] = 0.0;
-		thisSegment[6] = 0.0;
-		segment.push_back(thisSegment);
-		return segment;
+	int splitPoint = worstPoint;
+	if (splitPoint <= first) splitPoint = first + 1;
+	if (splitPoint >= last) splitPoint = last - 1;
+
+	// Both halves leave the split point along the same line.
+	double centerTangent[2];
+	if (!_UnitDirection(_Point(points, splitPoint + 1), _Point(points, splitPoint - 1),
+			centerTangent)) {
+		_UnitDirection(_Point(points, splitPoint), _Point(points, splitPoint - 1),
+			centerTangent);
 	}
 
-	std::vector<std::vector<double> > result1 = _FitSequence(path, lineThreshold, quadraticThreshold, sequenceStart, splitPoint + 1, depth + 1);
-	std::vector<std::vector<double> > result2 = _FitSequence(path, lineThreshold, quadraticThreshold, splitPoint, sequenceEnd, depth + 1);
+	CubicRange left = range;
+	left.last = splitPoint;
+	left.depth = range.depth + 1;
+	left.endTangent[0] = centerTangent[0];
+	left.endTangent[1] = centerTangent[1];
+
+	CubicRange right = range;
+	right.first = splitPoint;
+	right.depth = range.depth + 1;
+	right.startTangent[0] = -centerTangent[0];
+	right.startTangent[1] = -centerTangent[1];
+
+	fCubicStack.push_back(right);
+	fCubicStack.push_back(left);
+}
 
-	segment.insert(segment.end(), result1.begin(), result1.end());
-	segment.insert(segment.end(), result2.begin(), result2.end());
-	return segment;
+void
+PathTracer::_EmitCubic(const double control[4][2])
+{
+	fSegments.push_back(3.0);
+	fSegments.push_back(control[0][0]);
+	fSegments.push_back(control[0][1]);
+	fSegments.push_back(control[1][0]);
+	fSegments.push_back(control[1][1]);
+	fSegments.push_back(control[3][0]);
+	fSegments.push_back(control[3][1]);
+	fSegments.push_back(control[2][0]);
+	fSegments.push_back(control[2][1]);
+}
+
+std::vector<std::vector<double> >
+PathTracer::_TakeSegments()
+{
+	size_t count = fSegments.size() / kSegmentStride;
+	std::vector<std::vector<double> > segments;
+	segments.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		const double* values = &fSegments[i * kSegmentStride];
+		size_t size = values[0] == 3.0 ? 9 : 7;
+		segments.push_back(std::vector<double>(values, values + size));
+	}
+	return segments;
 }
 
 std::vector<std::vector<double> >
@@ -266,8 +781,9 @@ PathTracer::_FitSequenceWithEdges(
 	const SharedEdgeRegistry* edgeRegistry,
 	int layer, int pathIndex)
 {
-	std::vector<std::vector<double> > result =
-		_FitSequence(path, lineThreshold, quadraticThreshold, sequenceStart, sequenceEnd, depth);
+	std::vector<std::vector<double> > result = fCubicFitting
+		? _FitCubicSequence(path, lineThreshold, quadraticThreshold)
+		: _FitSequence(path, lineThreshold, quadraticThreshold, sequenceStart, sequenceEnd, depth);
 
 	if (!edgeRegistry || result.empty())
 		return result;
@@ -286,7 +802,7 @@ PathTracer::_FitSequenceWithEdges(
 				result[i][3] = unifiedX;
 				result[i][4] = unifiedY;
 			}
-		} else if (type == 2 && result[i].size() >= 7) {
+		} else if (type >= 2 && result[i].size() >= 7) {
 			if (edgeRegistry->GetUnifiedCoordinate(layer, pathIndex, i, 2, unifiedX, unifiedY)) {
 				result[i][5] = unifiedX;
 				result[i][6] = unifiedY;
@@ -9,12 +9,30 @@
 #include <vector>
 
 class SharedEdgeRegistry;
+class TileSeams;
 
+// Traced segments are vectors of doubles, with the segment type first:
+//   line		1, x1, y1, x2, y2, 0, 0
+//   quadratic	2, x1, y1, cx, cy, x2, y2
+//   cubic		3, x1, y1, c1x, c1y, x2, y2, c2x, c2y
+// Every curve keeps its end point at [5], [6]; a cubic appends the control
+// point next to its end, so code that only needs end points treats both
+// curve types alike.
 class PathTracer {
 public:
 							PathTracer();
 							~PathTracer();
 
+	// Fit cubic Bezier segments instead of quadratic ones. Outlines are cut
+	// at corners; within each part the cubics join with matching tangents.
+	void					SetCubicFitting(bool enabled)
+								{ fCubicFitting = enabled; }
+
+	// Paths of a tile are fitted in parts from one anchor on the seams to
+	// the next, so the points where they join or leave a seam stay put.
+	void					SetSeams(const TileSeams* seams)
+								{ fSeams = seams; }
+
 	std::vector<std::vector<double> >
 							TracePath(const std::vector<std::vector<double> >& path,
 									float lineThreshold, float quadraticThreshold);
@@ -33,11 +51,47 @@ public:
 										float lineThreshold, float quadraticThreshold);
 
 private:
+	struct Range {
+		int					start;
+		int					end;
+		int					depth;
+	};
+
+	// Points first to last, inclusive, with unit tangents pointing into
+	// the range at both ends.
+	struct CubicRange {
+		int					first;
+		int					last;
+		int					depth;
+		double				startTangent[2];
+		double				endTangent[2];
+	};
+
 	std::vector<std::vector<double> >
 							_FitSequence(const std::vector<std::vector<double> >& path,
 										float lineThreshold, float quadraticThreshold,
 										int sequenceStart, int sequenceEnd, int depth);
 
+	void					_FitRange(const std::vector<std::vector<double> >& path,
+										float lineThreshold, float quadraticThreshold,
+										const Range& range);
+	void					_Emit(double type, double x1, double y1,
+										double x2, double y2, double x3, double y3);
+
+	std::vector<std::vector<double> >
+							_TraceBetweenAnchors(
+										const std::vector<std::vector<double> >& path,
+										float lineThreshold, float quadraticThreshold);
+
+	std::vector<std::vector<double> >
+							_FitCubicSequence(const std::vector<std::vector<double> >& path,
+										float lineThreshold, float quadraticThreshold);
+	void					_FitCubicRange(float curveThreshold, const CubicRange& range);
+	void					_EmitCubic(const double control[4][2]);
+
+	std::vector<std::vector<double> >
+							_TakeSegments();
+
 	std::vector<std::vector<double> >
 							_FitSequenceWithEdges(
 										const std::vector<std::vector<double> >& path,
@@ -45,6 +99,19 @@ private:
 										int sequenceStart, int sequenceEnd, int depth,
 										const SharedEdgeRegistry* edgeRegistry,
 										int layer, int pathIndex);
+
+	bool					fCubicFitting;
+	const TileSeams*		fSeams;
+
+	// Scratch kept across paths, so tracing a layer only allocates the
+	// segments it returns once the buffers have grown to the largest path.
+	// Segments are collected flat, kSegmentStride values each.
+	std::vector<Range>		fStack;
+	std::vector<CubicRange>	fCubicStack;
+	std::vector<int>		fCorners;
+	std::vector<double>		fPoints;
+	std::vector<double>		fParameters;
+	std::vector<double>		fSegments;
 };
 
 #endif
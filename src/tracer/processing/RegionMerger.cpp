@@ -4,9 +4,12 @@
  */
 
 #include <cmath>
+#include <algorithm>
+#include <thread>
 
 #include "RegionMerger.h"
 #include "MathUtils.h"
+#include "ParallelUtils.h"
 
 RegionMerger::RegionMerger() {}
 RegionMerger::~RegionMerger() {}
@@ -34,6 +37,30 @@ RegionMerger::_AccumulateSample(WLSums& s, double x, double y, double luma, doub
 	s.Wsy += w * luma * y;
 }
 
+void
+RegionMerger::_MergeSums(WLSums& dst, const WLSums& src)
+{
+	dst.W   += src.W;
+	dst.Wx  += src.Wx;
+	dst.Wy  += src.Wy;
+	dst.Wxx += src.Wxx;
+	dst.Wyy += src.Wyy;
+	dst.Wxy += src.Wxy;
+
+	dst.Ws  += src.Ws;
+	dst.Wsx += src.Wsx;
+	dst.Wsy += src.Wsy;
+}
+
+void
+RegionMerger::_MergeStats(EdgeStats& dst, const EdgeStats& src)
+{
+	dst.count += src.count;
+	dst.sumDiff += src.sumDiff;
+	_MergeSums(dst.sa, src.sa);
+	_MergeSums(dst.sb, src.sb);
+}
+
 bool
 RegionMerger::_GradientFromSums(const WLSums& s, double& gx, double& gy)
 {
@@ -51,168 +78,166 @@ RegionMerger::_GradientFromSums(const WLSums& s, double& gx, double& gy)
 	return true;
 }
 
+bool
+RegionMerger::_AccumulatePair(EdgeTable& table,
+							const std::vector<std::vector<unsigned char> >& palette,
+							const BitmapData& source,
+							const double* lumaLUT,
+							bool useLinear,
+							int a, int b,
+							int ax, int ay, int bx, int by)
+{
+	int K = (int)palette.size();
+	int aa = a < b ? a : b;
+	int bb = a < b ? b : a;
+
+	if (aa >= K || bb >= K)
+		return true;
+
+	unsigned char alphaA = palette[aa][3];
+	unsigned char alphaB = palette[bb][3];
+
+	if (MathUtils::IsTransparent(alphaA) || MathUtils::IsTransparent(alphaB))
+		return false;
+
+	if (MathUtils::AlphaGroup(alphaA) != MathUtils::AlphaGroup(alphaB))
+		return false;
+
+	int width = source.Width();
+	int height = source.Height();
+
+	if (ax < 0 || ax >= width || ay < 0 || ay >= height ||
+		bx < 0 || bx >= width || by < 0 || by >= height)
+		return true;
+
+	const unsigned char* p1 = source.Bits() + ((size_t)ay * width + ax) * 4;
+	const unsigned char* p2 = source.Bits() + ((size_t)by * width + bx) * 4;
+
+	double diff = _ColorDiffL2(p1[0], p1[1], p1[2], p1[3], p2[0], p2[1], p2[2], p2[3], useLinear);
+	if (diff > MathUtils::MAX_DISTANCE * 0.5)
+		return false;
+
+	EdgeStats& es = table.At(aa, bb);
+	es.sumDiff += diff;
+	es.count++;
+
+	double s1 = MathUtils::LumaD(lumaLUT[p1[0]], lumaLUT[p1[1]], lumaLUT[p1[2]]);
+	double s2 = MathUtils::LumaD(lumaLUT[p2[0]], lumaLUT[p2[1]], lumaLUT[p2[2]]);
+	_AccumulateSample(es.sa, (double)ax, (double)ay, s1, 1.0);
+	_AccumulateSample(es.sb, (double)bx, (double)by, s2, 1.0);
+
+	return true;
+}
+
+void
+RegionMerger::_AccumulateRows(const IndexedBitmap& indexed,
+							const BitmapData& source,
+							const double* lumaLUT,
+							bool useLinear,
+							int rowStart, int rowEnd,
+							EdgeTable& table)
+{
+	const std::vector<std::vector<int> >& arr = indexed.Array();
+	const std::vector<std::vector<unsigned char> >& palette = indexed.Palette();
+
+	int xs = 1, xe = (int)arr[0].size() - 2;
+
+	for (int y = rowStart; y < rowEnd; y++) {
+		const std::vector<int>& row = arr[y];
+		const std::vector<int>& below = arr[y + 1];
+
+		for (int x = xs; x <= xe; x++) {
+			int a = row[x];
+			if (a < 0) continue;
+
+			// A rejected horizontal pair also skips the vertical neighbour,
+			// matching the original single-pass accumulation.
+			int b = row[x + 1];
+			if (b >= 0 && b != a) {
+				if (!_AccumulatePair(table, palette, source, lumaLUT, useLinear,
+						a, b, x - 1, y - 1, x, y - 1))
+					continue;
+			}
+
+			b = below[x];
+			if (b >= 0 && b != a) {
+				_AccumulatePair(table, palette, source, lumaLUT, useLinear,
+					a, b, x - 1, y - 1, x - 1, y);
+			}
+		}
+	}
+}
+
 void
 RegionMerger::_BuildAdjacency(const IndexedBitmap& indexed,
 							const BitmapData& source,
 							const TracingOptions& options,
-							std::map<std::pair<int,int>, EdgeStats>& adj)
+							EdgeTable& adj)
 {
 	const std::vector<std::vector<int> >& arr = indexed.Array();
-	const std::vector<std::vector<unsigned char> >& palette = indexed.Palette();
+	int K = (int)indexed.Palette().size();
 
-	if (arr.empty() || arr[0].empty())
+	adj.Init(K);
+
+	if (arr.empty() || arr[0].empty() || K == 0)
 		return;
 
 	int h = (int)arr.size();
-	int w = (int)arr[0].size();
-
 	int ys = 1, ye = h - 2;
-	int xs = 1, xe = w - 2;
+	int rows = ye - ys + 1;
+	if (rows <= 0)
+		return;
 
 	bool useLinear = options.fRegionMergeUseLinearRGB;
 
-	for (int y = ys; y <= ye; y++) {
-		for (int x = xs; x <= xe; x++) {
-			int a = arr[y][x];
-			if (a < 0) continue;
+	double lumaLUT[256];
+	for (int v = 0; v < 256; v++)
+		lumaLUT[v] = useLinear ? MathUtils::SRGBToLinearLUT((unsigned char)v) : (double)v;
 
-			int b = arr[y][x + 1];
-			if (b >= 0 && b != a) {
-				int aa = a < b ? a : b;
-				int bb = a < b ? b : a;
-
-				if (aa < (int)palette.size() && bb < (int)palette.size()) {
-					unsigned char alphaA = palette[aa][3];
-					unsigned char alphaB = palette[bb][3];
-					
-					if (MathUtils::IsTransparent(alphaA) || MathUtils::IsTransparent(alphaB)) {
-						continue;
-					}
-					
-					if (MathUtils::AlphaGroup(alphaA) != MathUtils::AlphaGroup(alphaB)) {
-						continue;
-					}
-					
-					std::pair<int,int> key(aa, bb);
-					std::map<std::pair<int,int>, EdgeStats>::iterator it = adj.find(key);
-					if (it == adj.end()) {
-						adj[key] = EdgeStats(aa, bb);
-						it = adj.find(key);
-					}
-
-					int ax = x - 1;
-					int ay = y - 1;
-					int bx = x;
-					int by = y - 1;
-
-					if (ax >= 0 && ax < source.Width() && ay >= 0 && ay < source.Height() &&
-						bx >= 0 && bx < source.Width() && by >= 0 && by < source.Height()) {
-
-						unsigned char r1 = source.GetPixelComponent(ax, ay, 0);
-						unsigned char g1 = source.GetPixelComponent(ax, ay, 1);
-						unsigned char b1 = source.GetPixelComponent(ax, ay, 2);
-						unsigned char a1 = source.GetPixelComponent(ax, ay, 3);
-
-						unsigned char r2 = source.GetPixelComponent(bx, by, 0);
-						unsigned char g2 = source.GetPixelComponent(bx, by, 1);
-						unsigned char b2 = source.GetPixelComponent(bx, by, 2);
-						unsigned char a2 = source.GetPixelComponent(bx, by, 3);
-
-						double diff = _ColorDiffL2(r1,g1,b1,a1,r2,g2,b2,a2,useLinear);
-						if (diff > MathUtils::MAX_DISTANCE * 0.5) continue;
-						
-						it->second.sumDiff += diff;
-						it->second.count++;
-
-						double R1 = (double)r1, G1 = (double)g1, B1 = (double)b1;
-						double R2 = (double)r2, G2 = (double)g2, B2 = (double)b2;
-						if (useLinear) {
-							R1 = MathUtils::SRGBToLinear(R1);
-							G1 = MathUtils::SRGBToLinear(G1);
-							B1 = MathUtils::SRGBToLinear(B1);
-							R2 = MathUtils::SRGBToLinear(R2);
-							G2 = MathUtils::SRGBToLinear(G2);
-							B2 = MathUtils::SRGBToLinear(B2);
-						}
-						double s1 = MathUtils::LumaD(R1,G1,B1);
-						double s2 = MathUtils::LumaD(R2,G2,B2);
-						_AccumulateSample(it->second.sa, (double)ax, (double)ay, s1, 1.0);
-						_AccumulateSample(it->second.sb, (double)bx, (double)by, s2, 1.0);
-					}
-				}
-			}
+	// Each worker accumulates a band of rows into a private table; the
+	// tables are then summed in band order so results do not depend on
+	// scheduling. The band count is capped to keep dense tables bounded.
+	const size_t kMaxTableBytes = 64 * 1024 * 1024;
+	size_t tableBytes = (size_t)K * K * sizeof(EdgeStats);
 
-			b = arr[y + 1][x];
-			if (b >= 0 && b != a) {
-				int aa = a < b ? a : b;
-				int bb = a < b ? b : a;
-
-				if (aa < (int)palette.size() && bb < (int)palette.size()) {
-					unsigned char alphaA = palette[aa][3];
-					unsigned char alphaB = palette[bb][3];
-
-					if (MathUtils::IsTransparent(alphaA) || MathUtils::IsTransparent(alphaB))
-						continue;
-					
-					if (MathUtils::AlphaGroup(alphaA) != MathUtils::AlphaGroup(alphaB))
-						continue;
-
-					std::pair<int,int> key(aa, bb);
-					std::map<std::pair<int,int>, EdgeStats>::iterator it = adj.find(key);
-					if (it == adj.end()) {
-						adj[key] = EdgeStats(aa, bb);
-						it = adj.find(key);
-					}
-
-					int ax = x - 1;
-					int ay = y - 1;
-					int bx = x - 1;
-					int by = y;
-
-					if (ax >= 0 && ax < source.Width() && ay >= 0 && ay < source.Height() &&
-						bx >= 0 && bx < source.Width() && by >= 0 && by < source.Height()) {
-
-						unsigned char r1 = source.GetPixelComponent(ax, ay, 0);
-						unsigned char g1 = source.GetPixelComponent(ax, ay, 1);
-						unsigned char b1 = source.GetPixelComponent(ax, ay, 2);
-						unsigned char a1 = source.GetPixelComponent(ax, ay, 3);
-
-						unsigned char r2 = source.GetPixelComponent(bx, by, 0);
-						unsigned char g2 = source.GetPixelComponent(bx, by, 1);
-						unsigned char b2 = source.GetPixelComponent(bx, by, 2);
-						unsigned char a2 = source.GetPixelComponent(bx, by, 3);
-
-						double diff = _ColorDiffL2(r1,g1,b1,a1,r2,g2,b2,a2,useLinear);
-						if (diff > MathUtils::MAX_DISTANCE * 0.5)
-							continue;
-
-						it->second.sumDiff += diff;
-						it->second.count++;
-
-						double R1 = (double)r1, G1 = (double)g1, B1 = (double)b1;
-						double R2 = (double)r2, G2 = (double)g2, B2 = (double)b2;
-						if (useLinear) {
-							R1 = MathUtils::SRGBToLinear(R1);
-							G1 = MathUtils::SRGBToLinear(G1);
-							B1 = MathUtils::SRGBToLinear(B1);
-							R2 = MathUtils::SRGBToLinear(R2);
-							G2 = MathUtils::SRGBToLinear(G2);
-							B2 = MathUtils::SRGBToLinear(B2);
-						}
-						double s1 = MathUtils::LumaD(R1,G1,B1);
-						double s2 = MathUtils::LumaD(R2,G2,B2);
-						_AccumulateSample(it->second.sa, (double)ax, (double)ay, s1, 1.0);
-						_AccumulateSample(it->second.sb, (double)bx, (double)by, s2, 1.0);
-					}
-				}
+	int numBands = (int)std::thread::hardware_concurrency();
+	if (numBands < 1) numBands = 1;
+	if (numBands > rows) numBands = rows;
+	if (adj.IsDense() && tableBytes * numBands > kMaxTableBytes)
+		numBands = std::max(1, (int)(kMaxTableBytes / tableBytes));
+
+	if (numBands == 1) {
+		_AccumulateRows(indexed, source, lumaLUT, useLinear, ys, ye + 1, adj);
+		return;
+	}
+
+	std::vector<EdgeTable> bands(numBands);
+
+	ParallelUtils::ParallelFor(0, numBands, [&](int band) {
+		int rowStart = ys + (int)((long long)rows * band / numBands);
+		int rowEnd = ys + (int)((long long)rows * (band + 1) / numBands);
+		bands[band].Init(K);
+		_AccumulateRows(indexed, source, lumaLUT, useLinear, rowStart, rowEnd, bands[band]);
+	});
+
+	for (int band = 0; band < numBands; band++) {
+		const EdgeTable& table = bands[band];
+		if (table.IsDense()) {
+			for (size_t i = 0; i < table.dense.size(); i++) {
+				if (table.dense[i].count > 0)
+					_MergeStats(adj.dense[i], table.dense[i]);
 			}
+		} else {
+			std::map<std::pair<int, int>, EdgeStats>::const_iterator it;
+			for (it = table.sparse.begin(); it != table.sparse.end(); ++it)
+				_MergeStats(adj.sparse[it->first], it->second);
 		}
 	}
 }
 
 void
 RegionMerger::_ApplyMerging(const IndexedBitmap& indexed,
-							const std::map<std::pair<int,int>, EdgeStats>& adj,
+							const EdgeTable& adj,
 							const TracingOptions& options,
 							std::vector<int>& indexMap)
 {
@@ -229,14 +254,31 @@ RegionMerger::_ApplyMerging(const IndexedBitmap& indexed,
 
 	const int MIN_REGION_AREA = 50; // TODO ?
 
-	std::map<std::pair<int,int>, EdgeStats>::const_iterator it = adj.begin();
-	for (; it != adj.end(); ++it) {
-		const EdgeStats& es = it->second;
-		if (es.count < (long)minCount)
+	// Pairs in (a, b) order either way, so merges happen in the same order
+	// for dense and sparse tables.
+	std::vector<std::pair<int, int> > pairs;
+	if (adj.IsDense()) {
+		for (int ia = 0; ia < K; ia++) {
+			for (int ib = ia + 1; ib < K; ib++) {
+				if (adj.dense[(size_t)ia * K + ib].count > 0)
+					pairs.push_back(std::make_pair(ia, ib));
+			}
+		}
+	} else {
+		std::map<std::pair<int, int>, EdgeStats>::const_iterator it;
+		for (it = adj.sparse.begin(); it != adj.sparse.end(); ++it)
+			pairs.push_back(it->first);
+	}
+
+	for (size_t p = 0; p < pairs.size(); p++) {
+		int ia = pairs[p].first;
+		int ib = pairs[p].second;
+		const EdgeStats& es = *adj.Find(ia, ib);
+		if (es.count == 0 || es.count < (long)minCount)
 			continue;
 
-		unsigned char aA = (es.a >= 0 && es.a < K) ? palette[es.a][3] : 255;
-		unsigned char aB = (es.b >= 0 && es.b < K) ? palette[es.b][3] : 255;
+		unsigned char aA = palette[ia][3];
+		unsigned char aB = palette[ib][3];
 
 		if (MathUtils::IsTransparent(aA) || MathUtils::IsTransparent(aB))
 			continue;
@@ -284,7 +326,7 @@ RegionMerger::_ApplyMerging(const IndexedBitmap& indexed,
 		}
 
 		if (mergeOK) {
-			dsu.Union(es.a, es.b);
+			dsu.Union(ia, ib);
 		}
 	}
 
@@ -306,7 +348,7 @@ RegionMerger::MergeRegions(const IndexedBitmap& indexed,
 	if (arr.empty() || arr[0].empty())
 		return indexed;
 
-	std::map<std::pair<int,int>, EdgeStats> adjacency;
+	EdgeTable adjacency;
 	_BuildAdjacency(indexed, source, options, adjacency);
 
 	std::vector<int> indexMap;
@@ -6,9 +6,8 @@
 #ifndef REGION_MERGER_H
 #define REGION_MERGER_H
 
-#include <vector>
 #include <map>
-#include <utility>
+#include <vector>
 #include <cmath>
 
 #include "IndexedBitmap.h"
@@ -35,16 +34,52 @@ private:
 		{}
 	};
 
+	// Boundary statistics for an unordered palette pair (a < b).
 	struct EdgeStats {
-		int a, b;
 		long count;
 		double sumDiff;
 
 		WLSums sa;
 		WLSums sb;
 
-		EdgeStats() : a(0), b(0), count(0), sumDiff(0.0) {}
-		EdgeStats(int ia, int ib) : a(ia), b(ib), count(0), sumDiff(0.0) {}
+		EdgeStats() : count(0), sumDiff(0.0) {}
+	};
+
+	// EdgeStats for all pairs of a palette. Up to kMaxDenseColors colors
+	// they live in a dense K x K table indexed by a * K + b, of which only
+	// the upper triangle is used; larger palettes would make that table
+	// too big and fall back to a map of the pairs that actually touch.
+	static const int kMaxDenseColors = 256;
+
+	struct EdgeTable {
+		int K;
+		std::vector<EdgeStats> dense;
+		std::map<std::pair<int, int>, EdgeStats> sparse;
+
+		EdgeTable() : K(0) {}
+
+		void Init(int colors) {
+			K = colors;
+			dense.clear();
+			sparse.clear();
+			if (IsDense())
+				dense.assign((size_t)K * K, EdgeStats());
+		}
+		bool IsDense() const { return K <= kMaxDenseColors; }
+		EdgeStats& At(int a, int b) {
+			if (IsDense())
+				return dense[(size_t)a * K + b];
+			return sparse[std::make_pair(a, b)];
+		}
+		const EdgeStats* Find(int a, int b) const {
+			if (IsDense()) {
+				const EdgeStats& es = dense[(size_t)a * K + b];
+				return es.count > 0 ? &es : NULL;
+			}
+			std::map<std::pair<int, int>, EdgeStats>::const_iterator it
+				= sparse.find(std::make_pair(a, b));
+			return it != sparse.end() ? &it->second : NULL;
+		}
 	};
 
 	struct DSU {
@@ -78,15 +113,32 @@ private:
 									bool useLinear);
 
 	void				_AccumulateSample(WLSums& s, double x, double y, double luma, double w);
+	void				_MergeSums(WLSums& dst, const WLSums& src);
+	void				_MergeStats(EdgeStats& dst, const EdgeStats& src);
 	bool				_GradientFromSums(const WLSums& s, double& gx, double& gy);
 
+	bool				_AccumulatePair(EdgeTable& table,
+										const std::vector<std::vector<unsigned char> >& palette,
+										const BitmapData& source,
+										const double* lumaLUT,
+										bool useLinear,
+										int a, int b,
+										int ax, int ay, int bx, int by);
+
+	void				_AccumulateRows(const IndexedBitmap& indexed,
+										const BitmapData& source,
+										const double* lumaLUT,
+										bool useLinear,
+										int rowStart, int rowEnd,
+										EdgeTable& table);
+
 	void				_BuildAdjacency(const IndexedBitmap& indexed,
 										const BitmapData& source,
 										const TracingOptions& options,
-										std::map<std::pair<int,int>, EdgeStats>& adj);
+										EdgeTable& adj);
 
 	void				_ApplyMerging(const IndexedBitmap& indexed,
-									const std::map<std::pair<int,int>, EdgeStats>& adj,
+									const EdgeTable& adj,
 									const TracingOptions& options,
 									std::vector<int>& indexMap);
 };
@@ -41,12 +41,47 @@ SelectiveBlur::_GenerateGaussianKernel(int radius)
 BitmapData
 SelectiveBlur::BlurBitmap(const BitmapData& bitmap, float radius, float delta)
 {
-	BitmapData result(bitmap.Width(), bitmap.Height(),
-					std::vector<unsigned char>(bitmap.Width() * bitmap.Height() * 4));
+	if (static_cast<int>(floor(radius)) < 1)
+		return bitmap;
+
+	BitmapData result(bitmap.Width(), bitmap.Height(), bitmap.Bits());
+	BlurBitmapInPlace(result, radius, delta);
+	return result;
+}
+
+void
+SelectiveBlur::_BlurRow(const unsigned char* source, unsigned char* target,
+	int width, const std::vector<double>& kernel, int radius)
+{
+	for (int x = 0; x < width; x++) {
+		double redAccumulator = 0, greenAccumulator = 0, blueAccumulator = 0, alphaAccumulator = 0;
+		double weightAccumulator = 0;
+
+		for (int k = -radius; k < (radius + 1); k++) {
+			if (((x + k) > 0) && ((x + k) < width)) {
+				const unsigned char* p = source + (x + k) * 4;
+				redAccumulator   += p[0] * kernel[k + radius];
+				greenAccumulator += p[1] * kernel[k + radius];
+				blueAccumulator  += p[2] * kernel[k + radius];
+				alphaAccumulator += p[3] * kernel[k + radius];
+				weightAccumulator += kernel[k + radius];
+			}
+		}
+
+		unsigned char* out = target + x * 4;
+		out[0] = static_cast<unsigned char>(floor(redAccumulator / weightAccumulator));
+		out[1] = static_cast<unsigned char>(floor(greenAccumulator / weightAccumulator));
+		out[2] = static_cast<unsigned char>(floor(blueAccumulator / weightAccumulator));
+		out[3] = static_cast<unsigned char>(floor(alphaAccumulator / weightAccumulator));
+	}
+}
 
+void
+SelectiveBlur::BlurBitmapInPlace(BitmapData& bitmap, float radius, float delta)
+{
 	int radiusInt = static_cast<int>(floor(radius));
 	if (radiusInt < 1)
-		return bitmap;
+		return;
 
 	if (radiusInt > 5)
 		radiusInt = 5;
@@ -55,73 +90,63 @@ SelectiveBlur::BlurBitmap(const BitmapData& bitmap, float radius, float delta)
 	if (deltaInt > 1024)
 		deltaInt = 1024;
 
-	std::vector<double> gaussianKernel = _GenerateGaussianKernel(radiusInt);
+	unsigned char* bits = bitmap.MutableBits();
+	if (bits == NULL)
+		return;
 
-	// Horizontal blur pass
-	for (int y = 0; y < bitmap.Height(); y++) {
-		for (int x = 0; x < bitmap.Width(); x++) {
-			double redAccumulator = 0, greenAccumulator = 0, blueAccumulator = 0, alphaAccumulator = 0;
-			double weightAccumulator = 0;
+	int width = bitmap.Width();
+	int height = bitmap.Height();
+	size_t rowBytes = (size_t)width * 4;
 
-			for (int k = -radiusInt; k < (radiusInt + 1); k++) {
-				if (((x + k) > 0) && ((x + k) < bitmap.Width())) {
-					redAccumulator   += bitmap.GetPixelComponent(x + k, y, 0) * gaussianKernel[k + radiusInt];
-					greenAccumulator += bitmap.GetPixelComponent(x + k, y, 1) * gaussianKernel[k + radiusInt];
-					blueAccumulator  += bitmap.GetPixelComponent(x + k, y, 2) * gaussianKernel[k + radiusInt];
-					alphaAccumulator += bitmap.GetPixelComponent(x + k, y, 3) * gaussianKernel[k + radiusInt];
-					weightAccumulator += gaussianKernel[k + radiusInt];
-				}
-			}
+	std::vector<double> gaussianKernel = _GenerateGaussianKernel(radiusInt);
 
-			result.SetPixelComponent(x, y, 0, static_cast<unsigned char>(floor(redAccumulator / weightAccumulator)));
-			result.SetPixelComponent(x, y, 1, static_cast<unsigned char>(floor(greenAccumulator / weightAccumulator)));
-			result.SetPixelComponent(x, y, 2, static_cast<unsigned char>(floor(blueAccumulator / weightAccumulator)));
-			result.SetPixelComponent(x, y, 3, static_cast<unsigned char>(floor(alphaAccumulator / weightAccumulator)));
+	// Horizontally blurred rows y - radius .. y + radius live in a small
+	// ring, so row y can be overwritten while the rows below it still hold
+	// the original pixels the horizontal pass and the edge test need.
+	int ringSize = radiusInt * 2 + 1;
+	std::vector<unsigned char> ring(ringSize * rowBytes);
+	int nextRow = 0;
+
+	for (int y = 0; y < height; y++) {
+		for (; nextRow <= y + radiusInt && nextRow < height; nextRow++) {
+			_BlurRow(bits + nextRow * rowBytes, &ring[(nextRow % ringSize) * rowBytes],
+				width, gaussianKernel, radiusInt);
 		}
-	}
 
-	std::vector<unsigned char> horizontalBlurredData = result.Data();
+		unsigned char* row = bits + y * rowBytes;
 
-	// Vertical blur pass
-	for (int y = 0; y < bitmap.Height(); y++) {
-		for (int x = 0; x < bitmap.Width(); x++) {
+		for (int x = 0; x < width; x++) {
 			double redAccumulator = 0, greenAccumulator = 0, blueAccumulator = 0, alphaAccumulator = 0;
 			double weightAccumulator = 0;
 
 			for (int k = -radiusInt; k < (radiusInt + 1); k++) {
-				if (((y + k) > 0) && ((y + k) < bitmap.Height())) {
-					int index = (((y + k) * bitmap.Width()) + x) * 4;
-					redAccumulator   += horizontalBlurredData[index] * gaussianKernel[k + radiusInt];
-					greenAccumulator += horizontalBlurredData[index + 1] * gaussianKernel[k + radiusInt];
-					blueAccumulator  += horizontalBlurredData[index + 2] * gaussianKernel[k + radiusInt];
-					alphaAccumulator += horizontalBlurredData[index + 3] * gaussianKernel[k + radiusInt];
+				if (((y + k) > 0) && ((y + k) < height)) {
+					const unsigned char* p = &ring[((y + k) % ringSize) * rowBytes + x * 4];
+					redAccumulator   += p[0] * gaussianKernel[k + radiusInt];
+					greenAccumulator += p[1] * gaussianKernel[k + radiusInt];
+					blueAccumulator  += p[2] * gaussianKernel[k + radiusInt];
+					alphaAccumulator += p[3] * gaussianKernel[k + radiusInt];
 					weightAccumulator += gaussianKernel[k + radiusInt];
 				}
 			}
 
-			result.SetPixelComponent(x, y, 0, static_cast<unsigned char>(floor(redAccumulator / weightAccumulator)));
-			result.SetPixelComponent(x, y, 1, static_cast<unsigned char>(floor(greenAccumulator / weightAccumulator)));
-			result.SetPixelComponent(x, y, 2, static_cast<unsigned char>(floor(blueAccumulator / weightAccumulator)));
-			result.SetPixelComponent(x, y, 3, static_cast<unsigned char>(floor(alphaAccumulator / weightAccumulator)));
-		}
-	}
-
-	// Selective blur: preserve edges
-	for (int y = 0; y < bitmap.Height(); y++) {
-		for (int x = 0; x < bitmap.Width(); x++) {
-			int difference = abs(result.GetPixelComponent(x, y, 0) - bitmap.GetPixelComponent(x, y, 0)) +
-							abs(result.GetPixelComponent(x, y, 1) - bitmap.GetPixelComponent(x, y, 1)) +
-							abs(result.GetPixelComponent(x, y, 2) - bitmap.GetPixelComponent(x, y, 2)) +
-							abs(result.GetPixelComponent(x, y, 3) - bitmap.GetPixelComponent(x, y, 3));
-
-			if (difference > deltaInt) {
-				result.SetPixelComponent(x, y, 0, bitmap.GetPixelComponent(x, y, 0));
-				result.SetPixelComponent(x, y, 1, bitmap.GetPixelComponent(x, y, 1));
-				result.SetPixelComponent(x, y, 2, bitmap.GetPixelComponent(x, y, 2));
-				result.SetPixelComponent(x, y, 3, bitmap.GetPixelComponent(x, y, 3));
+			unsigned char blurred[4];
+			blurred[0] = static_cast<unsigned char>(floor(redAccumulator / weightAccumulator));
+			blurred[1] = static_cast<unsigned char>(floor(greenAccumulator / weightAccumulator));
+			blurred[2] = static_cast<unsigned char>(floor(blueAccumulator / weightAccumulator));
+			blurred[3] = static_cast<unsigned char>(floor(alphaAccumulator / weightAccumulator));
+
+			// Selective blur: preserve edges
+			unsigned char* pixel = row + x * 4;
+			int difference = abs(blurred[0] - pixel[0]) + abs(blurred[1] - pixel[1]) +
+							abs(blurred[2] - pixel[2]) + abs(blurred[3] - pixel[3]);
+
+			if (difference <= deltaInt) {
+				pixel[0] = blurred[0];
+				pixel[1] = blurred[1];
+				pixel[2] = blurred[2];
+				pixel[3] = blurred[3];
 			}
 		}
 	}
-
-	return result;
 }
@@ -17,8 +17,17 @@ public:
 	BitmapData				BlurBitmap(const BitmapData& bitmap,
 									float radius, float delta);
 
+	// Blurs an owned bitmap without allocating a second full-size buffer;
+	// the result is identical to BlurBitmap().
+	void					BlurBitmapInPlace(BitmapData& bitmap,
+									float radius, float delta);
+
 private:
 	std::vector<double>		_GenerateGaussianKernel(int radius);
+	void					_BlurRow(const unsigned char* source,
+									unsigned char* target, int width,
+									const std::vector<double>& kernel,
+									int radius);
 };
 
 #endif
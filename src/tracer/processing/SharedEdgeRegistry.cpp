@@ -116,7 +116,7 @@ SharedEdgeRegistry::RegisterPaths(
 
 				if (type == 1 && seg.size() >= 5) {
 					_RegisterPoint(seg[3], seg[4], k, i, j, 1);
-				} else if (type == 2 && seg.size() >= 7) {
+				} else if (type >= 2 && seg.size() >= 7) {
 					_RegisterPoint(seg[5], seg[6], k, i, j, 2);
 				}
 			}
@@ -31,6 +31,8 @@ public:
 
 	void					GetSharedSegmentMask(int layer, int path, std::vector<bool>& sharedMask) const;
 
+	size_t					PointCount() const { return fPoints.size(); }
+
 private:
 	struct PointKey {
 		int gx, gy;
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2025, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef TILE_SEAMS_H
+#define TILE_SEAMS_H
+
+#include <vector>
+
+// The lines a tile was cut along, in the coordinates of its outlines:
+// x = Left() and Right(), y = Top() and Bottom(). A side that is an edge
+// of the image is no seam and lies at infinity.
+//
+// Outlines on both sides of a seam only meet if the points they have on
+// it stay where the scanner put them. Stages that simplify outlines keep
+// every point on a seam, and fits end at anchors, the points where an
+// outline joins or leaves a seam.
+class TileSeams {
+public:
+							TileSeams(double left, double top, double right,
+								double bottom)
+								: fLeft(left), fTop(top), fRight(right),
+								  fBottom(bottom) {}
+
+	double					Left() const { return fLeft; }
+	double					Top() const { return fTop; }
+	double					Right() const { return fRight; }
+	double					Bottom() const { return fBottom; }
+
+	bool					OnVertical(double x) const
+								{ return x == fLeft || x == fRight; }
+	bool					OnHorizontal(double y) const
+								{ return y == fTop || y == fBottom; }
+	bool					Contains(double x, double y) const
+								{ return OnVertical(x) || OnHorizontal(y); }
+
+	bool					Contains(const std::vector<double>& point) const
+								{ return Contains(point[0], point[1]); }
+
+	bool					IsAnchor(const std::vector<double>& previous,
+								const std::vector<double>& point,
+								const std::vector<double>& next) const
+	{
+		return (OnVertical(point[0])
+				&& (previous[0] != point[0] || next[0] != point[0]))
+			|| (OnHorizontal(point[1])
+				&& (previous[1] != point[1] || next[1] != point[1]));
+	}
+
+	bool					Touches(const std::vector<std::vector<double> >& points) const
+	{
+		for (size_t i = 0; i < points.size(); i++) {
+			if (Contains(points[i]))
+				return true;
+		}
+		return false;
+	}
+
+private:
+	double					fLeft;
+	double					fTop;
+	double					fRight;
+	double					fBottom;
+};
+
+#endif
@@ -12,7 +12,7 @@
 static const int kMaxNodes = 266817;
 static const int kMaxTreeDepth = 8;
 
-ColorCube::ColorCube(const std::vector<std::vector<int> >& pixels, int maxColors, int skipValue)
+ColorCube::ColorCube(const PackedPixelView& pixels, int maxColors, int skipValue)
 	: fPixels(pixels)
 	, fMaxColors(maxColors)
 	, fColors(0)
@@ -43,12 +43,12 @@ ColorCube::~ColorCube()
 void
 ColorCube::ClassifyColors()
 {
-	int height = fPixels.size();
-	int width = fPixels[0].size();
+	int height = fPixels.Height();
+	int width = fPixels.Width();
 
 	for (int y = 0; y < height; y++) {
 		for (int x = 0; x < width; x++) {
-			int pixel = fPixels[y][x];
+			int pixel = fPixels.Pixel(x, y);
 
 			if (pixel == fSkipValue)
 				continue;
@@ -105,14 +105,14 @@ ColorCube::AssignColors()
 	fColors = 0;
 	fRoot->CreateColormap();
 
-	int height = fPixels.size();
-	int width = fPixels[0].size();
+	int height = fPixels.Height();
+	int width = fPixels.Width();
 
 	ColorSearchResult search;
 
 	for (int y = 0; y < height; y++) {
 		for (int x = 0; x < width; x++) {
-			int pixel = fPixels[y][x];
+			int pixel = fPixels.Pixel(x, y);
 
 			if (pixel == fSkipValue)
 				continue;
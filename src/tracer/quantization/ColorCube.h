@@ -7,6 +7,7 @@
 #define COLOR_CUBE_H
 
 #include <vector>
+#include "BitmapData.h"
 #include "MathUtils.h"
 
 class ColorNode;
@@ -20,7 +21,7 @@ struct ColorSearchResult {
 
 class ColorCube {
 public:
-							ColorCube(const std::vector<std::vector<int> >& pixels, int maxColors, int skipValue = 2147483647);
+							ColorCube(const PackedPixelView& pixels, int maxColors, int skipValue = 2147483647);
 							~ColorCube();
 
 	void					ClassifyColors();
@@ -32,7 +33,7 @@ public:
 private:
 	friend class ColorNode;
 
-	std::vector<std::vector<int> > fPixels;
+	PackedPixelView			fPixels;
 	int						fMaxColors;
 	std::vector<int>		fColormap;
 
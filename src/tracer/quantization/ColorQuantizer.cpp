@@ -28,7 +28,7 @@ ColorQuantizer::QuantizeImage(const std::vector<std::vector<int> >& pixels, int
 {
 	MathUtils::Init();
 
-	ColorCube cube(pixels, maxColors);
+	ColorCube cube(PackedPixelView(pixels), maxColors);
 	cube.ClassifyColors();
 	cube.ReduceColors();
 	cube.AssignColors();
@@ -37,6 +37,12 @@ ColorQuantizer::QuantizeImage(const std::vector<std::vector<int> >& pixels, int
 
 std::vector<int>
 ColorQuantizer::QuantizeImageMasked(const std::vector<std::vector<int> >& pixels, int maxColors, int skipValue)
+{
+	return QuantizeImageMasked(PackedPixelView(pixels), maxColors, skipValue);
+}
+
+std::vector<int>
+ColorQuantizer::QuantizeImageMasked(const PackedPixelView& pixels, int maxColors, int skipValue)
 {
 	MathUtils::Init();
 
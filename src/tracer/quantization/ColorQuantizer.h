@@ -23,6 +23,9 @@ public:
 	std::vector<int>	QuantizeImageMasked(const std::vector<std::vector<int> >& pixels,
 									int maxColors,
 									int skipValue);
+	std::vector<int>	QuantizeImageMasked(const PackedPixelView& pixels,
+									int maxColors,
+									int skipValue);
 
 	IndexedBitmap		QuantizeColors(const BitmapData& bitmap,
 									const std::vector<std::vector<unsigned char> >& palette,
@@ -3,11 +3,14 @@
  * Distributed under the terms of the MIT License.
  */
 
+#include <algorithm>
+
 #include "MathUtils.h"
 
 bool MathUtils::sInitialized = false;
 int MathUtils::sSquares[512];
 int MathUtils::sShift[9];
+double MathUtils::sSRGBToLinear[256];
 const double MathUtils::MAX_DISTANCE = 999999.0;
 
 void
@@ -26,6 +29,9 @@ MathUtils::_InitTables()
 	for (int i = 0; i < 9; i++)
 		sShift[i] = 1 << (15 - i);
 
+	for (int i = 0; i < 256; i++)
+		sSRGBToLinear[i] = SRGBToLinear((double)i);
+
 	sInitialized = true;
 }
 
@@ -121,6 +127,59 @@ MathUtils::Solve3x3Normalized(double M[3][3], double B[3], double X[3])
 	return true;
 }
 
+bool
+MathUtils::Solve5x5(double M[5][5], double B[5], double X[5])
+{
+	int i, j, k;
+	double A[5][6];
+	double scale = 0.0;
+	for (i = 0; i < 5; i++) {
+		for (j = 0; j < 5; j++) {
+			A[i][j] = M[i][j];
+			scale = std::max(scale, std::fabs(M[i][j]));
+		}
+		A[i][5] = B[i];
+	}
+	if (scale < 1e-100) scale = 1.0;
+
+	for (i = 0; i < 5; i++) {
+		int piv = i;
+		double maxabs = std::fabs(A[i][i]);
+		for (k = i + 1; k < 5; k++) {
+			double v = std::fabs(A[k][i]);
+			if (v > maxabs) {
+				maxabs = v;
+				piv = k;
+			}
+		}
+
+		if (maxabs < 1e-12 * scale)
+			return false;
+
+		if (piv != i) {
+			for (j = i; j < 6; j++)
+				std::swap(A[i][j], A[piv][j]);
+		}
+
+		double diag = A[i][i];
+		for (j = i; j < 6; j++)
+			A[i][j] /= diag;
+
+		for (k = 0; k < 5; k++) {
+			if (k != i) {
+				double f = A[k][i];
+				for (j = i; j < 6; j++)
+					A[k][j] -= f * A[i][j];
+			}
+		}
+	}
+
+	for (i = 0; i < 5; i++)
+		X[i] = A[i][5];
+
+	return true;
+}
+
 double
 MathUtils::SRGBToLinear(double v)
 {
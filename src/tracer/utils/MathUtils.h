@@ -29,10 +29,17 @@ public:
 
 	static bool					Solve3x3(double M[3][3], double B[3], double X[3]);
 	static bool					Solve3x3Normalized(double M[3][3], double B[3], double X[3]);
+	static bool					Solve5x5(double M[5][5], double B[5], double X[5]);
 
 	static double				SRGBToLinear(double v);
 	static double				LinearToSRGB(double v);
 
+	static inline double		SRGBToLinearLUT(unsigned char v)
+	{
+		Init();
+		return sSRGBToLinear[v];
+	}
+
 	static double				LumaD(double r, double g, double b);
 
 	static double				CalculateSaturation(unsigned char r, unsigned char g, unsigned char b);
@@ -78,6 +85,7 @@ private:
 	static bool					sInitialized;
 	static int					sSquares[512];
 	static int					sShift[9];
+	static double				sSRGBToLinear[256];
 };
 
 #endif